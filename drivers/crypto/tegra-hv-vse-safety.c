@@ -1125,6 +1125,108 @@ exit:
 	return err;
 }
 
+/*
+ * Map the source of a hash request for DMA. Behind an IOMMU the entries
+ * of a scatterlist are usually merged into one IOVA range, which the
+ * server can hash in place instead of going through sha_buf.
+ */
+static int tegra_hv_vse_safety_sha_map_src(struct tegra_virtual_se_dev *se_dev,
+				struct ahash_request *req)
+{
+	struct tegra_virtual_se_req_context *req_ctx = ahash_request_ctx(req);
+	struct scatterlist *sg;
+	dma_addr_t start, end;
+	int mapped, i;
+
+	req_ctx->src_nents = sg_nents_for_len(req->src, req->nbytes);
+	if (req_ctx->src_nents <= 0)
+		return -EINVAL;
+
+	mapped = dma_map_sg(se_dev->dev, req->src, req_ctx->src_nents,
+			DMA_TO_DEVICE);
+	if (!mapped)
+		return -ENOMEM;
+
+	start = sg_dma_address(req->src);
+	end = start;
+	for_each_sg(req->src, sg, mapped, i) {
+		if (sg_dma_address(sg) != end)
+			goto unmap;
+		end += sg_dma_len(sg);
+	}
+
+	/* the server takes a 32-bit address */
+	if (end - start < req->nbytes || upper_32_bits(end - 1))
+		goto unmap;
+
+	req_ctx->src_mapped = true;
+	return 0;
+
+unmap:
+	dma_unmap_sg(se_dev->dev, req->src, req_ctx->src_nents, DMA_TO_DEVICE);
+	return -EINVAL;
+}
+
+static void tegra_hv_vse_safety_sha_unmap_src(
+				struct tegra_virtual_se_dev *se_dev,
+				struct ahash_request *req)
+{
+	struct tegra_virtual_se_req_context *req_ctx = ahash_request_ctx(req);
+
+	if (!req_ctx->src_mapped)
+		return;
+
+	dma_unmap_sg(se_dev->dev, req->src, req_ctx->src_nents, DMA_TO_DEVICE);
+	req_ctx->src_mapped = false;
+}
+
+/* Hash a block aligned DMA range, split at the server buffer limit */
+static int tegra_hv_vse_safety_sha_send_dma(struct ahash_request *req,
+				dma_addr_t addr, u32 len)
+{
+	struct tegra_virtual_se_dev *se_dev = g_virtual_se_dev[VIRTUAL_SE_SHA];
+	struct tegra_virtual_se_req_context *req_ctx = ahash_request_ctx(req);
+	struct tegra_virtual_se_ivc_msg_t *ivc_req_msg;
+	struct tegra_virtual_se_ivc_tx_msg_t *ivc_tx;
+	u32 max_len, chunk;
+	int err = 0;
+
+	max_len = rounddown(TEGRA_VIRTUAL_SE_MAX_BUFFER_SIZE - 1,
+			req_ctx->blk_size);
+
+	ivc_req_msg = devm_kzalloc(se_dev->dev, sizeof(*ivc_req_msg),
+			GFP_KERNEL);
+	if (!ivc_req_msg)
+		return -ENOMEM;
+
+	while (len) {
+		chunk = min(len, max_len);
+
+		memset(ivc_req_msg, 0, sizeof(*ivc_req_msg));
+		ivc_tx = &ivc_req_msg->tx[0];
+		ivc_tx->sha.op_hash.src_addr.lo = (u32)addr;
+		ivc_tx->sha.op_hash.src_addr.hi = chunk;
+		ivc_tx->sha.op_hash.dst = (u64)req_ctx->hash_result_addr;
+		memcpy(ivc_tx->sha.op_hash.hash, req_ctx->hash_result,
+			req_ctx->intermediate_digest_size);
+
+		req_ctx->total_count += chunk;
+
+		err = tegra_hv_vse_safety_send_sha_data(se_dev, req,
+				ivc_req_msg, chunk, false);
+		if (err) {
+			dev_err(se_dev->dev, "%s error %d\n", __func__, err);
+			break;
+		}
+
+		addr += chunk;
+		len -= chunk;
+	}
+
+	devm_kfree(se_dev->dev, ivc_req_msg);
+	return err;
+}
+
 static int tegra_hv_vse_safety_sha_fast_path(struct ahash_request *req,
 					bool is_last, bool process_cur_req)
 {
@@ -1189,7 +1291,15 @@ static int tegra_hv_vse_safety_sha_fast_path(struct ahash_request *req,
 		dev_dbg(se_dev->dev, "%s: req_ctx->residual_bytes %u\n",
 			__func__, req_ctx->residual_bytes);
 
-		if (num_blks > 0) {
+		if (num_blks > 0 && req_ctx->src_mapped) {
+			/* whole update in place, no copy through sha_buf */
+			bytes_process_in_req = num_blks * req_ctx->blk_size;
+			err = tegra_hv_vse_safety_sha_send_dma(req,
+					sg_dma_address(req->src),
+					bytes_process_in_req);
+			if (err)
+				return err;
+		} else if (num_blks > 0) {
 			ivc_req_msg = devm_kzalloc(se_dev->dev,
 				sizeof(*ivc_req_msg), GFP_KERNEL);
 			if (!ivc_req_msg)
@@ -1540,7 +1650,14 @@ static int tegra_hv_vse_safety_sha_op(struct ahash_request *req, bool is_last,
 
 	num_blks = req->nbytes / req_ctx->blk_size;
 
-	if (sg_nents(req->src) > 1)
+	/*
+	 * A scatterlist with several entries can still take the fast path
+	 * if it maps to one DMA range, otherwise it is copied to sha_buf.
+	 */
+	req_ctx->src_mapped = false;
+	if (req_ctx->force_align == false && num_blks > 0 &&
+			sg_nents(req->src) > 1 &&
+			tegra_hv_vse_safety_sha_map_src(se_dev, req))
 		req_ctx->force_align = true;
 
 	if (req_ctx->force_align == false && num_blks > 0)
@@ -1548,6 +1665,8 @@ static int tegra_hv_vse_safety_sha_op(struct ahash_request *req, bool is_last,
 	else
 		ret = tegra_hv_vse_safety_sha_slow_path(req, is_last, process_cur_req);
 
+	tegra_hv_vse_safety_sha_unmap_src(se_dev, req);
+
 	return ret;
 }
 
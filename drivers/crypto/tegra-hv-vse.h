@@ -157,6 +157,8 @@ struct tegra_virtual_se_req_context {
 	bool is_first;			/* Represents first block */
 	bool req_context_initialized;	/* Mark initialization status */
 	bool force_align;		/* Enforce buffer alignment */
+	bool src_mapped;		/* Source mapped to one DMA range */
+	int src_nents;			/* Source entries mapped for DMA */
 	/*Crypto dev instance*/
 	uint32_t node_id;
 };
@@ -31,8 +31,8 @@ struct tegra_aes_ctx {
 	struct tegra_se *se;
 	u32 alg;
 	u32 ivsize;
-	u32 key1_id;
-	u32 key2_id;
+	struct tegra_se_key *key1;
+	struct tegra_se_key *key2;
 };
 
 struct tegra_aes_reqctx {
@@ -52,7 +52,9 @@ struct tegra_aead_ctx {
 	unsigned int authsize;
 	u32 alg;
 	u32 keylen;
+	/* keyslot of key while a request is executing */
 	u32 key_id;
+	struct tegra_se_key *key;
 };
 
 struct tegra_aead_reqctx {
@@ -77,7 +79,9 @@ struct tegra_cmac_ctx {
 #endif
 	struct tegra_se *se;
 	unsigned int alg;
+	/* keyslot of key while a request is executing */
 	u32 key_id;
+	struct tegra_se_key *key;
 	struct crypto_shash *fallback_tfm;
 };
 
@@ -270,6 +274,7 @@ static int tegra_aes_do_one_req(struct crypto_engine *engine, void *areq)
 	struct tegra_aes_reqctx *rctx = skcipher_request_ctx(req);
 	struct tegra_se *se = ctx->se;
 	unsigned int cmdlen;
+	u32 key1_id, key2_id;
 	int ret;
 
 	/* Set buffer size as a multiple of AES_BLOCK_SIZE*/
@@ -279,6 +284,21 @@ static int tegra_aes_do_one_req(struct crypto_engine *engine, void *areq)
 	if (!rctx->datbuf.buf)
 		return -ENOMEM;
 
+	/* Load the keys into keyslots if they were evicted */
+	ret = tegra_key_get(se, ctx->key1, &key1_id);
+	if (ret)
+		goto out_free;
+
+	ret = tegra_key_get(se, ctx->key2, &key2_id);
+	if (ret) {
+		tegra_key_put(ctx->key1);
+		goto out_free;
+	}
+
+	rctx->crypto_config |= SE_AES_KEY_INDEX(key1_id);
+	if (key2_id)
+		rctx->crypto_config |= SE_AES_KEY2_INDEX(key2_id);
+
 	rctx->iv = (u32 *)req->iv;
 	rctx->len = req->cryptlen;
 
@@ -294,10 +314,14 @@ static int tegra_aes_do_one_req(struct crypto_engine *engine, void *areq)
 	cmdlen = tegra_aes_prep_cmd(se, rctx);
 	ret = tegra_se_host1x_submit(se, cmdlen);
 
+	tegra_key_put(ctx->key2);
+	tegra_key_put(ctx->key1);
+
 	/* Copy the result */
 	tegra_aes_update_iv(req, ctx);
 	scatterwalk_map_and_copy(rctx->datbuf.buf, req->dst, 0, req->cryptlen, 1);
 
+out_free:
 	/* Free the buffer */
 	dma_free_coherent(ctx->se->dev, rctx->datbuf.size,
 			  rctx->datbuf.buf, rctx->datbuf.addr);
@@ -325,8 +349,8 @@ static int tegra_aes_cra_init(struct crypto_skcipher *tfm)
 
 	ctx->ivsize = crypto_skcipher_ivsize(tfm);
 	ctx->se = se_alg->se_dev;
-	ctx->key1_id = 0;
-	ctx->key2_id = 0;
+	ctx->key1 = NULL;
+	ctx->key2 = NULL;
 
 	algname = crypto_tfm_alg_name(&tfm->base);
 	ret = se_algname_to_algid(algname);
@@ -350,11 +374,8 @@ static void tegra_aes_cra_exit(struct crypto_skcipher *tfm)
 {
 	struct tegra_aes_ctx *ctx = crypto_tfm_ctx(&tfm->base);
 
-	if (ctx->key1_id)
-		tegra_key_invalidate(ctx->se, ctx->key1_id, ctx->alg);
-
-	if (ctx->key2_id)
-		tegra_key_invalidate(ctx->se, ctx->key2_id, ctx->alg);
+	tegra_key_invalidate(ctx->se, ctx->key1);
+	tegra_key_invalidate(ctx->se, ctx->key2);
 }
 
 static int tegra_aes_setkey(struct crypto_skcipher *tfm,
@@ -367,7 +388,7 @@ static int tegra_aes_setkey(struct crypto_skcipher *tfm,
 		return -EINVAL;
 	}
 
-	return tegra_key_submit(ctx->se, key, keylen, ctx->alg, &ctx->key1_id);
+	return tegra_key_submit(ctx->se, key, keylen, ctx->alg, &ctx->key1);
 }
 
 static int tegra_xts_setkey(struct crypto_skcipher *tfm,
@@ -384,12 +405,12 @@ static int tegra_xts_setkey(struct crypto_skcipher *tfm,
 	}
 
 	ret = tegra_key_submit(ctx->se, key, len,
-			       ctx->alg, &ctx->key1_id);
+			       ctx->alg, &ctx->key1);
 	if (ret)
 		return ret;
 
 	return tegra_key_submit(ctx->se, key + len, len,
-			       ctx->alg, &ctx->key2_id);
+			       ctx->alg, &ctx->key2);
 
 	return 0;
 }
@@ -462,10 +483,6 @@ static int tegra_aes_crypt(struct skcipher_request *req, bool encrypt)
 	rctx->encrypt = encrypt;
 	rctx->config = tegra234_aes_cfg(ctx->alg, encrypt);
 	rctx->crypto_config = tegra234_aes_crypto_cfg(ctx->alg, encrypt);
-	rctx->crypto_config |= SE_AES_KEY_INDEX(ctx->key1_id);
-
-	if (ctx->key2_id)
-		rctx->crypto_config |= SE_AES_KEY2_INDEX(ctx->key2_id);
 
 	return crypto_transfer_skcipher_request_to_engine(ctx->se->engine, req);
 }
@@ -1188,6 +1205,10 @@ static int tegra_ccm_do_one_req(struct crypto_engine *engine, void *areq)
 	if (!rctx->inbuf.buf)
 		return -ENOMEM;
 
+	ret = tegra_key_get(se, ctx->key, &ctx->key_id);
+	if (ret)
+		goto key_err;
+
 	rctx->outbuf.size = rctx->assoclen + rctx->authsize + rctx->cryptlen + 100;
 	rctx->outbuf.buf = dma_alloc_coherent(ctx->se->dev, rctx->outbuf.size,
 					      &rctx->outbuf.addr, GFP_KERNEL);
@@ -1228,6 +1249,9 @@ out:
 			  rctx->outbuf.buf, rctx->outbuf.addr);
 
 outbuf_err:
+	tegra_key_put(ctx->key);
+
+key_err:
 	dma_free_coherent(ctx->se->dev, rctx->inbuf.size,
 			  rctx->inbuf.buf, rctx->inbuf.addr);
 
@@ -1261,6 +1285,9 @@ static int tegra_gcm_do_one_req(struct crypto_engine *engine, void *areq)
 	if (!rctx->inbuf.buf)
 		return -ENOMEM;
 
+	ret = tegra_key_get(ctx->se, ctx->key, &ctx->key_id);
+	if (ret)
+		goto key_err;
 
 	rctx->outbuf.size = rctx->assoclen + rctx->authsize + rctx->cryptlen;
 	rctx->outbuf.buf = dma_alloc_coherent(ctx->se->dev, rctx->outbuf.size,
@@ -1300,6 +1327,9 @@ out:
 			  rctx->outbuf.buf, rctx->outbuf.addr);
 
 outbuf_err:
+	tegra_key_put(ctx->key);
+
+key_err:
 	dma_free_coherent(ctx->se->dev, rctx->inbuf.size,
 			  rctx->inbuf.buf, rctx->inbuf.addr);
 
@@ -1329,6 +1359,7 @@ static int tegra_ccm_cra_init(struct crypto_aead *tfm)
 
 	ctx->se = se_alg->se_dev;
 	ctx->key_id = 0;
+	ctx->key = NULL;
 
 	ret = se_algname_to_algid(algname);
 	if (ret < 0) {
@@ -1367,6 +1398,7 @@ static int tegra_gcm_cra_init(struct crypto_aead *tfm)
 
 	ctx->se = se_alg->se_dev;
 	ctx->key_id = 0;
+	ctx->key = NULL;
 
 	ret = se_algname_to_algid(algname);
 	if (ret < 0) {
@@ -1424,8 +1456,7 @@ static void tegra_aead_cra_exit(struct crypto_aead *tfm)
 {
 	struct tegra_aead_ctx *ctx = crypto_tfm_ctx(&tfm->base);
 
-	if (ctx->key_id)
-		tegra_key_invalidate(ctx->se, ctx->key_id, ctx->alg);
+	tegra_key_invalidate(ctx->se, ctx->key);
 }
 
 static int tegra_aead_crypt(struct aead_request *req, bool encrypt)
@@ -1459,7 +1490,7 @@ static int tegra_aead_setkey(struct crypto_aead *tfm,
 		return -EINVAL;
 	}
 
-	return tegra_key_submit(ctx->se, key, keylen, ctx->alg, &ctx->key_id);
+	return tegra_key_submit(ctx->se, key, keylen, ctx->alg, &ctx->key);
 }
 
 static unsigned int tegra_cmac_prep_cmd(struct tegra_se *se, struct tegra_cmac_reqctx *rctx)
@@ -1675,6 +1706,10 @@ static int tegra_cmac_do_one_req(struct crypto_engine *engine, void *areq)
 	struct tegra_se *se = ctx->se;
 	int ret;
 
+	ret = tegra_key_get(se, ctx->key, &ctx->key_id);
+	if (ret)
+		goto out;
+
 	if (rctx->task & SHA_UPDATE) {
 		ret = tegra_cmac_do_update(req);
 		rctx->task &= ~SHA_UPDATE;
@@ -1685,6 +1720,9 @@ static int tegra_cmac_do_one_req(struct crypto_engine *engine, void *areq)
 		rctx->task &= ~SHA_FINAL;
 	}
 
+	tegra_key_put(ctx->key);
+
+out:
 	crypto_finalize_hash_request(se->engine, req, ret);
 
 	return 0;
@@ -1729,6 +1767,7 @@ static int tegra_cmac_cra_init(struct crypto_tfm *tfm)
 
 	ctx->se = se_alg->se_dev;
 	ctx->key_id = 0;
+	ctx->key = NULL;
 
 	ret = se_algname_to_algid(algname);
 	if (ret < 0) {
@@ -1756,7 +1795,7 @@ static void tegra_cmac_cra_exit(struct crypto_tfm *tfm)
 	if (ctx->fallback_tfm)
 		crypto_free_shash(ctx->fallback_tfm);
 
-	tegra_key_invalidate(ctx->se, ctx->key_id, ctx->alg);
+	tegra_key_invalidate(ctx->se, ctx->key);
 }
 
 static int tegra_cmac_init(struct ahash_request *req)
@@ -1801,7 +1840,7 @@ static int tegra_cmac_setkey(struct crypto_ahash *tfm, const u8 *key,
 	if (ctx->fallback_tfm)
 		crypto_shash_setkey(ctx->fallback_tfm, key, keylen);
 
-	return tegra_key_submit(ctx->se, key, keylen, ctx->alg, &ctx->key_id);
+	return tegra_key_submit(ctx->se, key, keylen, ctx->alg, &ctx->key);
 }
 
 static int tegra_cmac_update(struct ahash_request *req)
@@ -29,7 +29,7 @@ struct tegra_sha_ctx {
 	struct tegra_se *se;
 	unsigned int alg;
 	bool fallback;
-	u32 key_id;
+	struct tegra_se_key *key;
 	struct crypto_ahash *fallback_tfm;
 };
 
@@ -437,6 +437,11 @@ static int tegra_sha_do_one_req(struct crypto_engine *engine, void *areq)
 	struct tegra_se *se = ctx->se;
 	int ret = 0;
 
+	/* HMAC key, loaded into a keyslot if it was evicted */
+	ret = tegra_key_get(se, ctx->key, &rctx->key_id);
+	if (ret)
+		goto out;
+
 	if (rctx->task & SHA_UPDATE) {
 		ret = tegra_sha_do_update(req);
 		rctx->task &= ~SHA_UPDATE;
@@ -447,6 +452,9 @@ static int tegra_sha_do_one_req(struct crypto_engine *engine, void *areq)
 		rctx->task &= ~SHA_FINAL;
 	}
 
+	tegra_key_put(ctx->key);
+
+out:
 	crypto_finalize_hash_request(se->engine, req, ret);
 
 	return 0;
@@ -498,7 +506,7 @@ static int tegra_sha_cra_init(struct crypto_tfm *tfm)
 
 	ctx->se = se_alg->se_dev;
 	ctx->fallback = false;
-	ctx->key_id = 0;
+	ctx->key = NULL;
 
 	ret = se_algname_to_algid(algname);
 	if (ret < 0) {
@@ -527,7 +535,7 @@ static void tegra_sha_cra_exit(struct crypto_tfm *tfm)
 	if (ctx->fallback_tfm)
 		crypto_free_ahash(ctx->fallback_tfm);
 
-	tegra_key_invalidate(ctx->se, ctx->key_id, ctx->alg);
+	tegra_key_invalidate(ctx->se, ctx->key);
 }
 
 static int tegra_sha_init(struct ahash_request *req)
@@ -543,7 +551,6 @@ static int tegra_sha_init(struct ahash_request *req)
 	rctx->total_len = 0;
 	rctx->datbuf.size = 0;
 	rctx->residue.size = 0;
-	rctx->key_id = ctx->key_id;
 	rctx->task = SHA_FIRST;
 	rctx->alg = ctx->alg;
 	rctx->blk_size = crypto_ahash_blocksize(tfm);
@@ -590,7 +597,7 @@ static int tegra_hmac_setkey(struct crypto_ahash *tfm, const u8 *key,
 
 	ctx->fallback = false;
 
-	return tegra_key_submit(ctx->se, key, keylen, ctx->alg, &ctx->key_id);
+	return tegra_key_submit(ctx->se, key, keylen, ctx->alg, &ctx->key);
 }
 
 static int tegra_sha_update(struct ahash_request *req)
@@ -5,7 +5,12 @@
  */
 
 #include <linux/bitops.h>
+#include <linux/debugfs.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
 #include <linux/module.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
 #include <crypto/aes.h>
 
 #include "tegra-se.h"
@@ -16,36 +21,61 @@
 #define SE_KEY_RSVD_MASK		(BIT(0) | BIT(14) | BIT(15))
 #define SE_KEY_VALID_MASK		(SE_KEY_FULL_MASK & ~SE_KEY_RSVD_MASK)
 
-/* Mutex lock to guard keyslots */
+#define SE_KEY_HASH_BITS		6
+
+/*
+ * Keyslots are a cache of key material. A tfm holds a reference to a key
+ * entry, not to a slot; tfms with identical key material and algorithm
+ * share one entry. A request pins the entry and loads it into a slot if
+ * needed, evicting the least recently used unpinned key when no slot is
+ * free. Keys are zeroed in their slot when the last tfm drops them.
+ */
+struct tegra_se_key {
+	struct hlist_node node;
+	/* on tegra_key_lru while loaded and not pinned */
+	struct list_head lru;
+	u32 hash;
+	unsigned int users;
+	unsigned int pins;
+	u32 slot;
+	u32 alg;
+	u32 keylen;
+	u32 key[AES_MAX_KEY_SIZE / sizeof(u32)];
+};
+
+/* Mutex lock to guard the key entries */
 static DEFINE_MUTEX(kslt_lock);
+static DEFINE_HASHTABLE(tegra_key_hash, SE_KEY_HASH_BITS);
+static LIST_HEAD(tegra_key_lru);
+
+static struct {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+	unsigned long shared;
+} tegra_key_stats;
 
 /* Keyslot bitmask (0 = available, 1 = in use/not available) */
-static u16 tegra_se_keyslots = SE_KEY_RSVD_MASK;
+static unsigned long tegra_se_keyslots = SE_KEY_RSVD_MASK;
 
 static u16 tegra_keyslot_alloc(void)
 {
-	u16 keyid;
-
-	mutex_lock(&kslt_lock);
-	/* Check if all key slots are full */
-	if (tegra_se_keyslots == GENMASK(SE_MAX_KEYSLOT, 0)) {
-		mutex_unlock(&kslt_lock);
-		return 0;
-	}
-
-	keyid = ffz(tegra_se_keyslots);
-	tegra_se_keyslots |= BIT(keyid);
+	unsigned long keyid;
 
-	mutex_unlock(&kslt_lock);
+	/* Claim the first free slot, retry if another CPU got there first */
+	do {
+		keyid = find_first_zero_bit(&tegra_se_keyslots,
+					    SE_MAX_KEYSLOT + 1);
+		if (keyid > SE_MAX_KEYSLOT)
+			return 0;
+	} while (test_and_set_bit(keyid, &tegra_se_keyslots));
 
 	return keyid;
 }
 
 static void tegra_keyslot_free(u16 slot)
 {
-	mutex_lock(&kslt_lock);
-	tegra_se_keyslots &= ~(BIT(slot));
-	mutex_unlock(&kslt_lock);
+	clear_bit(slot, &tegra_se_keyslots);
 }
 
 static unsigned int tegra_key_prep_ins_cmd(struct tegra_se *se, u32 *cpuvaddr,
@@ -96,21 +126,6 @@ static unsigned int tegra_key_prep_ins_cmd(struct tegra_se *se, u32 *cpuvaddr,
 	return i;
 }
 
-static bool tegra_key_in_kslt(u32 keyid)
-{
-	bool ret;
-
-	if (keyid > SE_MAX_KEYSLOT)
-		return false;
-
-	mutex_lock(&kslt_lock);
-	ret = ((BIT(keyid) & SE_KEY_VALID_MASK) &&
-		(BIT(keyid) & tegra_se_keyslots));
-	mutex_unlock(&kslt_lock);
-
-	return ret;
-}
-
 static int tegra_key_insert(struct tegra_se *se, const u8 *key,
 			    u32 keylen, u16 slot, u32 alg)
 {
@@ -122,35 +137,227 @@ static int tegra_key_insert(struct tegra_se *se, const u8 *key,
 	return tegra_se_host1x_submit(se, size);
 }
 
-void tegra_key_invalidate(struct tegra_se *se, u32 keyid, u32 alg)
+static struct tegra_se_key *tegra_key_lookup(const u8 *key, u32 keylen,
+					     u32 alg, u32 hash)
+{
+	struct tegra_se_key *k;
+
+	hash_for_each_possible(tegra_key_hash, k, node, hash) {
+		if (k->hash == hash && k->alg == alg && k->keylen == keylen &&
+		    !memcmp(k->key, key, keylen))
+			return k;
+	}
+
+	return NULL;
+}
+
+/* Called with kslt_lock held */
+static void tegra_key_release(struct tegra_se *se, struct tegra_se_key *k)
 {
 	u8 zkey[AES_MAX_KEY_SIZE] = {0};
 
-	if (!keyid)
+	if (--k->users)
 		return;
 
-	/* Overwrite the key with 0s */
-	tegra_key_insert(se, zkey, AES_MAX_KEY_SIZE, keyid, alg);
+	hash_del(&k->node);
+
+	if (k->slot) {
+		WARN_ON(k->pins);
+		list_del(&k->lru);
+		/* Overwrite the key with 0s */
+		tegra_key_insert(se, zkey, AES_MAX_KEY_SIZE, k->slot, k->alg);
+		tegra_keyslot_free(k->slot);
+	}
+
+	memzero_explicit(k->key, sizeof(k->key));
+	kfree(k);
+}
+
+/**
+ * tegra_key_invalidate - Drop the reference of a tfm to its key.
+ *
+ * @se  : Security engine used to clear the keyslot.
+ * @key : Key returned by tegra_key_submit(), may be NULL.
+ */
+void tegra_key_invalidate(struct tegra_se *se, struct tegra_se_key *key)
+{
+	if (!key)
+		return;
 
-	tegra_keyslot_free(keyid);
+	mutex_lock(&kslt_lock);
+	tegra_key_release(se, key);
+	mutex_unlock(&kslt_lock);
 }
 
-int tegra_key_submit(struct tegra_se *se, const u8 *key, u32 keylen, u32 alg, u32 *keyid)
+/**
+ * tegra_key_submit - Set the key of a tfm.
+ *
+ * @se     : Security engine of the tfm.
+ * @key    : Key material.
+ * @keylen : Length of the key, at most AES_MAX_KEY_SIZE.
+ * @alg    : Algorithm the key is used for.
+ * @keyp   : Key of the tfm, replaced by the new key.
+ *
+ * The key is only loaded into a keyslot by tegra_key_get().
+ *
+ * Return : 0 if successful, -errno otherwise.
+ */
+int tegra_key_submit(struct tegra_se *se, const u8 *key, u32 keylen, u32 alg,
+		     struct tegra_se_key **keyp)
 {
-	int ret;
+	struct tegra_se_key *k;
+	u32 hash;
+
+	if (keylen > AES_MAX_KEY_SIZE)
+		return -EINVAL;
+
+	hash = jhash(key, keylen, alg);
 
-	/* Use the existing slot if it is already allocated */
-	if (!tegra_key_in_kslt(*keyid)) {
-		*keyid = tegra_keyslot_alloc();
-		if (!(*keyid)) {
-			dev_err(se->dev, "failed to allocate key slot\n");
+	mutex_lock(&kslt_lock);
+
+	k = tegra_key_lookup(key, keylen, alg, hash);
+	if (k) {
+		k->users++;
+		tegra_key_stats.shared++;
+	} else {
+		k = kzalloc(sizeof(*k), GFP_KERNEL);
+		if (!k) {
+			mutex_unlock(&kslt_lock);
 			return -ENOMEM;
 		}
+
+		INIT_LIST_HEAD(&k->lru);
+		k->hash = hash;
+		k->users = 1;
+		k->alg = alg;
+		k->keylen = keylen;
+		memcpy(k->key, key, keylen);
+		hash_add(tegra_key_hash, &k->node, hash);
 	}
 
-	ret = tegra_key_insert(se, key, keylen, *keyid, alg);
-	if (ret)
-		return ret;
+	if (*keyp)
+		tegra_key_release(se, *keyp);
+	*keyp = k;
+
+	mutex_unlock(&kslt_lock);
 
 	return 0;
 }
+
+/**
+ * tegra_key_get - Pin a key in a keyslot for a request.
+ *
+ * @se    : Security engine executing the request, used to load the key.
+ * @key   : Key of the tfm, NULL if the request uses no key.
+ * @keyid : Returns the keyslot, 0 for a NULL key.
+ *
+ * Must be paired with tegra_key_put() once the request completed.
+ *
+ * Return : 0 if successful, -EBUSY if all keyslots are pinned.
+ */
+int tegra_key_get(struct tegra_se *se, struct tegra_se_key *key, u32 *keyid)
+{
+	struct tegra_se_key *victim;
+	u16 slot;
+	int ret = 0;
+
+	*keyid = 0;
+	if (!key)
+		return 0;
+
+	mutex_lock(&kslt_lock);
+
+	if (key->slot) {
+		tegra_key_stats.hits++;
+		if (!key->pins++)
+			list_del_init(&key->lru);
+		*keyid = key->slot;
+		goto unlock;
+	}
+
+	tegra_key_stats.misses++;
+
+	slot = tegra_keyslot_alloc();
+	if (!slot) {
+		victim = list_first_entry_or_null(&tegra_key_lru,
+						  struct tegra_se_key, lru);
+		if (!victim) {
+			dev_err(se->dev, "all key slots are busy\n");
+			ret = -EBUSY;
+			goto unlock;
+		}
+
+		/* the slot is overwritten by the new key right away */
+		list_del_init(&victim->lru);
+		slot = victim->slot;
+		victim->slot = 0;
+		tegra_key_stats.evictions++;
+	}
+
+	ret = tegra_key_insert(se, (u8 *)key->key, key->keylen, slot,
+			       key->alg);
+	if (ret) {
+		tegra_keyslot_free(slot);
+		goto unlock;
+	}
+
+	key->slot = slot;
+	key->pins = 1;
+	*keyid = slot;
+
+unlock:
+	mutex_unlock(&kslt_lock);
+
+	return ret;
+}
+
+/**
+ * tegra_key_put - Unpin a key pinned by tegra_key_get().
+ *
+ * @key : Key of the tfm, may be NULL.
+ */
+void tegra_key_put(struct tegra_se_key *key)
+{
+	if (!key)
+		return;
+
+	mutex_lock(&kslt_lock);
+	if (!--key->pins)
+		list_add_tail(&key->lru, &tegra_key_lru);
+	mutex_unlock(&kslt_lock);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *tegra_key_debugfs;
+
+static int tegra_key_stats_show(struct seq_file *s, void *data)
+{
+	mutex_lock(&kslt_lock);
+	seq_printf(s, "slots in use: %u of %u\n",
+		   hweight_long(tegra_se_keyslots & SE_KEY_VALID_MASK),
+		   hweight_long(SE_KEY_VALID_MASK));
+	seq_printf(s, "hits: %lu\n", tegra_key_stats.hits);
+	seq_printf(s, "misses: %lu\n", tegra_key_stats.misses);
+	seq_printf(s, "evictions: %lu\n", tegra_key_stats.evictions);
+	seq_printf(s, "shared: %lu\n", tegra_key_stats.shared);
+	mutex_unlock(&kslt_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(tegra_key_stats);
+
+void tegra_key_debugfs_init(void)
+{
+	tegra_key_debugfs = debugfs_create_file("tegra-se-keyslots", 0444,
+						NULL, NULL,
+						&tegra_key_stats_fops);
+}
+
+void tegra_key_debugfs_exit(void)
+{
+	debugfs_remove(tegra_key_debugfs);
+}
+#else
+void tegra_key_debugfs_init(void) { }
+void tegra_key_debugfs_exit(void) { }
+#endif
@@ -436,11 +436,20 @@ static int __init tegra_se_module_init(void)
 	if (ret)
 		return ret;
 
-	return platform_driver_register(&tegra_se_driver);
+	ret = platform_driver_register(&tegra_se_driver);
+	if (ret) {
+		host1x_driver_unregister(&tegra_se_host1x_driver);
+		return ret;
+	}
+
+	tegra_key_debugfs_init();
+
+	return 0;
 }
 
 static void __exit tegra_se_module_exit(void)
 {
+	tegra_key_debugfs_exit();
 	host1x_driver_unregister(&tegra_se_host1x_driver);
 	platform_driver_unregister(&tegra_se_driver);
 }
@@ -517,13 +517,19 @@ static inline int se_algname_to_algid(const char *name)
 }
 
 /* Functions */
+struct tegra_se_key;
+
 int tegra_init_aes(struct tegra_se *se);
 int tegra_init_hash(struct tegra_se *se);
 void tegra_deinit_aes(struct tegra_se *se);
 void tegra_deinit_hash(struct tegra_se *se);
 int tegra_key_submit(struct tegra_se *se, const u8 *key,
-		     u32 keylen, u32 alg, u32 *keyid);
-void tegra_key_invalidate(struct tegra_se *se, u32 keyid, u32 alg);
+		     u32 keylen, u32 alg, struct tegra_se_key **keyp);
+void tegra_key_invalidate(struct tegra_se *se, struct tegra_se_key *key);
+int tegra_key_get(struct tegra_se *se, struct tegra_se_key *key, u32 *keyid);
+void tegra_key_put(struct tegra_se_key *key);
+void tegra_key_debugfs_init(void);
+void tegra_key_debugfs_exit(void);
 int tegra_se_host1x_submit(struct tegra_se *se, u32 size);
 
 /* HOST1x OPCODES */
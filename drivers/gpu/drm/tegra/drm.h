@@ -62,6 +62,8 @@ struct tegra_drm {
 	unsigned int num_crtcs;
 
 	struct tegra_display_hub *hub;
+
+	struct tegra_bo_cache bo_cache;
 };
 
 static inline struct host1x *tegra_drm_to_host1x(struct tegra_drm *tegra)
@@ -81,6 +83,8 @@ struct tegra_drm_context {
 	/* Only used by new UAPI. */
 	struct xarray mappings;
 	struct host1x_memory_context *memory_context;
+	/* firewall verdicts of recent gathers, NULL if not allocated */
+	struct tegra_drm_fw_cache *fw_cache;
 };
 
 struct tegra_drm_client_ops {
@@ -0,0 +1,212 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/* Copyright (c) 2024 NVIDIA Corporation */
+
+/*
+ * KUnit checks of the firewall verdict cache: a hit must skip the
+ * decode, but never let through a gather that full validation rejects.
+ */
+
+#include <kunit/test.h>
+#include <linux/sizes.h>
+
+#include "drm.h"
+#include "submit.h"
+#include "uapi.h"
+
+#define TEST_CLASS	0x5d
+#define TEST_ADDR_REG	0x10
+#define TEST_IOVA	0x100000
+#define TEST_WORDS	64
+#define TEST_PAD	4
+
+struct fw_test {
+	struct tegra_drm_client client;
+	struct tegra_drm_mapping mapping;
+	struct tegra_drm_used_mapping used;
+	struct tegra_drm_submit_data submit;
+	struct tegra_drm_fw_cache *cache;
+	/* gather starts at TEST_PAD, to check offsets relative to start */
+	u32 data[TEST_PAD + TEST_WORDS];
+};
+
+/* number of is_addr_reg calls, i.e. registers decoded by the firewall */
+static unsigned int fw_test_decoded;
+
+static int fw_test_is_addr_reg(struct device *dev, u32 class, u32 offset)
+{
+	fw_test_decoded++;
+
+	return offset == TEST_ADDR_REG;
+}
+
+static const struct tegra_drm_client_ops fw_test_ops = {
+	.is_addr_reg = fw_test_is_addr_reg,
+};
+
+/* SETCLASS, one address write, then a NONINCR of plain data */
+static void fw_test_fill(struct fw_test *t, u32 words, u32 addr, u32 fill)
+{
+	u32 *gather = &t->data[TEST_PAD];
+	u32 i;
+
+	memset(t->data, 0xff, sizeof(t->data));
+	gather[0] = (TEST_CLASS << 6);
+	gather[1] = (1 << 28) | (TEST_ADDR_REG << 16) | 1;
+	gather[2] = addr;
+	gather[3] = (2 << 28) | (0x20 << 16) | (words - 4);
+	for (i = 4; i < words; i++)
+		gather[i] = fill + i;
+}
+
+static int fw_test_validate(struct fw_test *t, u32 words, u32 *class)
+{
+	unsigned int decoded = fw_test_decoded;
+	int err;
+
+	err = tegra_drm_fw_validate(&t->client, t->cache, t->data, TEST_PAD,
+				    words, &t->submit, class);
+
+	return err ? err : fw_test_decoded - decoded;
+}
+
+static int fw_test_init(struct kunit *test)
+{
+	struct fw_test *t;
+
+	t = kunit_kzalloc(test, sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return -ENOMEM;
+
+	t->client.base.class = TEST_CLASS;
+	t->client.ops = &fw_test_ops;
+	t->mapping.iova = TEST_IOVA;
+	t->mapping.iova_end = TEST_IOVA + SZ_4K - 1;
+	t->used.mapping = &t->mapping;
+	t->submit.used_mappings = &t->used;
+	t->submit.num_used_mappings = 1;
+	t->cache = tegra_drm_fw_cache_create();
+	if (!t->cache)
+		return -ENOMEM;
+
+	fw_test_fill(t, TEST_WORDS, TEST_IOVA, 0);
+	test->priv = t;
+
+	return 0;
+}
+
+static void fw_test_exit(struct kunit *test)
+{
+	struct fw_test *t = test->priv;
+
+	tegra_drm_fw_cache_destroy(t->cache);
+}
+
+static void fw_test_hit(struct kunit *test)
+{
+	struct fw_test *t = test->priv;
+	u32 class = 0;
+
+	KUNIT_EXPECT_GT(test, fw_test_validate(t, TEST_WORDS, &class), 0);
+	KUNIT_EXPECT_EQ(test, class, TEST_CLASS);
+
+	/* the class the gather ends in comes from the cache on a hit */
+	class = 0;
+	KUNIT_EXPECT_EQ(test, fw_test_validate(t, TEST_WORDS, &class), 0);
+	KUNIT_EXPECT_EQ(test, class, TEST_CLASS);
+}
+
+static void fw_test_miss(struct kunit *test)
+{
+	struct fw_test *t = test->priv;
+	u32 class = 0;
+
+	KUNIT_EXPECT_GT(test, fw_test_validate(t, TEST_WORDS, &class), 0);
+
+	/* other starting class */
+	class = TEST_CLASS;
+	KUNIT_EXPECT_GT(test, fw_test_validate(t, TEST_WORDS, &class), 0);
+
+	/* one word changed */
+	class = 0;
+	fw_test_fill(t, TEST_WORDS, TEST_IOVA, 1);
+	KUNIT_EXPECT_GT(test, fw_test_validate(t, TEST_WORDS, &class), 0);
+
+	/* short gathers are not cached */
+	fw_test_fill(t, TEST_WORDS - 1, TEST_IOVA, 0);
+	class = 0;
+	KUNIT_EXPECT_GT(test, fw_test_validate(t, TEST_WORDS - 1, &class), 0);
+	class = 0;
+	KUNIT_EXPECT_GT(test, fw_test_validate(t, TEST_WORDS - 1, &class), 0);
+}
+
+static void fw_test_addr_recheck(struct kunit *test)
+{
+	struct fw_test *t = test->priv;
+	u32 class = 0;
+
+	KUNIT_EXPECT_GT(test, fw_test_validate(t, TEST_WORDS, &class), 0);
+
+	/* the buffer the address pointed into is no longer mapped */
+	t->mapping.iova = TEST_IOVA + SZ_4K;
+	t->mapping.iova_end = TEST_IOVA + SZ_8K - 1;
+	class = 0;
+	KUNIT_EXPECT_EQ(test, fw_test_validate(t, TEST_WORDS, &class), -EINVAL);
+
+	/* the verdict is still cached for jobs that map it */
+	t->mapping.iova = TEST_IOVA;
+	class = 0;
+	KUNIT_EXPECT_EQ(test, fw_test_validate(t, TEST_WORDS, &class), 0);
+
+	/* an unmapped address is never cached */
+	fw_test_fill(t, TEST_WORDS, TEST_IOVA + SZ_8K, 0);
+	KUNIT_EXPECT_EQ(test, fw_test_validate(t, TEST_WORDS, &class), -EINVAL);
+	KUNIT_EXPECT_EQ(test, fw_test_validate(t, TEST_WORDS, &class), -EINVAL);
+}
+
+static void fw_test_evict(struct kunit *test)
+{
+	struct fw_test *t = test->priv;
+	u32 class = 0;
+	u32 i;
+
+	/* fill the cache, 32 entries */
+	for (i = 0; i < 32; i++) {
+		fw_test_fill(t, TEST_WORDS, TEST_IOVA, i * TEST_WORDS);
+		class = 0;
+		KUNIT_EXPECT_GT(test, fw_test_validate(t, TEST_WORDS, &class), 0);
+	}
+
+	/* a hit makes the oldest entry the most recently used */
+	fw_test_fill(t, TEST_WORDS, TEST_IOVA, 0);
+	class = 0;
+	KUNIT_EXPECT_EQ(test, fw_test_validate(t, TEST_WORDS, &class), 0);
+
+	/* one more gather evicts the least recently used, the second */
+	fw_test_fill(t, TEST_WORDS, TEST_IOVA, 32 * TEST_WORDS);
+	class = 0;
+	KUNIT_EXPECT_GT(test, fw_test_validate(t, TEST_WORDS, &class), 0);
+
+	fw_test_fill(t, TEST_WORDS, TEST_IOVA, 0);
+	class = 0;
+	KUNIT_EXPECT_EQ(test, fw_test_validate(t, TEST_WORDS, &class), 0);
+
+	fw_test_fill(t, TEST_WORDS, TEST_IOVA, TEST_WORDS);
+	class = 0;
+	KUNIT_EXPECT_GT(test, fw_test_validate(t, TEST_WORDS, &class), 0);
+}
+
+static struct kunit_case fw_test_cases[] = {
+	KUNIT_CASE(fw_test_hit),
+	KUNIT_CASE(fw_test_miss),
+	KUNIT_CASE(fw_test_addr_recheck),
+	KUNIT_CASE(fw_test_evict),
+	{}
+};
+
+static struct kunit_suite fw_test_suite = {
+	.name = "tegra-drm-firewall",
+	.init = fw_test_init,
+	.exit = fw_test_exit,
+	.test_cases = fw_test_cases,
+};
+kunit_test_suite(fw_test_suite);
@@ -1,17 +1,59 @@
 // SPDX-License-Identifier: GPL-2.0-only
 /* Copyright (c) 2010-2020 NVIDIA Corporation */
 
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+
 #include "drm.h"
 #include "submit.h"
 #include "uapi.h"
 
+/* shorter gathers are cheaper to validate than to look up */
+#define FW_CACHE_MIN_WORDS	64
+#define FW_CACHE_MAX_ENTRIES	32
+#define FW_CACHE_MAX_WORDS	(64 * 1024)
+#define FW_CACHE_HASH_BITS	5
+
+/*
+ * Gather that passed the firewall. The verdict only depends on the
+ * words and the class the gather starts in, except for the values
+ * written to address registers which must point into the mappings of
+ * the job. Those are recorded in addrs and checked again on every hit.
+ */
+struct fw_cache_entry {
+	struct hlist_node node;
+	struct list_head lru;
+	u32 hash;
+	u32 words;
+	u32 class_in;
+	u32 class_out;
+	u32 num_addrs;
+	u16 *addrs;
+	u32 data[];
+};
+
+struct tegra_drm_fw_cache {
+	struct mutex lock;
+	DECLARE_HASHTABLE(table, FW_CACHE_HASH_BITS);
+	struct list_head lru;
+	u32 num_entries;
+	u32 num_words;
+};
+
 struct tegra_drm_firewall {
 	struct tegra_drm_submit_data *submit;
 	struct tegra_drm_client *client;
 	u32 *data;
+	u32 start;
 	u32 pos;
 	u32 end;
 	u32 class;
+	/* if set, records the position of each address word */
+	u16 *addrs;
+	u32 num_addrs;
 };
 
 static int fw_next(struct tegra_drm_firewall *fw, u32 *word)
@@ -57,6 +99,9 @@ static int fw_check_reg(struct tegra_drm_firewall *fw, u32 offset)
 	if (!is_addr)
 		return 0;
 
+	if (fw->addrs)
+		fw->addrs[fw->num_addrs++] = fw->pos - 1 - fw->start;
+
 	if (!fw_check_addr_valid(fw, word))
 		return -EINVAL;
 
@@ -141,17 +186,19 @@ enum {
 	HOST1X_OPCODE_EXTEND    = 0x0e,
 };
 
-int tegra_drm_fw_validate(struct tegra_drm_client *client, u32 *data, u32 start,
-			  u32 words, struct tegra_drm_submit_data *submit,
-			  u32 *job_class)
+static int fw_validate(struct tegra_drm_client *client, u32 *data, u32 start,
+		       u32 words, struct tegra_drm_submit_data *submit,
+		       u32 *job_class, u16 *addrs, u32 *num_addrs)
 {
 	struct tegra_drm_firewall fw = {
 		.submit = submit,
 		.client = client,
 		.data = data,
+		.start = start,
 		.pos = start,
 		.end = start+words,
 		.class = *job_class,
+		.addrs = addrs,
 	};
 	bool payload_valid = false;
 	u32 payload;
@@ -253,5 +300,172 @@ int tegra_drm_fw_validate(struct tegra_drm_client *client, u32 *data, u32 start,
 			return err;
 	}
 
+	if (num_addrs)
+		*num_addrs = fw.num_addrs;
+
 	return 0;
 }
+
+static struct fw_cache_entry *fw_cache_lookup(struct tegra_drm_fw_cache *cache,
+					      u32 hash, const u32 *data,
+					      u32 words, u32 class)
+{
+	struct fw_cache_entry *entry;
+
+	hash_for_each_possible(cache->table, entry, node, hash) {
+		if (entry->hash == hash && entry->words == words &&
+		    entry->class_in == class &&
+		    !memcmp(entry->data, data, words * sizeof(*data)))
+			return entry;
+	}
+
+	return NULL;
+}
+
+static bool fw_cache_check_addrs(struct fw_cache_entry *entry, const u32 *data,
+				 struct tegra_drm_submit_data *submit)
+{
+	struct tegra_drm_firewall fw = { .submit = submit };
+	u32 i;
+
+	for (i = 0; i < entry->num_addrs; i++)
+		if (!fw_check_addr_valid(&fw, data[entry->addrs[i]]))
+			return false;
+
+	return true;
+}
+
+static void fw_cache_evict(struct tegra_drm_fw_cache *cache,
+			   struct fw_cache_entry *entry)
+{
+	hash_del(&entry->node);
+	list_del(&entry->lru);
+	cache->num_entries--;
+	cache->num_words -= entry->words;
+	kfree(entry);
+}
+
+static void fw_cache_insert(struct tegra_drm_fw_cache *cache, u32 hash,
+			    const u32 *data, u32 words, u32 class_in,
+			    u32 class_out, const u16 *addrs, u32 num_addrs)
+{
+	struct fw_cache_entry *entry;
+	size_t size;
+
+	size = struct_size(entry, data, words) + num_addrs * sizeof(*addrs);
+	entry = kmalloc(size, GFP_KERNEL);
+	if (!entry)
+		return;
+
+	entry->hash = hash;
+	entry->words = words;
+	entry->class_in = class_in;
+	entry->class_out = class_out;
+	entry->num_addrs = num_addrs;
+	entry->addrs = (u16 *)&entry->data[words];
+	memcpy(entry->data, data, words * sizeof(*data));
+	memcpy(entry->addrs, addrs, num_addrs * sizeof(*addrs));
+
+	mutex_lock(&cache->lock);
+
+	/* another submit may have raced us to it */
+	if (fw_cache_lookup(cache, hash, data, words, class_in)) {
+		mutex_unlock(&cache->lock);
+		kfree(entry);
+		return;
+	}
+
+	while (cache->num_entries >= FW_CACHE_MAX_ENTRIES ||
+	       cache->num_words + words > FW_CACHE_MAX_WORDS)
+		fw_cache_evict(cache, list_last_entry(&cache->lru,
+						      struct fw_cache_entry, lru));
+
+	hash_add(cache->table, &entry->node, hash);
+	list_add(&entry->lru, &cache->lru);
+	cache->num_entries++;
+	cache->num_words += words;
+
+	mutex_unlock(&cache->lock);
+}
+
+/*
+ * Validate a gather, skipping the decode for gathers identical to one
+ * that already passed in this context. A cached gather is only reused
+ * if the values it writes to address registers still fall within the
+ * mappings of the current job, so unmapping or remapping buffers can
+ * not be used to get past the firewall.
+ */
+int tegra_drm_fw_validate(struct tegra_drm_client *client,
+			  struct tegra_drm_fw_cache *cache, u32 *data, u32 start,
+			  u32 words, struct tegra_drm_submit_data *submit,
+			  u32 *job_class)
+{
+	struct fw_cache_entry *entry;
+	u32 class_in = *job_class;
+	u32 num_addrs, hash;
+	bool cached;
+	u16 *addrs;
+	int err;
+
+	if (!cache || words < FW_CACHE_MIN_WORDS || words > FW_CACHE_MAX_WORDS)
+		return fw_validate(client, data, start, words, submit,
+				   job_class, NULL, NULL);
+
+	hash = jhash2(data + start, words, class_in);
+
+	mutex_lock(&cache->lock);
+	entry = fw_cache_lookup(cache, hash, data + start, words, class_in);
+	cached = entry;
+	if (entry && fw_cache_check_addrs(entry, data + start, submit)) {
+		list_move(&entry->lru, &cache->lru);
+		*job_class = entry->class_out;
+		mutex_unlock(&cache->lock);
+		return 0;
+	}
+	mutex_unlock(&cache->lock);
+
+	/* a cached gather that now fails is re-run to report the error */
+	addrs = cached ? NULL : kmalloc_array(words, sizeof(*addrs), GFP_KERNEL);
+	if (!addrs)
+		return fw_validate(client, data, start, words, submit,
+				   job_class, NULL, NULL);
+
+	err = fw_validate(client, data, start, words, submit, job_class,
+			  addrs, &num_addrs);
+	if (!err)
+		fw_cache_insert(cache, hash, data + start, words, class_in,
+				*job_class, addrs, num_addrs);
+
+	kfree(addrs);
+
+	return err;
+}
+
+struct tegra_drm_fw_cache *tegra_drm_fw_cache_create(void)
+{
+	struct tegra_drm_fw_cache *cache;
+
+	cache = kzalloc(sizeof(*cache), GFP_KERNEL);
+	if (!cache)
+		return NULL;
+
+	mutex_init(&cache->lock);
+	hash_init(cache->table);
+	INIT_LIST_HEAD(&cache->lru);
+
+	return cache;
+}
+
+void tegra_drm_fw_cache_destroy(struct tegra_drm_fw_cache *cache)
+{
+	struct fw_cache_entry *entry, *tmp;
+
+	if (!cache)
+		return;
+
+	list_for_each_entry_safe(entry, tmp, &cache->lru, lru)
+		fw_cache_evict(cache, entry);
+
+	mutex_destroy(&cache->lock);
+	kfree(cache);
+}
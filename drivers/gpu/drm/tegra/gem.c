@@ -13,8 +13,11 @@
 #include <nvidia/conftest.h>
 
 #include <linux/dma-buf.h>
+#include <linux/file.h>
+#include <linux/highmem.h>
 #include <linux/iommu.h>
 #include <linux/module.h>
+#include <linux/sizes.h>
 #include <linux/vmalloc.h>
 
 #include <drm/drm_drv.h>
@@ -26,6 +29,10 @@
 
 MODULE_IMPORT_NS(DMA_BUF);
 
+/* limits of the cache of freed buffer objects, per device */
+#define TEGRA_BO_CACHE_MAX_SIZE		SZ_64M
+#define TEGRA_BO_CACHE_MAX_OBJECT	SZ_8M
+
 static unsigned int sg_dma_count_chunks(struct scatterlist *sgl, unsigned int nents)
 {
 	dma_addr_t next = ~(dma_addr_t)0;
@@ -274,17 +281,25 @@ unlock:
 	return err;
 }
 
+static void __tegra_bo_iommu_unmap(struct tegra_drm *tegra, struct tegra_bo *bo)
+{
+	lockdep_assert_held(&tegra->mm_lock);
+
+	iommu_unmap(tegra->domain, bo->iova, bo->size);
+	drm_mm_remove_node(bo->mm);
+}
+
 static int tegra_bo_iommu_unmap(struct tegra_drm *tegra, struct tegra_bo *bo)
 {
 	if (!bo->mm)
 		return 0;
 
 	mutex_lock(&tegra->mm_lock);
-	iommu_unmap(tegra->domain, bo->iova, bo->size);
-	drm_mm_remove_node(bo->mm);
+	__tegra_bo_iommu_unmap(tegra, bo);
 	mutex_unlock(&tegra->mm_lock);
 
 	kfree(bo->mm);
+	bo->mm = NULL;
 
 	return 0;
 }
@@ -400,19 +415,283 @@ static int tegra_bo_alloc(struct drm_device *drm, struct tegra_bo *bo)
 	return 0;
 }
 
+/*
+ * Free a cached object. Its GEM object has already been released, but
+ * the shmem file backing the pages is still referenced by the cache.
+ */
+static void tegra_bo_cache_free(struct drm_device *drm, struct tegra_bo *bo)
+{
+	struct tegra_drm *tegra = drm->dev_private;
+
+	if (tegra->domain)
+		tegra_bo_iommu_unmap(tegra, bo);
+
+	tegra_bo_free(drm, bo);
+	fput(bo->gem.filp);
+	kfree(bo);
+}
+
+static void tegra_bo_cache_unlink(struct tegra_bo_cache *cache,
+				  struct tegra_bo *bo)
+{
+	hash_del(&bo->cache_node);
+	list_del(&bo->cache_lru);
+	cache->size -= bo->gem.size;
+}
+
+static bool tegra_bo_cache_put(struct tegra_drm *tegra, struct tegra_bo *bo)
+{
+	struct tegra_bo_cache *cache = &tegra->bo_cache;
+	size_t size = bo->gem.size;
+	struct tegra_bo *old, *tmp;
+	LIST_HEAD(evicted);
+
+	if (!cache->enabled || size > TEGRA_BO_CACHE_MAX_OBJECT)
+		return false;
+
+	/* imported or vmap()ed for fbdev, not worth the special cases */
+	if (bo->gem.import_attach || (bo->pages && bo->vaddr))
+		return false;
+
+	/* keep the shmem file holding the pages across the release */
+	get_file(bo->gem.filp);
+	drm_gem_object_release(&bo->gem);
+
+	mutex_lock(&cache->lock);
+
+	/* raced with tegra_bo_cache_fini() */
+	if (!cache->enabled) {
+		mutex_unlock(&cache->lock);
+		tegra_bo_cache_free(tegra->drm, bo);
+		return true;
+	}
+
+	hash_add(cache->buckets, &bo->cache_node, size);
+	list_add(&bo->cache_lru, &cache->lru);
+	cache->size += size;
+
+	while (cache->size > TEGRA_BO_CACHE_MAX_SIZE) {
+		old = list_last_entry(&cache->lru, struct tegra_bo, cache_lru);
+		tegra_bo_cache_unlink(cache, old);
+		list_add(&old->cache_lru, &evicted);
+	}
+
+	mutex_unlock(&cache->lock);
+
+	list_for_each_entry_safe(old, tmp, &evicted, cache_lru)
+		tegra_bo_cache_free(tegra->drm, old);
+
+	return true;
+}
+
+static struct tegra_bo *tegra_bo_cache_get(struct drm_device *drm, size_t size)
+{
+	struct tegra_drm *tegra = drm->dev_private;
+	struct tegra_bo_cache *cache = &tegra->bo_cache;
+	struct tegra_bo *bo = NULL, *iter;
+	struct file *filp;
+	unsigned long i;
+	int err;
+
+	if (!cache->enabled)
+		return NULL;
+
+	size = round_up(size, PAGE_SIZE);
+
+	mutex_lock(&cache->lock);
+
+	hash_for_each_possible(cache->buckets, iter, cache_node, size) {
+		if (iter->gem.size == size) {
+			bo = iter;
+			tegra_bo_cache_unlink(cache, bo);
+			break;
+		}
+	}
+
+	mutex_unlock(&cache->lock);
+
+	if (!bo)
+		return NULL;
+
+	/* set up a new GEM object around the cached backing storage */
+	filp = bo->gem.filp;
+	memset(&bo->gem, 0, sizeof(bo->gem));
+	bo->gem.funcs = &tegra_gem_object_funcs;
+	drm_gem_private_object_init(drm, &bo->gem, size);
+	bo->gem.filp = filp;
+
+	err = drm_gem_create_mmap_offset(&bo->gem);
+	if (err < 0) {
+		get_file(filp);
+		drm_gem_object_release(&bo->gem);
+		tegra_bo_cache_free(drm, bo);
+		return NULL;
+	}
+
+	host1x_bo_init(&bo->base, &tegra_bo_ops);
+	memset(&bo->tiling, 0, sizeof(bo->tiling));
+	bo->flags = 0;
+
+	/* new objects are zeroed, don't hand out the previous contents */
+	if (bo->pages) {
+		for (i = 0; i < bo->num_pages; i++)
+			clear_highpage(bo->pages[i]);
+
+		dma_sync_sgtable_for_device(drm->dev, bo->sgt, DMA_TO_DEVICE);
+	} else {
+		memset(bo->vaddr, 0, size);
+	}
+
+	return bo;
+}
+
+static unsigned long tegra_bo_cache_count(struct shrinker *shrinker,
+					  struct shrink_control *sc)
+{
+#if defined(NV_SHRINKER_ALLOC_PRESENT) /* Linux 6.7 */
+	struct tegra_drm *tegra = shrinker->private_data;
+#else
+	struct tegra_drm *tegra = container_of(shrinker, struct tegra_drm,
+					       bo_cache.shrinker);
+#endif
+
+	return READ_ONCE(tegra->bo_cache.size) >> PAGE_SHIFT;
+}
+
+static unsigned long tegra_bo_cache_scan(struct shrinker *shrinker,
+					 struct shrink_control *sc)
+{
+#if defined(NV_SHRINKER_ALLOC_PRESENT) /* Linux 6.7 */
+	struct tegra_drm *tegra = shrinker->private_data;
+#else
+	struct tegra_drm *tegra = container_of(shrinker, struct tegra_drm,
+					       bo_cache.shrinker);
+#endif
+	struct tegra_bo_cache *cache = &tegra->bo_cache;
+	struct tegra_bo *bo, *tmp;
+	unsigned long freed = 0;
+	LIST_HEAD(victims);
+
+	/*
+	 * IOMMU mappings are created with mm_lock held and may allocate
+	 * memory, which can end up here. Never wait for it.
+	 */
+	if (tegra->domain && !mutex_trylock(&tegra->mm_lock))
+		return SHRINK_STOP;
+
+	if (!mutex_trylock(&cache->lock)) {
+		if (tegra->domain)
+			mutex_unlock(&tegra->mm_lock);
+		return SHRINK_STOP;
+	}
+
+	while (freed < sc->nr_to_scan && !list_empty(&cache->lru)) {
+		bo = list_last_entry(&cache->lru, struct tegra_bo, cache_lru);
+		tegra_bo_cache_unlink(cache, bo);
+		list_add(&bo->cache_lru, &victims);
+		freed += bo->gem.size >> PAGE_SHIFT;
+	}
+
+	mutex_unlock(&cache->lock);
+
+	if (tegra->domain) {
+		list_for_each_entry(bo, &victims, cache_lru)
+			if (bo->mm)
+				__tegra_bo_iommu_unmap(tegra, bo);
+
+		mutex_unlock(&tegra->mm_lock);
+	}
+
+	list_for_each_entry_safe(bo, tmp, &victims, cache_lru) {
+		kfree(bo->mm);
+		bo->mm = NULL;
+		tegra_bo_cache_free(tegra->drm, bo);
+	}
+
+	return freed;
+}
+
+void tegra_bo_cache_init(struct tegra_drm *tegra)
+{
+	struct tegra_bo_cache *cache = &tegra->bo_cache;
+
+	mutex_init(&cache->lock);
+	hash_init(cache->buckets);
+	INIT_LIST_HEAD(&cache->lru);
+
+#if defined(NV_SHRINKER_ALLOC_PRESENT) /* Linux 6.7 */
+	cache->shrinker = shrinker_alloc(0, "tegra-drm-bo-cache");
+	if (!cache->shrinker) {
+		dev_warn(tegra->drm->dev, "failed to allocate BO cache shrinker\n");
+		return;
+	}
+
+	cache->shrinker->count_objects = tegra_bo_cache_count;
+	cache->shrinker->scan_objects = tegra_bo_cache_scan;
+	cache->shrinker->seeks = DEFAULT_SEEKS;
+	cache->shrinker->private_data = tegra;
+
+	shrinker_register(cache->shrinker);
+#else
+	cache->shrinker.count_objects = tegra_bo_cache_count;
+	cache->shrinker.scan_objects = tegra_bo_cache_scan;
+	cache->shrinker.seeks = DEFAULT_SEEKS;
+
+#if defined(NV_REGISTER_SHRINKER_HAS_FMT_ARG) /* Linux v6.0 */
+	if (register_shrinker(&cache->shrinker, "tegra-drm-bo-cache")) {
+#else
+	if (register_shrinker(&cache->shrinker)) {
+#endif
+		dev_warn(tegra->drm->dev, "failed to register BO cache shrinker\n");
+		return;
+	}
+#endif
+
+	cache->enabled = true;
+}
+
+void tegra_bo_cache_fini(struct tegra_drm *tegra)
+{
+	struct tegra_bo_cache *cache = &tegra->bo_cache;
+	struct tegra_bo *bo, *tmp;
+
+	if (!cache->enabled)
+		return;
+
+#if defined(NV_SHRINKER_ALLOC_PRESENT) /* Linux 6.7 */
+	shrinker_free(cache->shrinker);
+#else
+	unregister_shrinker(&cache->shrinker);
+#endif
+
+	mutex_lock(&cache->lock);
+	cache->enabled = false;
+	mutex_unlock(&cache->lock);
+
+	list_for_each_entry_safe(bo, tmp, &cache->lru, cache_lru) {
+		tegra_bo_cache_unlink(cache, bo);
+		tegra_bo_cache_free(tegra->drm, bo);
+	}
+
+	mutex_destroy(&cache->lock);
+}
+
 struct tegra_bo *tegra_bo_create(struct drm_device *drm, size_t size,
 				 unsigned long flags)
 {
 	struct tegra_bo *bo;
 	int err;
 
-	bo = tegra_bo_alloc_object(drm, size);
-	if (IS_ERR(bo))
-		return bo;
+	bo = tegra_bo_cache_get(drm, size);
+	if (!bo) {
+		bo = tegra_bo_alloc_object(drm, size);
+		if (IS_ERR(bo))
+			return bo;
 
-	err = tegra_bo_alloc(drm, bo);
-	if (err < 0)
-		goto release;
+		err = tegra_bo_alloc(drm, bo);
+		if (err < 0)
+			goto release;
+	}
 
 	if (flags & DRM_TEGRA_GEM_CREATE_TILED)
 		bo->tiling.mode = TEGRA_BO_TILING_MODE_TILED;
@@ -515,6 +794,9 @@ void tegra_bo_free_object(struct drm_gem_object *gem)
 				dev_name(mapping->dev));
 	}
 
+	if (tegra_bo_cache_put(tegra, bo))
+		return;
+
 	if (tegra->domain)
 		tegra_bo_iommu_unmap(tegra, bo);
 
@@ -8,7 +8,12 @@
 #ifndef __HOST1X_GEM_H
 #define __HOST1X_GEM_H
 
+#include <nvidia/conftest.h>
+
+#include <linux/hashtable.h>
 #include <linux/host1x-next.h>
+#include <linux/mutex.h>
+#include <linux/shrinker.h>
 
 #include <drm/drm.h>
 #include <drm/drm_gem.h>
@@ -47,6 +52,28 @@ struct tegra_bo {
 	size_t size;
 
 	struct tegra_bo_tiling tiling;
+
+	/* links in the buffer object cache while the object is cached */
+	struct hlist_node cache_node;
+	struct list_head cache_lru;
+};
+
+/*
+ * Recently freed buffer objects, bucketed by size. A cached object
+ * keeps its pages and IOMMU mapping so that it can be handed out again
+ * without allocating or mapping anything.
+ */
+struct tegra_bo_cache {
+	struct mutex lock;
+	DECLARE_HASHTABLE(buckets, 6);
+	struct list_head lru;
+	size_t size;
+	bool enabled;
+#if defined(NV_SHRINKER_ALLOC_PRESENT) /* Linux 6.7 */
+	struct shrinker *shrinker;
+#else
+	struct shrinker shrinker;
+#endif
 };
 
 static inline struct tegra_bo *to_tegra_bo(struct drm_gem_object *gem)
@@ -67,6 +94,11 @@ struct tegra_bo *tegra_bo_create_with_handle(struct drm_file *file,
 					     unsigned long flags,
 					     u32 *handle);
 void tegra_bo_free_object(struct drm_gem_object *gem);
+
+struct tegra_drm;
+
+void tegra_bo_cache_init(struct tegra_drm *tegra);
+void tegra_bo_cache_fini(struct tegra_drm *tegra);
 int tegra_bo_dumb_create(struct drm_file *file, struct drm_device *drm,
 			 struct drm_mode_create_dumb *args);
 
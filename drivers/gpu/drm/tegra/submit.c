@@ -397,8 +397,9 @@ static int submit_job_add_gather(struct host1x_job *job, struct tegra_drm_contex
 		return -EINVAL;
 	}
 
-	if (tegra_drm_fw_validate(context->client, bo->gather_data, *offset,
-				  cmd->words, job_data, class)) {
+	if (tegra_drm_fw_validate(context->client, context->fw_cache,
+				  bo->gather_data, *offset, cmd->words,
+				  job_data, class)) {
 		SUBMIT_ERR(context, "job was rejected by firewall");
 		return -EINVAL;
 	}
@@ -21,8 +21,14 @@ struct tegra_drm_submit_data {
 	} timestamps;
 };
 
-int tegra_drm_fw_validate(struct tegra_drm_client *client, u32 *data, u32 start,
+struct tegra_drm_fw_cache;
+
+int tegra_drm_fw_validate(struct tegra_drm_client *client,
+			  struct tegra_drm_fw_cache *cache, u32 *data, u32 start,
 			  u32 words, struct tegra_drm_submit_data *submit,
 			  u32 *job_class);
 
+struct tegra_drm_fw_cache *tegra_drm_fw_cache_create(void);
+void tegra_drm_fw_cache_destroy(struct tegra_drm_fw_cache *cache);
+
 #endif
@@ -10,6 +10,7 @@
 #include <drm/drm_utils.h>
 
 #include "drm.h"
+#include "submit.h"
 #include "uapi.h"
 
 static void tegra_drm_mapping_release(struct kref *ref)
@@ -41,6 +42,8 @@ static void tegra_drm_channel_context_close(struct tegra_drm_context *context)
 
 	xa_destroy(&context->mappings);
 
+	tegra_drm_fw_cache_destroy(context->fw_cache);
+
 	host1x_channel_put(context->channel);
 
 	kfree(context);
@@ -139,6 +142,8 @@ int tegra_drm_ioctl_channel_open(struct drm_device *drm, void *data, struct drm_
 
 	context->client = client;
 	xa_init_flags(&context->mappings, XA_FLAGS_ALLOC1);
+	/* the cache is only an optimization, run without it if this fails */
+	context->fw_cache = tegra_drm_fw_cache_create();
 
 	args->version = client->version;
 	args->capabilities = 0;
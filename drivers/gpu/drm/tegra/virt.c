@@ -6,6 +6,7 @@
 #include <linux/clk.h>
 #include <linux/debugfs.h>
 #include <linux/host1x-next.h>
+#include <linux/interrupt.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_device.h>
@@ -14,6 +15,7 @@
 #include <linux/pm_runtime.h>
 #include <linux/seq_file.h>
 #include <linux/version.h>
+#include <linux/wait.h>
 
 #include <soc/tegra/virt/hv-ivc.h>
 
@@ -29,8 +31,15 @@
 #define TEGRA_VHOST_CMD_RESUME			3
 #define TEGRA_VHOST_CMD_GET_CONNECTION_ID	4
 
+#define VIRT_IVC_TIMEOUT_MS			10000
+
 struct tegra_vhost_connect_params {
 	u32 module;
+	/*
+	 * Request tag, in what used to be padding. Servers that echo it let
+	 * responses be matched out of order, zero means untagged.
+	 */
+	u32 tag;
 	u64 connection_id;
 };
 
@@ -41,6 +50,15 @@ struct tegra_vhost_cmd_msg {
 	struct tegra_vhost_connect_params connect;
 };
 
+/* command in flight on the IVC channel */
+struct virt_ivc_request {
+	struct list_head node;
+	struct tegra_vhost_cmd_msg *msg;
+	struct completion done;
+	u32 tag;
+	int err;
+};
+
 struct virt_engine {
 	struct device *dev;
 	int connection_id;
@@ -55,6 +73,15 @@ static DEFINE_MUTEX(ivc_cookie_lock);
 static struct tegra_hv_ivc_cookie *ivc_cookie;
 static struct kref ivc_ref;
 
+/* protects the IVC queues and the transport state below */
+static DEFINE_SPINLOCK(ivc_lock);
+static LIST_HEAD(ivc_pending);
+static DECLARE_WAIT_QUEUE_HEAD(ivc_tx_wq);
+static u32 ivc_next_tag;
+static bool ivc_server_tags;
+/* timed out requests whose untagged responses are still to come */
+static unsigned int ivc_orphans;
+
 static inline struct virt_engine *to_virt_engine(struct tegra_drm_client *client)
 {
 	return container_of(client, struct virt_engine, client);
@@ -145,9 +172,77 @@ static const struct tegra_drm_client_ops virt_engine_ops = {
 	.has_job_timestamping = virt_engine_has_job_timestamping,
 };
 
+static struct virt_ivc_request *virt_ivc_match(struct tegra_vhost_cmd_msg *msg)
+{
+	struct virt_ivc_request *req;
+
+	if (msg->connect.tag) {
+		ivc_server_tags = true;
+
+		list_for_each_entry(req, &ivc_pending, node)
+			if (req->tag == msg->connect.tag)
+				return req;
+
+		/* response to a request that timed out */
+		return NULL;
+	}
+
+	/* untagged responses come back in the order requests were sent */
+	if (ivc_orphans) {
+		ivc_orphans--;
+		return NULL;
+	}
+
+	return list_first_entry_or_null(&ivc_pending, struct virt_ivc_request, node);
+}
+
+static irqreturn_t virt_ivc_isr(int irq, void *data)
+{
+	struct tegra_vhost_cmd_msg msg;
+	struct virt_ivc_request *req;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ivc_lock, flags);
+
+	if (tegra_hv_ivc_channel_notified(ivc_cookie) == 0) {
+		while (tegra_hv_ivc_can_read(ivc_cookie)) {
+			if (tegra_hv_ivc_read(ivc_cookie, &msg, sizeof(msg)) != sizeof(msg))
+				break;
+
+			req = virt_ivc_match(&msg);
+			if (!req)
+				continue;
+
+			*req->msg = msg;
+			list_del_init(&req->node);
+			complete(&req->done);
+		}
+	}
+
+	spin_unlock_irqrestore(&ivc_lock, flags);
+
+	/* the peer may also have freed space or finished a channel reset */
+	wake_up(&ivc_tx_wq);
+
+	return IRQ_HANDLED;
+}
+
+static bool virt_ivc_channel_ready(void)
+{
+	unsigned long flags;
+	bool ready;
+
+	spin_lock_irqsave(&ivc_lock, flags);
+	ready = tegra_hv_ivc_channel_notified(ivc_cookie) == 0;
+	spin_unlock_irqrestore(&ivc_lock, flags);
+
+	return ready;
+}
+
 static int virt_engine_setup_ivc(struct virt_engine *virt)
 {
 	struct device_node *host1x_dn = virt->dev->parent->of_node;
+	struct tegra_hv_ivc_cookie *cookie;
 	struct device_node *hv;
 	u32 ivc_instance;
 	int err;
@@ -155,48 +250,74 @@ static int virt_engine_setup_ivc(struct virt_engine *virt)
 	mutex_lock(&ivc_cookie_lock);
 
 	if (ivc_cookie) {
-		err = PTR_ERR_OR_ZERO(ivc_cookie);
-		if (!err)
-			kref_get(&ivc_ref);
+		kref_get(&ivc_ref);
 		mutex_unlock(&ivc_cookie_lock);
-		return err;
+		return 0;
 	}
 
 	hv = of_parse_phandle(host1x_dn, "nvidia,server-ivc", 0);
 	if (!hv) {
 		dev_err(virt->dev, "nvidia,server-ivc not configured\n");
-		return -EINVAL;
+		err = -EINVAL;
+		goto unlock;
 	}
 
 	err = of_property_read_u32_index(host1x_dn, "nvidia,server-ivc", 1, &ivc_instance);
 	if (err) {
 		dev_err(virt->dev, "nvidia,server-ivc not configured\n");
-		return -EINVAL;
+		of_node_put(hv);
+		err = -EINVAL;
+		goto unlock;
+	}
+
+	cookie = tegra_hv_ivc_reserve(hv, ivc_instance, NULL);
+	of_node_put(hv);
+	if (IS_ERR(cookie)) {
+		dev_err(virt->dev, "IVC channel reservation failed: %ld\n", PTR_ERR(cookie));
+		err = PTR_ERR(cookie);
+		goto unlock;
 	}
 
-	ivc_cookie = tegra_hv_ivc_reserve(hv, ivc_instance, NULL);
-	if (IS_ERR(ivc_cookie)) {
-		dev_err(virt->dev, "IVC channel reservation failed: %ld\n", PTR_ERR(ivc_cookie));
-		return PTR_ERR(ivc_cookie);
+	ivc_cookie = cookie;
+
+	err = request_irq(cookie->irq, virt_ivc_isr, 0, "tegra-drm-virt", cookie);
+	if (err < 0) {
+		dev_err(virt->dev, "failed to request IVC irq %d: %d\n", cookie->irq, err);
+		goto unreserve;
 	}
 
-	tegra_hv_ivc_channel_reset(ivc_cookie);
+	tegra_hv_ivc_channel_reset(cookie);
 
-	while (tegra_hv_ivc_channel_notified(ivc_cookie))
-		;
+	if (!wait_event_timeout(ivc_tx_wq, virt_ivc_channel_ready(),
+				msecs_to_jiffies(VIRT_IVC_TIMEOUT_MS))) {
+		dev_err(virt->dev, "IVC channel reset timed out\n");
+		err = -ETIMEDOUT;
+		goto free_irq;
+	}
 
 	kref_init(&ivc_ref);
 
 	mutex_unlock(&ivc_cookie_lock);
 
 	return 0;
+
+free_irq:
+	free_irq(cookie->irq, cookie);
+unreserve:
+	ivc_cookie = NULL;
+	tegra_hv_ivc_unreserve(cookie);
+unlock:
+	mutex_unlock(&ivc_cookie_lock);
+	return err;
 }
 
 static void release_ivc_cookie(struct kref *ref)
 {
 	(void)ref;
 
+	free_irq(ivc_cookie->irq, ivc_cookie);
 	tegra_hv_ivc_unreserve(ivc_cookie);
+	ivc_cookie = NULL;
 	mutex_unlock(&ivc_cookie_lock);
 }
 
@@ -205,43 +326,117 @@ static void virt_engine_cleanup(void)
 	kref_put_mutex(&ivc_ref, release_ivc_cookie, &ivc_cookie_lock);
 }
 
-static int virt_engine_transfer(void *data, u32 size)
+static bool virt_ivc_try_write(struct virt_ivc_request *req)
 {
-	int err;
+	unsigned long flags;
+	bool written = false;
 
-	mutex_lock(&ivc_cookie_lock);
+	spin_lock_irqsave(&ivc_lock, flags);
 
-	while (!tegra_hv_ivc_can_write(ivc_cookie))
-		;
+	if (tegra_hv_ivc_channel_notified(ivc_cookie) != 0 ||
+	    !tegra_hv_ivc_can_write(ivc_cookie))
+		goto unlock;
 
-	err = tegra_hv_ivc_write(ivc_cookie, data, size);
-	if (err != size) {
-		mutex_unlock(&ivc_cookie_lock);
-		return -ENOMEM;
-	}
+	do {
+		req->tag = ++ivc_next_tag;
+	} while (!req->tag);
+	req->msg->connect.tag = req->tag;
 
-	while (!tegra_hv_ivc_can_read(ivc_cookie))
-		;
+	if (tegra_hv_ivc_write(ivc_cookie, req->msg, sizeof(*req->msg)) != sizeof(*req->msg))
+		req->err = -ENOMEM;
+	else
+		list_add_tail(&req->node, &ivc_pending);
 
-	err = tegra_hv_ivc_read(ivc_cookie, data, size);
-	if (err != size) {
-		mutex_unlock(&ivc_cookie_lock);
-		return -EIO;
+	written = true;
+
+unlock:
+	spin_unlock_irqrestore(&ivc_lock, flags);
+	return written;
+}
+
+/*
+ * Queue a command to the server without waiting for its response, so
+ * that several commands can be outstanding. Sleeps until the channel
+ * has room for the frame.
+ */
+static int virt_ivc_submit(struct virt_ivc_request *req, struct tegra_vhost_cmd_msg *msg)
+{
+	req->msg = msg;
+	req->err = 0;
+	INIT_LIST_HEAD(&req->node);
+	init_completion(&req->done);
+
+	if (!wait_event_timeout(ivc_tx_wq, virt_ivc_try_write(req),
+				msecs_to_jiffies(VIRT_IVC_TIMEOUT_MS)))
+		return -ETIMEDOUT;
+
+	return req->err;
+}
+
+/*
+ * Wait for the response to a submitted command, it is copied back into
+ * the message passed to virt_ivc_submit().
+ */
+static int virt_ivc_wait(struct virt_ivc_request *req)
+{
+	unsigned long flags;
+	int err = 0;
+
+	if (wait_for_completion_timeout(&req->done, msecs_to_jiffies(VIRT_IVC_TIMEOUT_MS)))
+		return 0;
+
+	spin_lock_irqsave(&ivc_lock, flags);
+	if (!completion_done(&req->done)) {
+		list_del(&req->node);
+		if (!ivc_server_tags)
+			ivc_orphans++;
+		err = -ETIMEDOUT;
 	}
+	spin_unlock_irqrestore(&ivc_lock, flags);
 
-	mutex_unlock(&ivc_cookie_lock);
-	return 0;
+	return err;
+}
+
+static int virt_engine_transfer(struct tegra_vhost_cmd_msg *msg)
+{
+	struct virt_ivc_request req;
+	int err;
+
+	err = virt_ivc_submit(&req, msg);
+	if (err < 0)
+		return err;
+
+	return virt_ivc_wait(&req);
 }
 
 static int virt_engine_connect(struct virt_engine *virt, u32 module_id)
 {
+	struct tegra_vhost_cmd_msg host_msg = { 0 };
 	struct tegra_vhost_cmd_msg msg = { 0 };
+	struct virt_ivc_request host_req, req;
 	int err;
 
+	/*
+	 * Connect to HOST module. This doesn't really do anything but it
+	 * needs to come first, queue both connects back to back.
+	 */
+	host_msg.cmd = TEGRA_VHOST_CMD_CONNECT;
+	host_msg.connect.module = 1;
+
+	err = virt_ivc_submit(&host_req, &host_msg);
+	if (err < 0)
+		return err;
+
 	msg.cmd = TEGRA_VHOST_CMD_CONNECT;
 	msg.connect.module = module_id;
 
-	err = virt_engine_transfer(&msg, sizeof(msg));
+	err = virt_ivc_submit(&req, &msg);
+
+	virt_ivc_wait(&host_req);
+	if (err < 0)
+		return err;
+
+	err = virt_ivc_wait(&req);
 	if (err < 0)
 		return err;
 
@@ -256,7 +451,7 @@ static int virt_engine_suspend(struct device *dev)
 	msg.cmd = TEGRA_VHOST_CMD_SUSPEND;
 	msg.connection_id = virt->connection_id;
 
-	return virt_engine_transfer(&msg, sizeof(msg));
+	return virt_engine_transfer(&msg);
 }
 
 static int virt_engine_resume(struct device *dev)
@@ -267,7 +462,7 @@ static int virt_engine_resume(struct device *dev)
 	msg.cmd = TEGRA_VHOST_CMD_RESUME;
 	msg.connection_id = virt->connection_id;
 
-	return virt_engine_transfer(&msg, sizeof(msg));
+	return virt_engine_transfer(&msg);
 }
 
 static int actmon_debugfs_usage_show(struct seq_file *s, void *unused)
@@ -437,6 +632,9 @@ static int virt_engine_probe(struct platform_device *pdev)
         u32 hwpm_ip_index;
 #endif
 
+	/* the tag lives in padding, the wire format must not change */
+	BUILD_BUG_ON(sizeof(struct tegra_vhost_cmd_msg) != 32);
+
 	err = of_property_read_u32(pdev->dev.of_node, "nvidia,module-id", &module_id);
 	if (err < 0) {
 		dev_err(dev, "could not read property nvidia,module-id: %d\n", err);
@@ -490,9 +688,6 @@ static int virt_engine_probe(struct platform_device *pdev)
 	if (err < 0)
 		goto unregister_client;
 
-	/* Connect to HOST module. This doesn't really do anything but we need to do it first. */
-	virt_engine_connect(virt, 1);
-
 	virt->connection_id = virt_engine_connect(virt, module_id);
 	if (virt->connection_id < 0) {
 		dev_err(dev, "failed to register with server\n");
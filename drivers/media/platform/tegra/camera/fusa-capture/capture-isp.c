@@ -322,170 +322,89 @@ ret:
 }
 
 /**
- * @brief Patch the inputfence syncpoints of a process descriptor w/ ISP
- * IOVA-mapped addresses.
+ * @brief No. of fence relocations copied from user space at a time.
+ */
+#define ISP_CAPTURE_RELOC_BATCH	16U
+
+/**
+ * @brief Patch the fence syncpoints listed by a relocation array in a
+ * process descriptor w/ ISP IOVA-mapped addresses.
+ *
+ * The descriptor queue is patched through the kernel mapping made at
+ * channel setup, and the relocations are copied in batches to the stack,
+ * so a request neither maps the queue nor allocates memory.
  *
  * @param[in]	chan		ISP channel context
  * @param[in]	req		ISP process request
+ * @param[in]	relocs		Fence relocations of the request
  * @param[in]	request_offset	Descriptor offset from process descriptor queue
  *				[byte]
  *
  * @returns	0 (success), neg. errno (failure)
  */
-static int isp_capture_setup_inputfences(
+static int isp_capture_setup_fences(
 	struct tegra_isp_channel *chan,
 	struct isp_capture_req *req,
+	const struct capture_isp_reloc *relocs,
 	int request_offset)
 {
-	uint32_t __user *inpfences_reloc_user;
-	uint32_t *inpfences_relocs = NULL;
-	uint32_t inputfences_offset = 0;
-	void *reloc_page_addr  = NULL;
 	struct isp_capture *capture = chan->capture_data;
-	void *vmap_base = NULL;
-#if defined(NV_LINUX_IOSYS_MAP_H_PRESENT)
-	struct iosys_map map;
-#else
-	struct dma_buf_map map;
-#endif
-	int i = 0;
+	struct capture_common_buf *requests = &capture->capture_desc_ctx.requests;
+	uint32_t __user *reloc_user;
+	uint32_t batch[ISP_CAPTURE_RELOC_BATCH];
+	uint32_t fence_offset;
+	uint32_t max_relative;
+	uint32_t done, n, i;
 	int err = 0;
 
-	/* It is valid not to have inputfences for given frame capture */
-	if (!req->inputfences_relocs.num_relocs)
+	/* It is valid not to have fences for given frame capture */
+	if (!relocs->num_relocs)
 		return 0;
 
-	inpfences_reloc_user = (uint32_t __user *)
-			(uintptr_t)req->inputfences_relocs.reloc_relatives;
-
-	inpfences_relocs = kcalloc(req->inputfences_relocs.num_relocs,
-				sizeof(uint32_t), GFP_KERNEL);
-	if (unlikely(inpfences_relocs == NULL)) {
-		dev_err(chan->isp_dev,
-			"failed to allocate inputfences reloc array\n");
+	if (requests->va == NULL) {
+		dev_err(chan->isp_dev, "%s: descriptor queue not mapped\n",
+			__func__);
 		return -ENOMEM;
 	}
 
-	err = copy_from_user(inpfences_relocs, inpfences_reloc_user,
-		req->inputfences_relocs.num_relocs * sizeof(uint32_t)) ?
-			-EFAULT : 0;
-	if (err < 0) {
-		dev_err(chan->isp_dev, "failed to copy inputfences relocs\n");
-		goto fail;
-	}
+	reloc_user = (uint32_t __user *)(uintptr_t)relocs->reloc_relatives;
+	max_relative = max(req->gos_relative, req->sp_relative);
 
-	err = dma_buf_vmap(capture->capture_desc_ctx.requests.buf, &map);
-	vmap_base = err ? NULL : map.vaddr;
-	if (!vmap_base) {
-		pr_err("%s: Cannot map capture descriptor request\n", __func__);
-		err = -ENOMEM;
-		goto fail;
-	}
-	reloc_page_addr = vmap_base;
+	for (done = 0; done < relocs->num_relocs; done += n) {
+		n = min(relocs->num_relocs - done, ISP_CAPTURE_RELOC_BATCH);
 
-	for (i = 0; i < req->inputfences_relocs.num_relocs; i++) {
-		inputfences_offset = request_offset +
-					inpfences_relocs[i];
-		err = isp_capture_populate_fence_info(chan, inputfences_offset,
-				req->gos_relative, req->sp_relative, reloc_page_addr);
-		if (err < 0) {
-			dev_err(chan->isp_dev,
-				"Populate inputfences info failed\n");
-			goto fail;
+		if (copy_from_user(batch, reloc_user + done,
+				n * sizeof(uint32_t))) {
+			dev_err(chan->isp_dev, "failed to copy fence relocs\n");
+			return -EFAULT;
 		}
-	}
-
-	spec_bar();
 
-fail:
-	if (vmap_base != NULL)
-		dma_buf_vunmap(capture->capture_desc_ctx.requests.buf,
-			&map);
-	kfree(inpfences_relocs);
-	return err;
-}
+		for (i = 0; i < n; i++) {
+			fence_offset = request_offset + batch[i];
 
-/**
- * @brief Patch the prefence syncpoints of a process descriptor w/ ISP
- * IOVA-mapped addresses.
- *
- * @param[in]	chan		ISP channel context
- * @param[in]	req		ISP process request
- * @param[in]	request_offset	Descriptor offset from process descriptor queue
- *				[byte]
- *
- * @returns	0 (success), neg. errno (failure)
- */
-static int isp_capture_setup_prefences(
-	struct tegra_isp_channel *chan,
-	struct isp_capture_req *req,
-	int request_offset)
-{
-	uint32_t __user *prefence_reloc_user;
-	uint32_t *prefence_relocs = NULL;
-	uint32_t prefence_offset = 0;
-	int i = 0;
-	int err = 0;
-	void *reloc_page_addr = NULL;
-	struct isp_capture *capture = chan->capture_data;
-	void *vmap_base = NULL;
-#if defined(NV_LINUX_IOSYS_MAP_H_PRESENT)
-	struct iosys_map map;
-#else
-	struct dma_buf_map map;
-#endif
-
-	/* It is valid not to have prefences for given frame capture */
-	if (!req->prefences_relocs.num_relocs)
-		return 0;
-
-	prefence_reloc_user = (uint32_t __user *)
-			(uintptr_t)req->prefences_relocs.reloc_relatives;
-
-	prefence_relocs = kcalloc(req->prefences_relocs.num_relocs,
-		sizeof(uint32_t), GFP_KERNEL);
-	if (unlikely(prefence_relocs == NULL)) {
-		dev_err(chan->isp_dev,
-			"failed to allocate prefences reloc array\n");
-		return -ENOMEM;
-	}
-
-	err = copy_from_user(prefence_relocs, prefence_reloc_user,
-		req->prefences_relocs.num_relocs * sizeof(uint32_t)) ?
-			-EFAULT : 0;
-	if (err < 0) {
-		dev_err(chan->isp_dev, "failed to copy prefences relocs\n");
-		goto fail;
-	}
-
-	err = dma_buf_vmap(capture->capture_desc_ctx.requests.buf, &map);
-	vmap_base = err ? NULL : map.vaddr;
-	if (!vmap_base) {
-		pr_err("%s: Cannot map capture descriptor request\n", __func__);
-		err = -ENOMEM;
-		goto fail;
-	}
-	reloc_page_addr = vmap_base;
+			/* patched words must lie in the descriptor queue */
+			if ((uint64_t)fence_offset + max_relative +
+					sizeof(uint64_t) > requests->buf->size) {
+				dev_err(chan->isp_dev,
+					"fence reloc %u out of bounds\n",
+					batch[i]);
+				return -EINVAL;
+			}
 
-	for (i = 0; i < req->prefences_relocs.num_relocs; i++) {
-		prefence_offset = request_offset +
-					prefence_relocs[i];
-		err = isp_capture_populate_fence_info(chan, prefence_offset,
-				req->gos_relative, req->sp_relative, reloc_page_addr);
-		if (err < 0) {
-			dev_err(chan->isp_dev, "Populate prefences info failed\n");
-			goto fail;
+			err = isp_capture_populate_fence_info(chan,
+					fence_offset, req->gos_relative,
+					req->sp_relative, requests->va);
+			if (err < 0) {
+				dev_err(chan->isp_dev,
+					"Populate fence info failed\n");
+				return err;
+			}
 		}
 	}
 
 	spec_bar();
 
-fail:
-	if (vmap_base != NULL)
-		dma_buf_vunmap(capture->capture_desc_ctx.requests.buf,
-			&map);
-	kfree(prefence_relocs);
-	return err;
+	return 0;
 }
 
 /**
@@ -1657,13 +1576,15 @@ int isp_capture_request(
 	request_offset = req->buffer_index *
 			capture->capture_desc_ctx.request_size;
 
-	err = isp_capture_setup_inputfences(chan, req, request_offset);
+	err = isp_capture_setup_fences(chan, req, &req->inputfences_relocs,
+			request_offset);
 	if (err < 0) {
 		dev_err(chan->isp_dev, "failed to setup inputfences\n");
 		goto fail;
 	}
 
-	err = isp_capture_setup_prefences(chan, req, request_offset);
+	err = isp_capture_setup_fences(chan, req, &req->prefences_relocs,
+			request_offset);
 	if (err < 0) {
 		dev_err(chan->isp_dev, "failed to setup prefences\n");
 		goto fail;
@@ -310,7 +310,13 @@ static void vi_capture_ivc_status_callback(
 			 * Only fire completions if not using
 			 * the new progress status buffer mechanism
 			 */
-			complete(&capture->capture_resp);
+			mutex_lock(&capture->status_cb_lock);
+			if (capture->status_cb != NULL)
+				capture->status_cb(capture->status_cb_priv,
+					chan, buffer_index);
+			else
+				complete(&capture->capture_resp);
+			mutex_unlock(&capture->status_cb_lock);
 		}
 		dev_dbg(chan->dev, "%s: status chan_id %u msg_id %u\n",
 				__func__, status_msg->header.channel_id,
@@ -476,6 +482,7 @@ int vi_capture_init(
 	init_completion(&capture->capture_resp);
 
 	mutex_init(&capture->reset_lock);
+	mutex_init(&capture->status_cb_lock);
 	mutex_init(&capture->control_msg_lock);
 	mutex_init(&capture->unpins_list_lock);
 
@@ -1518,6 +1525,32 @@ int vi_capture_set_progress_status_notifier(
 }
 EXPORT_SYMBOL_GPL(vi_capture_set_progress_status_notifier);
 
+int vi_capture_set_status_callback(
+	struct tegra_vi_channel *chan,
+	vi_capture_status_cb cb,
+	void *priv)
+{
+	struct vi_capture *capture;
+
+	if (chan == NULL)
+		return -ENODEV;
+
+	capture = chan->capture_data;
+	if (capture == NULL) {
+		dev_err(chan->dev,
+				"%s: vi capture uninitialized\n", __func__);
+		return -ENODEV;
+	}
+
+	mutex_lock(&capture->status_cb_lock);
+	capture->status_cb = cb;
+	capture->status_cb_priv = priv;
+	mutex_unlock(&capture->status_cb_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(vi_capture_set_status_callback);
+
 static int csi_vi_get_mapping_table(struct platform_device *pdev)
 {
 	uint32_t index = 0;
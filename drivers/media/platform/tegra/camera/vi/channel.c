@@ -799,6 +799,12 @@ static void tegra_channel_buffer_queue(struct vb2_buffer *vb)
 	list_add_tail(&buf->queue, &chan->capture);
 	spin_unlock(&chan->start_lock);
 
+	if (chan->vi->fops && chan->vi->fops->vi_buffer_queue) {
+		/* Submit directly, completion is reported asynchronously */
+		chan->vi->fops->vi_buffer_queue(chan);
+		return;
+	}
+
 	/* Wake up kthread for capture */
 	wake_up_interruptible(&chan->start_wait);
 }
@@ -2648,6 +2654,7 @@ int tegra_channel_init(struct tegra_channel *chan)
 	init_waitqueue_head(&chan->dequeue_wait);
 	spin_lock_init(&chan->dequeue_lock);
 	mutex_init(&chan->stop_kthread_lock);
+	mutex_init(&chan->submit_lock);
 	init_rwsem(&chan->reset_lock);
 	atomic_set(&chan->is_streaming, DISABLE);
 	spin_lock_init(&chan->capture_state_lock);
@@ -12,9 +12,7 @@
  */
 
 #include <linux/errno.h>
-#include <linux/freezer.h>
 #include <linux/fs.h>
-#include <linux/kthread.h>
 #include <linux/nvhost.h>
 #include <linux/pm_runtime.h>
 #include <linux/semaphore.h>
@@ -76,6 +74,9 @@ static const struct capture_descriptor capture_template = {
 	},
 };
 
+static void vi5_capture_status_cb(void *priv,
+	struct tegra_vi_channel *vi_chan, uint32_t buffer_index);
+
 static void vi5_init_video_formats(struct tegra_channel *chan)
 {
 	int i;
@@ -381,6 +382,14 @@ static int tegra_channel_capture_setup(struct tegra_channel *chan, unsigned int
 		return err;
 	}
 
+	/* Frame completions are delivered from the capture IVC callback */
+	err = vi_capture_set_status_callback(chan->tegra_vi_channel[vi_port],
+			vi5_capture_status_cb, chan);
+	if (err) {
+		dev_err(chan->vi->dev, "vi capture status callback failed\n");
+		return err;
+	}
+
 	return 0;
 }
 
@@ -461,6 +470,7 @@ static void vi5_capture_enqueue(struct tegra_channel *chan,
 	struct tegra_channel_buffer *buf)
 {
 	int err = 0;
+	bool linked;
 	unsigned int vi_port;
 	unsigned long flags;
 	struct tegra_mc_vi *vi = chan->vi;
@@ -470,6 +480,18 @@ static void vi5_capture_enqueue(struct tegra_channel *chan,
 		.buffer_index = 0,
 	}};
 
+	/*
+	 * The status callback completes the oldest buffer on the dequeue
+	 * list, so the buffer has to be there before its request can
+	 * complete.
+	 */
+	for (vi_port = 0; vi_port < chan->valid_ports; vi_port++)
+		buf->capture_descr_index[vi_port] = chan->capture_descr_index;
+
+	spin_lock(&chan->dequeue_lock);
+	list_add_tail(&buf->queue, &chan->dequeue);
+	spin_unlock(&chan->dequeue_lock);
+
 	for (vi_port = 0; vi_port < chan->valid_ports; vi_port++) {
 		vi5_setup_surface(chan, buf, chan->capture_descr_index, vi_port);
 		request[vi_port].buffer_index = chan->capture_descr_index;
@@ -487,20 +509,30 @@ static void vi5_capture_enqueue(struct tegra_channel *chan,
 			chan->capture_reqs_enqueued += 1;
 		}
 		spin_unlock_irqrestore(&chan->capture_state_lock, flags);
-		buf->capture_descr_index[vi_port] = chan->capture_descr_index;
 	}
 	chan->capture_descr_index = ((chan->capture_descr_index + 1)
 					% (chan->capture_queue_depth));
 
+	return;
+
+uncorr_err:
+	/*
+	 * Not every port has the request, so the buffer can't complete.
+	 * Hand it back to the capture list, error recovery returns it to
+	 * vb2 once the channel has been stopped.
+	 */
 	spin_lock(&chan->dequeue_lock);
-	list_add_tail(&buf->queue, &chan->dequeue);
+	linked = !list_empty(&buf->queue);
+	if (linked)
+		list_del_init(&buf->queue);
 	spin_unlock(&chan->dequeue_lock);
 
-	wake_up_interruptible(&chan->dequeue_wait);
-
-	return;
+	if (linked) {
+		spin_lock(&chan->start_lock);
+		list_add(&buf->queue, &chan->capture);
+		spin_unlock(&chan->start_lock);
+	}
 
-uncorr_err:
 	spin_lock_irqsave(&chan->capture_state_lock, flags);
 	chan->capture_state = CAPTURE_ERROR;
 	spin_unlock_irqrestore(&chan->capture_state_lock, flags);
@@ -509,14 +541,12 @@ uncorr_err:
 static void vi5_capture_dequeue(struct tegra_channel *chan,
 	struct tegra_channel_buffer *buf)
 {
-	int err = 0;
 	bool frame_err = false;
 	int vi_port = 0;
 	int gang_prev_frame_id = 0;
 	unsigned long flags;
 	struct tegra_mc_vi *vi = chan->vi;
 	struct vb2_v4l2_buffer *vb = &buf->buf;
-	int timeout_ms = CAPTURE_TIMEOUT_MS;
 	struct timespec64 ts;
 	struct capture_descriptor *descr = NULL;
 
@@ -526,27 +556,11 @@ static void vi5_capture_dequeue(struct tegra_channel *chan,
 		if (buf->vb2_state != VB2_BUF_STATE_ACTIVE)
 			goto rel_buf;
 
-		/* Dequeue a frame and check its capture status */
-		timeout_ms = chan->capture_timeout_ms;
-		err = vi_capture_status(chan->tegra_vi_channel[vi_port], timeout_ms);
-		if (err) {
-			if (err == -ETIMEDOUT) {
-				if (timeout_ms < 0) {
-					spin_lock_irqsave(&chan->capture_state_lock, flags);
-					chan->capture_state = CAPTURE_ERROR_TIMEOUT;
-					spin_unlock_irqrestore(&chan->capture_state_lock, flags);
-					buf->vb2_state = VB2_BUF_STATE_ERROR;
-					goto rel_buf;
-				} else {
-					dev_err(vi->dev,
-						"uncorr_err: request timed out after %d ms\n",
-						timeout_ms);
-				}
-			} else {
-				dev_err(vi->dev, "uncorr_err: request err %d\n", err);
-			}
-			goto uncorr_err;
-		} else if (descr->status.status != CAPTURE_STATUS_SUCCESS) {
+		/*
+		 * Status for every port of this frame has been reported by
+		 * the capture IVC callback, check its capture status
+		 */
+		if (descr->status.status != CAPTURE_STATUS_SUCCESS) {
 			if ((descr->status.flags
 					& CAPTURE_STATUS_FLAG_CHANNEL_IN_ERROR) != 0) {
 				chan->queue_error = true;
@@ -576,7 +590,6 @@ static void vi5_capture_dequeue(struct tegra_channel *chan,
 		spin_unlock_irqrestore(&chan->capture_state_lock, flags);
 	}
 
-	wake_up_interruptible(&chan->start_wait);
 	/* Read SOF from capture descriptor */
 	ts = ns_to_timespec64((s64)descr->status.sof_timestamp);
 	trace_tegra_channel_capture_frame("sof", &ts);
@@ -612,6 +625,12 @@ static int vi5_channel_error_recover(struct tegra_channel *chan,
 	struct tegra_mc_vi *vi = chan->vi;
 	struct v4l2_subdev *csi_subdev;
 
+	/* detach status callbacks, waiting out any in-flight completion */
+	for (vi_port = 0; vi_port < chan->valid_ports; vi_port++)
+		vi_capture_set_status_callback(chan->tegra_vi_channel[vi_port],
+			NULL, NULL);
+	cancel_delayed_work(&chan->timeout_work);
+
 	/* stop vi channel */
 	for (vi_port = 0; vi_port < chan->valid_ports; vi_port++) {
 		err = vi_capture_release(chan->tegra_vi_channel[vi_port],
@@ -640,6 +659,9 @@ static int vi5_channel_error_recover(struct tegra_channel *chan,
 		buf->vb2_state = VB2_BUF_STATE_ERROR;
 		vi5_capture_dequeue(chan, buf);
 	}
+	spin_lock(&chan->dequeue_lock);
+	memset(chan->status_count, 0, sizeof(chan->status_count));
+	spin_unlock(&chan->dequeue_lock);
 
 	/* report queue error to application */
 	if (queue_error)
@@ -682,157 +704,212 @@ done:
 	return err;
 }
 
-static int tegra_channel_kthread_capture_enqueue(void *data)
+static void vi5_capture_submit(struct tegra_channel *chan)
 {
-	struct tegra_channel *chan = data;
 	struct tegra_channel_buffer *buf;
 	unsigned long flags;
-	set_freezable();
-
-	while (1) {
-		try_to_freeze();
+	bool submitted = false;
 
-		wait_event_interruptible(chan->start_wait,
-			(kthread_should_stop() || !list_empty(&chan->capture)));
+	mutex_lock(&chan->submit_lock);
 
-		while (!(kthread_should_stop() || list_empty(&chan->capture))) {
-			spin_lock_irqsave(&chan->capture_state_lock, flags);
-			if ((chan->capture_state == CAPTURE_ERROR)
-					|| !(chan->capture_reqs_enqueued
-					< (chan->capture_queue_depth * chan->valid_ports))) {
-				spin_unlock_irqrestore(
-					&chan->capture_state_lock, flags);
-				break;
-			}
-			spin_unlock_irqrestore(&chan->capture_state_lock,
-				flags);
+	while (chan->capture_active && !list_empty(&chan->capture)) {
+		spin_lock_irqsave(&chan->capture_state_lock, flags);
+		if ((chan->capture_state == CAPTURE_ERROR)
+				|| !(chan->capture_reqs_enqueued
+				< (chan->capture_queue_depth * chan->valid_ports))) {
+			spin_unlock_irqrestore(&chan->capture_state_lock, flags);
+			break;
+		}
+		spin_unlock_irqrestore(&chan->capture_state_lock, flags);
 
-			buf = dequeue_buffer(chan, false);
-			if (!buf)
-				break;
+		buf = dequeue_buffer(chan, false);
+		if (!buf)
+			break;
 
-			buf->vb2_state = VB2_BUF_STATE_ACTIVE;
+		buf->vb2_state = VB2_BUF_STATE_ACTIVE;
 
-			vi5_capture_enqueue(chan, buf);
-		}
+		vi5_capture_enqueue(chan, buf);
+		submitted = true;
+	}
 
-		if (kthread_should_stop())
-			break;
+	spin_lock_irqsave(&chan->capture_state_lock, flags);
+	if (chan->capture_active) {
+		if (chan->capture_state == CAPTURE_ERROR)
+			schedule_work(&chan->error_work);
+		else if (submitted && chan->capture_timeout_ms >= 0)
+			/* no-op if a frame is already being timed */
+			schedule_delayed_work(&chan->timeout_work,
+				msecs_to_jiffies(chan->capture_timeout_ms));
 	}
+	spin_unlock_irqrestore(&chan->capture_state_lock, flags);
 
-	return 0;
+	mutex_unlock(&chan->submit_lock);
 }
 
-static int tegra_channel_kthread_capture_dequeue(void *data)
+/*
+ * vb2 calls buf_queue with its own locks held, so the IVC submit is left
+ * to status_work. Before streaming starts, start_capture submits instead.
+ */
+static void vi5_buffer_queue(struct tegra_channel *chan)
 {
-	int err = 0;
 	unsigned long flags;
-	struct tegra_channel *chan = data;
-	struct tegra_channel_buffer *buf;
 
-	set_freezable();
-	allow_signal(SIGINT);
-
-	while (1) {
-		try_to_freeze();
+	spin_lock_irqsave(&chan->capture_state_lock, flags);
+	if (chan->capture_active)
+		schedule_work(&chan->status_work);
+	spin_unlock_irqrestore(&chan->capture_state_lock, flags);
+}
 
-		wait_event_interruptible(chan->dequeue_wait,
-			(kthread_should_stop()
-				|| !list_empty(&chan->dequeue)
-				|| (chan->capture_state == CAPTURE_ERROR)));
+/*
+ * Runs in the capture IVC worker: must not block on the channel, so
+ * refill and error recovery are deferred to status_work and error_work.
+ */
+static void vi5_capture_status_cb(void *priv,
+	struct tegra_vi_channel *vi_chan, uint32_t buffer_index)
+{
+	struct tegra_channel *chan = priv;
+	struct tegra_channel_buffer *buf = NULL;
+	unsigned int vi_port;
+	unsigned int i;
+	unsigned long flags;
 
-		while (!(kthread_should_stop() || list_empty(&chan->dequeue)
-				|| (chan->capture_state == CAPTURE_ERROR))) {
+	for (vi_port = 0; vi_port < chan->valid_ports; vi_port++) {
+		if (chan->tegra_vi_channel[vi_port] == vi_chan)
+			break;
+	}
+	if (WARN_ON(vi_port == chan->valid_ports))
+		return;
 
-			buf = dequeue_dequeue_buffer(chan);
-			if (!buf)
-				break;
+	/* A frame is complete once every ganged port has reported status */
+	spin_lock(&chan->dequeue_lock);
+	chan->status_count[vi_port] += 1;
+	for (i = 0; i < chan->valid_ports; i++) {
+		if (chan->status_count[i] == 0)
+			goto unlock;
+	}
+	if (!list_empty(&chan->dequeue)) {
+		for (i = 0; i < chan->valid_ports; i++)
+			chan->status_count[i] -= 1;
+		buf = list_first_entry(&chan->dequeue,
+			struct tegra_channel_buffer, queue);
+		list_del_init(&buf->queue);
+	}
+unlock:
+	spin_unlock(&chan->dequeue_lock);
 
-			vi5_capture_dequeue(chan, buf);
-		}
+	if (!buf)
+		return;
 
-		spin_lock_irqsave(&chan->capture_state_lock, flags);
-		if (chan->capture_state == CAPTURE_ERROR_TIMEOUT) {
-			spin_unlock_irqrestore(&chan->capture_state_lock,
-				flags);
-			break;
-		}
+	vi5_capture_dequeue(chan, buf);
 
+	spin_lock_irqsave(&chan->capture_state_lock, flags);
+	if (chan->capture_active) {
 		if (chan->capture_state == CAPTURE_ERROR) {
-			spin_unlock_irqrestore(&chan->capture_state_lock,
-				flags);
-			err = tegra_channel_error_recover(chan, false);
-			if (err) {
-				dev_err(chan->vi->dev,
-					"fatal: error recovery failed\n");
-				break;
-			}
-		} else
-			spin_unlock_irqrestore(&chan->capture_state_lock,
-				flags);
-		if (kthread_should_stop())
-			break;
+			schedule_work(&chan->error_work);
+		} else {
+			if (!list_empty(&chan->capture))
+				schedule_work(&chan->status_work);
+
+			/* restart the frame timeout for the next request */
+			if (list_empty(&chan->dequeue))
+				cancel_delayed_work(&chan->timeout_work);
+			else if (chan->capture_timeout_ms >= 0)
+				mod_delayed_work(system_wq, &chan->timeout_work,
+					msecs_to_jiffies(chan->capture_timeout_ms));
+		}
 	}
+	spin_unlock_irqrestore(&chan->capture_state_lock, flags);
+}
 
-	return 0;
+static void vi5_capture_status_work(struct work_struct *work)
+{
+	struct tegra_channel *chan = container_of(work,
+			struct tegra_channel, status_work);
+
+	vi5_capture_submit(chan);
 }
 
-static int vi5_channel_start_kthreads(struct tegra_channel *chan)
+static void vi5_capture_timeout_work(struct work_struct *work)
 {
-	int err = 0;
+	struct tegra_channel *chan = container_of(to_delayed_work(work),
+			struct tegra_channel, timeout_work);
+	unsigned long flags;
 
-	/* Start the kthread for capture enqueue */
-	if (chan->kthread_capture_start) {
-		dev_err(chan->vi->dev, "enqueue kthread already initialized\n");
-		err = -1;
-		goto done;
-	}
-	chan->kthread_capture_start = kthread_run(
-		tegra_channel_kthread_capture_enqueue, chan, chan->video->name);
-	if (IS_ERR(chan->kthread_capture_start)) {
-		dev_err(&chan->video->dev,
-			"failed to run kthread for capture enqueue\n");
-		err = PTR_ERR(chan->kthread_capture_start);
-		goto done;
+	spin_lock_irqsave(&chan->capture_state_lock, flags);
+	if (chan->capture_active && chan->capture_state != CAPTURE_ERROR
+			&& !list_empty(&chan->dequeue)) {
+		dev_err(chan->vi->dev,
+			"uncorr_err: request timed out after %d ms\n",
+			chan->capture_timeout_ms);
+		chan->capture_state = CAPTURE_ERROR;
+		schedule_work(&chan->error_work);
 	}
+	spin_unlock_irqrestore(&chan->capture_state_lock, flags);
+}
 
-	/* Start the kthread for capture dequeue */
-	if (chan->kthread_capture_dequeue) {
-		dev_err(chan->vi->dev, "dequeue kthread already initialized\n");
-		err = -1;
-		goto done;
+static void vi5_capture_error_work(struct work_struct *work)
+{
+	struct tegra_channel *chan = container_of(work,
+			struct tegra_channel, error_work);
+	int err = 0;
+
+	mutex_lock(&chan->submit_lock);
+	if (!chan->capture_active) {
+		mutex_unlock(&chan->submit_lock);
+		return;
 	}
-	chan->kthread_capture_dequeue = kthread_run(
-		tegra_channel_kthread_capture_dequeue, chan, chan->video->name);
-	if (IS_ERR(chan->kthread_capture_dequeue)) {
-		dev_err(&chan->video->dev,
-			"failed to run kthread for capture dequeue\n");
-		err = PTR_ERR(chan->kthread_capture_dequeue);
-		goto done;
+	err = tegra_channel_error_recover(chan, false);
+	mutex_unlock(&chan->submit_lock);
+
+	if (err) {
+		dev_err(chan->vi->dev, "fatal: error recovery failed\n");
+		return;
 	}
 
-done:
-	return err;
+	/* resubmit buffers queued while the channel was being reset */
+	vi5_capture_submit(chan);
 }
 
-static void vi5_channel_stop_kthreads(struct tegra_channel *chan)
+static void vi5_channel_start_capture(struct tegra_channel *chan)
 {
-	mutex_lock(&chan->stop_kthread_lock);
+	unsigned long flags;
 
-	/* Stop the kthread for capture enqueue */
-	if (chan->kthread_capture_start) {
-		kthread_stop(chan->kthread_capture_start);
-		chan->kthread_capture_start = NULL;
-	}
+	INIT_WORK(&chan->status_work, vi5_capture_status_work);
+	INIT_WORK(&chan->error_work, vi5_capture_error_work);
+	INIT_DELAYED_WORK(&chan->timeout_work, vi5_capture_timeout_work);
 
-	/* Stop the kthread for capture dequeue */
-	if (chan->kthread_capture_dequeue) {
-		send_sig(SIGINT, chan->kthread_capture_dequeue, 1);
-		kthread_stop(chan->kthread_capture_dequeue);
-		chan->kthread_capture_dequeue = NULL;
-	}
+	spin_lock(&chan->dequeue_lock);
+	memset(chan->status_count, 0, sizeof(chan->status_count));
+	spin_unlock(&chan->dequeue_lock);
+
+	mutex_lock(&chan->submit_lock);
+	spin_lock_irqsave(&chan->capture_state_lock, flags);
+	chan->capture_active = true;
+	spin_unlock_irqrestore(&chan->capture_state_lock, flags);
+	mutex_unlock(&chan->submit_lock);
 
-	mutex_unlock(&chan->stop_kthread_lock);
+	/* submit buffers queued before streaming was started */
+	vi5_capture_submit(chan);
+}
+
+static void vi5_channel_stop_capture(struct tegra_channel *chan)
+{
+	unsigned int vi_port;
+	unsigned long flags;
+
+	mutex_lock(&chan->submit_lock);
+	spin_lock_irqsave(&chan->capture_state_lock, flags);
+	chan->capture_active = false;
+	spin_unlock_irqrestore(&chan->capture_state_lock, flags);
+	mutex_unlock(&chan->submit_lock);
+
+	cancel_delayed_work_sync(&chan->timeout_work);
+	cancel_work_sync(&chan->status_work);
+	cancel_work_sync(&chan->error_work);
+
+	for (vi_port = 0; vi_port < chan->valid_ports; vi_port++)
+		vi_capture_set_status_callback(chan->tegra_vi_channel[vi_port],
+			NULL, NULL);
 }
 
 static void vi5_unit_get_device_handle(struct platform_device *pdev,
@@ -942,9 +1019,7 @@ static int vi5_channel_start_streaming(struct vb2_queue *vq, u32 count)
 		chan->sequence = 0;
 		tegra_channel_init_ring_buffer(chan);
 
-		ret = vi5_channel_start_kthreads(chan);
-		if (ret != 0)
-			goto err_start_kthreads;
+		vi5_channel_start_capture(chan);
 	}
 
 	/* csi stream/sensor devices should be streamon post vi channel setup */
@@ -962,14 +1037,12 @@ err_write_blobs:
 	tegra_channel_set_stream(chan, false);
 
 err_set_stream:
-	if (!chan->bypass)
-		vi5_channel_stop_kthreads(chan);
-
-err_start_kthreads:
-	if (!chan->bypass)
+	if (!chan->bypass) {
+		vi5_channel_stop_capture(chan);
 		for (vi_port = 0; vi_port < chan->valid_ports; vi_port++)
 			vi_capture_release(chan->tegra_vi_channel[vi_port],
 				CAPTURE_CHANNEL_RESET_FLAG_IMMEDIATE);
+	}
 
 err_setup:
 	if (!chan->bypass)
@@ -992,7 +1065,7 @@ static int vi5_channel_stop_streaming(struct vb2_queue *vq)
 	long err;
 	int vi_port = 0;
 	if (!chan->bypass)
-		vi5_channel_stop_kthreads(chan);
+		vi5_channel_stop_capture(chan);
 
 	/* csi stream/sensor(s) devices to be closed before vi channel */
 	tegra_channel_set_stream(chan, false);
@@ -1120,6 +1193,7 @@ struct tegra_vi_fops vi5_fops = {
 	.vi_stop_streaming = vi5_channel_stop_streaming,
 	.vi_setup_queue = vi5_channel_setup_queue,
 	.vi_error_recover = vi5_channel_error_recover,
+	.vi_buffer_queue = vi5_buffer_queue,
 	.vi_add_ctrls = vi5_add_ctrls,
 	.vi_init_video_formats = vi5_init_video_formats,
 	.vi_unit_get_device_handle = vi5_unit_get_device_handle,
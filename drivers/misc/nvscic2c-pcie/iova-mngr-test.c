@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2022, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+
+/*
+ * KUnit checks of the IOVA manager: best-fit placement on reserve and
+ * coalescing of free neighbours on release, through the public API only.
+ */
+
+#include <kunit/test.h>
+#include <linux/sizes.h>
+
+#include "iova-mngr.h"
+
+#define TEST_BASE	(0x80000000ULL)
+#define TEST_SIZE	(SZ_64K)
+
+static void *
+test_reserve(struct kunit *test, void *mngr, size_t size, u64 *address)
+{
+	void *block = NULL;
+	size_t offset = 0;
+
+	KUNIT_ASSERT_EQ(test, 0,
+			iova_mngr_block_reserve(mngr, size, address, &offset,
+						&block));
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, block);
+	KUNIT_EXPECT_EQ(test, (u64)offset, *address - TEST_BASE);
+	return block;
+}
+
+static void *
+test_init(struct kunit *test)
+{
+	void *mngr = NULL;
+
+	KUNIT_ASSERT_EQ(test, 0,
+			iova_mngr_init("iova_test", TEST_BASE, TEST_SIZE, &mngr));
+	return mngr;
+}
+
+/* whole region is free again only if every release coalesced.*/
+static void
+expect_all_free(struct kunit *test, void *mngr)
+{
+	void *block = NULL;
+	u64 address = 0;
+
+	block = test_reserve(test, mngr, TEST_SIZE, &address);
+	KUNIT_EXPECT_EQ(test, address, TEST_BASE);
+	KUNIT_EXPECT_EQ(test, 0, iova_mngr_block_release(mngr, &block));
+}
+
+static void iova_mngr_test_sequential(struct kunit *test)
+{
+	void *mngr = test_init(test);
+	void *block[4] = {NULL};
+	u64 address = 0;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		block[i] = test_reserve(test, mngr, SZ_4K, &address);
+		KUNIT_EXPECT_EQ(test, address, TEST_BASE + i * SZ_4K);
+	}
+	for (i = 0; i < 4; i++)
+		KUNIT_EXPECT_EQ(test, 0, iova_mngr_block_release(mngr, &block[i]));
+	KUNIT_EXPECT_PTR_EQ(test, block[0], NULL);
+
+	expect_all_free(test, mngr);
+	iova_mngr_deinit(&mngr);
+	KUNIT_EXPECT_PTR_EQ(test, mngr, NULL);
+}
+
+static void iova_mngr_test_best_fit(struct kunit *test)
+{
+	void *mngr = test_init(test);
+	void *a, *b, *c, *d, *e, *f, *g;
+	u64 address = 0;
+
+	/* a:4K b:8K c:4K d:4K e:4K f:4K, rest free.*/
+	a = test_reserve(test, mngr, SZ_4K, &address);
+	b = test_reserve(test, mngr, SZ_8K, &address);
+	c = test_reserve(test, mngr, SZ_4K, &address);
+	d = test_reserve(test, mngr, SZ_4K, &address);
+	e = test_reserve(test, mngr, SZ_4K, &address);
+	f = test_reserve(test, mngr, SZ_4K, &address);
+
+	/* f merges into the tail: 8K hole at +4K, 4K at +16K, tail at +24K.*/
+	KUNIT_ASSERT_EQ(test, 0, iova_mngr_block_release(mngr, &b));
+	KUNIT_ASSERT_EQ(test, 0, iova_mngr_block_release(mngr, &d));
+	KUNIT_ASSERT_EQ(test, 0, iova_mngr_block_release(mngr, &f));
+
+	/* smallest hole that fits, lowest address among equal sizes.*/
+	g = test_reserve(test, mngr, SZ_4K, &address);
+	KUNIT_EXPECT_EQ(test, address, TEST_BASE + SZ_16K);
+	KUNIT_ASSERT_EQ(test, 0, iova_mngr_block_release(mngr, &g));
+
+	/* 8K skips the 4K holes and takes the 8K hole exactly.*/
+	g = test_reserve(test, mngr, SZ_8K, &address);
+	KUNIT_EXPECT_EQ(test, address, TEST_BASE + SZ_4K);
+	KUNIT_ASSERT_EQ(test, 0, iova_mngr_block_release(mngr, &g));
+
+	/* 12K only fits in the tail.*/
+	g = test_reserve(test, mngr, SZ_8K + SZ_4K, &address);
+	KUNIT_EXPECT_EQ(test, address, TEST_BASE + 6 * SZ_4K);
+	KUNIT_ASSERT_EQ(test, 0, iova_mngr_block_release(mngr, &g));
+
+	/* releasing e merges with the holes on both sides.*/
+	KUNIT_ASSERT_EQ(test, 0, iova_mngr_block_release(mngr, &e));
+	g = test_reserve(test, mngr, SZ_16K + SZ_4K, &address);
+	KUNIT_EXPECT_EQ(test, address, TEST_BASE + SZ_16K);
+	KUNIT_ASSERT_EQ(test, 0, iova_mngr_block_release(mngr, &g));
+
+	KUNIT_ASSERT_EQ(test, 0, iova_mngr_block_release(mngr, &c));
+	KUNIT_ASSERT_EQ(test, 0, iova_mngr_block_release(mngr, &a));
+	expect_all_free(test, mngr);
+	iova_mngr_deinit(&mngr);
+}
+
+static void iova_mngr_test_exhaust(struct kunit *test)
+{
+	void *mngr = test_init(test);
+	void *block[TEST_SIZE / SZ_4K] = {NULL};
+	void *extra = NULL;
+	u64 address = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(block); i++)
+		block[i] = test_reserve(test, mngr, SZ_4K, &address);
+	KUNIT_EXPECT_EQ(test, -ENOMEM,
+			iova_mngr_block_reserve(mngr, 1, &address, NULL, &extra));
+	KUNIT_EXPECT_PTR_EQ(test, extra, NULL);
+
+	/* free every other block, then the rest: all merge cases run.*/
+	for (i = 1; i < ARRAY_SIZE(block); i += 2)
+		KUNIT_ASSERT_EQ(test, 0, iova_mngr_block_release(mngr, &block[i]));
+	KUNIT_EXPECT_EQ(test, -ENOMEM,
+			iova_mngr_block_reserve(mngr, SZ_8K, &address, NULL,
+						&extra));
+	for (i = 0; i < ARRAY_SIZE(block); i += 2)
+		KUNIT_ASSERT_EQ(test, 0, iova_mngr_block_release(mngr, &block[i]));
+
+	expect_all_free(test, mngr);
+	iova_mngr_deinit(&mngr);
+}
+
+static void iova_mngr_test_same_name(struct kunit *test)
+{
+	void *first = test_init(test);
+	void *second = test_init(test);
+
+	KUNIT_EXPECT_PTR_NE(test, first, second);
+	iova_mngr_deinit(&second);
+	iova_mngr_deinit(&first);
+}
+
+static struct kunit_case iova_mngr_test_cases[] = {
+	KUNIT_CASE(iova_mngr_test_sequential),
+	KUNIT_CASE(iova_mngr_test_best_fit),
+	KUNIT_CASE(iova_mngr_test_exhaust),
+	KUNIT_CASE(iova_mngr_test_same_name),
+	{}
+};
+
+static struct kunit_suite iova_mngr_test_suite = {
+	.name = "nvscic2c-pcie-iova-mngr",
+	.test_cases = iova_mngr_test_cases,
+};
+kunit_test_suite(iova_mngr_test_suite);
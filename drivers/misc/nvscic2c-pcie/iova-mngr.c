@@ -4,8 +4,11 @@
 #define pr_fmt(fmt)	"nvscic2c-pcie: iova-mgr: " fmt
 
 #include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/printk.h>
+#include <linux/rbtree.h>
 #include <linux/slab.h>
 #include <linux/types.h>
 
@@ -18,13 +21,21 @@
  *
  * IOVA manager chunks entire IOVA space into these blocks/chunks.
  *
- * The chunk/block is also a node for linking to previous and next
- * nodes of a circular doubly linked list - free or reserved.
+ * A free chunk/block is a node in two rb-trees: one ordered by address
+ * (for locating neighbours to coalesce on release) and one ordered by
+ * size, then address (for best-fit on reserve). A reserved chunk/block
+ * is a node in the reserved list instead.
  */
 struct block_t {
-	/* for management of this chunk in either avail or reserve lists.*/
+	/* for management of this chunk in the reserved list.*/
 	struct list_head node;
 
+	/* for management of this chunk in the free address tree.*/
+	struct rb_node addr_node;
+
+	/* for management of this chunk in the free size tree.*/
+	struct rb_node size_node;
+
 	/* block address.*/
 	u64 address;
 
@@ -36,8 +47,8 @@ struct block_t {
  * INTERNAL datastructure for IOVA space manager.
  *
  * IOVA space manager would fragment and manage the IOVA region
- * using two circular doubly linked lists - reserved list and
- * free list. These lists contain blocks/chunks reserved
+ * using two rb-trees for the free blocks and a circular doubly linked
+ * list for the reserved blocks. These contain blocks/chunks reserved
  * or free for use by clients (callers) from the overall
  * IOVA region the IOVA manager was configured with.
  */
@@ -50,12 +61,14 @@ struct mngr_ctx_t {
 	char name[NAME_MAX];
 
 	/*
-	 * Circular doubly linked list of blocks indicating
-	 * available/free IOVA space(s). When IOVA manager is
+	 * Free blocks ordered by address. When IOVA manager is
 	 * initialised all of the IOVA space is marked as available
 	 * to begin with.
 	 */
-	struct list_head *free_list;
+	struct rb_root free_addr;
+
+	/* The same free blocks ordered by (size, address) for best-fit.*/
+	struct rb_root free_size;
 
 	/*
 	 * Book-keeping of the user IOVA blocks in a circular double
@@ -63,13 +76,112 @@ struct mngr_ctx_t {
 	 */
 	struct list_head *reserved_list;
 
-	/* Ensuring reserve, free and the list operations are serialized.*/
+	/* Ensuring reserve, free and the tree operations are serialized.*/
 	struct mutex lock;
 
 	/* base address memory manager is configured with. */
 	u64 base_address;
 };
 
+static void
+free_addr_insert(struct mngr_ctx_t *ctx, struct block_t *block)
+{
+	struct rb_node **link = &ctx->free_addr.rb_node, *parent = NULL;
+	struct block_t *curr = NULL;
+
+	while (*link) {
+		parent = *link;
+		curr = rb_entry(parent, struct block_t, addr_node);
+		if (block->address < curr->address)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&block->addr_node, parent, link);
+	rb_insert_color(&block->addr_node, &ctx->free_addr);
+}
+
+static void
+free_size_insert(struct mngr_ctx_t *ctx, struct block_t *block)
+{
+	struct rb_node **link = &ctx->free_size.rb_node, *parent = NULL;
+	struct block_t *curr = NULL;
+
+	while (*link) {
+		parent = *link;
+		curr = rb_entry(parent, struct block_t, size_node);
+		if (block->size < curr->size ||
+		    (block->size == curr->size &&
+		     block->address < curr->address))
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&block->size_node, parent, link);
+	rb_insert_color(&block->size_node, &ctx->free_size);
+}
+
+static void
+free_block_insert(struct mngr_ctx_t *ctx, struct block_t *block)
+{
+	free_addr_insert(ctx, block);
+	free_size_insert(ctx, block);
+}
+
+static void
+free_block_erase(struct mngr_ctx_t *ctx, struct block_t *block)
+{
+	rb_erase(&block->addr_node, &ctx->free_addr);
+	rb_erase(&block->size_node, &ctx->free_size);
+}
+
+/*
+ * Smallest free block that can hold size. Among equal sized blocks,
+ * the lowest address is preferred.
+ */
+static struct block_t *
+free_block_best_fit(struct mngr_ctx_t *ctx, size_t size)
+{
+	struct rb_node *rb = ctx->free_size.rb_node;
+	struct block_t *curr = NULL, *best = NULL;
+
+	while (rb) {
+		curr = rb_entry(rb, struct block_t, size_node);
+		if (curr->size >= size) {
+			best = curr;
+			rb = rb->rb_left;
+		} else {
+			rb = rb->rb_right;
+		}
+	}
+	return best;
+}
+
+/*
+ * Free block with the highest address lower than address, and the free
+ * block with the lowest address higher than address.
+ */
+static void
+free_block_neighbours(struct mngr_ctx_t *ctx, u64 address,
+		      struct block_t **prev, struct block_t **next)
+{
+	struct rb_node *rb = ctx->free_addr.rb_node;
+	struct block_t *curr = NULL;
+
+	*prev = NULL;
+	*next = NULL;
+	while (rb) {
+		curr = rb_entry(rb, struct block_t, addr_node);
+		if (address < curr->address) {
+			*next = curr;
+			rb = rb->rb_left;
+		} else {
+			*prev = curr;
+			rb = rb->rb_right;
+		}
+	}
+}
+
 /*
  * Reserves a block from the free IOVA regions. Once reserved, the block
  * is marked reserved and appended in the reserved list (no ordering
@@ -81,16 +193,21 @@ iova_mngr_block_reserve(void *mngr_handle, size_t size,
 			void **block_handle)
 {
 	struct mngr_ctx_t *ctx = (struct mngr_ctx_t *)(mngr_handle);
-	struct block_t *reserve = NULL, *curr = NULL, *best = NULL;
+	struct block_t *reserve = NULL, *best = NULL, *found = NULL;
 	int ret = 0;
 
 	if (WARN_ON(!ctx || *block_handle || !size))
 		return -EINVAL;
 
+	/* allocate outside the lock, freed if not required.*/
+	reserve = kzalloc(sizeof(*reserve), GFP_KERNEL);
+	if (WARN_ON(!reserve))
+		return -ENOMEM;
+
 	mutex_lock(&ctx->lock);
 
 	/* if there are no free blocks to reserve. */
-	if (list_empty(ctx->free_list)) {
+	if (RB_EMPTY_ROOT(&ctx->free_size)) {
 		ret = -ENOMEM;
 		pr_err("(%s): No memory available to reserve block of size:(%lu)\n",
 		       ctx->name, size);
@@ -98,14 +215,7 @@ iova_mngr_block_reserve(void *mngr_handle, size_t size,
 	}
 
 	/* find the best of all free bocks to reserve.*/
-	list_for_each_entry(curr, ctx->free_list, node) {
-		if (curr->size >= size) {
-			if (!best)
-				best = curr;
-			else if (curr->size < best->size)
-				best = curr;
-		}
-	}
+	best = free_block_best_fit(ctx, size);
 
 	/* if there isn't any free block of requested size. */
 	if (!best) {
@@ -113,51 +223,52 @@ iova_mngr_block_reserve(void *mngr_handle, size_t size,
 		pr_err("(%s): No enough mem available to reserve block sz:(%lu)\n",
 		       ctx->name, size);
 		goto err;
-	} else {
-		struct block_t *found = NULL;
+	}
 
+	if (best->size == size) {
 		/* perfect fit.*/
-		if (best->size == size) {
-			list_del(&best->node);
-			list_add_tail(&best->node, ctx->reserved_list);
-			found = best;
-		} else {
-			/* chunk out a new block, adjust the free block.*/
-			reserve = kzalloc(sizeof(*reserve), GFP_KERNEL);
-			if (WARN_ON(!reserve)) {
-				ret = -ENOMEM;
-				goto err;
-			}
-			reserve->address = best->address;
-			reserve->size = size;
-			best->address += size;
-			best->size -= size;
-			list_add_tail(&reserve->node, ctx->reserved_list);
-			found = reserve;
-		}
-		*block_handle = (void *)(found);
-
-		if (address)
-			*address = found->address;
-		if (offset)
-			*offset = (found->address - ctx->base_address);
+		free_block_erase(ctx, best);
+		found = best;
+	} else {
+		/*
+		 * chunk out a new block, adjust the free block. Address
+		 * order of the free block is unchanged, only the size
+		 * tree needs re-positioning.
+		 */
+		rb_erase(&best->size_node, &ctx->free_size);
+		reserve->address = best->address;
+		reserve->size = size;
+		best->address += size;
+		best->size -= size;
+		free_size_insert(ctx, best);
+		found = reserve;
+		reserve = NULL;
 	}
+	list_add_tail(&found->node, ctx->reserved_list);
+	*block_handle = (void *)(found);
+
+	if (address)
+		*address = found->address;
+	if (offset)
+		*offset = (found->address - ctx->base_address);
 err:
 	mutex_unlock(&ctx->lock);
+	if (reserve)
+		kfree(reserve);
 	return ret;
 }
 
 /*
  * Release an already reserved IOVA block/chunk by the caller back to
- * free list.
+ * free trees, coalescing with the immediate free neighbours.
  */
 int
 iova_mngr_block_release(void *mngr_handle, void **block_handle)
 {
 	struct mngr_ctx_t *ctx = (struct mngr_ctx_t *)(mngr_handle);
 	struct block_t *release = (struct block_t *)(*block_handle);
-	struct block_t *curr = NULL, *prev = NULL;
-	bool done = false;
+	struct block_t *prev = NULL, *next = NULL;
+	bool merge_prev = false, merge_next = false;
 	int ret = 0;
 
 	if (!ctx || !release)
@@ -165,76 +276,38 @@ iova_mngr_block_release(void *mngr_handle, void **block_handle)
 
 	mutex_lock(&ctx->lock);
 
-	list_for_each_entry(curr, ctx->free_list, node) {
-		if (release->address < curr->address) {
-			/* if the immediate next node is available for merge.*/
-			if (curr->address == release->address + release->size) {
-				curr->address = release->address;
-				curr->size += release->size;
-				list_del(&release->node);
-				kfree(release);
-				/*
-				 * if the immediate previous node is also
-				 * available for merge.
-				 */
-				if ((prev) &&
-				    ((prev->address + prev->size)
-				      == curr->address)) {
-					prev->size += curr->size;
-					list_del(&curr->node);
-					kfree(curr);
-				}
-			} else if ((prev) &&
-				   ((prev->address + prev->size)
-				    == release->address)) {
-				/*
-				 * if only the immediate prev node is available
-				 */
-				prev->size += release->size;
-				list_del(&release->node);
-				kfree(release);
-			} else {
-				/*
-				 * cannot be merged with either the immediate
-				 * prev or the immediate next node. Add it in the
-				 * free list before the current node.
-				 */
-				list_del(&release->node);
-				list_add_tail(&release->node, &curr->node);
-			}
-			done = true;
-			break;
-		}
-		prev = curr;
-	}
-
-	/*
-	 * Even if after traversing each entry in list, we could not
-	 * add the block to be released back in free list, because:
-	 */
-	if (!done) {
-		if (!list_empty(ctx->free_list)) {
-			/*
-			 * The block to be freed has the highest order
-			 * address of all the existing blocks in free list.
-			 */
-			struct block_t *last =
-			list_last_entry(ctx->free_list, struct block_t, node);
-			if ((last->address + last->size) == release->address) {
-				/* can be merged with last node of list.*/
-				last->size += release->size;
-				list_del(&release->node);
-				kfree(release);
-			} else {
-				/* cannot be merged, add as the last node.*/
-				list_del(&release->node);
-				list_add_tail(&release->node, ctx->free_list);
-			}
-		} else {
-			/* free list was empty.*/
-			list_del(&release->node);
-			list_add_tail(&release->node, ctx->free_list);
-		}
+	list_del(&release->node);
+	free_block_neighbours(ctx, release->address, &prev, &next);
+	merge_prev = (prev && (prev->address + prev->size) == release->address);
+	merge_next = (next && (release->address + release->size) == next->address);
+
+	if (merge_prev && merge_next) {
+		/* both immediate prev and next nodes are available.*/
+		rb_erase(&prev->size_node, &ctx->free_size);
+		free_block_erase(ctx, next);
+		prev->size += release->size + next->size;
+		free_size_insert(ctx, prev);
+		kfree(next);
+		kfree(release);
+	} else if (merge_prev) {
+		/* if only the immediate prev node is available.*/
+		rb_erase(&prev->size_node, &ctx->free_size);
+		prev->size += release->size;
+		free_size_insert(ctx, prev);
+		kfree(release);
+	} else if (merge_next) {
+		/*
+		 * if only the immediate next node is available. Moving its
+		 * start address down to release keeps address order intact.
+		 */
+		rb_erase(&next->size_node, &ctx->free_size);
+		next->address = release->address;
+		next->size += release->size;
+		free_size_insert(ctx, next);
+		kfree(release);
+	} else {
+		/* cannot be merged with either, add as a new free node.*/
+		free_block_insert(ctx, release);
 	}
 	*block_handle = NULL;
 
@@ -255,6 +328,7 @@ iova_mngr_print(void *mngr_handle)
 {
 	struct mngr_ctx_t *ctx = (struct mngr_ctx_t *)(mngr_handle);
 	struct block_t *block = NULL;
+	struct rb_node *rb = NULL;
 
 	if (ctx) {
 		mutex_lock(&ctx->lock);
@@ -264,7 +338,8 @@ iova_mngr_print(void *mngr_handle)
 				 ctx->name, &block->address, block->size);
 		}
 		pr_debug("(%s): Free\n", ctx->name);
-		list_for_each_entry(block, ctx->free_list, node) {
+		for (rb = rb_first(&ctx->free_addr); rb; rb = rb_next(rb)) {
+			block = rb_entry(rb, struct block_t, addr_node);
 			pr_debug("\t\t (%s): address = 0x%pa[p], size = 0x%lx\n",
 				 ctx->name, &block->address, block->size);
 		}
@@ -274,8 +349,8 @@ iova_mngr_print(void *mngr_handle)
 
 /*
  * Initialises the IOVA space manager with the base address + size
- * provided. IOVA manager would use two lists for book-keeping reserved
- * memory blocks and free memory blocks.
+ * provided. IOVA manager would use two rb-trees for book-keeping free
+ * memory blocks and a list for reserved memory blocks.
  *
  * When initialised all of the IOVA region: base_address + size is free.
  */
@@ -295,18 +370,15 @@ iova_mngr_init(char *name, u64 base_address, size_t size, void **mngr_handle)
 		ret = -ENOMEM;
 		goto err;
 	}
-
-	ctx->free_list = kzalloc(sizeof(*ctx->free_list), GFP_KERNEL);
-	if (WARN_ON(!ctx->free_list)) {
-		ret = -ENOMEM;
-		goto err;
-	}
+	ctx->free_addr = RB_ROOT;
+	ctx->free_size = RB_ROOT;
 
 	ctx->reserved_list = kzalloc(sizeof(*ctx->reserved_list), GFP_KERNEL);
 	if (WARN_ON(!ctx->reserved_list)) {
 		ret = -ENOMEM;
 		goto err;
 	}
+	INIT_LIST_HEAD(ctx->reserved_list);
 
 	if (strlen(name) > (NAME_MAX - 1)) {
 		ret = -EINVAL;
@@ -314,8 +386,6 @@ iova_mngr_init(char *name, u64 base_address, size_t size, void **mngr_handle)
 		goto err;
 	}
 	strcpy(ctx->name, name);
-	INIT_LIST_HEAD(ctx->reserved_list);
-	INIT_LIST_HEAD(ctx->free_list);
 	mutex_init(&ctx->lock);
 	ctx->base_address = base_address;
 
@@ -327,7 +397,7 @@ iova_mngr_init(char *name, u64 base_address, size_t size, void **mngr_handle)
 	}
 	block->address = base_address;
 	block->size = size;
-	list_add(&block->node, ctx->free_list);
+	free_block_insert(ctx, block);
 
 	*mngr_handle = ctx;
 	return ret;
@@ -347,6 +417,7 @@ iova_mngr_deinit(void **mngr_handle)
 {
 	struct block_t *block = NULL;
 	struct list_head *curr = NULL, *next = NULL;
+	struct rb_node *rb = NULL;
 	struct mngr_ctx_t *ctx = (struct mngr_ctx_t *)(*mngr_handle);
 
 	if (ctx) {
@@ -354,7 +425,7 @@ iova_mngr_deinit(void **mngr_handle)
 		iova_mngr_print(*mngr_handle);
 
 		/* ideally, all blocks should have returned before this.*/
-		if (!list_empty(ctx->reserved_list)) {
+		if (ctx->reserved_list && !list_empty(ctx->reserved_list)) {
 			list_for_each_safe(curr, next, ctx->reserved_list) {
 				block = list_entry(curr, struct block_t, node);
 				iova_mngr_block_release(*mngr_handle,
@@ -363,15 +434,14 @@ iova_mngr_deinit(void **mngr_handle)
 		}
 
 		/* ideally, just one whole free block should remain as free.*/
-		list_for_each_safe(curr, next, ctx->free_list) {
-			block = list_entry(curr, struct block_t, node);
-			list_del(&block->node);
+		while ((rb = rb_first(&ctx->free_addr))) {
+			block = rb_entry(rb, struct block_t, addr_node);
+			free_block_erase(ctx, block);
 			kfree(block);
 		}
 
 		mutex_destroy(&ctx->lock);
 		kfree(ctx->reserved_list);
-		kfree(ctx->free_list);
 		kfree(ctx);
 		*mngr_handle = NULL;
 	}
@@ -22,7 +22,7 @@ iova_mngr_block_reserve(void *mngr_handle, size_t size,
  * iova_mngr_block_release
  *
  * Release an already reserved IOVA block/chunk by the caller back to
- * free list.
+ * free trees, coalescing with the immediate free neighbours.
  */
 int
 iova_mngr_block_release(void *mngr_handle, void **block_handle);
@@ -41,8 +41,8 @@ void iova_mngr_print(void *handle);
  * iova_mngr_init
  *
  * Initialises the IOVA space manager with the base address + size
- * provided. IOVA manager would use two lists for book-keeping reserved
- * memory blocks and free memory blocks.
+ * provided. IOVA manager would use two rb-trees for book-keeping free
+ * memory blocks and a list for reserved memory blocks.
  *
  * When initialised all of the IOVA region: base_address + size is free.
  */
@@ -6,6 +6,8 @@
 #include <nvidia/conftest.h>
 
 #include <linux/anon_inodes.h>
+#include <linux/bitmap.h>
+#include <linux/bitops.h>
 #include <linux/device.h>
 #include <linux/errno.h>
 #include <linux/fdtable.h>
@@ -62,12 +64,21 @@ struct copy_req_params {
 
 /* one copy request.*/
 struct copy_request {
-	/* book-keeping for copy completion.*/
+	/* book-keeping for copy completion: node in the head's batch list.*/
 	struct list_head node;
 
+	/*
+	 * copy requests merged into this request's eDMA descriptor chain.
+	 * Only populated for the head of a chain, completed along with it.
+	 */
+	struct list_head batch;
+
+	/* index of this copy_request in the ctx copy request pool.*/
+	u32 pool_idx;
+
 	/*
 	 * back-reference to stream_ext_context, used in eDMA callback.
-	 * to add this copy_request back in free_list for reuse. Also,
+	 * to return this copy_request back to the pool for reuse. Also,
 	 * the host1x_pdev in ctx is used via this ctx in the callback.
 	 */
 	struct stream_ext_ctx_t *ctx;
@@ -203,10 +214,13 @@ struct stream_ext_ctx_t {
 	/* Intermediate validated and copied user-args for submit-copy ioctl.*/
 	struct copy_req_params cr_params;
 
-	/* Async copy: book-keeping copy-requests: free and in-progress.*/
-	struct list_head free_list;
-	/* guard free_list.*/
-	struct mutex free_lock;
+	/*
+	 * Async copy: pool of max_copy_requests copy-requests. A set bit in
+	 * cr_pool_busy marks the copy-request in-progress. Bits are claimed
+	 * by submit and released by eDMA callback atomically, without a lock.
+	 */
+	struct copy_request **cr_pool;
+	unsigned long *cr_pool_busy;
 	atomic_t transfer_count;
 	wait_queue_head_t transfer_waitq;
 
@@ -252,6 +266,12 @@ allocate_copy_request(struct stream_ext_ctx_t *ctx,
 		      struct copy_request **copy_request);
 static void
 free_copy_request(struct copy_request **copy_request);
+static void
+free_copy_request_pool(struct stream_ext_ctx_t *ctx);
+static struct copy_request *
+copy_request_pool_get(struct stream_ext_ctx_t *ctx);
+static void
+copy_request_pool_put(struct copy_request *cr);
 
 static int
 allocate_copy_req_params(struct stream_ext_ctx_t *ctx,
@@ -549,19 +569,17 @@ ioctl_map_obj(struct stream_ext_ctx_t *ctx,
 	return ret;
 }
 
-/* implement NVSCIC2C_PCIE_IOCTL_SUBMIT_COPY_REQUEST ioctl call. */
+/*
+ * Parse, validate and take references of one user submit-copy args into
+ * a copy-request from the pool and generate its eDMA descriptors.
+ */
 static int
-ioctl_submit_copy_request(struct stream_ext_ctx_t *ctx,
-			  struct nvscic2c_pcie_submit_copy_args *args)
+prepare_copy_request(struct stream_ext_ctx_t *ctx,
+		     struct nvscic2c_pcie_submit_copy_args *args,
+		     struct copy_request **copy_request)
 {
 	int ret = 0;
 	struct copy_request *cr = NULL;
-	edma_xfer_status_t edma_status = EDMA_XFER_FAIL_INVAL_INPUTS;
-	enum nvscic2c_pcie_link link = NVSCIC2C_PCIE_LINK_DOWN;
-
-	link = pci_client_query_link_status(ctx->pci_client_h);
-	if (link != NVSCIC2C_PCIE_LINK_UP)
-		return -ENOLINK;
 
 	/* copy user-supplied submit-copy args.*/
 	ret = copy_args_from_user(ctx, args, &ctx->cr_params);
@@ -573,19 +591,16 @@ ioctl_submit_copy_request(struct stream_ext_ctx_t *ctx,
 	if (ret)
 		return ret;
 
-	/* get one copy-request from the free list.*/
-	mutex_lock(&ctx->free_lock);
-	if (list_empty(&ctx->free_list)) {
+	/* get one copy-request from the pool.*/
+	cr = copy_request_pool_get(ctx);
+	if (!cr) {
 		/*
 		 * user supplied more than mentioned in max_copy_requests OR
 		 * eDMA async didn't invoke callback when eDMA was done.
 		 */
-		mutex_unlock(&ctx->free_lock);
 		return -EAGAIN;
 	}
-	cr = list_first_entry(&ctx->free_list, struct copy_request, node);
-	list_del(&cr->node);
-	mutex_unlock(&ctx->free_lock);
+	INIT_LIST_HEAD(&cr->batch);
 
 	/*
 	 * To support out-of-order free and copy-requets when eDMA is in async
@@ -608,23 +623,168 @@ ioctl_submit_copy_request(struct stream_ext_ctx_t *ctx,
 		goto reclaim_cr;
 	}
 
-	/* schedule asynchronous eDMA.*/
+	*copy_request = cr;
+	return ret;
+
+reclaim_cr:
+	copy_request_pool_put(cr);
+	return ret;
+}
+
+/* drop the references and return the copy-request(s) of a chain to pool.*/
+static void
+reclaim_copy_chain(struct copy_request *head)
+{
+	struct copy_request *cr = NULL, *next = NULL;
+
+	list_for_each_entry_safe(cr, next, &head->batch, node) {
+		list_del(&cr->node);
+		release_copy_request_handles(cr);
+		copy_request_pool_put(cr);
+	}
+	release_copy_request_handles(head);
+	copy_request_pool_put(head);
+}
+
+/*
+ * Append the eDMA descriptors of cr to the chain of head. A descriptor
+ * contiguous in both source and destination with the last descriptor of
+ * the chain is folded into it. Caller ensures head has enough space.
+ */
+static void
+merge_copy_request(struct copy_request *head, struct copy_request *cr)
+{
+	u64 i = 0;
+	struct tegra_pcie_edma_desc *last = NULL, *desc = NULL;
+
+	for (i = 0; i < cr->num_edma_desc; i++) {
+		desc = &cr->edma_desc[i];
+		last = &head->edma_desc[head->num_edma_desc - 1];
+		if ((last->src + last->sz) == desc->src &&
+		    (last->dst + last->sz) == desc->dst &&
+		    ((u64)last->sz + desc->sz) <= U32_MAX) {
+			last->sz += desc->sz;
+		} else {
+			head->edma_desc[head->num_edma_desc] = *desc;
+			head->num_edma_desc++;
+		}
+	}
+	cr->num_edma_desc = 0;
+	list_add_tail(&cr->node, &head->batch);
+}
+
+/* schedule asynchronous eDMA for the descriptor chain of head.*/
+static int
+submit_copy_chain(struct stream_ext_ctx_t *ctx, struct copy_request *head)
+{
+	edma_xfer_status_t edma_status = EDMA_XFER_FAIL_INVAL_INPUTS;
+
 	atomic_inc(&ctx->transfer_count);
-	edma_status = schedule_edma_xfer(ctx->edma_h, (void *)cr,
-					 cr->num_edma_desc, cr->edma_desc);
+	edma_status = schedule_edma_xfer(ctx->edma_h, (void *)head,
+					 head->num_edma_desc, head->edma_desc);
 	if (edma_status != EDMA_XFER_SUCCESS) {
-		ret = -EIO;
 		atomic_dec(&ctx->transfer_count);
-		release_copy_request_handles(cr);
-		goto reclaim_cr;
+		reclaim_copy_chain(head);
+		return -EIO;
 	}
 
-	return ret;
+	return 0;
+}
+
+/* implement NVSCIC2C_PCIE_IOCTL_SUBMIT_COPY_REQUEST ioctl call. */
+static int
+ioctl_submit_copy_request(struct stream_ext_ctx_t *ctx,
+			  struct nvscic2c_pcie_submit_copy_args *args)
+{
+	int ret = 0;
+	struct copy_request *cr = NULL;
+	enum nvscic2c_pcie_link link = NVSCIC2C_PCIE_LINK_DOWN;
+
+	link = pci_client_query_link_status(ctx->pci_client_h);
+	if (link != NVSCIC2C_PCIE_LINK_UP)
+		return -ENOLINK;
+
+	ret = prepare_copy_request(ctx, args, &cr);
+	if (ret)
+		return ret;
+
+	return submit_copy_chain(ctx, cr);
+}
+
+/*
+ * implement NVSCIC2C_PCIE_IOCTL_SUBMIT_COPY_BATCH ioctl call.
+ *
+ * Consecutive copy requests are merged into one eDMA descriptor chain for
+ * as long as the chain fits max_flush_ranges descriptors, and the chain is
+ * completed with a single eDMA callback. Post-fences are signalled in the
+ * order of the copy requests in the batch.
+ */
+static int
+ioctl_submit_copy_batch(struct stream_ext_ctx_t *ctx,
+			struct nvscic2c_pcie_submit_copy_batch_args *args)
+{
+	int ret = 0;
+	u64 i = 0, num_chained = 0;
+	struct copy_request *cr = NULL, *head = NULL;
+	struct nvscic2c_pcie_submit_copy_args cr_args = {0};
+	struct nvscic2c_pcie_submit_copy_args __user *user_args = NULL;
+	enum nvscic2c_pcie_link link = NVSCIC2C_PCIE_LINK_DOWN;
+
+	args->num_submitted = 0;
+	if (WARN_ON(!args->num_copy_requests ||
+		    args->num_copy_requests > ctx->cr_limits.max_copy_requests))
+		return -EINVAL;
+
+	link = pci_client_query_link_status(ctx->pci_client_h);
+	if (link != NVSCIC2C_PCIE_LINK_UP)
+		return -ENOLINK;
+
+	user_args = (struct nvscic2c_pcie_submit_copy_args __user *)
+		    args->copy_requests;
+	for (i = 0; i < args->num_copy_requests; i++) {
+		if (copy_from_user(&cr_args, &user_args[i], sizeof(cr_args))) {
+			ret = -EFAULT;
+			break;
+		}
+
+		cr = NULL;
+		ret = prepare_copy_request(ctx, &cr_args, &cr);
+		if (ret)
+			break;
+
+		if (head && (head->num_edma_desc + cr->num_edma_desc) <=
+			    ctx->cr_limits.max_flush_ranges) {
+			merge_copy_request(head, cr);
+			num_chained++;
+			continue;
+		}
+
+		/* chain full, submit it and start a new one.*/
+		if (head) {
+			ret = submit_copy_chain(ctx, head);
+			if (ret) {
+				head = NULL;
+				release_copy_request_handles(cr);
+				copy_request_pool_put(cr);
+				break;
+			}
+			args->num_submitted += num_chained;
+		}
+		head = cr;
+		num_chained = 1;
+	}
+
+	if (head) {
+		if (!submit_copy_chain(ctx, head))
+			args->num_submitted += num_chained;
+		else if (!ret)
+			ret = -EIO;
+	}
+
+	/* partial submission is reported through num_submitted.*/
+	if (args->num_submitted)
+		ret = 0;
 
-reclaim_cr:
-	mutex_lock(&ctx->free_lock);
-	list_add_tail(&cr->node, &ctx->free_list);
-	mutex_unlock(&ctx->free_lock);
 	return ret;
 }
 
@@ -636,7 +796,6 @@ ioctl_set_max_copy_requests(struct stream_ext_ctx_t *ctx,
 	int ret = 0;
 	u32 i = 0;
 	struct copy_request *cr = NULL;
-	struct list_head *curr = NULL, *next = NULL;
 
 	if (WARN_ON(!args->max_copy_requests ||
 		    !args->max_flush_ranges ||
@@ -661,6 +820,15 @@ ioctl_set_max_copy_requests(struct stream_ext_ctx_t *ctx,
 	}
 
 	/* allocate the maximum outstanding copy requests we can have.*/
+	ctx->cr_pool = kcalloc(ctx->cr_limits.max_copy_requests,
+			       sizeof(*ctx->cr_pool), GFP_KERNEL);
+	ctx->cr_pool_busy = bitmap_zalloc(ctx->cr_limits.max_copy_requests,
+					  GFP_KERNEL);
+	if (WARN_ON(!ctx->cr_pool || !ctx->cr_pool_busy)) {
+		ret = -ENOMEM;
+		goto clean_up;
+	}
+
 	for (i = 0; i < ctx->cr_limits.max_copy_requests; i++) {
 		cr = NULL;
 		ret = allocate_copy_request(ctx, &cr);
@@ -668,24 +836,16 @@ ioctl_set_max_copy_requests(struct stream_ext_ctx_t *ctx,
 			pr_err("Failed to allocate copy request\n");
 			goto clean_up;
 		}
-
-		mutex_lock(&ctx->free_lock);
-		list_add(&cr->node, &ctx->free_list);
-		mutex_unlock(&ctx->free_lock);
+		cr->pool_idx = i;
+		ctx->cr_pool[i] = cr;
 	}
 
 	return ret;
 
 clean_up:
-	mutex_unlock(&ctx->free_lock);
-	list_for_each_safe(curr, next, &ctx->free_list) {
-		cr = list_entry(curr, struct copy_request, node);
-		list_del(curr);
-		free_copy_request(&cr);
-	}
-	mutex_unlock(&ctx->free_lock);
-
+	free_copy_request_pool(ctx);
 	free_copy_req_params(&ctx->cr_params);
+	memset(&ctx->cr_limits, 0, sizeof(ctx->cr_limits));
 
 	return ret;
 }
@@ -726,6 +886,11 @@ stream_extension_ioctl(void *stream_ext_h, unsigned int cmd, void *args)
 			((struct stream_ext_ctx_t *)ctx,
 			 (struct nvscic2c_pcie_submit_copy_args *)args);
 		break;
+	case NVSCIC2C_PCIE_IOCTL_SUBMIT_COPY_BATCH:
+		ret = ioctl_submit_copy_batch
+			((struct stream_ext_ctx_t *)ctx,
+			 (struct nvscic2c_pcie_submit_copy_batch_args *)args);
+		break;
 	case NVSCIC2C_PCIE_IOCTL_MAX_COPY_REQUESTS:
 		ret = ioctl_set_max_copy_requests
 			((struct stream_ext_ctx_t *)ctx,
@@ -772,8 +937,6 @@ stream_extension_init(struct stream_ext_params *params, void **stream_ext_h)
 	}
 
 	/* copy operations.*/
-	mutex_init(&ctx->free_lock);
-	INIT_LIST_HEAD(&ctx->free_list);
 	atomic_set(&ctx->transfer_count, 0);
 	init_waitqueue_head(&ctx->transfer_waitq);
 
@@ -794,7 +957,6 @@ stream_extension_deinit(void **stream_ext_h)
 {
 	long ret = 0;
 	struct file *filep = NULL;
-	struct copy_request *cr = NULL;
 	struct stream_ext_obj *stream_obj = NULL;
 	struct list_head *curr = NULL, *next = NULL;
 	struct stream_ext_ctx_t *ctx = (struct stream_ext_ctx_t *)*stream_ext_h;
@@ -811,15 +973,8 @@ stream_extension_deinit(void **stream_ext_h)
 		pr_err("(%s): timed-out waiting for eDMA callbacks to return\n",
 		       ctx->ep_name);
 
-	mutex_lock(&ctx->free_lock);
-	list_for_each_safe(curr, next, &ctx->free_list) {
-		cr = list_entry(curr, struct copy_request, node);
-		list_del(curr);
-		free_copy_request(&cr);
-	}
-	mutex_unlock(&ctx->free_lock);
+	free_copy_request_pool(ctx);
 	free_copy_req_params(&ctx->cr_params);
-	mutex_destroy(&ctx->free_lock);
 
 	/*
 	 * clean-up the non freed stream objs. Descriptor shall be freed when
@@ -944,44 +1099,51 @@ schedule_edma_xfer(void *edma_h, void *priv, u64 num_desc,
 	if (WARN_ON(!num_desc || !desc))
 		return -EINVAL;
 
+	/*
+	 * spread over all WR channels, callbacks still come in submission
+	 * order which the post-fence signalling relies on.
+	 */
 	info.type = EDMA_XFER_WRITE;
-	info.channel_num = 0; // no use-case to use all WR channels yet.
 	info.desc = desc;
 	info.nents = num_desc;
 	info.complete = callback_edma_xfer;
 	info.priv = priv;
 
-	return tegra_pcie_edma_submit_xfer(edma_h, &info);
+	return tegra_pcie_edma_submit_xfer_multi(edma_h, &info);
 }
 
-/* Callback with each async eDMA submit xfer.*/
+/* Callback with each async eDMA submit xfer, once per descriptor chain.*/
 static void
 callback_edma_xfer(void *priv, edma_xfer_status_t status,
 		   struct tegra_pcie_edma_desc *desc)
 {
-	struct copy_request *cr = (struct copy_request *)priv;
+	struct copy_request *head = (struct copy_request *)priv;
+	struct stream_ext_ctx_t *ctx = head->ctx;
+	struct copy_request *cr = NULL;
 
-	mutex_lock(&cr->ctx->free_lock);
-	/* increment post fences: local and remote.*/
+	/* increment post fences: local and remote, in submission order.*/
 	if (status == EDMA_XFER_SUCCESS) {
-		signal_remote_post_fences(cr);
-		signal_local_post_fences(cr);
+		signal_remote_post_fences(head);
+		signal_local_post_fences(head);
+		list_for_each_entry(cr, &head->batch, node) {
+			signal_remote_post_fences(cr);
+			signal_local_post_fences(cr);
+		}
 	} else {
 		/* eDMA xfer failed, Update eDMA error and notify user. */
-		(void)pci_client_set_edma_error(cr->ctx->pci_client_h,
-						cr->ctx->ep_id,
+		(void)pci_client_set_edma_error(ctx->pci_client_h,
+						ctx->ep_id,
 						NVSCIC2C_PCIE_EDMA_XFER_ERROR);
 	}
 
-	/* releases the references of the cubmit-copy handles.*/
-	release_copy_request_handles(cr);
-
-	/* reclaim the copy_request for reuse.*/
-	list_add_tail(&cr->node, &cr->ctx->free_list);
-	mutex_unlock(&cr->ctx->free_lock);
+	/*
+	 * releases the references of the submit-copy handles and reclaim
+	 * the copy_request(s) for reuse.
+	 */
+	reclaim_copy_chain(head);
 
-	if (atomic_dec_and_test(&cr->ctx->transfer_count))
-		wake_up_all(&cr->ctx->transfer_waitq);
+	if (atomic_dec_and_test(&ctx->transfer_count))
+		wake_up_all(&ctx->transfer_waitq);
 }
 
 static int
@@ -1372,6 +1534,47 @@ free_copy_request(struct copy_request **copy_request)
 	*copy_request = NULL;
 }
 
+static void
+free_copy_request_pool(struct stream_ext_ctx_t *ctx)
+{
+	u64 i = 0;
+
+	if (ctx->cr_pool) {
+		for (i = 0; i < ctx->cr_limits.max_copy_requests; i++)
+			free_copy_request(&ctx->cr_pool[i]);
+	}
+	kfree(ctx->cr_pool);
+	ctx->cr_pool = NULL;
+	bitmap_free(ctx->cr_pool_busy);
+	ctx->cr_pool_busy = NULL;
+}
+
+/* claim a free copy-request from the pool, NULL if all are in-progress.*/
+static struct copy_request *
+copy_request_pool_get(struct stream_ext_ctx_t *ctx)
+{
+	unsigned long idx = 0;
+	unsigned long max = ctx->cr_limits.max_copy_requests;
+
+	if (!ctx->cr_pool)
+		return NULL;
+
+	do {
+		idx = find_first_zero_bit(ctx->cr_pool_busy, max);
+		if (idx >= max)
+			return NULL;
+	} while (test_and_set_bit_lock(idx, ctx->cr_pool_busy));
+
+	return ctx->cr_pool[idx];
+}
+
+/* return a copy-request to the pool for reuse.*/
+static void
+copy_request_pool_put(struct copy_request *cr)
+{
+	clear_bit_unlock(cr->pool_idx, cr->ctx->cr_pool_busy);
+}
+
 static int
 allocate_copy_request(struct stream_ext_ctx_t *ctx,
 		      struct copy_request **copy_request)
@@ -22,6 +22,9 @@
 #include <linux/cred.h>
 #include <linux/of.h>
 #include <linux/fs.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/stringhash.h>
 
 #ifdef CONFIG_TEGRA_VIRTUALIZATION
 #include <soc/tegra/virt/syscalls.h>
@@ -49,6 +52,87 @@ static struct nvsciipc *ctx;
 static int32_t s_guestid = -1;
 #endif /* CONFIG_TEGRA_VIRTUALIZATION */
 
+static u32 nvsciipc_name_hash(struct nvsciipc *ctx, const char *name)
+{
+	return hash_32(full_name_hash(NULL, name,
+		strnlen(name, NVSCIIPC_MAX_EP_NAME)), ctx->ht_bits);
+}
+
+static void nvsciipc_free_db_index(struct nvsciipc *ctx)
+{
+	kfree(ctx->name_ht);
+	ctx->name_ht = NULL;
+	kfree(ctx->vuid_ht);
+	ctx->vuid_ht = NULL;
+	kfree(ctx->db_nodes);
+	ctx->db_nodes = NULL;
+	ctx->ht_bits = 0;
+}
+
+/* build hash indexes by ep_name and vuid over the db */
+static int nvsciipc_build_db_index(struct nvsciipc *ctx)
+{
+	struct nvsciipc_db_node *node;
+	unsigned int nbuckets;
+	int i;
+
+	/* keep load factor at or below 0.5 */
+	ctx->ht_bits = ilog2(roundup_pow_of_two(ctx->num_eps * 2));
+	nbuckets = 1U << ctx->ht_bits;
+
+	ctx->name_ht = kcalloc(nbuckets, sizeof(*ctx->name_ht), GFP_KERNEL);
+	ctx->vuid_ht = kcalloc(nbuckets, sizeof(*ctx->vuid_ht), GFP_KERNEL);
+	ctx->db_nodes = kcalloc(ctx->num_eps, sizeof(*ctx->db_nodes),
+			GFP_KERNEL);
+	if ((ctx->name_ht == NULL) || (ctx->vuid_ht == NULL) ||
+		(ctx->db_nodes == NULL)) {
+		ERR("memory allocation for db index failed\n");
+		nvsciipc_free_db_index(ctx);
+		return -ENOMEM;
+	}
+
+	/* insert in reverse, so the lowest idx of duplicates is found first */
+	for (i = ctx->num_eps - 1; i >= 0; i--) {
+		node = &ctx->db_nodes[i];
+		node->idx = i;
+		hlist_add_head(&node->name_node,
+			&ctx->name_ht[nvsciipc_name_hash(ctx, ctx->db[i]->ep_name)]);
+		hlist_add_head(&node->vuid_node,
+			&ctx->vuid_ht[hash_64(ctx->db[i]->vuid, ctx->ht_bits)]);
+	}
+
+	return 0;
+}
+
+/* returns index of endpoint in db, or -1 if not found */
+static int nvsciipc_find_db_by_name(struct nvsciipc *ctx, const char *name)
+{
+	struct nvsciipc_db_node *node;
+
+	hlist_for_each_entry(node, &ctx->name_ht[nvsciipc_name_hash(ctx, name)],
+		name_node) {
+		if (!strncmp(name, ctx->db[node->idx]->ep_name,
+			NVSCIIPC_MAX_EP_NAME))
+			return node->idx;
+	}
+
+	return -1;
+}
+
+/* returns index of endpoint in db, or -1 if not found */
+static int nvsciipc_find_db_by_vuid(struct nvsciipc *ctx, uint64_t vuid)
+{
+	struct nvsciipc_db_node *node;
+
+	hlist_for_each_entry(node, &ctx->vuid_ht[hash_64(vuid, ctx->ht_bits)],
+		vuid_node) {
+		if (ctx->db[node->idx]->vuid == vuid)
+			return node->idx;
+	}
+
+	return -1;
+}
+
 NvSciError NvSciIpcEndpointGetAuthToken(NvSciIpcEndpoint handle,
 		NvSciIpcEndpointAuthToken *authToken)
 {
@@ -150,18 +234,13 @@ NvSciError NvSciIpcEndpointMapVuid(NvSciIpcEndpointVuid localUserVuid,
 		return NvSciError_NotInitialized;
 	}
 
-	for (i = 0; i < ctx->num_eps; i++) {
-		if (ctx->db[i]->vuid == localUserVuid) {
-			backend = ctx->db[i]->backend;
-			entry = ctx->db[i];
-			break;
-		}
-	}
-
-	if (i == ctx->num_eps) {
+	i = nvsciipc_find_db_by_vuid(ctx, localUserVuid);
+	if (i < 0) {
 		ERR("wrong localUserVuid passed\n");
 		return NvSciError_BadParameter;
 	}
+	backend = ctx->db[i]->backend;
+	entry = ctx->db[i];
 
 	switch (backend) {
 	case NVSCIIPC_BACKEND_ITC:
@@ -214,6 +293,7 @@ static void nvsciipc_free_db(struct nvsciipc *ctx)
 			kfree(ctx->db[i]);
 
 		kfree(ctx->db);
+		nvsciipc_free_db_index(ctx);
 	}
 
 	ctx->num_eps = 0;
@@ -322,19 +402,15 @@ static int nvsciipc_ioctl_get_db_by_name(struct nvsciipc *ctx, unsigned int cmd,
 	}
 
 	/* read operation */
-	for (i = 0; i < ctx->num_eps; i++) {
-		if (!strncmp(get_db.ep_name, ctx->db[i]->ep_name,
-			NVSCIIPC_MAX_EP_NAME)) {
-			get_db.entry = *ctx->db[i];
-			get_db.idx = i;
-			break;
-		}
-	}
-
-	if (i == ctx->num_eps) {
+	i = nvsciipc_find_db_by_name(ctx, get_db.ep_name);
+	if (i < 0) {
 		INFO("%s: no entry (%s)\n", __func__, get_db.ep_name);
 		return -ENOENT;
-	} else if (copy_to_user((void __user *)arg, &get_db,
+	}
+
+	get_db.entry = *ctx->db[i];
+	get_db.idx = i;
+	if (copy_to_user((void __user *)arg, &get_db,
 				_IOC_SIZE(cmd))) {
 		ERR("%s : copy_to_user failed\n", __func__);
 		return -EFAULT;
@@ -361,18 +437,15 @@ static int nvsciipc_ioctl_get_db_by_vuid(struct nvsciipc *ctx, unsigned int cmd,
 	}
 
 	/* read operation */
-	for (i = 0; i < ctx->num_eps; i++) {
-		if (get_db.vuid == ctx->db[i]->vuid) {
-			get_db.entry = *ctx->db[i];
-			get_db.idx = i;
-			break;
-		}
-	}
-
-	if (i == ctx->num_eps) {
+	i = nvsciipc_find_db_by_vuid(ctx, get_db.vuid);
+	if (i < 0) {
 		INFO("%s: no entry (0x%llx)\n", __func__, get_db.vuid);
 		return -ENOENT;
-	} else if (copy_to_user((void __user *)arg, &get_db,
+	}
+
+	get_db.entry = *ctx->db[i];
+	get_db.idx = i;
+	if (copy_to_user((void __user *)arg, &get_db,
 				_IOC_SIZE(cmd))) {
 		ERR("%s : copy_to_user failed\n", __func__);
 		return -EFAULT;
@@ -399,18 +472,14 @@ static int nvsciipc_ioctl_get_vuid(struct nvsciipc *ctx, unsigned int cmd,
 	}
 
 	/* read operation */
-	for (i = 0; i < ctx->num_eps; i++) {
-		if (!strncmp(get_vuid.ep_name, ctx->db[i]->ep_name,
-			NVSCIIPC_MAX_EP_NAME)) {
-			get_vuid.vuid = ctx->db[i]->vuid;
-			break;
-		}
-	}
-
-	if (i == ctx->num_eps) {
+	i = nvsciipc_find_db_by_name(ctx, get_vuid.ep_name);
+	if (i < 0) {
 		INFO("%s: no entry (%s)\n", __func__, get_vuid.ep_name);
 		return -ENOENT;
-	} else if (copy_to_user((void __user *)arg, &get_vuid,
+	}
+
+	get_vuid.vuid = ctx->db[i]->vuid;
+	if (copy_to_user((void __user *)arg, &get_vuid,
 				_IOC_SIZE(cmd))) {
 		ERR("%s : copy_to_user failed\n", __func__);
 		return -EFAULT;
@@ -419,6 +488,88 @@ static int nvsciipc_ioctl_get_vuid(struct nvsciipc *ctx, unsigned int cmd,
 	return 0;
 }
 
+static int nvsciipc_ioctl_get_db_batch(struct nvsciipc *ctx, unsigned int cmd,
+		unsigned long arg)
+{
+	struct nvsciipc_get_db_batch batch;
+	struct nvsciipc_get_db_by_name by_name;
+	struct nvsciipc_get_db_by_vuid by_vuid;
+	void __user *uentry;
+	uint32_t n;
+	int i;
+
+	if ((ctx->num_eps == 0) || (ctx->set_db_f != true)) {
+		ERR("%s[%d] need to set endpoint database first\n", __func__,
+			get_current()->pid);
+		return -EPERM;
+	}
+
+	if (copy_from_user(&batch, (void __user *)arg, _IOC_SIZE(cmd))) {
+		ERR("%s : copy_from_user failed\n", __func__);
+		return -EFAULT;
+	}
+
+	if ((batch.type != NVSCIIPC_GET_DB_BATCH_BY_NAME) &&
+		(batch.type != NVSCIIPC_GET_DB_BATCH_BY_VUID)) {
+		ERR("%s : invalid type %u\n", __func__, batch.type);
+		return -EINVAL;
+	}
+
+	batch.num_found = 0;
+	for (n = 0; n < batch.num_entries; n++) {
+		if (batch.type == NVSCIIPC_GET_DB_BATCH_BY_NAME) {
+			uentry = (void __user *)(uintptr_t)(batch.entries +
+				((uint64_t)n * sizeof(by_name)));
+			if (copy_from_user(&by_name, uentry, sizeof(by_name))) {
+				ERR("%s : copy_from_user failed\n", __func__);
+				return -EFAULT;
+			}
+
+			i = nvsciipc_find_db_by_name(ctx, by_name.ep_name);
+			if (i >= 0) {
+				by_name.entry = *ctx->db[i];
+				by_name.idx = i;
+				batch.num_found++;
+			} else {
+				by_name.idx = NVSCIIPC_DB_IDX_INVALID;
+			}
+
+			if (copy_to_user(uentry, &by_name, sizeof(by_name))) {
+				ERR("%s : copy_to_user failed\n", __func__);
+				return -EFAULT;
+			}
+		} else {
+			uentry = (void __user *)(uintptr_t)(batch.entries +
+				((uint64_t)n * sizeof(by_vuid)));
+			if (copy_from_user(&by_vuid, uentry, sizeof(by_vuid))) {
+				ERR("%s : copy_from_user failed\n", __func__);
+				return -EFAULT;
+			}
+
+			i = nvsciipc_find_db_by_vuid(ctx, by_vuid.vuid);
+			if (i >= 0) {
+				by_vuid.entry = *ctx->db[i];
+				by_vuid.idx = i;
+				batch.num_found++;
+			} else {
+				by_vuid.idx = NVSCIIPC_DB_IDX_INVALID;
+			}
+
+			if (copy_to_user(uentry, &by_vuid, sizeof(by_vuid))) {
+				ERR("%s : copy_to_user failed\n", __func__);
+				return -EFAULT;
+			}
+		}
+	}
+
+	if (copy_to_user((void __user *)arg, &batch, _IOC_SIZE(cmd))) {
+		ERR("%s : copy_to_user failed\n", __func__);
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
 static int nvsciipc_ioctl_set_db(struct nvsciipc *ctx, unsigned int cmd,
 		unsigned long arg)
 {
@@ -443,6 +594,15 @@ static int nvsciipc_ioctl_set_db(struct nvsciipc *ctx, unsigned int cmd,
 	}
 #endif /* CONFIG_ANDROID || CONFIG_TEGRA_SYSTEM_TYPE_ACK */
 
+	/*
+	 * Lookups run without nvsciipc_mutex, so the db and its index must
+	 * not change once published.
+	 */
+	if (ctx->set_db_f == true) {
+		ERR("db is already set\n");
+		return -EBUSY;
+	}
+
 	if (copy_from_user(&user_db, (void __user *)arg, _IOC_SIZE(cmd))) {
 		ERR("copying user db failed\n");
 		return -EFAULT;
@@ -530,6 +690,10 @@ static int nvsciipc_ioctl_set_db(struct nvsciipc *ctx, unsigned int cmd,
 	}
 #endif /* CONFIG_TEGRA_VIRTUALIZATION */
 
+	ret = nvsciipc_build_db_index(ctx);
+	if (ret != 0)
+		goto ptr_error;
+
 	kfree(entry_ptr);
 
 	ctx->set_db_f = true;
@@ -620,6 +784,9 @@ static long nvsciipc_dev_ioctl(struct file *filp, unsigned int cmd,
 	case NVSCIIPC_IOCTL_GET_DB_SIZE:
 		ret = nvsciipc_ioctl_get_dbsize(ctx, cmd, arg);
 		break;
+	case NVSCIIPC_IOCTL_GET_DB_BATCH:
+		ret = nvsciipc_ioctl_get_db_batch(ctx, cmd, arg);
+		break;
 #if DEBUG_AUTH_API
 	case NVSCIIPC_IOCTL_VALIDATE_AUTH_TOKEN:
 		ret = nvsciipc_ioctl_validate_auth_token(ctx, cmd, arg);
@@ -1,6 +1,6 @@
 /* SPDX-License-Identifier: GPL-2.0-only */
 /*
- * Copyright (c) 2019-2023, NVIDIA CORPORATION. All rights reserved.
+ * Copyright (c) 2019-2024, NVIDIA CORPORATION. All rights reserved.
  */
 
 #ifndef __NVSCIIPC_KERNEL_H__
@@ -24,6 +24,13 @@
 #define NVSCIIPC_BACKEND_C2C_NPM	4U
 #define NVSCIIPC_BACKEND_UNKNOWN	0xFFFFFFFFU
 
+/* index node of one db entry, linked in both name and vuid hash tables */
+struct nvsciipc_db_node {
+	struct hlist_node name_node;
+	struct hlist_node vuid_node;
+	int idx;
+};
+
 struct nvsciipc {
 	struct device *dev;
 
@@ -36,6 +43,12 @@ struct nvsciipc {
 	int num_eps;
 	struct nvsciipc_config_entry **db;
 	volatile bool set_db_f;
+
+	/* hash indexes of db by ep_name and vuid, built at set_db */
+	struct nvsciipc_db_node *db_nodes;
+	struct hlist_head *name_ht;
+	struct hlist_head *vuid_ht;
+	unsigned int ht_bits;
 };
 
 struct vuid_bitfield_64 {
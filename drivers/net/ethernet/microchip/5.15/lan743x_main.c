@@ -1357,9 +1357,19 @@ static int lan743x_tx_next_index(struct lan743x_tx *tx, int index)
 	return ((++index) % tx->ring_size);
 }
 
-static void lan743x_tx_release_completed_descriptors(struct lan743x_tx *tx)
+static void lan743x_tx_release_completed_descriptors(struct lan743x_tx *tx,
+						     unsigned int *pkts,
+						     unsigned int *bytes)
 {
+	struct lan743x_tx_buffer_info *buffer_info;
+
 	while (le32_to_cpu(*tx->head_cpu_ptr) != (tx->last_head)) {
+		/* the skb sits on the last descriptor of its frame */
+		buffer_info = &tx->buffer_info[tx->last_head];
+		if (buffer_info->skb) {
+			(*pkts)++;
+			*bytes += buffer_info->skb->len;
+		}
 		lan743x_tx_release_desc(tx, tx->last_head, false);
 		tx->last_head = lan743x_tx_next_index(tx, tx->last_head);
 	}
@@ -1578,18 +1588,34 @@ static int lan743x_tx_frame_add_fragment(struct lan743x_tx *tx,
 	return 0;
 }
 
+static void lan743x_tx_ring_doorbell(struct lan743x_tx *tx)
+{
+	/* assuming tx->ring_lock has already been acquired */
+	u32 tx_tail_flags = 0;
+
+	if (tx->vector_flags & LAN743X_VECTOR_FLAG_VECTOR_ENABLE_AUTO_SET)
+		tx_tail_flags |= TX_TAIL_SET_TOP_INT_VEC_EN_;
+	if (tx->vector_flags & LAN743X_VECTOR_FLAG_SOURCE_ENABLE_AUTO_SET)
+		tx_tail_flags |= TX_TAIL_SET_DMAC_INT_EN_ |
+		TX_TAIL_SET_TOP_INT_EN_;
+
+	lan743x_csr_write(tx->adapter, TX_TAIL(tx->channel_number),
+			  tx_tail_flags | tx->last_tail);
+	tx->doorbell_pending = false;
+}
+
 static void lan743x_tx_frame_end(struct lan743x_tx *tx,
 				 struct sk_buff *skb,
 				 bool time_stamp,
-				 bool ignore_sync)
+				 bool ignore_sync,
+				 bool more)
 {
 	/* called only from within lan743x_tx_xmit_frame
 	 * assuming tx->ring_lock has already been acquired
 	 */
 	struct lan743x_tx_descriptor *tx_descriptor = NULL;
 	struct lan743x_tx_buffer_info *buffer_info = NULL;
-	struct lan743x_adapter *adapter = tx->adapter;
-	u32 tx_tail_flags = 0;
+	struct netdev_queue *txq;
 
 	/* wrap up previous descriptor */
 	if ((tx->frame_data0 & TX_DESC_DATA0_DTYPE_MASK_) ==
@@ -1612,19 +1638,19 @@ static void lan743x_tx_frame_end(struct lan743x_tx *tx,
 
 	dma_wmb();
 
-	if (tx->vector_flags & LAN743X_VECTOR_FLAG_VECTOR_ENABLE_AUTO_SET)
-		tx_tail_flags |= TX_TAIL_SET_TOP_INT_VEC_EN_;
-	if (tx->vector_flags & LAN743X_VECTOR_FLAG_SOURCE_ENABLE_AUTO_SET)
-		tx_tail_flags |= TX_TAIL_SET_DMAC_INT_EN_ |
-		TX_TAIL_SET_TOP_INT_EN_;
-
-	lan743x_csr_write(adapter, TX_TAIL(tx->channel_number),
-			  tx_tail_flags | tx->frame_tail);
+	/* write TX_TAIL once per xmit_more batch, or earlier when BQL
+	 * stops the queue
+	 */
+	txq = netdev_get_tx_queue(tx->adapter->netdev, tx->channel_number);
+	if (__netdev_tx_sent_queue(txq, skb->len, more))
+		lan743x_tx_ring_doorbell(tx);
+	else
+		tx->doorbell_pending = true;
 	tx->frame_flags &= ~TX_FRAME_FLAG_IN_PROGRESS;
 }
 
 static netdev_tx_t lan743x_tx_xmit_frame(struct lan743x_tx *tx,
-					 struct sk_buff *skb)
+					 struct sk_buff *skb, bool more)
 {
 	int required_number_of_descriptors = 0;
 	unsigned int start_frame_length = 0;
@@ -1633,11 +1659,13 @@ static netdev_tx_t lan743x_tx_xmit_frame(struct lan743x_tx *tx,
 	unsigned long irq_flags = 0;
 	bool do_timestamp = false;
 	bool ignore_sync = false;
+	struct netdev_queue *txq;
 	int nr_frags = 0;
 	bool gso = false;
 	int j;
 
 	required_number_of_descriptors = lan743x_tx_get_desc_cnt(tx, skb);
+	txq = netdev_get_tx_queue(tx->adapter->netdev, tx->channel_number);
 
 	spin_lock_irqsave(&tx->ring_lock, irq_flags);
 	if (required_number_of_descriptors >
@@ -1701,9 +1729,14 @@ static netdev_tx_t lan743x_tx_xmit_frame(struct lan743x_tx *tx,
 	}
 
 finish:
-	lan743x_tx_frame_end(tx, skb, do_timestamp, ignore_sync);
+	lan743x_tx_frame_end(tx, skb, do_timestamp, ignore_sync, more);
 
 unlock:
+	/* frames of the batch may still be waiting for the doorbell when
+	 * this one is dropped or the queue had to be stopped
+	 */
+	if (tx->doorbell_pending && (!more || netif_xmit_stopped(txq)))
+		lan743x_tx_ring_doorbell(tx);
 	spin_unlock_irqrestore(&tx->ring_lock, irq_flags);
 	return NETDEV_TX_OK;
 }
@@ -1713,7 +1746,9 @@ static int lan743x_tx_napi_poll(struct napi_struct *napi, int weight)
 	struct lan743x_tx *tx = container_of(napi, struct lan743x_tx, napi);
 	struct lan743x_adapter *adapter = tx->adapter;
 	bool start_transmitter = false;
+	unsigned int pkts = 0, bytes = 0;
 	unsigned long irq_flags = 0;
+	struct netdev_queue *txq;
 	u32 ioc_bit = 0;
 
 	ioc_bit = DMAC_INT_BIT_TX_IOC_(tx->channel_number);
@@ -1723,7 +1758,9 @@ static int lan743x_tx_napi_poll(struct napi_struct *napi, int weight)
 	spin_lock_irqsave(&tx->ring_lock, irq_flags);
 
 	/* clean up tx ring */
-	lan743x_tx_release_completed_descriptors(tx);
+	lan743x_tx_release_completed_descriptors(tx, &pkts, &bytes);
+	txq = netdev_get_tx_queue(adapter->netdev, tx->channel_number);
+	netdev_tx_completed_queue(txq, pkts, bytes);
 	if (netif_queue_stopped(adapter->netdev)) {
 		if (tx->overflow_skb) {
 			if (lan743x_tx_get_desc_cnt(tx, tx->overflow_skb) <=
@@ -1737,7 +1774,7 @@ static int lan743x_tx_napi_poll(struct napi_struct *napi, int weight)
 
 	if (start_transmitter) {
 		/* space is now available, transmit overflow skb */
-		lan743x_tx_xmit_frame(tx, tx->overflow_skb);
+		lan743x_tx_xmit_frame(tx, tx->overflow_skb, false);
 		tx->overflow_skb = NULL;
 		netif_wake_queue(adapter->netdev);
 	}
@@ -1867,11 +1904,14 @@ static void lan743x_tx_close(struct lan743x_tx *tx)
 				 0, 1000, 20000, 100);
 
 	lan743x_tx_release_all_descriptors(tx);
+	netdev_tx_reset_queue(netdev_get_tx_queue(adapter->netdev,
+						  tx->channel_number));
 
 	if (tx->overflow_skb) {
 		dev_kfree_skb(tx->overflow_skb);
 		tx->overflow_skb = NULL;
 	}
+	tx->doorbell_pending = false;
 
 	lan743x_tx_ring_cleanup(tx);
 }
@@ -1990,6 +2030,39 @@ static void lan743x_rx_update_tail(struct lan743x_rx *rx, int index)
 				  index);
 }
 
+#ifdef LAN743X_PAGE_POOL
+static int lan743x_rx_init_ring_element(struct lan743x_rx *rx, int index,
+					gfp_t gfp)
+{
+	struct lan743x_rx_buffer_info *buffer_info;
+	struct lan743x_rx_descriptor *descriptor;
+	struct page *page;
+
+	descriptor = &rx->ring_cpu_ptr[index];
+	buffer_info = &rx->buffer_info[index];
+
+	/* pages come back to the pool already mapped and synced for the
+	 * device, so refilling a descriptor costs no dma mapping
+	 */
+	page = page_pool_alloc_pages(rx->page_pool, gfp | __GFP_NOWARN);
+	if (!page)
+		return -ENOMEM;
+
+	buffer_info->page = page;
+	buffer_info->dma_ptr = page_pool_get_dma_addr(page) +
+			       LAN743X_RX_HEADROOM;
+	buffer_info->buffer_length = LAN743X_RX_BUF_SIZE;
+	descriptor->data1 = cpu_to_le32(DMA_ADDR_LOW32(buffer_info->dma_ptr));
+	descriptor->data2 = cpu_to_le32(DMA_ADDR_HIGH32(buffer_info->dma_ptr));
+	descriptor->data3 = 0;
+	descriptor->data0 = cpu_to_le32((RX_DESC_DATA0_OWN_ |
+			    (buffer_info->buffer_length &
+			    RX_DESC_DATA0_BUF_LENGTH_MASK_)));
+	lan743x_rx_update_tail(rx, index);
+
+	return 0;
+}
+#else
 static int lan743x_rx_init_ring_element(struct lan743x_rx *rx, int index,
 					gfp_t gfp)
 {
@@ -2046,6 +2119,7 @@ static int lan743x_rx_init_ring_element(struct lan743x_rx *rx, int index,
 
 	return 0;
 }
+#endif
 
 static void lan743x_rx_reuse_ring_element(struct lan743x_rx *rx, int index)
 {
@@ -2074,6 +2148,11 @@ static void lan743x_rx_release_ring_element(struct lan743x_rx *rx, int index)
 
 	memset(descriptor, 0, sizeof(*descriptor));
 
+#ifdef LAN743X_PAGE_POOL
+	if (buffer_info->page)
+		page_pool_put_full_page(rx->page_pool, buffer_info->page,
+					false);
+#else
 	if (buffer_info->dma_ptr) {
 		dma_unmap_single(&rx->adapter->pdev->dev,
 				 buffer_info->dma_ptr,
@@ -2086,6 +2165,7 @@ static void lan743x_rx_release_ring_element(struct lan743x_rx *rx, int index)
 		dev_kfree_skb(buffer_info->skb);
 		buffer_info->skb = NULL;
 	}
+#endif
 
 	memset(buffer_info, 0, sizeof(*buffer_info));
 }
@@ -2093,15 +2173,11 @@ static void lan743x_rx_release_ring_element(struct lan743x_rx *rx, int index)
 static struct sk_buff *
 lan743x_rx_trim_skb(struct sk_buff *skb, int frame_length)
 {
-	if (skb_linearize(skb)) {
+	frame_length = max_t(int, 0, frame_length - ETH_FCS_LEN);
+	if (skb->len > frame_length && pskb_trim(skb, frame_length)) {
 		dev_kfree_skb_irq(skb);
 		return NULL;
 	}
-	frame_length = max_t(int, 0, frame_length - ETH_FCS_LEN);
-	if (skb->len > frame_length) {
-		skb->tail -= skb->len - frame_length;
-		skb->len = frame_length;
-	}
 	return skb;
 }
 
@@ -2115,7 +2191,13 @@ static int lan743x_rx_process_buffer(struct lan743x_rx *rx)
 	int frame_length, buffer_length;
 	int extension_index = -1;
 	bool is_last, is_first;
+#ifdef LAN743X_PAGE_POOL
+	unsigned int used_length;
+	dma_addr_t dma_ptr;
+	struct page *page;
+#else
 	struct sk_buff *skb;
+#endif
 
 	if (current_head_index < 0 || current_head_index >= rx->ring_size)
 		goto done;
@@ -2165,6 +2247,64 @@ static int lan743x_rx_process_buffer(struct lan743x_rx *rx)
 		   is_last  ? "last  " : "      ",
 		   frame_length, buffer_length);
 
+#ifdef LAN743X_PAGE_POOL
+	/* save existing page, give the descriptor a new one from the pool */
+	page = buffer_info->page;
+	dma_ptr = buffer_info->dma_ptr;
+	if (lan743x_rx_init_ring_element(rx, rx->last_head, GFP_ATOMIC)) {
+		/* failed to allocate next page.
+		 * Memory is very low.
+		 * Drop this packet and reuse buffer.
+		 */
+		lan743x_rx_reuse_ring_element(rx, rx->last_head);
+		/* drop packet that was being assembled */
+		dev_kfree_skb_irq(rx->skb_head);
+		rx->skb_head = NULL;
+		goto process_extension;
+	}
+
+	/* sync used area of buffer only, frame length is valid only if
+	 * LS bit is set and is a safe upper bound for the used area
+	 */
+	used_length = buffer_length;
+	if (is_last)
+		used_length = min_t(unsigned int, used_length,
+				    frame_length + RX_HEAD_PADDING);
+	dma_sync_single_for_cpu(&rx->adapter->pdev->dev, dma_ptr,
+				used_length, DMA_FROM_DEVICE);
+
+	/* the first buffer becomes the skb head, the following buffers are
+	 * attached as page fragments
+	 */
+	if (is_first) {
+		if (rx->skb_head)
+			dev_kfree_skb_irq(rx->skb_head);
+		rx->skb_head = napi_build_skb(page_address(page), PAGE_SIZE);
+		if (!rx->skb_head) {
+			page_pool_recycle_direct(rx->page_pool, page);
+			goto process_extension;
+		}
+		skb_mark_for_recycle(rx->skb_head, page, rx->page_pool);
+		skb_reserve(rx->skb_head, LAN743X_RX_HEADROOM + RX_HEAD_PADDING);
+		skb_put(rx->skb_head, buffer_length - RX_HEAD_PADDING);
+	} else if (rx->skb_head &&
+		   skb_shinfo(rx->skb_head)->nr_frags < MAX_SKB_FRAGS) {
+		skb_add_rx_frag(rx->skb_head, skb_shinfo(rx->skb_head)->nr_frags,
+				page, LAN743X_RX_HEADROOM, buffer_length,
+				PAGE_SIZE);
+	} else {
+		/* packet to assemble has already been dropped because one or
+		 * more of its buffers could not be allocated, or it has more
+		 * buffers than an skb can hold
+		 */
+		netdev_dbg(netdev, "drop buffer intended for dropped packet");
+		page_pool_recycle_direct(rx->page_pool, page);
+		if (rx->skb_head) {
+			dev_kfree_skb_irq(rx->skb_head);
+			rx->skb_head = NULL;
+		}
+	}
+#else
 	/* save existing skb, allocate new skb and map to dma */
 	skb = buffer_info->skb;
 	if (lan743x_rx_init_ring_element(rx, rx->last_head,
@@ -2204,6 +2344,7 @@ static int lan743x_rx_process_buffer(struct lan743x_rx *rx)
 		netdev_dbg(netdev, "drop buffer intended for dropped packet");
 		dev_kfree_skb_irq(skb);
 	}
+#endif
 
 process_extension:
 	if (extension_index >= 0) {
@@ -2293,6 +2434,18 @@ static void lan743x_rx_ring_cleanup(struct lan743x_rx *rx)
 			lan743x_rx_release_ring_element(rx, index);
 	}
 
+	if (rx->skb_head) {
+		dev_kfree_skb(rx->skb_head);
+		rx->skb_head = NULL;
+	}
+
+#ifdef LAN743X_PAGE_POOL
+	if (rx->page_pool) {
+		page_pool_destroy(rx->page_pool);
+		rx->page_pool = NULL;
+	}
+#endif
+
 	if (rx->head_cpu_ptr) {
 		dma_free_coherent(&rx->adapter->pdev->dev,
 				  sizeof(*rx->head_cpu_ptr), rx->head_cpu_ptr,
@@ -2319,6 +2472,15 @@ static void lan743x_rx_ring_cleanup(struct lan743x_rx *rx)
 
 static int lan743x_rx_ring_init(struct lan743x_rx *rx)
 {
+#ifdef LAN743X_PAGE_POOL
+	struct page_pool_params pp_params = {
+		.flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV,
+		.order = 0,
+		.dma_dir = DMA_FROM_DEVICE,
+		.offset = LAN743X_RX_HEADROOM,
+		.max_len = LAN743X_RX_BUF_SIZE,
+	};
+#endif
 	size_t ring_allocation_size = 0;
 	dma_addr_t dma_ptr = 0;
 	void *cpu_ptr = NULL;
@@ -2381,6 +2543,18 @@ static int lan743x_rx_ring_init(struct lan743x_rx *rx)
 		goto cleanup;
 	}
 
+#ifdef LAN743X_PAGE_POOL
+	pp_params.pool_size = rx->ring_size;
+	pp_params.nid = dev_to_node(&rx->adapter->pdev->dev);
+	pp_params.dev = &rx->adapter->pdev->dev;
+	rx->page_pool = page_pool_create(&pp_params);
+	if (IS_ERR(rx->page_pool)) {
+		ret = PTR_ERR(rx->page_pool);
+		rx->page_pool = NULL;
+		goto cleanup;
+	}
+#endif
+
 	rx->last_head = 0;
 	for (index = 0; index < rx->ring_size; index++) {
 		ret = lan743x_rx_init_ring_element(rx, index, GFP_KERNEL);
@@ -2628,7 +2802,8 @@ static netdev_tx_t lan743x_netdev_xmit_frame(struct sk_buff *skb,
 {
 	struct lan743x_adapter *adapter = netdev_priv(netdev);
 
-	return lan743x_tx_xmit_frame(&adapter->tx[0], skb);
+	return lan743x_tx_xmit_frame(&adapter->tx[0], skb,
+				     netdev_xmit_more());
 }
 
 /**
@@ -8,6 +8,10 @@
 #define _LAN743X_H
 
 #include <linux/phy.h>
+#if IS_ENABLED(CONFIG_PAGE_POOL)
+#include <net/page_pool.h>
+#define LAN743X_PAGE_POOL
+#endif
 #include "lan743x_ptp.h"
 
 #define DRIVER_AUTHOR   "Bryan Whitehead <Bryan.Whitehead@microchip.com>"
@@ -663,6 +667,8 @@ struct lan743x_tx {
 	u32		frame_first;
 	u32		frame_data0;
 	u32		frame_tail;
+	/* frames queued with xmit_more whose TX_TAIL write is deferred */
+	bool		doorbell_pending;
 
 	struct lan743x_tx_buffer_info *buffer_info;
 
@@ -695,6 +701,9 @@ struct lan743x_rx {
 	dma_addr_t ring_dma_ptr;
 
 	struct lan743x_rx_buffer_info *buffer_info;
+#ifdef LAN743X_PAGE_POOL
+	struct page_pool *page_pool;
+#endif
 
 	__le32		*head_cpu_ptr;
 	dma_addr_t	head_dma_ptr;
@@ -705,7 +714,11 @@ struct lan743x_rx {
 
 	u32		frame_count;
 
+#ifdef LAN743X_PAGE_POOL
+	struct sk_buff *skb_head;
+#else
 	struct sk_buff *skb_head, *skb_tail;
+#endif
 };
 
 struct lan743x_adapter {
@@ -820,6 +833,18 @@ struct lan743x_tx_buffer_info {
 
 #define RX_HEAD_PADDING		NET_IP_ALIGN
 
+#ifdef LAN743X_PAGE_POOL
+/* Each rx buffer is one page from the page_pool of the ring. The DMA area
+ * starts after the headroom and leaves room for skb_shared_info at the
+ * end of the page, so that the first buffer of a frame becomes the skb
+ * head through build_skb() without a copy.
+ */
+#define LAN743X_RX_HEADROOM	NET_SKB_PAD
+#define LAN743X_RX_BUF_SIZE	\
+	min_t(unsigned int, RX_DESC_DATA0_BUF_LENGTH_MASK_, \
+	      SKB_WITH_OVERHEAD(PAGE_SIZE - LAN743X_RX_HEADROOM))
+#endif
+
 struct lan743x_rx_descriptor {
 	__le32     data0;
 	__le32     data1;
@@ -830,7 +855,11 @@ struct lan743x_rx_descriptor {
 #define RX_BUFFER_INFO_FLAG_ACTIVE      BIT(0)
 struct lan743x_rx_buffer_info {
 	int flags;
+#ifdef LAN743X_PAGE_POOL
+	struct page *page;
+#else
 	struct sk_buff *skb;
+#endif
 
 	dma_addr_t      dma_ptr;
 	unsigned int    buffer_length;
@@ -49,6 +49,20 @@
 #include "r8126_lib.h"
 #endif
 
+#if defined(ENABLE_XDP_SUPPORT) && \
+    (LINUX_VERSION_CODE < KERNEL_VERSION(5,15,0) || !defined(CONFIG_R8126_NAPI))
+#undef ENABLE_XDP_SUPPORT
+#endif
+#ifdef ENABLE_XDP_SUPPORT
+#ifndef ENABLE_PAGE_REUSE
+#error "ENABLE_XDP_SUPPORT requires ENABLE_PAGE_REUSE"
+#endif
+#include <linux/bpf.h>
+#include <linux/bpf_trace.h>
+#include <linux/filter.h>
+#include <net/xdp.h>
+#endif //ENABLE_XDP_SUPPORT
+
 #ifndef fallthrough
 #define fallthrough
 #endif
@@ -572,6 +586,11 @@ static inline u32 rtl8126_ethtool_adv_to_mmd_eee_adv_cap2_t(u32 adv)
 #define NET_IP_ALIGN        2
 #endif
 #define R8126_RX_ALIGN        NET_IP_ALIGN
+#ifdef ENABLE_XDP_SUPPORT
+#define R8126_RX_HEADROOM     (XDP_PACKET_HEADROOM + R8126_RX_ALIGN)
+#else
+#define R8126_RX_HEADROOM     R8126_RX_ALIGN
+#endif //ENABLE_XDP_SUPPORT
 
 #ifdef CONFIG_R8126_NAPI
 #define NAPI_SUFFIX "-NAPI"
@@ -2121,6 +2140,9 @@ struct ring_info {
         unsigned int   bytecount;
         unsigned short gso_segs;
         u8      __pad[sizeof(void *) - sizeof(u32)];
+#ifdef ENABLE_XDP_SUPPORT
+        struct xdp_frame *xdpf;
+#endif //ENABLE_XDP_SUPPORT
 };
 
 struct pci_resource {
@@ -2199,6 +2221,9 @@ struct rtl8126_rx_ring {
 #ifdef ENABLE_PAGE_REUSE
         struct rtl8126_rx_buffer rx_buffer[MAX_NUM_RX_DESC];
         u16 rx_offset;
+#ifdef ENABLE_XDP_SUPPORT
+        struct xdp_rxq_info xdp_rxq;
+#endif //ENABLE_XDP_SUPPORT
 #else
         struct sk_buff *Rx_skbuff[MAX_NUM_RX_DESC]; /* Rx data buffers */
 #endif //ENABLE_PAGE_REUSE
@@ -2498,6 +2523,9 @@ struct rtl8126_private {
         unsigned rx_buf_page_size;
         u32 page_reuse_fail_cnt;
 #endif //ENABLE_PAGE_REUSE
+#ifdef ENABLE_XDP_SUPPORT
+        struct bpf_prog *xdp_prog;
+#endif //ENABLE_XDP_SUPPORT
         u16 HwSuppNumTxQueues;
         u16 HwSuppNumRxQueues;
         unsigned int num_tx_rings;
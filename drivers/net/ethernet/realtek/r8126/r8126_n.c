@@ -319,6 +319,12 @@ static int rtl8126_tx_interrupt_with_vector(struct rtl8126_private *tp, const in
 static void rtl8126_wait_for_quiescence(struct net_device *dev);
 static int rtl8126_change_mtu(struct net_device *dev, int new_mtu);
 static void rtl8126_down(struct net_device *dev);
+#ifdef ENABLE_XDP_SUPPORT
+static bool rtl8126_xdp_mtu_ok(struct rtl8126_private *tp, int mtu);
+static int rtl8126_xdp(struct net_device *dev, struct netdev_bpf *bpf);
+static int rtl8126_xdp_xmit(struct net_device *dev, int n,
+                            struct xdp_frame **frames, u32 flags);
+#endif //ENABLE_XDP_SUPPORT
 
 static int rtl8126_set_mac_address(struct net_device *dev, void *p);
 static void rtl8126_rar_set(struct rtl8126_private *tp, const u8 *addr);
@@ -12505,6 +12511,10 @@ rtl8126_init_software_variable(struct net_device *dev)
         dev->min_mtu = ETH_MIN_MTU;
         dev->max_mtu = tp->max_jumbo_frame_size;
 #endif //LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0)
+#if defined(ENABLE_XDP_SUPPORT) && LINUX_VERSION_CODE >= KERNEL_VERSION(6,3,0)
+        dev->xdp_features = NETDEV_XDP_ACT_BASIC | NETDEV_XDP_ACT_REDIRECT |
+                            NETDEV_XDP_ACT_NDO_XMIT;
+#endif //ENABLE_XDP_SUPPORT && LINUX_VERSION_CODE >= KERNEL_VERSION(6,3,0)
 
         if (tp->mcfg != CFG_METHOD_DEFAULT) {
                 struct ethtool_keee *eee = &tp->eee;
@@ -14088,6 +14098,10 @@ static const struct net_device_ops rtl8126_netdev_ops = {
 #ifdef CONFIG_NET_POLL_CONTROLLER
         .ndo_poll_controller    = rtl8126_netpoll,
 #endif
+#ifdef ENABLE_XDP_SUPPORT
+        .ndo_bpf            = rtl8126_xdp,
+        .ndo_xdp_xmit       = rtl8126_xdp_xmit,
+#endif //ENABLE_XDP_SUPPORT
 };
 #endif
 
@@ -14637,7 +14651,7 @@ rtl8126_remove_one(struct pci_dev *pdev)
 static inline unsigned int rtl8126_rx_page_order(unsigned rx_buf_sz, unsigned page_size)
 {
         unsigned truesize = SKB_DATA_ALIGN(sizeof(struct skb_shared_info)) +
-                            SKB_DATA_ALIGN(rx_buf_sz + R8126_RX_ALIGN);
+                            SKB_DATA_ALIGN(rx_buf_sz + R8126_RX_HEADROOM);
 
         return get_order(truesize * 2);
 }
@@ -14828,6 +14842,17 @@ static void rtl8126_free_rx_desc(struct rtl8126_private *tp)
 
 static void rtl8126_free_alloc_resources(struct rtl8126_private *tp)
 {
+#ifdef ENABLE_XDP_SUPPORT
+        int i;
+
+        for (i = 0; i < tp->num_rx_rings; i++) {
+                struct rtl8126_rx_ring *ring = &tp->rx_ring[i];
+
+                if (xdp_rxq_info_is_reg(&ring->xdp_rxq))
+                        xdp_rxq_info_unreg(&ring->xdp_rxq);
+        }
+#endif //ENABLE_XDP_SUPPORT
+
         rtl8126_free_rx_desc(tp);
 
         rtl8126_free_tx_desc(tp);
@@ -15426,6 +15451,13 @@ rtl8126_change_mtu(struct net_device *dev,
                 new_mtu = tp->max_jumbo_frame_size;
 #endif //LINUX_VERSION_CODE < KERNEL_VERSION(4,10,0)
 
+#ifdef ENABLE_XDP_SUPPORT
+        if (tp->xdp_prog && !rtl8126_xdp_mtu_ok(tp, new_mtu)) {
+                netdev_warn(dev, "MTU %d too large for XDP\n", new_mtu);
+                return -EINVAL;
+        }
+#endif //ENABLE_XDP_SUPPORT
+
         dev->mtu = new_mtu;
 
         tp->eee.tx_lpi_timer = dev->mtu + ETH_HLEN + 0x20;
@@ -15860,7 +15892,16 @@ rtl8126_init_ring(struct net_device *dev)
         for (i = 0; i < tp->num_rx_rings; i++) {
                 struct rtl8126_rx_ring *ring = &tp->rx_ring[i];
 #ifdef ENABLE_PAGE_REUSE
-                ring->rx_offset = R8126_RX_ALIGN;
+                ring->rx_offset = R8126_RX_HEADROOM;
+#ifdef ENABLE_XDP_SUPPORT
+                if (!xdp_rxq_info_is_reg(&ring->xdp_rxq) &&
+                    (xdp_rxq_info_reg(&ring->xdp_rxq, dev, i,
+                                      tp->r8126napi[i].napi.napi_id) < 0 ||
+                     xdp_rxq_info_reg_mem_model(&ring->xdp_rxq,
+                                                MEM_TYPE_PAGE_SHARED,
+                                                NULL) < 0))
+                        goto err_out;
+#endif //ENABLE_XDP_SUPPORT
 #else
                 memset(ring->Rx_skbuff, 0x0, sizeof(ring->Rx_skbuff));
 #endif //ENABLE_PAGE_REUSE
@@ -15918,6 +15959,13 @@ rtl8126_tx_clear_range(struct rtl8126_private *tp,
                                 dev_kfree_skb_any(skb);
                                 tx_skb->skb = NULL;
                         }
+#ifdef ENABLE_XDP_SUPPORT
+                        if (tx_skb->xdpf) {
+                                RTLDEV->stats.tx_dropped++;
+                                xdp_return_frame(tx_skb->xdpf);
+                                tx_skb->xdpf = NULL;
+                        }
+#endif //ENABLE_XDP_SUPPORT
                 }
         }
 }
@@ -16802,6 +16850,238 @@ err_stop:
         goto out;
 }
 
+#ifdef ENABLE_XDP_SUPPORT
+
+#define R8126_XDP_PASS          0
+#define R8126_XDP_CONSUMED      BIT(0)
+#define R8126_XDP_TX            BIT(1)
+#define R8126_XDP_REDIR         BIT(2)
+
+static bool
+rtl8126_xdp_mtu_ok(struct rtl8126_private *tp, int mtu)
+{
+#ifdef ENABLE_RX_PACKET_FRAGMENT
+        /* xdp programs only see single buffer frames */
+        return mtu + ETH_HLEN + RT_VALN_HLEN + ETH_FCS_LEN <=
+               SKB_DATA_ALIGN(RX_BUF_SIZE);
+#else
+        return true;
+#endif //ENABLE_RX_PACKET_FRAGMENT
+}
+
+static int
+rtl8126_xdp_setup(struct net_device *dev, struct bpf_prog *prog,
+                  struct netlink_ext_ack *extack)
+{
+        struct rtl8126_private *tp = netdev_priv(dev);
+        struct bpf_prog *old_prog;
+
+        if (prog && !rtl8126_xdp_mtu_ok(tp, dev->mtu)) {
+                NL_SET_ERR_MSG_MOD(extack, "MTU too large for XDP");
+                return -EOPNOTSUPP;
+        }
+
+        /* rx buffers always reserve XDP_PACKET_HEADROOM, so the program
+         * can be swapped without rebuilding the rings
+         */
+        old_prog = xchg(&tp->xdp_prog, prog);
+        if (old_prog)
+                bpf_prog_put(old_prog);
+
+        return 0;
+}
+
+static int
+rtl8126_xdp(struct net_device *dev, struct netdev_bpf *bpf)
+{
+        switch (bpf->command) {
+        case XDP_SETUP_PROG:
+                return rtl8126_xdp_setup(dev, bpf->prog, bpf->extack);
+        default:
+                return -EINVAL;
+        }
+}
+
+/* xdp frames share the tx rings of the stack, serialized by the tx lock
+ * of the matching queue
+ */
+static struct rtl8126_tx_ring *
+rtl8126_xdp_tx_ring(struct rtl8126_private *tp)
+{
+        return &tp->tx_ring[smp_processor_id() % tp->num_tx_rings];
+}
+
+static void
+rtl8126_xdp_tx_maybe_stop(struct rtl8126_private *tp,
+                          struct rtl8126_tx_ring *ring)
+{
+        if (likely(rtl8126_tx_slots_avail(tp, ring)))
+                return;
+
+        /* same handshake with rtl_tx as rtl8126_start_xmit */
+        smp_wmb();
+        netif_stop_subqueue(tp->dev, ring->index);
+        smp_mb();
+        if (rtl8126_tx_slots_avail(tp, ring))
+                netif_start_subqueue(tp->dev, ring->index);
+}
+
+static int
+rtl8126_xdp_xmit_frame(struct rtl8126_private *tp,
+                       struct rtl8126_tx_ring *ring,
+                       struct xdp_frame *xdpf)
+{
+        unsigned int entry = ring->cur_tx % ring->num_tx_desc;
+        struct TxDesc *txd = ring->TxDescArray + entry;
+        struct ring_info *tx_skb = ring->tx_skb + entry;
+        dma_addr_t mapping;
+
+        if (unlikely(!rtl8126_tx_slots_avail(tp, ring)))
+                return -EBUSY;
+
+        if (!tp->EnableTxNoClose &&
+            unlikely(le32_to_cpu(txd->opts1) & DescOwn))
+                return -EBUSY;
+
+        mapping = dma_map_single(tp_to_dev(tp), xdpf->data, xdpf->len,
+                                 DMA_TO_DEVICE);
+        if (unlikely(dma_mapping_error(tp_to_dev(tp), mapping)))
+                return -ENOMEM;
+
+        tx_skb->len = xdpf->len;
+        tx_skb->xdpf = xdpf;
+        tx_skb->bytecount = xdpf->len;
+        tx_skb->gso_segs = 1;
+
+        txd->addr = cpu_to_le64(mapping);
+        txd->opts2 = 0;
+        wmb();
+        txd->opts1 = cpu_to_le32(rtl8126_get_txd_opts1(ring,
+                                 DescOwn | FirstFrag | LastFrag,
+                                 xdpf->len, entry));
+
+        /* rtl_tx needs to see descriptor changes before updated tp->cur_tx */
+        smp_wmb();
+
+        WRITE_ONCE(ring->cur_tx, ring->cur_tx + 1);
+
+        return 0;
+}
+
+static int
+rtl8126_xdp_xmit_back(struct rtl8126_private *tp, struct xdp_buff *xdp)
+{
+        struct rtl8126_tx_ring *ring = rtl8126_xdp_tx_ring(tp);
+        struct netdev_queue *txq = txring_txq(ring);
+        struct xdp_frame *xdpf;
+        int ret;
+
+        xdpf = xdp_convert_buff_to_frame(xdp);
+        if (unlikely(!xdpf))
+                return -EOVERFLOW;
+
+        __netif_tx_lock(txq, smp_processor_id());
+        ret = rtl8126_xdp_xmit_frame(tp, ring, xdpf);
+        rtl8126_xdp_tx_maybe_stop(tp, ring);
+        __netif_tx_unlock(txq);
+
+        return ret;
+}
+
+static void
+rtl8126_xdp_flush_tx(struct rtl8126_private *tp)
+{
+        struct rtl8126_tx_ring *ring = rtl8126_xdp_tx_ring(tp);
+        struct netdev_queue *txq = txring_txq(ring);
+
+        __netif_tx_lock(txq, smp_processor_id());
+        rtl8126_doorbell(tp, ring);
+        __netif_tx_unlock(txq);
+}
+
+static int
+rtl8126_xdp_xmit(struct net_device *dev, int n, struct xdp_frame **frames,
+                 u32 flags)
+{
+        struct rtl8126_private *tp = netdev_priv(dev);
+        struct rtl8126_tx_ring *ring;
+        struct netdev_queue *txq;
+        int i;
+
+        if (unlikely(flags & ~XDP_XMIT_FLAGS_MASK))
+                return -EINVAL;
+
+        if (unlikely(test_bit(R8126_FLAG_DOWN, tp->task_flags) ||
+                     !netif_carrier_ok(dev)))
+                return -ENETDOWN;
+
+        ring = rtl8126_xdp_tx_ring(tp);
+        txq = txring_txq(ring);
+
+        __netif_tx_lock(txq, smp_processor_id());
+        for (i = 0; i < n; i++) {
+                if (rtl8126_xdp_xmit_frame(tp, ring, frames[i]))
+                        break;
+        }
+        if (i && (flags & XDP_XMIT_FLUSH))
+                rtl8126_doorbell(tp, ring);
+        rtl8126_xdp_tx_maybe_stop(tp, ring);
+        __netif_tx_unlock(txq);
+
+        /* the caller frees the frames that were not sent */
+        return i;
+}
+
+static void
+rtl8126_xdp_tx_done(struct rtl8126_private *tp, struct ring_info *tx_skb)
+{
+        struct net_device *dev = tp->dev;
+
+        RTLDEV->stats.tx_bytes += tx_skb->bytecount;
+        RTLDEV->stats.tx_packets++;
+
+        xdp_return_frame(tx_skb->xdpf);
+        tx_skb->xdpf = NULL;
+}
+
+static u32
+rtl8126_run_xdp(struct rtl8126_private *tp, struct bpf_prog *prog,
+                struct xdp_buff *xdp)
+{
+        struct net_device *dev = tp->dev;
+        u32 act;
+
+        act = bpf_prog_run_xdp(prog, xdp);
+        switch (act) {
+        case XDP_PASS:
+                return R8126_XDP_PASS;
+        case XDP_TX:
+                if (unlikely(rtl8126_xdp_xmit_back(tp, xdp)))
+                        goto out_failure;
+                return R8126_XDP_TX;
+        case XDP_REDIRECT:
+                if (unlikely(xdp_do_redirect(dev, xdp, prog)))
+                        goto out_failure;
+                return R8126_XDP_REDIR;
+        default:
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,17,0)
+                bpf_warn_invalid_xdp_action(dev, prog, act);
+#else
+                bpf_warn_invalid_xdp_action(act);
+#endif //LINUX_VERSION_CODE >= KERNEL_VERSION(5,17,0)
+                fallthrough;
+        case XDP_ABORTED:
+out_failure:
+                trace_xdp_exception(dev, prog, act);
+                RTLDEV->stats.rx_dropped++;
+                fallthrough;
+        case XDP_DROP:
+                return R8126_XDP_CONSUMED;
+        }
+}
+
+#endif //ENABLE_XDP_SUPPORT
+
 /* recycle tx no close desc*/
 static int
 rtl8126_tx_interrupt_noclose(struct rtl8126_tx_ring *ring, int budget)
@@ -16837,6 +17117,10 @@ rtl8126_tx_interrupt_noclose(struct rtl8126_tx_ring *ring, int budget)
                         RTL_NAPI_CONSUME_SKB_ANY(tx_skb->skb, budget);
                         tx_skb->skb = NULL;
                 }
+#ifdef ENABLE_XDP_SUPPORT
+                else if (tx_skb->xdpf != NULL)
+                        rtl8126_xdp_tx_done(tp, tx_skb);
+#endif //ENABLE_XDP_SUPPORT
                 dirty_tx++;
                 tx_left--;
         }
@@ -16894,6 +17178,10 @@ rtl8126_tx_interrupt_close(struct rtl8126_tx_ring *ring, int budget)
                         RTL_NAPI_CONSUME_SKB_ANY(tx_skb->skb, budget);
                         tx_skb->skb = NULL;
                 }
+#ifdef ENABLE_XDP_SUPPORT
+                else if (tx_skb->xdpf != NULL)
+                        rtl8126_xdp_tx_done(tp, tx_skb);
+#endif //ENABLE_XDP_SUPPORT
                 dirty_tx++;
                 tx_left--;
         }
@@ -17241,6 +17529,40 @@ static void rtl8126_put_rx_buffer(struct rtl8126_private *tp,
         ring->dirty_rx++;
 }
 
+#ifdef ENABLE_XDP_SUPPORT
+/* hand the same half page back to the ring, nobody else took a ref on it */
+static void
+rtl8126_recycle_rx_buffer(struct rtl8126_private *tp,
+                          struct rtl8126_rx_ring *ring,
+                          u32 cur_rx,
+                          struct rtl8126_rx_buffer *rxb)
+{
+        u32 entry = ring->dirty_rx % ring->num_rx_desc;
+        struct rtl8126_rx_buffer *nrxb = &ring->rx_buffer[entry];
+
+        if (cur_rx != ring->dirty_rx) {
+                nrxb->dma = rxb->dma;
+                nrxb->page_offset = rxb->page_offset;
+                nrxb->data = rxb->data;
+                nrxb->page = rxb->page;
+                rxb->page = NULL;
+        }
+
+        dma_sync_single_range_for_device(tp_to_dev(tp),
+                                         nrxb->dma,
+                                         nrxb->page_offset,
+                                         tp->rx_buf_sz,
+                                         DMA_FROM_DEVICE);
+
+        rtl8126_map_to_asic(tp, ring,
+                            rtl8126_get_rxdesc(tp, ring->RxDescArray, entry),
+                            nrxb->dma + nrxb->page_offset,
+                            tp->rx_buf_sz, entry);
+
+        ring->dirty_rx++;
+}
+#endif //ENABLE_XDP_SUPPORT
+
 #endif //ENABLE_PAGE_REUSE
 
 static int
@@ -17262,6 +17584,12 @@ rtl8126_rx_interrupt(struct net_device *dev,
 #else //ENABLE_PAGE_REUSE
         u64 rx_buf_phy_addr;
 #endif //ENABLE_PAGE_REUSE
+#ifdef ENABLE_XDP_SUPPORT
+        struct bpf_prog *xdp_prog = READ_ONCE(tp->xdp_prog);
+        unsigned int xdp_xmit = 0;
+        struct xdp_buff xdp;
+        u32 xdp_res;
+#endif //ENABLE_XDP_SUPPORT
         unsigned int total_rx_multicast_packets = 0;
         unsigned int total_rx_bytes = 0, total_rx_packets = 0;
 
@@ -17352,7 +17680,50 @@ rtl8126_rx_interrupt(struct net_device *dev,
                 rxb = &ring->rx_buffer[entry];
                 skb = rxb->skb;
                 rxb->skb = NULL;
+
+                /* sync before recycling, which may flip page_offset to
+                 * the other half of the page
+                 */
+                dma_sync_single_range_for_cpu(tp_to_dev(tp),
+                                              rxb->dma,
+                                              rxb->page_offset,
+                                              tp->rx_buf_sz,
+                                              DMA_FROM_DEVICE);
+
                 if (!skb) {
+#ifdef ENABLE_XDP_SUPPORT
+                        xdp_init_buff(&xdp, tp->rx_buf_page_size / 2,
+                                      &ring->xdp_rxq);
+                        xdp_prepare_buff(&xdp, rxb->data + rxb->page_offset -
+                                         ring->rx_offset, ring->rx_offset,
+                                         pkt_size, false);
+                        if (xdp_prog) {
+                                xdp_res = rtl8126_run_xdp(tp, xdp_prog, &xdp);
+                                if (xdp_res != R8126_XDP_PASS) {
+                                        /* tx and redirect now own this half
+                                         * page, a dropped one is reused
+                                         */
+                                        if (xdp_res == R8126_XDP_CONSUMED)
+                                                rtl8126_recycle_rx_buffer(tp, ring, cur_rx, rxb);
+                                        else
+                                                rtl8126_put_rx_buffer(tp, ring, cur_rx, rxb);
+                                        xdp_xmit |= xdp_res;
+                                        total_rx_bytes += pkt_size;
+                                        total_rx_packets++;
+                                        continue;
+                                }
+                        }
+
+                        skb = RTL_BUILD_SKB_INTR(xdp.data_hard_start, tp->rx_buf_page_size / 2);
+                        if (!skb) {
+                                //netdev_err(tp->dev, "Failed to allocate RX skb!\n");
+                                goto drop_packet;
+                        }
+
+                        skb->dev = dev;
+                        skb_reserve(skb, xdp.data - xdp.data_hard_start);
+                        skb_put(skb, xdp.data_end - xdp.data);
+#else
                         skb = RTL_BUILD_SKB_INTR(rxb->data + rxb->page_offset - ring->rx_offset, tp->rx_buf_page_size / 2);
                         if (!skb) {
                                 //netdev_err(tp->dev, "Failed to allocate RX skb!\n");
@@ -17363,17 +17734,12 @@ rtl8126_rx_interrupt(struct net_device *dev,
                         if (!R8126_USE_NAPI_ALLOC_SKB)
                                 skb_reserve(skb, R8126_RX_ALIGN);
                         skb_put(skb, pkt_size);
+#endif //ENABLE_XDP_SUPPORT
                 } else
                         skb_add_rx_frag(skb, skb_shinfo(skb)->nr_frags, rxb->page,
                                         rxb->page_offset, pkt_size, tp->rx_buf_page_size / 2);
                 //recycle desc
                 rtl8126_put_rx_buffer(tp, ring, cur_rx, rxb);
-
-                dma_sync_single_range_for_cpu(tp_to_dev(tp),
-                                              rxb->dma,
-                                              rxb->page_offset,
-                                              tp->rx_buf_sz,
-                                              DMA_FROM_DEVICE);
 #else //ENABLE_PAGE_REUSE
                 skb = RTL_ALLOC_SKB_INTR(&tp->r8126napi[ring->index].napi, pkt_size + R8126_RX_ALIGN);
                 if (!skb) {
@@ -17461,6 +17827,13 @@ drop_packet:
         count = cur_rx - ring->cur_rx;
         ring->cur_rx = cur_rx;
 
+#ifdef ENABLE_XDP_SUPPORT
+        if (xdp_xmit & R8126_XDP_REDIR)
+                xdp_do_flush();
+        if (xdp_xmit & R8126_XDP_TX)
+                rtl8126_xdp_flush_tx(tp);
+#endif //ENABLE_XDP_SUPPORT
+
         delta = rtl8126_rx_fill(tp, ring, dev, ring->dirty_rx, ring->cur_rx, 1);
         if (!delta && count && netif_msg_intr(tp))
                 printk(KERN_INFO "%s: no Rx buffer allocated\n", dev->name);
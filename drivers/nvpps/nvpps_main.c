@@ -13,6 +13,9 @@
 #include <linux/poll.h>
 #include <linux/gpio.h>
 #include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/random.h>
+#include <linux/seqlock.h>
 #include <linux/of_device.h>
 #include <linux/of_gpio.h>
 #include <asm/arch_timer.h>
@@ -24,6 +27,8 @@
 #include <linux/nvpps.h>
 #include <linux/of_address.h>
 
+#include "nvpps_servo.h"
+
 
 /* the following control flags are for
  * debugging purpose only
@@ -44,6 +49,24 @@ static DEFINE_IDR(s_nvpps_idr);
 bool print_pri_ptp_failed = true;
 bool print_sec_ptp_failed = true;
 
+/* simulated PPS source, selected with the NVPPS_MODE_SIM event mode */
+static int sim_drift_ppb;
+module_param(sim_drift_ppb, int, 0644);
+MODULE_PARM_DESC(sim_drift_ppb, "Frequency error of the simulated PTP clock in ppb");
+
+static unsigned int sim_jitter_ns;
+module_param(sim_jitter_ns, uint, 0644);
+MODULE_PARM_DESC(sim_jitter_ns, "Max jitter added to each simulated PTP timestamp in ns");
+
+static unsigned int sim_period_ms = 1000;
+module_param(sim_period_ms, uint, 0644);
+MODULE_PARM_DESC(sim_period_ms, "Period of the simulated PPS events in ms");
+
+/* history slot, written under the device lock and read lock-free */
+struct nvpps_hist_slot {
+	seqcount_t		seq;
+	struct nvpps_sample	sample;
+};
 
 /* platform device instance data */
 struct nvpps_device_data {
@@ -93,6 +116,16 @@ struct nvpps_device_data {
 	uint16_t	lock_threshold_val;
 	struct hte_ts_desc	desc;
 	struct gpio_desc	*gpio_in;
+
+	struct nvpps_hist_slot	hist[NVPPS_HISTORY_LEN];
+	/* last evt_nb stored in hist */
+	unsigned int		hist_head;
+
+	struct nvpps_servo	servo;
+
+	bool			sim;
+	u64			sim_tsc0;
+	u64			sim_ptp0;
 };
 
 
@@ -100,6 +133,10 @@ struct nvpps_device_data {
 struct nvpps_file_data {
 	struct nvpps_device_data	*pdev_data;
 	unsigned int			pps_event_id_rd;
+	/* history cursor, last evt_nb read with NVPPS_GETSAMPLES */
+	struct mutex			hist_lock;
+	unsigned int			hist_rd;
+	bool				hist_reader;
 };
 
 #define EQOS_STSR_OFFSET		0xb08
@@ -235,6 +272,45 @@ static inline u64 get_systime(struct nvpps_device_data *pdev_data, u64 *tsc)
 	return ns;
 }
 
+/*
+ * TSC of an event in ns. HTE timestamps are already in ns, counter
+ * reads are in ticks.
+ */
+static inline u64 nvpps_tsc_to_ns(struct nvpps_device_data *pdev_data,
+				  u64 tsc, u32 evt_mode)
+{
+	if (evt_mode == NVPPS_MODE_GPIO && pdev_data->use_gpio_int_timestamp)
+		return tsc;
+
+	return tsc * pdev_data->tsc_res_ns;
+}
+
+/*
+ * Append the event just latched in pdev_data to the history and feed
+ * it to the servo. Called with pdev_data->lock held.
+ */
+static void nvpps_record_event(struct nvpps_device_data *pdev_data)
+{
+	struct nvpps_hist_slot	*slot;
+	struct nvpps_sample	sample;
+
+	sample.evt_nb = pdev_data->pps_event_id;
+	sample.evt_mode = pdev_data->actual_evt_mode;
+	sample.tsc = nvpps_tsc_to_ns(pdev_data, pdev_data->tsc, sample.evt_mode);
+	sample.ptp = pdev_data->phc;
+	sample.secondary_ptp = pdev_data->secondary_phc;
+	sample.irq_latency = pdev_data->irq_latency;
+
+	slot = &pdev_data->hist[sample.evt_nb % NVPPS_HISTORY_LEN];
+	write_seqcount_begin(&slot->seq);
+	slot->sample = sample;
+	write_seqcount_end(&slot->seq);
+	/* readers only look at slots up to the head */
+	smp_store_release(&pdev_data->hist_head, sample.evt_nb);
+
+	nvpps_servo_sample(&pdev_data->servo, sample.tsc, sample.ptp);
+}
+
 /*
  * Report the PPS event
  */
@@ -330,6 +406,7 @@ static void nvpps_get_ts(struct nvpps_device_data *pdev_data, u64 irq_tsc)
 	 * irq_latency will be 0 if TIMER mode,  >0 if GPIO mode
 	 */
 	pdev_data->secondary_phc = secondary_phc ? secondary_phc - irq_latency : secondary_phc;
+	nvpps_record_event(pdev_data);
 	raw_spin_unlock_irqrestore(&pdev_data->lock, flags);
 
 	/* event notification */
@@ -337,6 +414,48 @@ static void nvpps_get_ts(struct nvpps_device_data *pdev_data, u64 irq_tsc)
 	kill_fasync(&pdev_data->pps_event_async_queue, SIGIO, POLL_IN);
 }
 
+/*
+ * Generate a PPS event from a simulated PTP clock running off the TSC
+ * with a fixed frequency error and random jitter, so that the history
+ * and the servo can be exercised without PPS or PTP hardware.
+ */
+static void nvpps_sim_ts(struct nvpps_device_data *pdev_data)
+{
+	u64		tsc = __arch_counter_get_cntvct();
+	u32		jitter = min_t(u32, READ_ONCE(sim_jitter_ns), NSEC_PER_SEC);
+	s32		drift = READ_ONCE(sim_drift_ppb);
+	unsigned long	flags;
+	u64		elapsed;
+	u64		phc;
+	u32		rem;
+
+	raw_spin_lock_irqsave(&pdev_data->lock, flags);
+	if (!pdev_data->sim_tsc0) {
+		pdev_data->sim_tsc0 = tsc;
+		pdev_data->sim_ptp0 = ktime_get_real_ns();
+	}
+
+	elapsed = (tsc - pdev_data->sim_tsc0) * pdev_data->tsc_res_ns;
+	phc = pdev_data->sim_ptp0 + elapsed;
+	phc += (s64)div_u64_rem(elapsed, NSEC_PER_SEC, &rem) * drift;
+	phc += div_s64((s64)rem * drift, NSEC_PER_SEC);
+	if (jitter)
+		phc += (s64)(get_random_u32() % (2 * jitter + 1)) - jitter;
+
+	pdev_data->pps_event_id_valid = true;
+	pdev_data->pps_event_id++;
+	pdev_data->tsc = tsc;
+	pdev_data->phc = phc;
+	pdev_data->secondary_phc = 0;
+	pdev_data->irq_latency = 0;
+	pdev_data->actual_evt_mode = NVPPS_MODE_SIM;
+	nvpps_record_event(pdev_data);
+	raw_spin_unlock_irqrestore(&pdev_data->lock, flags);
+
+	wake_up_interruptible(&pdev_data->pps_event_queue);
+	kill_fasync(&pdev_data->pps_event_async_queue, SIGIO, POLL_IN);
+}
+
 static irqreturn_t nvpps_gpio_isr(int irq, void *data)
 {
 	struct nvpps_device_data        *pdev_data = (struct nvpps_device_data *)data;
@@ -397,11 +516,16 @@ static void nvpps_timer_callback(struct timer_list *t)
         struct nvpps_device_data        *pdev_data = (struct nvpps_device_data *)from_timer(pdev_data, t, timer);
 #endif /* LINUX_VERSION_CODE < KERNEL_VERSION(4,15,0) */
 	/* get timestamps for this event */
-	nvpps_get_ts(pdev_data, 0);
+	if (READ_ONCE(pdev_data->sim))
+		nvpps_sim_ts(pdev_data);
+	else
+		nvpps_get_ts(pdev_data, 0);
 
 	/* set the next expire time */
 	if (pdev_data->timer_inited) {
-		mod_timer(&pdev_data->timer, jiffies + msecs_to_jiffies(1000));
+		mod_timer(&pdev_data->timer, jiffies + msecs_to_jiffies(
+			READ_ONCE(pdev_data->sim) ?
+				max(READ_ONCE(sim_period_ms), 1U) : 1000));
 	}
 }
 
@@ -451,6 +575,7 @@ static int set_mode(struct nvpps_device_data *pdev_data, u32 mode)
 						pdev_data->timer_inited = false;
 						del_timer_sync(&pdev_data->timer);
 					}
+					WRITE_ONCE(pdev_data->sim, false);
 					if (!pdev_data->irq_registered) {
 						/* register IRQ handler */
 						err = devm_request_irq(pdev_data->dev, pdev_data->irq, nvpps_gpio_isr,
@@ -471,6 +596,19 @@ static int set_mode(struct nvpps_device_data *pdev_data, u32 mode)
 				break;
 
 			case NVPPS_MODE_TIMER:
+			case NVPPS_MODE_SIM:
+				/* The simulated source runs off the same timer,
+				 * restart its clock on each switch to it.
+				 */
+				if (mode == NVPPS_MODE_SIM) {
+					unsigned long flags;
+
+					raw_spin_lock_irqsave(&pdev_data->lock, flags);
+					pdev_data->sim_tsc0 = 0;
+					raw_spin_unlock_irqrestore(&pdev_data->lock, flags);
+				}
+				WRITE_ONCE(pdev_data->sim, mode == NVPPS_MODE_SIM);
+
 				/* If GPIO mode is run and IRQ is registered previously,
 				 * then don't free the already requested IRQ. This is to
 				 * avoid free'ing and re-registering of the IRQ when
@@ -516,6 +654,12 @@ static __poll_t nvpps_poll(struct file *file, poll_table *wait)
 	struct nvpps_device_data	*pdev_data = pfile_data->pdev_data;
 
 	poll_wait(file, &pdev_data->pps_event_queue, wait);
+	if (READ_ONCE(pfile_data->hist_reader)) {
+		if (READ_ONCE(pfile_data->hist_rd) !=
+		    smp_load_acquire(&pdev_data->hist_head))
+			return POLLIN | POLLRDNORM;
+		return 0;
+	}
 	if (pdev_data->pps_event_id_valid &&
 		(pfile_data->pps_event_id_rd != pdev_data->pps_event_id)) {
 		return POLLIN | POLLRDNORM;
@@ -534,6 +678,105 @@ static int nvpps_fasync(int fd, struct file *file, int on)
 }
 
 
+/*
+ * Copy the history entries this file has not read yet. Entries are
+ * read without the device lock, a slot rewritten while being copied
+ * is retried, one already reused for a newer event is counted as lost.
+ */
+static int nvpps_get_samples(struct nvpps_file_data *pfile_data,
+			     void __user *uarg)
+{
+	struct nvpps_device_data	*pdev_data = pfile_data->pdev_data;
+	struct nvpps_samples		req;
+	struct nvpps_sample		*buf;
+	struct nvpps_hist_slot		*slot;
+	unsigned int			head, rd, id, seq;
+	u32				count, n = 0, lost = 0;
+	int				err = 0;
+
+	if (copy_from_user(&req, uarg, sizeof(req)))
+		return -EFAULT;
+
+	count = min_t(u32, req.count, NVPPS_HISTORY_LEN);
+	buf = kmalloc_array(count, sizeof(*buf), GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	mutex_lock(&pfile_data->hist_lock);
+	WRITE_ONCE(pfile_data->hist_reader, true);
+
+	head = smp_load_acquire(&pdev_data->hist_head);
+	rd = pfile_data->hist_rd;
+	if (head - rd > NVPPS_HISTORY_LEN) {
+		lost = head - rd - NVPPS_HISTORY_LEN;
+		rd = head - NVPPS_HISTORY_LEN;
+	}
+
+	while (rd != head && n < count) {
+		id = rd + 1;
+		slot = &pdev_data->hist[id % NVPPS_HISTORY_LEN];
+		do {
+			seq = read_seqcount_begin(&slot->seq);
+			buf[n] = slot->sample;
+		} while (read_seqcount_retry(&slot->seq, seq));
+
+		rd = id;
+		if (buf[n].evt_nb != id)
+			lost++;
+		else
+			n++;
+	}
+
+	if (n && copy_to_user(u64_to_user_ptr(req.samples), buf,
+			      n * sizeof(*buf))) {
+		err = -EFAULT;
+		goto unlock;
+	}
+
+	pfile_data->hist_rd = rd;
+	req.count = n;
+	req.lost = lost;
+	if (copy_to_user(uarg, &req, sizeof(req)))
+		err = -EFAULT;
+
+unlock:
+	mutex_unlock(&pfile_data->hist_lock);
+	kfree(buf);
+	return err;
+}
+
+static int nvpps_set_servo(struct nvpps_device_data *pdev_data,
+			   void __user *uarg)
+{
+	struct nvpps_servo		*servo = &pdev_data->servo;
+	struct nvpps_servo_params	params;
+	unsigned long			flags;
+
+	if (copy_from_user(&params, uarg, sizeof(params)))
+		return -EFAULT;
+
+	/* gains above one only make the loop unstable */
+	if (params.kp > NVPPS_SERVO_GAIN_ONE || params.ki > NVPPS_SERVO_GAIN_ONE)
+		return -EINVAL;
+	if (!params.step_ns)
+		params.step_ns = NVPPS_SERVO_DEF_STEP_NS;
+	params.enable = !!params.enable;
+
+	raw_spin_lock_irqsave(&pdev_data->lock, flags);
+	/* restart from the next sample, keep a frequency already learnt */
+	if (!servo->params.enable)
+		servo->freq = 0;
+	servo->params = params;
+	servo->state = NVPPS_SERVO_OFF;
+	servo->locked_cnt = 0;
+	servo->offset = 0;
+	servo->mult = nvpps_servo_mult(servo->freq);
+	nvpps_servo_publish(servo);
+	raw_spin_unlock_irqrestore(&pdev_data->lock, flags);
+
+	return 0;
+}
+
 static long nvpps_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	struct nvpps_file_data		*pfile_data = (struct nvpps_file_data *)file->private_data;
@@ -699,6 +942,33 @@ static long nvpps_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			break;
 		}
 
+		case NVPPS_GETSAMPLES:
+			dev_dbg(pdev_data->dev, "NVPPS_GETSAMPLES\n");
+
+			return nvpps_get_samples(pfile_data, uarg);
+
+		case NVPPS_SETSERVO:
+			dev_dbg(pdev_data->dev, "NVPPS_SETSERVO\n");
+
+			return nvpps_set_servo(pdev_data, uarg);
+
+		case NVPPS_GETSERVO: {
+			struct nvpps_servo_params	servo_params;
+			unsigned long			flags;
+
+			dev_dbg(pdev_data->dev, "NVPPS_GETSERVO\n");
+
+			raw_spin_lock_irqsave(&pdev_data->lock, flags);
+			servo_params = pdev_data->servo.params;
+			raw_spin_unlock_irqrestore(&pdev_data->lock, flags);
+
+			err = copy_to_user(uarg, &servo_params,
+				sizeof(struct nvpps_servo_params));
+			if (err)
+				return -EFAULT;
+			break;
+		}
+
 		default:
 			return -ENOTTY;
 	}
@@ -721,6 +991,13 @@ static int nvpps_open(struct inode *inode, struct file *file)
 
 	pfile_data->pdev_data = pdev_data;
 	pfile_data->pps_event_id_rd = (unsigned int)-1;
+	/* start with whatever history is still available */
+	mutex_init(&pfile_data->hist_lock);
+	pfile_data->hist_rd = smp_load_acquire(&pdev_data->hist_head);
+	if (pfile_data->hist_rd > NVPPS_HISTORY_LEN)
+		pfile_data->hist_rd -= NVPPS_HISTORY_LEN;
+	else
+		pfile_data->hist_rd = 0;
 
 	file->private_data = pfile_data;
 	kobject_get(&pdev_data->dev->kobj);
@@ -729,6 +1006,32 @@ static int nvpps_open(struct inode *inode, struct file *file)
 
 
 
+/*
+ * Map the servo model page read-only
+ */
+static int nvpps_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct nvpps_file_data		*pfile_data = (struct nvpps_file_data *)file->private_data;
+	struct nvpps_device_data	*pdev_data = pfile_data->pdev_data;
+
+	if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start != PAGE_SIZE)
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+#if defined(NV_VM_AREA_STRUCT_HAS_CONST_VM_FLAGS) /* Linux v6.3 */
+	vm_flags_clear(vma, VM_MAYWRITE);
+#else
+	vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+
+	return vm_insert_page(vma, vma->vm_start,
+			virt_to_page(pdev_data->servo.model));
+}
+
+
+
 static int nvpps_close(struct inode *inode, struct file *file)
 {
 	struct nvpps_device_data	*pdev_data = container_of(inode->i_cdev, struct nvpps_device_data, cdev);
@@ -747,6 +1050,7 @@ static const struct file_operations nvpps_fops = {
 	.poll		= nvpps_poll,
 	.fasync		= nvpps_fasync,
 	.unlocked_ioctl	= nvpps_ioctl,
+	.mmap		= nvpps_mmap,
 	.open		= nvpps_open,
 	.release	= nvpps_close,
 };
@@ -1005,6 +1309,23 @@ static int nvpps_probe(struct platform_device *pdev)
 	#undef _PICO_SECS
 	dev_info(&pdev->dev, "tsc_res_ns(%llu)\n", pdev_data->tsc_res_ns);
 
+	/* timestamp history and servo, the servo stays off until enabled */
+	for (index = 0; index < NVPPS_HISTORY_LEN; index++)
+		seqcount_init(&pdev_data->hist[index].seq);
+
+	pdev_data->servo.model = (struct nvpps_servo_model *)
+		devm_get_free_pages(&pdev->dev, GFP_KERNEL | __GFP_ZERO, 0);
+	if (!pdev_data->servo.model)
+		return -ENOMEM;
+	pdev_data->servo.params.kp = NVPPS_SERVO_DEF_KP;
+	pdev_data->servo.params.ki = NVPPS_SERVO_DEF_KI;
+	pdev_data->servo.params.step_ns = NVPPS_SERVO_DEF_STEP_NS;
+	pdev_data->servo.mult = nvpps_servo_mult(0);
+	/* fixed for the device lifetime, not republished by the servo */
+	pdev_data->servo.model->shift = NVPPS_SERVO_SHIFT;
+	pdev_data->servo.model->tsc_res_ns = pdev_data->tsc_res_ns;
+	nvpps_servo_publish(&pdev_data->servo);
+
 	/* Set up GPIO and HTE */
 	err = nvpps_gpio_hte_setup(pdev_data);
 	if (err < 0)
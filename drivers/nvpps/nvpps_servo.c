@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// SPDX-FileCopyrightText: Copyright (c) 2024 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <asm/barrier.h>
+
+#include "nvpps_servo.h"
+
+/*
+ * Copy the servo state to the user visible model. Readers retry while
+ * seq is odd or changes under them.
+ */
+void nvpps_servo_publish(struct nvpps_servo *servo)
+{
+	struct nvpps_servo_model	*model = servo->model;
+	u32				seq = model->seq;
+
+	WRITE_ONCE(model->seq, seq + 1);
+	smp_wmb();
+
+	model->state = servo->state;
+	model->tsc_ref = servo->tsc_ref;
+	model->ptp_ref = servo->ptp_ref;
+	model->mult = servo->mult;
+	model->offset_ns = servo->offset;
+	model->freq_ppb = servo->freq >> NVPPS_SERVO_FREQ_SHIFT;
+	model->updates = servo->updates;
+	model->steps = servo->steps;
+
+	smp_wmb();
+	WRITE_ONCE(model->seq, seq + 2);
+}
+
+/*
+ * Feed one TSC/PTP pair to the PI servo. The proportional term pulls
+ * the model phase toward the measurement, the integral term tracks the
+ * frequency of PTP relative to TSC. Called with the device lock held.
+ */
+void nvpps_servo_sample(struct nvpps_servo *servo, u64 tsc, u64 ptp)
+{
+	s64			interval;
+	s64			offset;
+	s64			ppb;
+	u64			predicted;
+
+	if (!servo->params.enable || !ptp)
+		return;
+
+	interval = (s64)(tsc - servo->tsc_ref);
+	if (servo->state == NVPPS_SERVO_OFF || interval <= 0 ||
+	    interval > NVPPS_SERVO_MAX_INTERVAL_NS)
+		goto step;
+
+	predicted = servo->ptp_ref +
+		((interval * (s64)servo->mult) >> NVPPS_SERVO_SHIFT);
+	offset = (s64)(ptp - predicted);
+	if (abs(offset) > servo->params.step_ns)
+		goto step;
+
+	servo->ptp_ref = predicted + ((offset * servo->params.kp) >> 16);
+	servo->tsc_ref = tsc;
+
+	ppb = div64_s64(offset * NSEC_PER_SEC, interval);
+	ppb = clamp(ppb, -NVPPS_SERVO_MAX_PPB, NVPPS_SERVO_MAX_PPB);
+	servo->freq += ((ppb << NVPPS_SERVO_FREQ_SHIFT) * servo->params.ki) >> 16;
+	servo->freq = clamp(servo->freq,
+			    -NVPPS_SERVO_MAX_PPB << NVPPS_SERVO_FREQ_SHIFT,
+			    NVPPS_SERVO_MAX_PPB << NVPPS_SERVO_FREQ_SHIFT);
+	servo->mult = nvpps_servo_mult(servo->freq);
+	servo->offset = offset;
+	servo->updates++;
+
+	if (abs(offset) < NVPPS_SERVO_LOCK_NS) {
+		if (servo->locked_cnt < NVPPS_SERVO_LOCK_CNT &&
+		    ++servo->locked_cnt == NVPPS_SERVO_LOCK_CNT)
+			servo->state = NVPPS_SERVO_LOCKED;
+	} else {
+		servo->locked_cnt = 0;
+		servo->state = NVPPS_SERVO_UNLOCKED;
+	}
+
+	nvpps_servo_publish(servo);
+	return;
+
+step:
+	/* first sample, gap or phase jump: re-anchor, keep the frequency */
+	if (servo->state != NVPPS_SERVO_OFF)
+		servo->steps++;
+	servo->state = NVPPS_SERVO_UNLOCKED;
+	servo->locked_cnt = 0;
+	servo->tsc_ref = tsc;
+	servo->ptp_ref = ptp;
+	servo->offset = 0;
+	servo->mult = nvpps_servo_mult(servo->freq);
+	nvpps_servo_publish(servo);
+}
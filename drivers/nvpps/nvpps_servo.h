@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/* SPDX-FileCopyrightText: Copyright (c) 2024 NVIDIA CORPORATION & AFFILIATES. All rights reserved. */
+
+#ifndef __NVPPS_SERVO_H__
+#define __NVPPS_SERVO_H__
+
+#include <linux/math64.h>
+#include <linux/time64.h>
+#include <linux/types.h>
+#include <uapi/linux/nvpps_ioctl.h>
+
+/* servo model, PTP = ptp_ref + ((TSC - tsc_ref) * mult) >> NVPPS_SERVO_SHIFT */
+#define NVPPS_SERVO_SHIFT		24
+/* fractional bits of the servo frequency, in ppb */
+#define NVPPS_SERVO_FREQ_SHIFT		10
+#define NVPPS_SERVO_MAX_PPB		500000LL
+/* longer gaps between samples re-anchor the model */
+#define NVPPS_SERVO_MAX_INTERVAL_NS	(4 * NSEC_PER_SEC)
+#define NVPPS_SERVO_GAIN_ONE		(1U << 16)
+#define NVPPS_SERVO_DEF_KP		0xb333	/* 0.7 */
+#define NVPPS_SERVO_DEF_KI		0x4ccc	/* 0.3 */
+#define NVPPS_SERVO_DEF_STEP_NS		1000000
+#define NVPPS_SERVO_LOCK_NS		1000
+#define NVPPS_SERVO_LOCK_CNT		4
+
+/* PI servo state, updated under the device lock */
+struct nvpps_servo {
+	struct nvpps_servo_params	params;
+	u32				state;
+	u32				locked_cnt;
+	u64				tsc_ref;
+	u64				ptp_ref;
+	/* frequency of PTP relative to TSC, ppb << NVPPS_SERVO_FREQ_SHIFT */
+	s64				freq;
+	u64				mult;
+	s64				offset;
+	u64				updates;
+	u64				steps;
+	/* page shared read-only with user space */
+	struct nvpps_servo_model	*model;
+};
+
+static inline u64 nvpps_servo_mult(s64 freq)
+{
+	return (1ULL << NVPPS_SERVO_SHIFT) +
+		div_s64(freq << (NVPPS_SERVO_SHIFT - NVPPS_SERVO_FREQ_SHIFT),
+			NSEC_PER_SEC);
+}
+
+void nvpps_servo_publish(struct nvpps_servo *servo);
+void nvpps_servo_sample(struct nvpps_servo *servo, u64 tsc, u64 ptp);
+
+#endif /* __NVPPS_SERVO_H__ */
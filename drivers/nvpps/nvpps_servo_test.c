@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// SPDX-FileCopyrightText: Copyright (c) 2024 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+
+/*
+ * KUnit checks of the PTP servo: lock on a drifting clock, re-anchor
+ * on phase jumps and gaps, and a consistent published model.
+ */
+
+#include <kunit/test.h>
+#include <linux/slab.h>
+
+#include "nvpps_servo.h"
+
+#define TEST_TSC0		1000000000ULL
+#define TEST_PTP0		1700000000000000000ULL
+#define TEST_PERIOD_NS		NSEC_PER_SEC
+#define TEST_SAMPLES		64
+/* frequency resolution of the model mult, about 60 ppb */
+#define TEST_PPB_RES		(NSEC_PER_SEC >> NVPPS_SERVO_SHIFT)
+
+/* PTP time at tsc of a clock running drift_ppb fast relative to TSC */
+static u64 test_ptp(u64 tsc, s64 drift_ppb)
+{
+	s64 elapsed = tsc - TEST_TSC0;
+
+	return TEST_PTP0 + elapsed + div_s64(elapsed * drift_ppb, NSEC_PER_SEC);
+}
+
+/* model prediction, as computed by a user space reader */
+static u64 test_predict(const struct nvpps_servo_model *model, u64 tsc)
+{
+	return model->ptp_ref +
+		(((s64)(tsc - model->tsc_ref) * (s64)model->mult) >> model->shift);
+}
+
+/* feed one sample per period and return the TSC of the next one */
+static u64 test_run(struct nvpps_servo *servo, u64 tsc, s64 drift_ppb,
+		    unsigned int samples)
+{
+	while (samples--) {
+		nvpps_servo_sample(servo, tsc, test_ptp(tsc, drift_ppb));
+		tsc += TEST_PERIOD_NS;
+	}
+
+	return tsc;
+}
+
+static int servo_test_init(struct kunit *test)
+{
+	struct nvpps_servo *servo;
+
+	servo = kunit_kzalloc(test, sizeof(*servo), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, servo);
+	servo->model = kunit_kzalloc(test, sizeof(*servo->model), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, servo->model);
+
+	servo->params.enable = 1;
+	servo->params.kp = NVPPS_SERVO_DEF_KP;
+	servo->params.ki = NVPPS_SERVO_DEF_KI;
+	servo->params.step_ns = NVPPS_SERVO_DEF_STEP_NS;
+	servo->mult = nvpps_servo_mult(0);
+	servo->model->shift = NVPPS_SERVO_SHIFT;
+	test->priv = servo;
+
+	return 0;
+}
+
+static void servo_test_lock(struct kunit *test)
+{
+	static const s64 drifts[] = { 0, 25000, -40000, 100000 };
+	struct nvpps_servo_model *model;
+	struct nvpps_servo *servo;
+	unsigned int i;
+	u64 tsc;
+
+	for (i = 0; i < ARRAY_SIZE(drifts); i++) {
+		servo_test_init(test);
+		servo = test->priv;
+		model = servo->model;
+
+		tsc = test_run(servo, TEST_TSC0, drifts[i], TEST_SAMPLES);
+
+		KUNIT_EXPECT_EQ(test, model->state, NVPPS_SERVO_LOCKED);
+		KUNIT_EXPECT_EQ(test, model->steps, 0);
+		KUNIT_EXPECT_EQ(test, model->updates, TEST_SAMPLES - 1);
+		KUNIT_EXPECT_LT(test, abs(model->offset_ns), NVPPS_SERVO_LOCK_NS);
+		KUNIT_EXPECT_LT(test, abs(model->freq_ppb - drifts[i]),
+				2 * TEST_PPB_RES);
+		/* half a period past the last sample */
+		tsc -= TEST_PERIOD_NS / 2;
+		KUNIT_EXPECT_LT(test,
+				abs((s64)(test_predict(model, tsc) -
+					  test_ptp(tsc, drifts[i]))),
+				NVPPS_SERVO_LOCK_NS);
+	}
+}
+
+static void servo_test_step(struct kunit *test)
+{
+	struct nvpps_servo *servo = test->priv;
+	struct nvpps_servo_model *model = servo->model;
+	s64 freq_ppb;
+	u64 tsc;
+
+	tsc = test_run(servo, TEST_TSC0, 25000, TEST_SAMPLES);
+	KUNIT_ASSERT_EQ(test, model->state, NVPPS_SERVO_LOCKED);
+	freq_ppb = model->freq_ppb;
+
+	/* a gap in the samples re-anchors, even with the model still exact */
+	tsc += NVPPS_SERVO_MAX_INTERVAL_NS;
+	nvpps_servo_sample(servo, tsc, test_ptp(tsc, 25000));
+	KUNIT_EXPECT_EQ(test, model->state, NVPPS_SERVO_UNLOCKED);
+	KUNIT_EXPECT_EQ(test, model->steps, 1);
+	KUNIT_EXPECT_EQ(test, model->offset_ns, 0);
+	KUNIT_EXPECT_EQ(test, model->freq_ppb, freq_ppb);
+	KUNIT_EXPECT_EQ(test, model->tsc_ref, tsc);
+	KUNIT_EXPECT_EQ(test, model->ptp_ref, test_ptp(tsc, 25000));
+
+	/* the learnt frequency locks again without a new pull-in */
+	tsc = test_run(servo, tsc + TEST_PERIOD_NS, 25000,
+		       NVPPS_SERVO_LOCK_CNT + 1);
+	KUNIT_EXPECT_EQ(test, model->state, NVPPS_SERVO_LOCKED);
+	KUNIT_EXPECT_EQ(test, model->steps, 1);
+	freq_ppb = model->freq_ppb;
+
+	/* a jump over step_ns re-anchors on the sample as well */
+	nvpps_servo_sample(servo, tsc, test_ptp(tsc, 25000) + 2 * NSEC_PER_MSEC);
+	KUNIT_EXPECT_EQ(test, model->steps, 2);
+	KUNIT_EXPECT_EQ(test, model->ptp_ref,
+			test_ptp(tsc, 25000) + 2 * NSEC_PER_MSEC);
+	KUNIT_EXPECT_EQ(test, model->freq_ppb, freq_ppb);
+}
+
+static void servo_test_disabled(struct kunit *test)
+{
+	struct nvpps_servo *servo = test->priv;
+	struct nvpps_servo_model *model = servo->model;
+
+	servo->params.enable = 0;
+	test_run(servo, TEST_TSC0, 25000, TEST_SAMPLES);
+	KUNIT_EXPECT_EQ(test, model->seq, 0);
+	KUNIT_EXPECT_EQ(test, servo->state, NVPPS_SERVO_OFF);
+
+	/* samples without a PTP time are ignored */
+	servo->params.enable = 1;
+	nvpps_servo_sample(servo, TEST_TSC0, 0);
+	KUNIT_EXPECT_EQ(test, model->seq, 0);
+	KUNIT_EXPECT_EQ(test, servo->state, NVPPS_SERVO_OFF);
+}
+
+static void servo_test_publish(struct kunit *test)
+{
+	struct nvpps_servo *servo = test->priv;
+	struct nvpps_servo_model *model = servo->model;
+	unsigned int i;
+
+	for (i = 1; i <= NVPPS_SERVO_LOCK_CNT + 2; i++) {
+		test_run(servo, TEST_TSC0 + i * TEST_PERIOD_NS, 25000, 1);
+		/* one even bump of seq per sample */
+		KUNIT_EXPECT_EQ(test, model->seq, 2 * i);
+		KUNIT_EXPECT_EQ(test, model->state, servo->state);
+		KUNIT_EXPECT_EQ(test, model->tsc_ref, servo->tsc_ref);
+		KUNIT_EXPECT_EQ(test, model->ptp_ref, servo->ptp_ref);
+		KUNIT_EXPECT_EQ(test, model->mult, servo->mult);
+		KUNIT_EXPECT_EQ(test, model->offset_ns, servo->offset);
+		KUNIT_EXPECT_EQ(test, model->freq_ppb,
+				servo->freq >> NVPPS_SERVO_FREQ_SHIFT);
+	}
+}
+
+static struct kunit_case servo_test_cases[] = {
+	KUNIT_CASE(servo_test_lock),
+	KUNIT_CASE(servo_test_step),
+	KUNIT_CASE(servo_test_disabled),
+	KUNIT_CASE(servo_test_publish),
+	{}
+};
+
+static struct kunit_suite servo_test_suite = {
+	.name = "nvpps-servo",
+	.init = servo_test_init,
+	.test_cases = servo_test_cases,
+};
+kunit_test_suite(servo_test_suite);
@@ -6,6 +6,7 @@
  */
 
 #include <linux/module.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/dma-mapping.h>
 #include <linux/io.h>
@@ -14,8 +15,15 @@
 #include <linux/platform_device.h>
 #include <linux/slab.h>
 #include <linux/interrupt.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/overflow.h>
+#include <linux/seq_file.h>
+#include <linux/sizes.h>
 #include <linux/tegra-pcie-edma.h>
 #include <linux/limits.h>
+#include <linux/list.h>
+#include <linux/atomic.h>
 #include "tegra-pcie-dma-osi.h"
 
 /** Default number of descriptors used */
@@ -33,10 +41,52 @@
 
 #define INCR_DESC(idx, i) ((idx) = ((idx) + (i)) % (ch->desc_sz))
 
+/** Minimum bytes per channel when a transfer is spread across channels */
+#define EDMA_MULTI_MIN_CHUNK	SZ_4K
+
+/** Submit time and size of xfer, kept at the ring index of its last descriptor */
+struct edma_ring_meta {
+	ktime_t ts;
+	u64 bytes;
+};
+
+/**
+ * Per channel counters exported through debugfs. Submit side counters are
+ * updated under the channel lock, completion side ones from the IRQ thread,
+ * atomics keep the debugfs reader from seeing torn values.
+ */
+struct edma_chan_stats {
+	atomic64_t submits;
+	atomic64_t descs;
+	atomic64_t completions;
+	atomic64_t errors;
+	atomic64_t bytes;
+	atomic64_t lat_total_ns;
+	atomic64_t lat_max_ns;
+};
+
+/** Book keeping of a transfer spread by tegra_pcie_edma_submit_xfer_multi() */
+struct edma_multi_xfer {
+	/** Entry in edma_prv multi_list, kept in submission order */
+	struct list_head node;
+	/** Outstanding channel xfers, plus one held by the submitter */
+	atomic_t pending;
+	/** Set once pending drops to zero, callback is due */
+	bool done;
+	/** First failure reported by any of the channel xfers */
+	edma_xfer_status_t st;
+	edma_complete_t *complete;
+	void *priv;
+	/** Per channel slices of the caller descriptors */
+	struct tegra_pcie_edma_desc desc[];
+};
+
 struct edma_chan {
 	void *desc;
 	void __iomem *remap_desc;
 	struct tegra_pcie_edma_xfer_info *ring;
+	struct edma_ring_meta *ring_meta;
+	struct edma_chan_stats stats;
 	dma_addr_t dma_iova;
 	uint32_t desc_sz;
 	/* descriptor size that is allocated for a channel */
@@ -72,6 +122,17 @@ struct edma_prv {
 	struct edma_chan rx[DMA_RD_CHNL_NUM];
 	/* BIT(0) - Write initialized, BIT(1) - Read initialized */
 	uint32_t ch_init;
+	/** Number of interrupts handled */
+	atomic64_t irq_count;
+	/** Outstanding tegra_pcie_edma_submit_xfer_multi() xfers */
+	struct list_head multi_list;
+	/** Protects multi_list and multi_draining */
+	struct mutex multi_lock;
+	/** A context is invoking multi xfer callbacks, see edma_multi_xfer_drain() */
+	bool multi_draining;
+	/** Woken when multi_draining is cleared */
+	wait_queue_head_t multi_wq;
+	struct dentry *debugfs;
 };
 
 /** TODO: Define osi_ll_init strcuture and make this as OSI */
@@ -205,6 +266,12 @@ static inline int edma_ch_init(struct edma_prv *prv, struct edma_chan *ch)
 			return -ENOMEM;
 	}
 
+	if (!ch->ring_meta) {
+		ch->ring_meta = kcalloc(ch->desc_sz, sizeof(*ch->ring_meta), GFP_KERNEL);
+		if (!ch->ring_meta)
+			return -ENOMEM;
+	}
+
 	return 0;
 }
 
@@ -263,23 +330,78 @@ static inline u32 get_dma_idx_from_llp(struct edma_prv *prv, u8 chan, struct edm
 	return cur_idx % (ch->desc_sz);
 }
 
+/*
+ * Invoke the callbacks of retired multi xfers in submission order. A slice can
+ * retire on one channel before an earlier xfer's slice on another channel, so
+ * an xfer is held back until every xfer submitted before it is done too.
+ *
+ * Callbacks run without multi_lock, so they may submit the next xfer. Only one
+ * context delivers at a time to keep the order; a drain that finds another one
+ * delivering returns, and the owner picks up what retired meanwhile.
+ */
+static void edma_multi_xfer_drain(struct edma_prv *prv)
+{
+	struct edma_multi_xfer *mx, *tmp;
+	LIST_HEAD(done);
+
+	mutex_lock(&prv->multi_lock);
+	if (prv->multi_draining) {
+		mutex_unlock(&prv->multi_lock);
+		return;
+	}
+	prv->multi_draining = true;
+
+	for (;;) {
+		list_for_each_entry_safe(mx, tmp, &prv->multi_list, node) {
+			if (!smp_load_acquire(&mx->done))
+				break;
+			list_move_tail(&mx->node, &done);
+		}
+		if (list_empty(&done))
+			break;
+		mutex_unlock(&prv->multi_lock);
+
+		list_for_each_entry_safe(mx, tmp, &done, node) {
+			list_del(&mx->node);
+			mx->complete(mx->priv, mx->st, NULL);
+			kfree(mx);
+		}
+
+		mutex_lock(&prv->multi_lock);
+	}
+
+	prv->multi_draining = false;
+	mutex_unlock(&prv->multi_lock);
+	wake_up(&prv->multi_wq);
+}
+
 static inline void process_r_idx(struct edma_chan *ch, edma_xfer_status_t st, u32 idx)
 {
 	u32 count = 0;
-	struct edma_hw_desc *dma_ll_virt;
-	struct edma_dblock *db;
+	u64 lat_ns, lat_max = 0, completions = 0, errors = 0, bytes = 0, lat_total = 0;
+	ktime_t now = ktime_get();
 	struct tegra_pcie_edma_xfer_info *ring;
+	struct edma_ring_meta *meta;
 
+	/*
+	 * LIE/RIE of intermediate descriptors are cleared at submit time, so only
+	 * the SW ring needs to be walked here and the descriptor memory, which is
+	 * across PCIe for remote DMA, is left untouched.
+	 */
 	while ((ch->r_idx != idx) && (count < ch->desc_sz)) {
 		count++;
 		ring = &ch->ring[ch->r_idx];
-		db = (struct edma_dblock *)ch->desc + ch->r_idx / 2;
-		dma_ll_virt = &db->desc[ch->r_idx % 2];
+		meta = &ch->ring_meta[ch->r_idx];
 		INCR_DESC(ch->r_idx, 1);
 		ch->rcount++;
-		/* clear lie and rie if any set */
-		dma_ll_virt->ctrl_reg.ctrl_e.lie = 0;
-		dma_ll_virt->ctrl_reg.ctrl_e.rie = 0;
+		if (meta->bytes) {
+			lat_ns = (u64)ktime_to_ns(ktime_sub(now, meta->ts));
+			completions++;
+			bytes += meta->bytes;
+			lat_total += lat_ns;
+			lat_max = max(lat_max, lat_ns);
+			meta->bytes = 0;
+		}
 		if (ch->type == EDMA_CHAN_XFER_ASYNC && ring->complete) {
 			ring->complete(ring->priv, st, NULL);
 			/* Clear ring callback and priv variables */
@@ -287,6 +409,19 @@ static inline void process_r_idx(struct edma_chan *ch, edma_xfer_status_t st, u3
 			ring->priv = NULL;
 		}
 	}
+
+	if (!completions)
+		return;
+
+	if (st != EDMA_XFER_SUCCESS)
+		errors = completions;
+	atomic64_add(completions, &ch->stats.completions);
+	atomic64_add(errors, &ch->stats.errors);
+	atomic64_add(bytes, &ch->stats.bytes);
+	atomic64_add(lat_total, &ch->stats.lat_total_ns);
+	/* Only the IRQ thread, or edma_stop() after synchronize_irq(), gets here */
+	if (lat_max > (u64)atomic64_read(&ch->stats.lat_max_ns))
+		atomic64_set(&ch->stats.lat_max_ns, lat_max);
 }
 
 static inline void process_ch_irq(struct edma_prv *prv, u32 chan, struct edma_chan *ch,
@@ -358,6 +493,7 @@ static irqreturn_t edma_irq_handler(int irq, void *cookie)
 	u32 ctrl_off[2] = {DMA_CH_CONTROL1_OFF_WRCH, DMA_CH_CONTROL1_OFF_RDCH};
 	u32 db_off[2] = {DMA_WRITE_DOORBELL_OFF, DMA_READ_DOORBELL_OFF};
 
+	atomic64_inc(&prv->irq_count);
 	for (i = 0; i < 2; i++) {
 		if (!(prv->ch_init & OSI_BIT(i)))
 			continue;
@@ -413,11 +549,46 @@ static irqreturn_t edma_irq_handler(int irq, void *cookie)
 		}
 	}
 
+	/* Deliver multi xfers retired by all channels of this interrupt at once */
+	edma_multi_xfer_drain(prv);
+
 	/* Must enable before exit */
 	enable_irq((u32)(irq & INT_MAX));
 	return IRQ_HANDLED;
 }
 
+static int edma_stats_show(struct seq_file *s, void *data)
+{
+	struct edma_prv *prv = (struct edma_prv *)s->private;
+	struct edma_chan *chan[2] = {&prv->tx[0], &prv->rx[0]};
+	u32 mode_cnt[2] = {DMA_WR_CHNL_NUM, DMA_RD_CHNL_NUM};
+	const char *name[2] = {"wr", "rd"};
+	struct edma_chan_stats *st;
+	s64 completions;
+	u32 i, j;
+
+	seq_printf(s, "irqs: %lld\n", atomic64_read(&prv->irq_count));
+	for (j = 0; j < 2; j++) {
+		for (i = 0; i < mode_cnt[j]; i++) {
+			if (!chan[j][i].desc_sz)
+				continue;
+
+			st = &chan[j][i].stats;
+			completions = atomic64_read(&st->completions);
+			seq_printf(s, "%s%u: submits %lld descs %lld completions %lld errors %lld bytes %lld lat_avg_ns %llu lat_max_ns %lld\n",
+				   name[j], i, atomic64_read(&st->submits),
+				   atomic64_read(&st->descs), completions,
+				   atomic64_read(&st->errors), atomic64_read(&st->bytes),
+				   completions ? div64_u64(atomic64_read(&st->lat_total_ns),
+							   completions) : 0,
+				   atomic64_read(&st->lat_max_ns));
+		}
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(edma_stats);
+
 void *tegra_pcie_edma_initialize(struct tegra_pcie_edma_init_info *info)
 {
 	struct edma_prv *prv;
@@ -547,6 +718,10 @@ void *tegra_pcie_edma_initialize(struct tegra_pcie_edma_init_info *info)
 	if (!prv->irq_name)
 		goto free_ring;
 
+	INIT_LIST_HEAD(&prv->multi_list);
+	mutex_init(&prv->multi_lock);
+	init_waitqueue_head(&prv->multi_wq);
+
 	ret = request_threaded_irq(prv->irq, edma_irq, edma_irq_handler,
 				   IRQF_SHARED,
 				   prv->irq_name, prv);
@@ -567,6 +742,10 @@ void *tegra_pcie_edma_initialize(struct tegra_pcie_edma_init_info *info)
 
 	edma_hw_init(prv, false);
 	edma_hw_init(prv, true);
+
+	prv->debugfs = debugfs_create_dir(prv->irq_name, NULL);
+	debugfs_create_file("stats", 0444, prv->debugfs, prv, &edma_stats_fops);
+
 	dev_info(prv->dev, "%s: success", __func__);
 
 	return prv;
@@ -578,6 +757,7 @@ free_ring:
 		for (i = 0; i < mode_cnt[j]; i++) {
 			ch = chan[j] + i;
 			kfree(ch->ring);
+			kfree(ch->ring_meta);
 		}
 	}
 free_dma_desc:
@@ -610,7 +790,7 @@ edma_xfer_status_t tegra_pcie_edma_submit_xfer(void *cookie,
 	struct edma_hw_desc *dma_ll_virt = NULL;
 	struct edma_dblock *db;
 	int i;
-	u64 total_sz = 0;
+	u64 total_sz = 0, total_bytes = 0;
 	edma_xfer_status_t st = EDMA_XFER_SUCCESS;
 	u32 avail, to_ms;
 	struct tegra_pcie_edma_xfer_info *ring;
@@ -662,6 +842,7 @@ edma_xfer_status_t tegra_pcie_edma_submit_xfer(void *cookie,
 		/* calculate number of packets and add those many headers */
 		total_sz +=  (u64)(((tx_info->desc[i].sz / ch->desc_sz) + 1) * 30ULL);
 		total_sz += tx_info->desc[i].sz;
+		total_bytes += tx_info->desc[i].sz;
 		dma_ll_virt->sar_low = lower_32_bits(tx_info->desc[i].src);
 		dma_ll_virt->sar_high = upper_32_bits(tx_info->desc[i].src);
 		dma_ll_virt->dar_low = lower_32_bits(tx_info->desc[i].dst);
@@ -672,6 +853,9 @@ edma_xfer_status_t tegra_pcie_edma_submit_xfer(void *cookie,
 			dma_ll_virt->ctrl_reg.ctrl_e.rie = !!prv->is_remote_dma;
 			final_pcs = ch->pcs;
 		} else {
+			/* Clear LIE/RIE left over from previous use of this descriptor */
+			dma_ll_virt->ctrl_reg.ctrl_e.lie = 0;
+			dma_ll_virt->ctrl_reg.ctrl_e.rie = 0;
 			/* CB should be updated last in the descriptor */
 			dma_ll_virt->ctrl_reg.ctrl_e.cb = ch->pcs;
 		}
@@ -694,6 +878,10 @@ edma_xfer_status_t tegra_pcie_edma_submit_xfer(void *cookie,
 	ring = &ch->ring[avail];
 	ring->priv = tx_info->priv;
 	ring->complete = tx_info->complete;
+	ch->ring_meta[avail].ts = ktime_get();
+	ch->ring_meta[avail].bytes = total_bytes;
+	atomic64_inc(&ch->stats.submits);
+	atomic64_add(tx_info->nents, &ch->stats.descs);
 
 	/* Update CB post SW ring update to order callback and transfer updates */
 	dma_ll_virt->ctrl_reg.ctrl_e.cb = final_pcs;
@@ -747,6 +935,150 @@ unlock:
 }
 EXPORT_SYMBOL_GPL(tegra_pcie_edma_submit_xfer);
 
+static void edma_multi_xfer_put(struct edma_multi_xfer *mx)
+{
+	/* Callback is left to edma_multi_xfer_drain() */
+	if (atomic_dec_and_test(&mx->pending))
+		smp_store_release(&mx->done, true);
+}
+
+static void edma_multi_xfer_complete(void *priv, edma_xfer_status_t status,
+				     struct tegra_pcie_edma_desc *desc)
+{
+	struct edma_multi_xfer *mx = (struct edma_multi_xfer *)priv;
+
+	/* Report the first failure of any channel */
+	if (status != EDMA_XFER_SUCCESS)
+		(void)cmpxchg(&mx->st, EDMA_XFER_SUCCESS, status);
+
+	edma_multi_xfer_put(mx);
+}
+
+static edma_xfer_status_t edma_multi_xfer_submit(struct edma_prv *prv,
+						 struct edma_multi_xfer *mx,
+						 edma_xfer_type_t type, u32 channel_num,
+						 u32 first, u32 last)
+{
+	struct tegra_pcie_edma_xfer_info info = {0};
+	edma_xfer_status_t st;
+
+	info.type = type;
+	info.channel_num = channel_num;
+	info.desc = &mx->desc[first];
+	info.nents = last - first;
+	info.complete = edma_multi_xfer_complete;
+	info.priv = mx;
+
+	atomic_inc(&mx->pending);
+	st = tegra_pcie_edma_submit_xfer(prv, &info);
+	if (st != EDMA_XFER_SUCCESS)
+		atomic_dec(&mx->pending);
+
+	return st;
+}
+
+edma_xfer_status_t tegra_pcie_edma_submit_xfer_multi(void *cookie,
+						      struct tegra_pcie_edma_xfer_info *tx_info)
+{
+	struct edma_prv *prv = (struct edma_prv *)cookie;
+	struct edma_multi_xfer *mx;
+	struct edma_chan *chans, *ch;
+	u32 mode_cnt[2] = {DMA_WR_CHNL_NUM, DMA_RD_CHNL_NUM};
+	u32 ch_idx[DMA_WR_CHNL_NUM];
+	u32 i, n_ch = 0, c = 0, k = 0, first = 0;
+	u64 total = 0, chunk, fill = 0, off, take;
+	edma_xfer_status_t st = EDMA_XFER_SUCCESS;
+	bool submitted = false;
+
+	if (!prv || !tx_info || tx_info->nents == 0 || !tx_info->desc ||
+	    !tx_info->complete ||
+	    (tx_info->type < EDMA_XFER_WRITE || tx_info->type > EDMA_XFER_READ))
+		return EDMA_XFER_FAIL_INVAL_INPUTS;
+
+	chans = (tx_info->type == EDMA_XFER_WRITE) ? &prv->tx[0] : &prv->rx[0];
+	for (i = 0; i < mode_cnt[tx_info->type]; i++) {
+		ch = chans + i;
+		if (ch->desc_sz && ch->type == EDMA_CHAN_XFER_ASYNC &&
+		    ch->st == EDMA_XFER_SUCCESS)
+			ch_idx[n_ch++] = i;
+	}
+	if (n_ch == 0)
+		return EDMA_XFER_FAIL_INVAL_INPUTS;
+
+	for (i = 0; i < tx_info->nents; i++)
+		total += tx_info->desc[i].sz;
+	if (total == 0)
+		return EDMA_XFER_FAIL_INVAL_INPUTS;
+
+	/* Equal share of bytes per channel, small transfers use fewer channels */
+	chunk = max_t(u64, DIV_ROUND_UP_ULL(total, n_ch), EDMA_MULTI_MIN_CHUNK);
+
+	/* Splitting at chunk boundaries adds at most one descriptor per channel */
+	mx = kzalloc(struct_size(mx, desc, tx_info->nents + n_ch), GFP_KERNEL);
+	if (!mx)
+		return EDMA_XFER_FAIL_NOMEM;
+
+	atomic_set(&mx->pending, 1);
+	mx->st = EDMA_XFER_SUCCESS;
+	mx->complete = tx_info->complete;
+	mx->priv = tx_info->priv;
+
+	mutex_lock(&prv->multi_lock);
+	list_add_tail(&mx->node, &prv->multi_list);
+	mutex_unlock(&prv->multi_lock);
+
+	for (i = 0; i < tx_info->nents; i++) {
+		off = 0;
+		while (off < tx_info->desc[i].sz) {
+			take = min_t(u64, tx_info->desc[i].sz - off, chunk - fill);
+			mx->desc[k].src = tx_info->desc[i].src + off;
+			mx->desc[k].dst = tx_info->desc[i].dst + off;
+			mx->desc[k].sz = (uint32_t)take;
+			k++;
+			off += take;
+			fill += take;
+			if (fill == chunk) {
+				st = edma_multi_xfer_submit(prv, mx, tx_info->type, ch_idx[c],
+							    first, k);
+				if (st != EDMA_XFER_SUCCESS)
+					goto out;
+				submitted = true;
+				first = k;
+				fill = 0;
+				c++;
+			}
+		}
+	}
+
+	if (k > first) {
+		st = edma_multi_xfer_submit(prv, mx, tx_info->type, ch_idx[c], first, k);
+		if (st == EDMA_XFER_SUCCESS)
+			submitted = true;
+	}
+
+out:
+	/* Nothing in flight, fail the call without invoking the callback */
+	if (!submitted) {
+		mutex_lock(&prv->multi_lock);
+		list_del(&mx->node);
+		mutex_unlock(&prv->multi_lock);
+		kfree(mx);
+		/* Later xfers may have been held back behind this one */
+		edma_multi_xfer_drain(prv);
+		return st;
+	}
+
+	/* Slices in flight carry the failure to the single completion callback */
+	if (st != EDMA_XFER_SUCCESS)
+		(void)cmpxchg(&mx->st, EDMA_XFER_SUCCESS, st);
+	edma_multi_xfer_put(mx);
+	/* All slices may already have been retired by the IRQ thread */
+	edma_multi_xfer_drain(prv);
+
+	return EDMA_XFER_SUCCESS;
+}
+EXPORT_SYMBOL_GPL(tegra_pcie_edma_submit_xfer_multi);
+
 static void edma_stop(struct edma_prv *prv, edma_xfer_status_t st)
 {
 	struct edma_chan *chan[2], *ch;
@@ -784,6 +1116,10 @@ static void edma_stop(struct edma_prv *prv, edma_xfer_status_t st)
 				process_r_idx(ch, st, ch->w_idx);
 		}
 	}
+
+	edma_multi_xfer_drain(prv);
+	/* a submitter may still be delivering callbacks */
+	wait_event(prv->multi_wq, !READ_ONCE(prv->multi_draining));
 }
 
 bool tegra_pcie_edma_stop(void *cookie)
@@ -810,6 +1146,7 @@ void tegra_pcie_edma_deinit(void *cookie)
 
 	edma_stop(prv, EDMA_XFER_DEINIT);
 
+	debugfs_remove_recursive(prv->debugfs);
 	free_irq(prv->irq, prv);
 	kfree(prv->irq_name);
 
@@ -825,6 +1162,7 @@ void tegra_pcie_edma_deinit(void *cookie)
 				dma_free_coherent(prv->dev, ch->edma_desc_size,
 						  ch->desc, ch->dma_iova);
 			kfree(ch->ring);
+			kfree(ch->ring_meta);
 		}
 	}
 
@@ -9,6 +9,7 @@
 #include <dce-client-ipc-internal.h>
 
 #define DCE_IPC_HANDLES_MAX 6U
+#define DCE_CLIENT_IPC_BATCH_MAX 8U
 #define DCE_CLIENT_IPC_HANDLE_INVALID 0U
 #define DCE_CLIENT_IPC_HANDLE_VALID ((u32)BIT(31))
 
@@ -22,6 +23,8 @@ static uint32_t dce_interface_type_map[DCE_CLIENT_IPC_TYPE_MAX] = {
 
 static void dce_client_process_event_ipc(struct tegra_dce *d,
 					 struct tegra_dce_client_ipc *cl);
+static void dce_client_ipc_req_work(struct work_struct *work);
+static void dce_client_ipc_cancel_reqs(struct tegra_dce_client_ipc *cl);
 
 static inline uint32_t dce_client_get_type(uint32_t int_type)
 {
@@ -177,11 +180,23 @@ int tegra_dce_register_ipc_client(u32 type,
 	cl->int_type = int_type;
 	cl->callback_fn = callback_fn;
 	atomic_set(&cl->complete, 0);
+	spin_lock_init(&cl->req_lock);
+	INIT_LIST_HEAD(&cl->req_list);
+	INIT_WORK(&cl->req_work, dce_client_ipc_req_work);
+	cl->next_seq = 0U;
+
+	ret = dce_mutex_init(&cl->rpc_lock);
+	if (ret) {
+		dce_err(d, "dce lock initialization failed for int_type: [%u]",
+			int_type);
+		goto out;
+	}
 
 	ret = dce_cond_init(&cl->recv_wait);
 	if (ret) {
 		dce_err(d, "dce condition initialization failed for int_type: [%u]",
 			int_type);
+		dce_mutex_destroy(&cl->rpc_lock);
 		goto out;
 	}
 
@@ -208,15 +223,76 @@ int tegra_dce_unregister_ipc_client(u32 handle)
 		return -EINVAL;
 	}
 
+	if (cl->valid) {
+		cancel_work_sync(&cl->req_work);
+		dce_client_ipc_cancel_reqs(cl);
+		dce_mutex_destroy(&cl->rpc_lock);
+	}
+
 	dce_cond_destroy(&cl->recv_wait);
 
 	return dce_client_ipc_handle_free(handle);
 }
 EXPORT_SYMBOL(tegra_dce_unregister_ipc_client);
 
+/*
+ * dce_client_ipc_xfer - Sends up to @count rpcs with one notification and
+ *			receives their responses.
+ *
+ * DCE answers rpcs on a channel in order and the response frames carry
+ * no tag, so responses are matched to @msgs in FIFO order. Responses
+ * may be signalled together, so drain everything readable after each
+ * wakeup rather than expecting one wakeup per response.
+ *
+ * Must be called with cl->rpc_lock held.
+ *
+ * Return : number of rpcs completed, or error if none could be sent.
+ */
+static int dce_client_ipc_xfer(struct tegra_dce_client_ipc *cl,
+			       struct dce_ipc_message **msgs, u32 count,
+			       int *status)
+{
+	struct tegra_dce *d = cl->d;
+	int sent;
+	int ret = 0;
+	int i = 0;
+
+	sent = dce_ipc_send_messages(d, cl->int_type, msgs, count);
+	if (sent < 0) {
+		dce_err(d, "Error in sending message to DCE");
+		return sent;
+	}
+
+	while (i < sent) {
+		if (!dce_ipc_is_data_available(d, cl->int_type)) {
+			ret = dce_ipc_wait_rpc(d, cl->int_type);
+			if (ret) {
+				dce_err(d, "Error in waiting for ack");
+				break;
+			}
+			continue;
+		}
+
+		status[i] = dce_ipc_read_message(d, cl->int_type,
+						 msgs[i]->rx.data,
+						 msgs[i]->rx.size);
+		if (status[i])
+			dce_err(d, "Error in reading DCE msg for ch_type [%d]",
+				cl->int_type);
+		i++;
+	}
+
+	/* responses that will not arrive fail with the wait error */
+	for (; i < sent; i++)
+		status[i] = ret;
+
+	return sent;
+}
+
 int tegra_dce_client_ipc_send_recv(u32 handle, struct dce_ipc_message *msg)
 {
 	int ret;
+	int status = 0;
 	struct tegra_dce_client_ipc *cl;
 
 	if (msg == NULL) {
@@ -230,13 +306,170 @@ int tegra_dce_client_ipc_send_recv(u32 handle, struct dce_ipc_message *msg)
 		goto out;
 	}
 
-	ret = dce_ipc_send_message_sync(cl->d, cl->int_type, msg);
+	dce_mutex_lock(&cl->rpc_lock);
+	ret = dce_client_ipc_xfer(cl, &msg, 1U, &status);
+	dce_mutex_unlock(&cl->rpc_lock);
+	if (ret > 0)
+		ret = status;
 
 out:
 	return ret;
 }
 EXPORT_SYMBOL(tegra_dce_client_ipc_send_recv);
 
+static void dce_client_ipc_complete_req(struct tegra_dce_client_ipc *cl,
+					struct dce_client_ipc_req *req,
+					int status)
+{
+	if (req->cb)
+		req->cb(cl->handle, req->seq, status, req->msg, req->usr_ctx);
+	dce_kfree(cl->d, req);
+}
+
+static void dce_client_ipc_cancel_reqs(struct tegra_dce_client_ipc *cl)
+{
+	struct dce_client_ipc_req *req, *tmp;
+	unsigned long flags;
+	LIST_HEAD(reqs);
+
+	spin_lock_irqsave(&cl->req_lock, flags);
+	list_splice_init(&cl->req_list, &reqs);
+	spin_unlock_irqrestore(&cl->req_lock, flags);
+
+	list_for_each_entry_safe(req, tmp, &reqs, node) {
+		list_del(&req->node);
+		dce_client_ipc_complete_req(cl, req, -ECANCELED);
+	}
+}
+
+static void dce_client_ipc_req_work(struct work_struct *work)
+{
+	struct tegra_dce_client_ipc *cl = container_of(work,
+			struct tegra_dce_client_ipc, req_work);
+	struct dce_client_ipc_req *reqs[DCE_CLIENT_IPC_BATCH_MAX];
+	struct dce_ipc_message *msgs[DCE_CLIENT_IPC_BATCH_MAX];
+	int status[DCE_CLIENT_IPC_BATCH_MAX];
+	struct dce_ipc_queue_info q_info;
+	unsigned long flags;
+	u32 batch_max;
+	u32 n, i;
+	int ret;
+
+	batch_max = DCE_CLIENT_IPC_BATCH_MAX;
+	if (!dce_ipc_get_channel_info(cl->d, &q_info, cl->int_type))
+		batch_max = clamp_t(u32, q_info.nframes, 1U,
+				    DCE_CLIENT_IPC_BATCH_MAX);
+
+	do {
+		n = 0;
+		spin_lock_irqsave(&cl->req_lock, flags);
+		while (n < batch_max && !list_empty(&cl->req_list)) {
+			reqs[n] = list_first_entry(&cl->req_list,
+					struct dce_client_ipc_req, node);
+			list_del(&reqs[n]->node);
+			msgs[n] = reqs[n]->msg;
+			n++;
+		}
+		spin_unlock_irqrestore(&cl->req_lock, flags);
+
+		if (n == 0)
+			break;
+
+		for (i = 0; i < n; i++)
+			status[i] = 0;
+
+		dce_mutex_lock(&cl->rpc_lock);
+		ret = dce_client_ipc_xfer(cl, msgs, n, status);
+		dce_mutex_unlock(&cl->rpc_lock);
+		if (ret < 0)
+			ret = 0;
+
+		/* requests that did not fit in the channel go back in front */
+		spin_lock_irqsave(&cl->req_lock, flags);
+		for (i = n; i > (u32)ret; i--)
+			list_add(&reqs[i - 1]->node, &cl->req_list);
+		spin_unlock_irqrestore(&cl->req_lock, flags);
+
+		for (i = 0; i < (u32)ret; i++)
+			dce_client_ipc_complete_req(cl, reqs[i], status[i]);
+
+		if (ret == 0) {
+			/* channel is unusable, fail what is queued */
+			dce_client_ipc_cancel_reqs(cl);
+			break;
+		}
+	} while (true);
+}
+
+int tegra_dce_client_ipc_send_batch(u32 handle, struct dce_ipc_message **msgs,
+		u32 count, tegra_dce_client_ipc_async_cb_t cb, void *usr_ctx,
+		u32 *seqp)
+{
+	struct tegra_dce_client_ipc *cl;
+	struct dce_client_ipc_req *req, *tmp;
+	unsigned long flags;
+	LIST_HEAD(reqs);
+	int ret = 0;
+	u32 i;
+
+	if (msgs == NULL || count == 0U)
+		return -EINVAL;
+
+	cl = dce_client_ipc_lookup_handle(handle);
+	if (cl == NULL || cl->valid == false)
+		return -EINVAL;
+
+	/* events are pushed by DCE, there is nothing to request */
+	if (cl->type == DCE_CLIENT_IPC_TYPE_RM_EVENT)
+		return -EINVAL;
+
+	for (i = 0; i < count; i++) {
+		if (msgs[i] == NULL) {
+			ret = -EINVAL;
+			goto err_free;
+		}
+
+		req = dce_kzalloc(cl->d, sizeof(*req), false);
+		if (req == NULL) {
+			ret = -ENOMEM;
+			goto err_free;
+		}
+
+		req->msg = msgs[i];
+		req->cb = cb;
+		req->usr_ctx = usr_ctx;
+		list_add_tail(&req->node, &reqs);
+	}
+
+	spin_lock_irqsave(&cl->req_lock, flags);
+	if (seqp != NULL)
+		*seqp = cl->next_seq;
+	list_for_each_entry(req, &reqs, node)
+		req->seq = cl->next_seq++;
+	list_splice_tail(&reqs, &cl->req_list);
+	spin_unlock_irqrestore(&cl->req_lock, flags);
+
+	queue_work(cl->d->d_async_ipc.async_rpc_wq, &cl->req_work);
+
+	return 0;
+
+err_free:
+	list_for_each_entry_safe(req, tmp, &reqs, node) {
+		list_del(&req->node);
+		dce_kfree(cl->d, req);
+	}
+	return ret;
+}
+EXPORT_SYMBOL(tegra_dce_client_ipc_send_batch);
+
+int tegra_dce_client_ipc_send_async(u32 handle, struct dce_ipc_message *msg,
+		tegra_dce_client_ipc_async_cb_t cb, void *usr_ctx, u32 *seqp)
+{
+	return tegra_dce_client_ipc_send_batch(handle, &msg, 1U, cb, usr_ctx,
+					       seqp);
+}
+EXPORT_SYMBOL(tegra_dce_client_ipc_send_async);
+
 int dce_client_init(struct tegra_dce *d)
 {
 	int ret = 0;
@@ -245,6 +478,15 @@ int dce_client_init(struct tegra_dce *d)
 
 	d_aipc->async_event_wq =
 		create_singlethread_workqueue("dce-async-ipc-wq");
+	if (d_aipc->async_event_wq == NULL)
+		return -ENOMEM;
+
+	d_aipc->async_rpc_wq =
+		alloc_ordered_workqueue("dce-async-rpc-wq", 0);
+	if (d_aipc->async_rpc_wq == NULL) {
+		destroy_workqueue(d_aipc->async_event_wq);
+		return -ENOMEM;
+	}
 
 	for (i = 0; i < DCE_MAX_ASYNC_WORK; i++) {
 		struct dce_async_work *d_work = &d_aipc->work[i];
@@ -264,6 +506,7 @@ void dce_client_deinit(struct tegra_dce *d)
 
 	flush_workqueue(d_aipc->async_event_wq);
 	destroy_workqueue(d_aipc->async_event_wq);
+	destroy_workqueue(d_aipc->async_rpc_wq);
 }
 
 int dce_client_ipc_wait(struct tegra_dce *d, u32 int_type)
@@ -624,6 +624,56 @@ out:
 	return ret;
 }
 
+/**
+ * dce_ipc_send_messages - Sends a batch of messages over ipc and
+ *				notifies DCE once for the whole batch.
+ *
+ * @d : Pointer to tegra_dce struct.
+ * @ch_type : Channel Id.
+ * @msgs : Messages to be written, in order.
+ * @count : Number of messages in @msgs.
+ *
+ * Writes as many of @msgs as there are free frames in the channel.
+ *
+ * Return : number of messages written if any, error code otherwise.
+ */
+int dce_ipc_send_messages(struct tegra_dce *d, u32 ch_type,
+		struct dce_ipc_message **msgs, u32 count)
+{
+	int ret = 0;
+	u32 i;
+	struct dce_ipc_channel *ch = d->d_ipc.ch[ch_type];
+
+	dce_mutex_lock(&ch->lock);
+
+	trace_ivc_send_req_received(d, ch);
+
+	for (i = 0; i < count; i++) {
+		ret = _dce_ipc_get_next_write_buff(ch);
+		if (ret)
+			break;
+
+		ret = _dce_ipc_write_channel(ch, msgs[i]->tx.data,
+					     msgs[i]->tx.size);
+		if (ret) {
+			dce_err(ch->d, "Error writing to channel");
+			break;
+		}
+	}
+
+	if (i > 0) {
+		ch->signal.notify(d, &ch->signal.to_d);
+		trace_ivc_send_complete(d, ch);
+		ret = (int)i;
+	} else {
+		dce_err(ch->d, "Error getting next free buf to write");
+	}
+
+	dce_mutex_unlock(&ch->lock);
+
+	return ret;
+}
+
 /**
  * dce_ipc_get_next_read_buff - waits for the next write frame.
  *
@@ -736,6 +786,29 @@ out:
 	return ret;
 }
 
+/**
+ * dce_ipc_wait_rpc - Waits for DCE to signal a response on a channel.
+ *
+ * @d : Pointer to tegra_dce struct.
+ * @ch_type : Channel Id.
+ *
+ * Return : 0 if successful
+ */
+int dce_ipc_wait_rpc(struct tegra_dce *d, u32 ch_type)
+{
+	int ret;
+	struct dce_ipc_channel *ch = d->d_ipc.ch[ch_type];
+
+	dce_mutex_lock(&ch->lock);
+	ret = _dce_ipc_wait(d, DCE_IPC_WAIT_TYPE_RPC, ch_type);
+	dce_mutex_unlock(&ch->lock);
+
+	if (ret == 0)
+		trace_ivc_wait_complete(d, ch);
+
+	return ret;
+}
+
 /**
  * dce_ipc_send_message_sync - Sends messages on a channel
  *				synchronously and waits for an ack.
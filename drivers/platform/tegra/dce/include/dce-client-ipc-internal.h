@@ -6,7 +6,11 @@
 #ifndef DCE_CLIENT_IPC_INTERNAL_H
 #define DCE_CLIENT_IPC_INTERNAL_H
 
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 #include <linux/platform/tegra/dce/dce-client-ipc.h>
+#include <dce-lock.h>
 
 /**
  * struct tegra_dce_client_ipc - Data Structure to hold client specific ipc
@@ -24,6 +28,11 @@
  * @complete : atomic variable used for IPC synchronization
  * @callback_fn : function pointer to the callback function passed by the
  *                client during registration
+ * @rpc_lock : serializes rpcs on the channel, sync and async alike
+ * @req_lock : protects @req_list and @next_seq
+ * @req_list : async rpcs waiting to be sent
+ * @req_work : sends queued async rpcs
+ * @next_seq : sequence tag of the next submitted rpc
  */
 struct tegra_dce_client_ipc {
 	bool valid;
@@ -35,6 +44,28 @@ struct tegra_dce_client_ipc {
 	struct dce_cond recv_wait;
 	atomic_t complete;
 	tegra_dce_client_ipc_callback_t callback_fn;
+	struct dce_mutex rpc_lock;
+	spinlock_t req_lock;
+	struct list_head req_list;
+	struct work_struct req_work;
+	uint32_t next_seq;
+};
+
+/**
+ * struct dce_client_ipc_req - An async rpc queued on a client
+ *
+ * @node : entry in tegra_dce_client_ipc.req_list
+ * @msg : message to send and receive the response in
+ * @seq : sequence tag
+ * @cb : completion callback
+ * @usr_ctx : context for @cb
+ */
+struct dce_client_ipc_req {
+	struct list_head node;
+	struct dce_ipc_message *msg;
+	uint32_t seq;
+	tegra_dce_client_ipc_async_cb_t cb;
+	void *usr_ctx;
 };
 
 #define DCE_MAX_ASYNC_WORK	8
@@ -46,9 +77,11 @@ struct dce_async_work {
 
 /**
  * @async_event_wq - Workqueue to process async events from DCE
+ * @async_rpc_wq - Ordered workqueue to send async rpcs to DCE
  */
 struct tegra_dce_async_ipc_info {
 	struct workqueue_struct *async_event_wq;
+	struct workqueue_struct *async_rpc_wq;
 	struct dce_async_work work[DCE_MAX_ASYNC_WORK];
 };
 
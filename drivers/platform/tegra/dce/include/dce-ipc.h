@@ -156,6 +156,11 @@ int dce_ipc_read_message(struct tegra_dce *d,
 int dce_ipc_send_message_sync(struct tegra_dce *d,
 		u32 ch_type, struct dce_ipc_message *msg);
 
+int dce_ipc_send_messages(struct tegra_dce *d, u32 ch_type,
+		struct dce_ipc_message **msgs, u32 count);
+
+int dce_ipc_wait_rpc(struct tegra_dce *d, u32 ch_type);
+
 int dce_ipc_get_channel_info(struct tegra_dce *d,
 		struct dce_ipc_queue_info *q_info, u32 ch_index);
 
@@ -381,6 +381,33 @@ int tegra_mce_write_uncore_perfmon(u32 req, u32 data)
 }
 EXPORT_SYMBOL_GPL(tegra_mce_write_uncore_perfmon);
 
+/**
+ * Query PMU for several uncore perfmon registers in one call
+ *
+ * @req input commands and counter indices
+ * @data output register values
+ * @count number of entries in @req and @data
+ *
+ * Returns status of the first failing read request, or 0.
+ */
+int tegra_mce_read_uncore_perfmon_batch(const u32 *req, u32 *data, u32 count)
+{
+	u32 i;
+	int ret;
+
+	if (mce_ops && mce_ops->read_uncore_perfmon_batch)
+		return mce_ops->read_uncore_perfmon_batch(req, data, count);
+
+	for (i = 0; i < count; i++) {
+		ret = tegra_mce_read_uncore_perfmon(req[i], &data[i]);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(tegra_mce_read_uncore_perfmon_batch);
+
 int tegra_mce_enable_latic(void)
 {
 	if (mce_ops && mce_ops->enable_latic)
@@ -258,6 +258,55 @@ static int tegra23x_mce_read_uncore_perfmon(u32 req, u32 *data)
 	return 0;
 }
 
+/*
+ * Read a set of uncore perfmon registers back to back. The ARI mailbox
+ * carries one register per request, but all of them are issued from the
+ * same core's ARI aperture without leaving the preempt disabled section,
+ * so the values are sampled as close together as the firmware allows.
+ */
+static int tegra23x_mce_read_uncore_perfmon_batch(const u32 *req, u32 *data,
+		u32 count)
+{
+	void __iomem *ari_base;
+	int32_t cpu_idx;
+	u32 out_lo;
+	int32_t ret = 0;
+	u32 i;
+
+	if (IS_ERR_OR_NULL(req) || IS_ERR_OR_NULL(data))
+		return -EINVAL;
+
+	preempt_disable();
+
+	cpu_idx = get_ari_address_index();
+	if (cpu_idx < 0) {
+		ret = cpu_idx;
+		goto out;
+	}
+	ari_base = ari_bar_array[cpu_idx];
+
+	for (i = 0; i < count; i++) {
+		ret = ari_send_request(ari_base, 0U,
+				(u32)TEGRA_ARI_PERFMON, req[i], 0U);
+		if (ret)
+			goto out;
+
+		out_lo = ari_get_response_low(ari_base);
+		if (out_lo != 0) {
+			pr_debug("%s: read %u status = %u\n", __func__, i, out_lo);
+			ret = -out_lo;
+			goto out;
+		}
+
+		data[i] = ari_get_response_high(ari_base);
+	}
+
+out:
+	preempt_enable();
+
+	return ret;
+}
+
 static int tegra23x_mce_write_uncore_perfmon(u32 req, u32 data)
 {
 	int32_t cpu_idx;
@@ -542,6 +591,7 @@ static struct tegra_mce_ops t23x_mce_ops = {
 	.echo_data = tegra23x_mce_echo_data,
 	.read_uncore_perfmon = tegra23x_mce_read_uncore_perfmon,
 	.write_uncore_perfmon = tegra23x_mce_write_uncore_perfmon,
+	.read_uncore_perfmon_batch = tegra23x_mce_read_uncore_perfmon_batch,
 	.read_cstate_stats = tegra23x_mce_read_cstate_stats,
 };
 
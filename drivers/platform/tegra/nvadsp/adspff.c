@@ -26,6 +26,9 @@
 #include <linux/debugfs.h>
 #include <linux/platform_device.h>
 #include <linux/list.h>
+#include <linux/kfifo.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
 
 #include <linux/tegra_nvadsp.h>
 #include <uapi/linux/sched/types.h>
@@ -35,6 +38,12 @@
 
 
 #define ADSPFF_MAX_OPEN_FILES	(32)
+#define ADSPFF_MSGQ_DEPTH	(64)
+/* write-behind buffer per file, and how long data may sit in it */
+#define ADSPFF_WB_SIZE		(64 * 1024)
+#define ADSPFF_WB_DELAY		msecs_to_jiffies(20)
+/* upper bound of data read ahead into the shared read buffer */
+#define ADSPFF_READAHEAD_MAX	(32 * 1024)
 
 struct file_struct {
 	struct file *fp;
@@ -42,13 +51,46 @@ struct file_struct {
 	unsigned int flags;
 	unsigned long long wr_offset;
 	unsigned long long rd_offset;
+	uint8_t *wb_buf;	/* ADSP writes not yet written to fp */
+	uint32_t wb_len;
+	int wb_err;		/* first failed write-behind, not yet reported */
 	struct list_head list;
 };
 
+/*
+ * Data read ahead for @file at @offset, placed in the free part of the
+ * shared read buffer starting at @wi, where the next read reply will go.
+ */
+struct adspff_readahead {
+	struct file_struct *file;
+	unsigned long long offset;
+	uint32_t wi;
+	uint32_t len;
+	uint32_t window;
+	bool pending;
+};
+
+struct adspff_stats {
+	uint64_t nr_msgs;
+	uint64_t nr_reads;
+	uint64_t nr_writes;
+	uint64_t read_bytes;
+	uint64_t write_bytes;
+	uint64_t ra_hit_bytes;
+	uint64_t wb_flushes;
+	uint64_t lat_total_ns;
+	uint64_t lat_max_ns;
+};
+
 static struct list_head file_list;
 static spinlock_t adspff_lock;
 static int open_count;
 
+static struct adspff_readahead adspff_ra;
+static struct adspff_stats adspff_stats;
+static bool adspff_wb_pending;
+static unsigned long adspff_wb_deadline;
+
 /******************************************************************************
 * Kernel file functions
 ******************************************************************************/
@@ -76,7 +118,7 @@ static void file_close(struct file *file)
 }
 
 static int file_write(struct file *file, unsigned long long *offset,
-				unsigned char *data, unsigned int size)
+				const unsigned char *data, unsigned int size)
 {
 	mm_segment_t oldfs;
 	int ret = 0;
@@ -90,11 +132,11 @@ static int file_write(struct file *file, unsigned long long *offset,
 	return ret;
 }
 
-static uint32_t file_read(struct file *file, unsigned long long *offset,
+static ssize_t file_read(struct file *file, unsigned long long *offset,
 				unsigned char *data, unsigned int size)
 {
 	mm_segment_t oldfs;
-	uint32_t ret = 0;
+	ssize_t ret = 0;
 
 	oldfs = get_fs();
 	set_fs(KERNEL_DS);
@@ -130,6 +172,204 @@ static uint32_t file_size(struct file *file)
 static struct adspff_shared_state_t *adspff;
 static struct nvadsp_mbox rx_mbox;
 
+/* messages are handled one at a time by the adspff kthread */
+static union adspff_message_t adspff_req;
+static union adspff_message_t adspff_ack;
+
+static inline void adspff_prepare_msgs(uint32_t req_size, uint32_t ack_size)
+{
+	memset(&adspff_req, 0, sizeof(adspff_req));
+	memset(&adspff_ack, 0, sizeof(adspff_ack));
+	adspff_req.msgq_msg.size = req_size;
+	adspff_ack.msgq_msg.size = ack_size;
+}
+
+static inline uint32_t adspff_read_buf_free(uint32_t wi, uint32_t ri)
+{
+	if (ri <= wi)
+		return ADSPFF_SHARED_BUFFER_SIZE - wi + ri - 1;
+
+	return ri - wi - 1;
+}
+
+/* read @size bytes of @file into the shared read buffer at @wi */
+static uint32_t adspff_read_to_ring(struct file_struct *file,
+	unsigned long long *offset, uint32_t wi, uint32_t size)
+{
+	uint32_t first = min_t(uint32_t, size, ADSPFF_SHARED_BUFFER_SIZE - wi);
+	uint32_t done;
+	ssize_t ret;
+
+	ret = file_read(file->fp, offset, adspff->read_buf.data + wi, first);
+	if (ret <= 0)
+		return 0;
+	done = ret;
+	if (done < first || size == first)
+		return done;
+
+	ret = file_read(file->fp, offset, adspff->read_buf.data, size - first);
+	if (ret > 0)
+		done += ret;
+
+	return done;
+}
+
+static void adspff_ra_invalidate(struct file_struct *file)
+{
+	if (file && adspff_ra.file != file)
+		return;
+
+	memset(&adspff_ra, 0, sizeof(adspff_ra));
+}
+
+/* take read-ahead data for a read of @file at ring position @wi */
+static uint32_t adspff_ra_consume(struct file_struct *file, uint32_t wi,
+	uint32_t size)
+{
+	struct adspff_readahead *ra = &adspff_ra;
+	uint32_t len;
+
+	if (ra->file != file || ra->wi != wi ||
+			ra->offset != file->rd_offset || !ra->len) {
+		adspff_ra_invalidate(NULL);
+		return 0;
+	}
+
+	len = min(size, ra->len);
+	file->rd_offset += len;
+	ra->offset += len;
+	ra->wi = (ra->wi + len) % ADSPFF_SHARED_BUFFER_SIZE;
+	ra->len -= len;
+	adspff_stats.ra_hit_bytes += len;
+
+	return len;
+}
+
+/* schedule read-ahead of the data following a read of @size bytes */
+static void adspff_ra_arm(struct file_struct *file, uint32_t wi,
+	uint32_t size)
+{
+	struct adspff_readahead *ra = &adspff_ra;
+
+	if (ra->file != file || ra->wi != wi ||
+			ra->offset != file->rd_offset) {
+		ra->file = file;
+		ra->wi = wi;
+		ra->offset = file->rd_offset;
+		ra->len = 0;
+	}
+	ra->window = min_t(uint32_t, 2 * size, ADSPFF_READAHEAD_MAX);
+	ra->pending = true;
+}
+
+/* fill the read-ahead window while the ADSP consumes the last reply */
+static void adspff_readahead(void)
+{
+	struct adspff_readahead *ra = &adspff_ra;
+	uint32_t wi = adspff->read_buf.write_index;
+	uint32_t ri = adspff->read_buf.read_index;
+	unsigned long long offset;
+	uint32_t want;
+
+	ra->pending = false;
+	if (!ra->file || !ra->file->fp || ra->wi != wi) {
+		adspff_ra_invalidate(NULL);
+		return;
+	}
+
+	want = min(ra->window, adspff_read_buf_free(wi, ri));
+	if (ra->len >= want)
+		return;
+
+	offset = ra->offset + ra->len;
+	ra->len += adspff_read_to_ring(ra->file, &offset,
+			(wi + ra->len) % ADSPFF_SHARED_BUFFER_SIZE,
+			want - ra->len);
+}
+
+/*
+ * The ADSP was told the buffered data was written when it was buffered,
+ * so a failure is latched and reported on its next call for the file.
+ */
+static void adspff_wb_flush(struct file_struct *file)
+{
+	int ret;
+
+	if (!file->wb_len)
+		return;
+
+	ret = file_write(file->fp, &file->wr_offset, file->wb_buf,
+			file->wb_len);
+	if (ret != file->wb_len) {
+		pr_err("write-behind to %s failed %d\n", file->file_name, ret);
+		if (!file->wb_err)
+			file->wb_err = ret < 0 ? ret : -EIO;
+	}
+
+	file->wb_len = 0;
+	adspff_stats.wb_flushes++;
+}
+
+static void adspff_wb_flush_all(void)
+{
+	struct file_struct *file;
+
+	list_for_each_entry(file, &file_list, list) {
+		if (file->fp)
+			adspff_wb_flush(file);
+	}
+	adspff_wb_pending = false;
+}
+
+/*
+ * Take @size bytes written by the ADSP out of the shared write buffer.
+ * Writes are coalesced per file and reach the file when the buffer
+ * fills, or after ADSPFF_WB_DELAY. They are always flushed before an
+ * fread, fsize or fclose of the file is handled, so any request the
+ * ADSP issues after its writes sees them in the file.
+ */
+static uint32_t adspff_write_behind(struct file_struct *file, uint32_t size)
+{
+	uint32_t ri = adspff->write_buf.read_index;
+	uint32_t first = min_t(uint32_t, size, ADSPFF_SHARED_BUFFER_SIZE - ri);
+	uint32_t written = 0;
+	int ret;
+
+	if (!file->wb_buf && size <= ADSPFF_WB_SIZE)
+		file->wb_buf = kmalloc(ADSPFF_WB_SIZE, GFP_KERNEL);
+
+	if (!file->wb_buf || size > ADSPFF_WB_SIZE) {
+		/* write through */
+		adspff_wb_flush(file);
+		ret = file_write(file->fp, &file->wr_offset,
+				adspff->write_buf.data + ri, first);
+		if (ret > 0)
+			written = ret;
+		if (ret == first && size > first) {
+			ret = file_write(file->fp, &file->wr_offset,
+					adspff->write_buf.data, size - first);
+			if (ret > 0)
+				written += ret;
+		}
+		return written;
+	}
+
+	if (file->wb_len + size > ADSPFF_WB_SIZE)
+		adspff_wb_flush(file);
+
+	memcpy(file->wb_buf + file->wb_len, adspff->write_buf.data + ri, first);
+	memcpy(file->wb_buf + file->wb_len + first, adspff->write_buf.data,
+			size - first);
+	file->wb_len += size;
+
+	if (!adspff_wb_pending) {
+		adspff_wb_pending = true;
+		adspff_wb_deadline = jiffies + ADSPFF_WB_DELAY;
+	}
+
+	return size;
+}
+
 /**																*
  * w  - open for writing (file need not exist)					*
  * a  - open for appending (file need not exist)				*
@@ -196,6 +436,8 @@ static struct file_struct *check_file_opened(const char *path)
 		file = NULL;
 	} else {
 		file = kzalloc(sizeof(*file), GFP_KERNEL);
+		if (!file)
+			return NULL;
 		open_count++;
 		list_add_tail(&file->list, &file_list);
 	}
@@ -204,33 +446,20 @@ static struct file_struct *check_file_opened(const char *path)
 
 static void adspff_fopen(void)
 {
-	union adspff_message_t *message;
-	union adspff_message_t *msg_recv;
+	union adspff_message_t *message = &adspff_req;
+	union adspff_message_t *msg_recv = &adspff_ack;
 	unsigned int flags = 0;
 	int ret = 0;
 	struct file_struct *file;
 
-
-	message = kzalloc(sizeof(union adspff_message_t), GFP_KERNEL);
-	if (!message)
-		return;
-
-
-	msg_recv = kzalloc(sizeof(union adspff_message_t), GFP_KERNEL);
-	if (!msg_recv) {
-		kfree(message);
-		return;
-	}
-
-	message->msgq_msg.size = MSGQ_MSG_SIZE(struct fopen_msg_t);
+	adspff_prepare_msgs(MSGQ_MSG_SIZE(struct fopen_msg_t),
+			MSGQ_MSG_SIZE(struct fopen_recv_msg_t));
 
 	ret = msgq_dequeue_message(&adspff->msgq_send.msgq,
 			(msgq_message_t *)message);
 
 	if (ret < 0) {
 		pr_err("fopen Dequeue failed %d.", ret);
-		kfree(message);
-		kfree(msg_recv);
 		return;
 	}
 
@@ -259,7 +488,6 @@ static void adspff_fopen(void)
 			(const char *) message->msg.payload.fopen_msg.fname);
 	}
 
-	msg_recv->msgq_msg.size = MSGQ_MSG_SIZE(struct fopen_recv_msg_t);
 	msg_recv->msg.payload.fopen_recv_msg.file = (int64_t)file;
 
 	ret = msgq_queue_message(&adspff->msgq_recv.msgq,
@@ -271,16 +499,11 @@ static void adspff_fopen(void)
 			file_close(file->fp);
 			file->fp = NULL;
 		}
-
-		kfree(message);
-		kfree(msg_recv);
 		return;
 	}
 
 	nvadsp_mbox_send(&rx_mbox, adspff_cmd_fopen_recv,
 				NVADSP_MBOX_SMSG, 0, 0);
-	kfree(message);
-	kfree(msg_recv);
 }
 
 static inline unsigned int is_read_file(struct file_struct *file)
@@ -295,27 +518,32 @@ static inline unsigned int is_write_file(struct file_struct *file)
 
 static void adspff_fclose(void)
 {
-	union adspff_message_t *message;
+	union adspff_message_t *message = &adspff_req;
 	struct file_struct *file = NULL;
 	int32_t ret = 0;
 
-	message = kzalloc(sizeof(union adspff_message_t), GFP_KERNEL);
-	if (!message)
-		return;
-
-	message->msgq_msg.size = MSGQ_MSG_SIZE(struct fclose_msg_t);
+	adspff_prepare_msgs(MSGQ_MSG_SIZE(struct fclose_msg_t), 0);
 
 	ret = msgq_dequeue_message(&adspff->msgq_send.msgq,
 				(msgq_message_t *)message);
 
 	if (ret < 0) {
 		pr_err("fclose Dequeue failed %d.", ret);
-		kfree(message);
 		return;
 	}
 
 	file = (struct file_struct *)message->msg.payload.fclose_msg.file;
 	if (file) {
+		/*
+		 * fclose has no reply, an error of the final flush stays
+		 * latched and fails the next fwrite or fsize of the file.
+		 */
+		if (file->fp)
+			adspff_wb_flush(file);
+		if (file->wb_err)
+			pr_err("fclose of %s lost data: %d\n", file->file_name,
+				file->wb_err);
+		adspff_ra_invalidate(file);
 		if ((file->flags & O_APPEND) == 0) {
 			if (is_read_file(file))
 				file->rd_offset = 0;
@@ -323,32 +551,41 @@ static void adspff_fclose(void)
 				file->wr_offset = 0;
 		}
 	}
-	kfree(message);
 }
 
 static void adspff_fsize(void)
 {
-	union adspff_message_t *msg_recv;
-	union adspff_message_t message;
+	union adspff_message_t *message = &adspff_req;
+	union adspff_message_t *msg_recv = &adspff_ack;
 	struct file_struct *file = NULL;
 	int32_t ret = 0;
-	uint32_t size = 0;
+	int32_t size = 0;
 
-	msg_recv = kzalloc(sizeof(union adspff_message_t), GFP_KERNEL);
-	msg_recv->msgq_msg.size = MSGQ_MSG_SIZE(struct ack_msg_t);
+	adspff_prepare_msgs(MSGQ_MSG_SIZE(struct fsize_msg_t),
+			MSGQ_MSG_SIZE(struct ack_msg_t));
 
-	message.msgq_msg.size = MSGQ_MSG_SIZE(struct fsize_msg_t);
 	ret = msgq_dequeue_message(&adspff->msgq_send.msgq,
-				(msgq_message_t *)&message);
+				(msgq_message_t *)message);
 
 	if (ret < 0) {
 		pr_err("fsize Dequeue failed %d.", ret);
-		kfree(msg_recv);
 		return;
 	}
-	file = (struct file_struct *)message.msg.payload.fsize_msg.file;
-	if (file) {
-		size = file_size(file->fp);
+	file = (struct file_struct *)message->msg.payload.fsize_msg.file;
+	if (file && file->fp) {
+		/* size must account for writes still held back */
+		adspff_wb_flush(file);
+		if (file->wb_err) {
+			/*
+			 * The ack only carries a size, so report no size and
+			 * leave the error latched to fail the next fwrite.
+			 */
+			pr_err("fsize of %s after lost data: %d\n",
+				file->file_name, file->wb_err);
+			size = 0;
+		} else {
+			size = file_size(file->fp);
+		}
 	}
 
 	/* send ack */
@@ -358,57 +595,51 @@ static void adspff_fsize(void)
 
 	if (ret < 0) {
 		pr_err("fsize Enqueue failed %d.", ret);
-		kfree(msg_recv);
 		return;
 	}
 	nvadsp_mbox_send(&rx_mbox, adspff_cmd_ack,
 			NVADSP_MBOX_SMSG, 0, 0);
-	kfree(msg_recv);
 }
 
 static void adspff_fwrite(void)
 {
-	union adspff_message_t message;
-	union adspff_message_t *msg_recv;
+	union adspff_message_t *message = &adspff_req;
+	union adspff_message_t *msg_recv = &adspff_ack;
 	struct file_struct *file = NULL;
 	int ret = 0;
 	uint32_t size = 0;
-	uint32_t bytes_to_write = 0;
-	uint32_t bytes_written = 0;
-
-	msg_recv = kzalloc(sizeof(union adspff_message_t), GFP_KERNEL);
-	if (!msg_recv)
-		return;
+	int32_t bytes_written = 0;
 
-	msg_recv->msgq_msg.size = MSGQ_MSG_SIZE(struct ack_msg_t);
+	adspff_prepare_msgs(MSGQ_MSG_SIZE(struct fwrite_msg_t),
+			MSGQ_MSG_SIZE(struct ack_msg_t));
 
-	message.msgq_msg.size = MSGQ_MSG_SIZE(struct fwrite_msg_t);
 	ret = msgq_dequeue_message(&adspff->msgq_send.msgq,
-				(msgq_message_t *)&message);
+				(msgq_message_t *)message);
 	if (ret < 0) {
 		pr_err("fwrite Dequeue failed %d.", ret);
-		kfree(msg_recv);
 		return;
 	}
 
-	file = (struct file_struct *)message.msg.payload.fwrite_msg.file;
-	size = message.msg.payload.fwrite_msg.size;
-
-	bytes_to_write = ((adspff->write_buf.read_index + size) < ADSPFF_SHARED_BUFFER_SIZE) ?
-		size : (ADSPFF_SHARED_BUFFER_SIZE - adspff->write_buf.read_index);
-	ret = file_write(file->fp, &file->wr_offset,
-			adspff->write_buf.data + adspff->write_buf.read_index, bytes_to_write);
-	bytes_written += ret;
-
-	if ((size - bytes_to_write) > 0) {
-		ret = file_write(file->fp, &file->wr_offset,
-				adspff->write_buf.data, size - bytes_to_write);
-		bytes_written += ret;
+	file = (struct file_struct *)message->msg.payload.fwrite_msg.file;
+	size = message->msg.payload.fwrite_msg.size;
+
+	if (file && file->fp) {
+		/* data read ahead may be stale once the file changes */
+		adspff_ra_invalidate(file);
+		/* earlier data was lost, fail this write with the error */
+		bytes_written = file->wb_err;
+		file->wb_err = 0;
+		if (!bytes_written)
+			bytes_written = adspff_write_behind(file, size);
 	}
 
 	adspff->write_buf.read_index =
 		(adspff->write_buf.read_index + size) % ADSPFF_SHARED_BUFFER_SIZE;
 
+	adspff_stats.nr_writes++;
+	if (bytes_written > 0)
+		adspff_stats.write_bytes += bytes_written;
+
 	/* send ack */
 	msg_recv->msg.payload.ack_msg.size = bytes_written;
 	ret = msgq_queue_message(&adspff->msgq_recv.msgq,
@@ -416,92 +647,63 @@ static void adspff_fwrite(void)
 
 	if (ret < 0) {
 		pr_err("adspff: fwrite Enqueue failed %d.", ret);
-		kfree(msg_recv);
 		return;
 	}
 	nvadsp_mbox_send(&rx_mbox, adspff_cmd_ack,
 			NVADSP_MBOX_SMSG, 0, 0);
-	kfree(msg_recv);
 }
 
 static void adspff_fread(void)
 {
-	union adspff_message_t *message;
-	union adspff_message_t *msg_recv;
+	union adspff_message_t *message = &adspff_req;
+	union adspff_message_t *msg_recv = &adspff_ack;
 	struct file_struct *file = NULL;
 	uint32_t bytes_free;
 	uint32_t wi = adspff->read_buf.write_index;
 	uint32_t ri = adspff->read_buf.read_index;
-	uint8_t can_wrap = 0;
 	uint32_t size = 0, size_read = 0;
 	int32_t ret = 0;
 
-	if (ri <= wi) {
-		bytes_free = ADSPFF_SHARED_BUFFER_SIZE - wi + ri - 1;
-		can_wrap = 1;
-	} else {
-		bytes_free = ri - wi - 1;
-		can_wrap = 0;
-	}
-	message = kzalloc(sizeof(union adspff_message_t), GFP_KERNEL);
-	if (!message)
-		return;
+	bytes_free = adspff_read_buf_free(wi, ri);
 
-	msg_recv = kzalloc(sizeof(union adspff_message_t), GFP_KERNEL);
-	if (!msg_recv) {
-		kfree(message);
-		return;
-	}
-
-	msg_recv->msgq_msg.size = MSGQ_MSG_SIZE(struct ack_msg_t);
-	message->msgq_msg.size = MSGQ_MSG_SIZE(struct fread_msg_t);
+	adspff_prepare_msgs(MSGQ_MSG_SIZE(struct fread_msg_t),
+			MSGQ_MSG_SIZE(struct ack_msg_t));
 
 	ret = msgq_dequeue_message(&adspff->msgq_send.msgq,
 				(msgq_message_t *)message);
 
 	if (ret < 0) {
 		pr_err("fread Dequeue failed %d.", ret);
-		kfree(message);
-		kfree(msg_recv);
 		return;
 	}
 
 	file = (struct file_struct *)message->msg.payload.fread_msg.file;
 	size = message->msg.payload.fread_msg.size;
-	if (bytes_free < size) {
+	if (!file || !file->fp || bytes_free < size) {
 		size_read = 0;
 		goto send_ack;
 	}
 
-	if (can_wrap) {
-		uint32_t bytes_to_read = (size < (ADSPFF_SHARED_BUFFER_SIZE - wi)) ?
-			size : (ADSPFF_SHARED_BUFFER_SIZE - wi);
-		ret = file_read(file->fp, &file->rd_offset,
-				adspff->read_buf.data + wi, bytes_to_read);
-		size_read = ret;
-		if (ret < bytes_to_read)
-			goto send_ack;
-		if ((size - bytes_to_read) > 0) {
-			ret = file_read(file->fp, &file->rd_offset,
-					adspff->read_buf.data, size - bytes_to_read);
-			size_read += ret;
-			goto send_ack;
-		}
-	} else {
-		ret = file_read(file->fp, &file->rd_offset,
-				adspff->read_buf.data + wi, size);
-		size_read = ret;
-		goto send_ack;
-	}
+	/* pending writes must land before the file is read back */
+	adspff_wb_flush(file);
+
+	size_read = adspff_ra_consume(file, wi, size);
+	if (size_read < size)
+		size_read += adspff_read_to_ring(file, &file->rd_offset,
+				(wi + size_read) % ADSPFF_SHARED_BUFFER_SIZE,
+				size - size_read);
+
 send_ack:
+	adspff_stats.nr_reads++;
+	adspff_stats.read_bytes += size_read;
+
 	msg_recv->msg.payload.ack_msg.size = size_read;
 	ret = msgq_queue_message(&adspff->msgq_recv.msgq,
 			(msgq_message_t *)msg_recv);
 
 	if (ret < 0) {
 		pr_err("fread Enqueue failed %d.", ret);
-		kfree(message);
-		kfree(msg_recv);
+		adspff_ra_invalidate(NULL);
 		return;
 	}
 	adspff->read_buf.write_index =
@@ -509,8 +711,10 @@ send_ack:
 
 	nvadsp_mbox_send(&rx_mbox, adspff_cmd_ack,
 			NVADSP_MBOX_SMSG, 0, 0);
-	kfree(message);
-	kfree(msg_recv);
+
+	/* ADSP reads sequentially, fetch the next chunk while it works */
+	if (size_read && size_read == size)
+		adspff_ra_arm(file, adspff->read_buf.write_index, size);
 }
 
 #if KERNEL_VERSION(5, 9, 0) > LINUX_VERSION_CODE
@@ -519,34 +723,60 @@ static const struct sched_param param = {
 };
 #endif
 static struct task_struct *adspff_kthread;
-static struct list_head adspff_kthread_msgq_head;
 static wait_queue_head_t  wait_queue;
 
 struct adspff_kthread_msg {
 	uint32_t msg_id;
-	struct list_head list;
+	ktime_t arrival;
 };
 
+static DEFINE_KFIFO(adspff_kthread_msgq, struct adspff_kthread_msg,
+		ADSPFF_MSGQ_DEPTH);
+
+static void adspff_account_latency(ktime_t arrival)
+{
+	uint64_t lat = ktime_to_ns(ktime_sub(ktime_get(), arrival));
+
+	adspff_stats.nr_msgs++;
+	adspff_stats.lat_total_ns += lat;
+	if (lat > adspff_stats.lat_max_ns)
+		adspff_stats.lat_max_ns = lat;
+}
+
+static long adspff_kthread_timeout(void)
+{
+	if (!adspff_wb_pending)
+		return MAX_SCHEDULE_TIMEOUT;
+
+	if (time_after_eq(jiffies, adspff_wb_deadline))
+		return 0;
+
+	return adspff_wb_deadline - jiffies;
+}
 
 static int adspff_kthread_fn(void *data)
 {
 	int ret = 0;
-	struct adspff_kthread_msg *kmsg;
-	unsigned long flags;
+	struct adspff_kthread_msg kmsg;
 
 	while (1) {
 
-		ret = wait_event_interruptible(wait_queue, kthread_should_stop()
-				 || !list_empty(&adspff_kthread_msgq_head));
+		wait_event_interruptible_timeout(wait_queue,
+				kthread_should_stop()
+				|| !kfifo_is_empty(&adspff_kthread_msgq)
+				|| adspff_ra.pending,
+				adspff_kthread_timeout());
 
-		if (kthread_should_stop())
+		if (kthread_should_stop()) {
+			adspff_wb_flush_all();
 			do_exit(0);
+		}
 
-		if (!list_empty(&adspff_kthread_msgq_head)) {
-			kmsg = list_first_entry(&adspff_kthread_msgq_head,
-					struct adspff_kthread_msg, list);
-			switch (kmsg->msg_id) {
+		if (kfifo_out_spinlocked(&adspff_kthread_msgq, &kmsg, 1,
+				&adspff_lock)) {
+			switch (kmsg.msg_id) {
 			case adspff_cmd_fopen:
+				adspff_ra_invalidate(NULL);
 				adspff_fopen();
 				break;
 			case adspff_cmd_fclose:
@@ -563,13 +793,17 @@ static int adspff_kthread_fn(void *data)
 				break;
 			default:
 				pr_warn("adspff: kthread unsupported msg %d\n",
-					kmsg->msg_id);
+					kmsg.msg_id);
 			}
-			spin_lock_irqsave(&adspff_lock, flags);
-			list_del(&kmsg->list);
-			spin_unlock_irqrestore(&adspff_lock, flags);
-			kfree(kmsg);
+			adspff_account_latency(kmsg.arrival);
+		} else if (adspff_ra.pending) {
+			/* idle: read ahead for the ADSP */
+			adspff_readahead();
 		}
+
+		if (adspff_wb_pending &&
+				time_after_eq(jiffies, adspff_wb_deadline))
+			adspff_wb_flush_all();
 	}
 
 	do_exit(ret);
@@ -582,20 +816,17 @@ static int adspff_kthread_fn(void *data)
 
 static int adspff_msg_handler(uint32_t msg, void *data)
 {
-	unsigned long flags;
-	struct adspff_kthread_msg *kmsg;
-
-	spin_lock_irqsave(&adspff_lock, flags);
-	kmsg = kzalloc(sizeof(*kmsg), GFP_ATOMIC);
-	if (!kmsg) {
-		spin_unlock_irqrestore(&adspff_lock, flags);
+	struct adspff_kthread_msg kmsg = {
+		.msg_id = msg,
+		.arrival = ktime_get(),
+	};
+
+	if (!kfifo_in_spinlocked(&adspff_kthread_msgq, &kmsg, 1,
+			&adspff_lock)) {
+		pr_err("adspff: message queue full, dropping msg %u\n", msg);
 		return -ENOMEM;
 	}
-
-	kmsg->msg_id = msg;
-	list_add_tail(&kmsg->list, &adspff_kthread_msgq_head);
 	wake_up(&wait_queue);
-	spin_unlock_irqrestore(&adspff_lock, flags);
 
 	return 0;
 }
@@ -607,11 +838,15 @@ static int adspff_set(void *data, u64 val)
 
 	if (val != 1)
 		return 0;
+	adspff_ra_invalidate(NULL);
 	list_for_each_safe(pos, n, &file_list) {
 		file = list_entry(pos, struct file_struct, list);
 		list_del(pos);
-		if (file->fp)
+		if (file->fp) {
+			adspff_wb_flush(file);
 			file_close(file->fp);
+		}
+		kfree(file->wb_buf);
 		kfree(file);
 	}
 
@@ -621,6 +856,25 @@ static int adspff_set(void *data, u64 val)
 }
 DEFINE_SIMPLE_ATTRIBUTE(adspff_fops, NULL, adspff_set, "%llu\n");
 
+static int adspff_stats_show(struct seq_file *s, void *data)
+{
+	struct adspff_stats *st = &adspff_stats;
+
+	seq_printf(s, "messages:        %llu\n", st->nr_msgs);
+	seq_printf(s, "reads:           %llu (%llu bytes)\n",
+		st->nr_reads, st->read_bytes);
+	seq_printf(s, "readahead hits:  %llu bytes\n", st->ra_hit_bytes);
+	seq_printf(s, "writes:          %llu (%llu bytes)\n",
+		st->nr_writes, st->write_bytes);
+	seq_printf(s, "write flushes:   %llu\n", st->wb_flushes);
+	seq_printf(s, "latency avg/max: %llu/%llu ns\n",
+		st->nr_msgs ? div64_u64(st->lat_total_ns, st->nr_msgs) : 0,
+		st->lat_max_ns);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(adspff_stats);
+
 #ifdef CONFIG_DEBUG_FS
 static int adspff_debugfs_init(struct nvadsp_drv_data *drv)
 {
@@ -639,6 +893,11 @@ static int adspff_debugfs_init(struct nvadsp_drv_data *drv)
 	if (!d)
 		return ret;
 
+	d = debugfs_create_file("stats", 0444, dir, NULL,
+			&adspff_stats_fops);
+	if (!d)
+		return ret;
+
 	return 0;
 }
 #endif
@@ -675,6 +934,11 @@ int adspff_init(struct platform_device *pdev)
 
 	adspff = ADSPFF_SHARED_STATE(app_info->mem.shared);
 
+	/* the mailbox handler may run as soon as the mailbox is open */
+	spin_lock_init(&adspff_lock);
+	INIT_KFIFO(adspff_kthread_msgq);
+	init_waitqueue_head(&wait_queue);
+
 	ret = nvadsp_mbox_open(&rx_mbox, &adspff->mbox_id,
 			"adspff", adspff_msg_handler, NULL);
 
@@ -683,19 +947,14 @@ int adspff_init(struct platform_device *pdev)
 		return -1;
 	}
 
-	spin_lock_init(&adspff_lock);
-
 #ifdef CONFIG_DEBUG_FS
 	ret = adspff_debugfs_init(drv);
 	if (ret)
 		pr_warn("adspff: failed to create debugfs entry\n");
 #endif
 
-	INIT_LIST_HEAD(&adspff_kthread_msgq_head);
 	INIT_LIST_HEAD(&file_list);
 
-	init_waitqueue_head(&wait_queue);
-
 #if KERNEL_VERSION(5, 9, 0) > LINUX_VERSION_CODE
 	sched_setscheduler(adspff_kthread, SCHED_FIFO, &param);
 #else
@@ -227,7 +227,7 @@ static int __virt_assert_t18x_adsp(struct nvadsp_drv_data *d)
 	msg.params.adsp_reset_info.reset_req = ASSERT;
 	msg.ack_required = true;
 
-	err = nvaudio_ivc_send_receive(hivc_client,
+	err = nvaudio_ivc_send_receive_atomic(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0)
@@ -252,7 +252,7 @@ static int __virt_deassert_t18x_adsp(struct nvadsp_drv_data *d)
 	msg.params.adsp_reset_info.reset_req = DEASSERT;
 	msg.ack_required = true;
 
-	err = nvaudio_ivc_send_receive(hivc_client,
+	err = nvaudio_ivc_send_receive_atomic(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0)
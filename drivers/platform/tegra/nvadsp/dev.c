@@ -459,12 +459,12 @@ static int __init nvadsp_probe(struct platform_device *pdev)
 	ret = nvadsp_reset_init(pdev);
 	if (ret) {
 		dev_err(dev, "Failed initialize resets\n");
-		goto err;
+		goto err_os_remove;
 	}
 
 	ret = nvadsp_app_module_probe(pdev);
 	if (ret)
-		goto err;
+		goto err_os_remove;
 
 	aram_addr = drv_data->adsp_mem[ARAM_ALIAS_0_ADDR];
 	aram_size = drv_data->adsp_mem[ARAM_ALIAS_0_SIZE];
@@ -479,9 +479,13 @@ static int __init nvadsp_probe(struct platform_device *pdev)
 	if (!drv_data->adsp_os_secload) {
 		ret = nvadsp_acast_init(pdev);
 		if (ret)
-			goto err;
+			goto err_os_remove;
 	}
 
+err_os_remove:
+	/* the success path falls through here as well */
+	if (ret)
+		nvadsp_os_remove(pdev);
 err:
 #ifdef CONFIG_PM
 	ret = pm_runtime_put_sync(dev);
@@ -500,6 +504,8 @@ static int nvadsp_remove(struct platform_device *pdev)
 
 	nvadsp_aram_exit();
 
+	nvadsp_os_remove(pdev);
+
 	pm_runtime_disable(&pdev->dev);
 
 #ifdef CONFIG_PM
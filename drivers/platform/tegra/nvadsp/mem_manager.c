@@ -3,6 +3,7 @@
 
 #define pr_fmt(fmt) "%s : %d, " fmt, __func__, __LINE__
 
+#include <linux/bitops.h>
 #include <linux/list.h>
 #include <linux/slab.h>
 #include <linux/string.h>
@@ -11,146 +12,181 @@
 
 #include "mem_manager.h"
 
-static void clear_alloc_list(struct mem_manager_info *mm_info);
+/*
+ * Segregated-fit allocator. Every chunk, free or allocated, sits on
+ * the address ordered chunks list so that neighbours are found in O(1)
+ * when coalescing. Free chunks are also kept on a bin per power-of-two
+ * size class, with a bitmap of non-empty bins, so a request only looks
+ * at the bin of its own size class and then at the first non-empty
+ * larger bin.
+ */
+
+static inline unsigned int mem_bin(unsigned long size)
+{
+	return size ? __fls(size) : 0;
+}
+
+static void mem_bin_add(struct mem_manager_info *mm_info,
+			struct mem_chunk *mc)
+{
+	unsigned int bin = mem_bin(mc->size);
+
+	mc->free = true;
+	strscpy(mc->name, "FREE", NAME_SIZE);
+	list_add(&mc->bin_node, &mm_info->bins[bin]);
+	__set_bit(bin, mm_info->bin_map);
+}
+
+static void mem_bin_del(struct mem_manager_info *mm_info,
+			struct mem_chunk *mc)
+{
+	unsigned int bin = mem_bin(mc->size);
+
+	list_del(&mc->bin_node);
+	if (list_empty(&mm_info->bins[bin]))
+		__clear_bit(bin, mm_info->bin_map);
+	mc->free = false;
+}
+
+static struct mem_chunk *mem_find_free(struct mem_manager_info *mm_info,
+				       size_t size)
+{
+	struct mem_chunk *mc, *best = NULL;
+	unsigned int bin = mem_bin(size);
+
+	/* best fit among chunks of the same size class */
+	list_for_each_entry(mc, &mm_info->bins[bin], bin_node) {
+		if (mc->size >= size && (!best || mc->size < best->size)) {
+			best = mc;
+			if (best->size == size)
+				return best;
+		}
+	}
+	if (best)
+		return best;
+
+	/* any chunk of a larger class fits, take the smallest one */
+	bin = find_next_bit(mm_info->bin_map, MEM_NR_BINS, bin + 1);
+	if (bin >= MEM_NR_BINS)
+		return NULL;
+
+	list_for_each_entry(mc, &mm_info->bins[bin], bin_node) {
+		if (!best || mc->size < best->size)
+			best = mc;
+	}
+	return best;
+}
 
 void *mem_request(void *mem_handle, const char *name, size_t size)
 {
 	unsigned long flags;
 	struct mem_manager_info *mm_info =
 		(struct mem_manager_info *)mem_handle;
-	struct mem_chunk *mc_iterator = NULL, *best_match_chunk = NULL;
+	struct mem_chunk *best_match_chunk = NULL;
 	struct mem_chunk *new_mc = NULL;
 
 	spin_lock_irqsave(&mm_info->lock, flags);
 
+	mm_info->nr_requests++;
+
 	/* Is mem full? */
-	if (list_empty(mm_info->free_list)) {
+	if (bitmap_empty(mm_info->bin_map, MEM_NR_BINS)) {
 		pr_err("%s : memory full\n", mm_info->name);
-		spin_unlock_irqrestore(&mm_info->lock, flags);
-		return ERR_PTR(-ENOMEM);
+		goto fail;
 	}
 
-	/* Find the best size match */
-	list_for_each_entry(mc_iterator, mm_info->free_list, node) {
-		if (mc_iterator->size >= size) {
-			if (best_match_chunk == NULL)
-				best_match_chunk = mc_iterator;
-			else if (mc_iterator->size < best_match_chunk->size)
-				best_match_chunk = mc_iterator;
-		}
-	}
+	best_match_chunk = mem_find_free(mm_info, size);
 
 	/* Is free node found? */
 	if (best_match_chunk == NULL) {
 		pr_err("%s : no enough memory available\n", mm_info->name);
-		spin_unlock_irqrestore(&mm_info->lock, flags);
-		return ERR_PTR(-ENOMEM);
+		goto fail;
 	}
 
 	/* Is it exact match? */
 	if (best_match_chunk->size == size) {
-		list_del(&best_match_chunk->node);
-		list_for_each_entry(mc_iterator, mm_info->alloc_list, node) {
-			if (best_match_chunk->address < mc_iterator->address) {
-				list_add_tail(&best_match_chunk->node,
-						&mc_iterator->node);
-				strscpy(best_match_chunk->name, name,
-						NAME_SIZE);
-				spin_unlock_irqrestore(&mm_info->lock, flags);
-				return best_match_chunk;
-			}
-		}
-		list_add(&best_match_chunk->node, mm_info->alloc_list);
-		strscpy(best_match_chunk->name, name, NAME_SIZE);
-		spin_unlock_irqrestore(&mm_info->lock, flags);
-		return best_match_chunk;
+		mem_bin_del(mm_info, best_match_chunk);
+		new_mc = best_match_chunk;
 	} else {
 		new_mc = kzalloc(sizeof(struct mem_chunk), GFP_ATOMIC);
 		if (unlikely(!new_mc)) {
 			pr_err("failed to allocate memory for mem_chunk\n");
-
-			spin_unlock_irqrestore(&mm_info->lock, flags);
-			return ERR_PTR(-ENOMEM);
+			goto fail;
 		}
+		/* allocate from the low end, the remainder stays free */
+		mem_bin_del(mm_info, best_match_chunk);
 		new_mc->address = best_match_chunk->address;
 		new_mc->size = size;
-		strscpy(new_mc->name, name, NAME_SIZE);
 		best_match_chunk->address += size;
 		best_match_chunk->size -= size;
-		list_for_each_entry(mc_iterator, mm_info->alloc_list, node) {
-			if (new_mc->address < mc_iterator->address) {
-				list_add_tail(&new_mc->node,
-						&mc_iterator->node);
-				spin_unlock_irqrestore(&mm_info->lock, flags);
-				return new_mc;
-			}
-		}
-		list_add_tail(&new_mc->node, mm_info->alloc_list);
-		spin_unlock_irqrestore(&mm_info->lock, flags);
-		return new_mc;
+		list_add_tail(&new_mc->node, &best_match_chunk->node);
+		mem_bin_add(mm_info, best_match_chunk);
 	}
+
+	strscpy(new_mc->name, name, NAME_SIZE);
+	mm_info->free_size -= size;
+	mm_info->nr_allocs++;
+
+	spin_unlock_irqrestore(&mm_info->lock, flags);
+	return new_mc;
+
+fail:
+	mm_info->nr_failures++;
+	spin_unlock_irqrestore(&mm_info->lock, flags);
+	return ERR_PTR(-ENOMEM);
 }
 
 /*
- * Find the node with sepcified address and remove it from list
+ * Return the chunk to the free bins, merging it with free neighbours
  */
 bool mem_release(void *mem_handle, void *handle)
 {
 	unsigned long flags;
 	struct mem_manager_info *mm_info =
 		(struct mem_manager_info *)mem_handle;
-	struct mem_chunk *mc_curr = NULL, *mc_prev = NULL;
 	struct mem_chunk *mc_free = (struct mem_chunk *)handle;
+	struct mem_chunk *mc_adj;
 
 	pr_debug(" addr = %lu, size = %lu, name = %s\n",
 			mc_free->address, mc_free->size, mc_free->name);
 
 	spin_lock_irqsave(&mm_info->lock, flags);
 
-	list_for_each_entry(mc_curr, mm_info->free_list, node) {
-		if (mc_free->address < mc_curr->address) {
-
-			strscpy(mc_free->name, "FREE", NAME_SIZE);
-
-			/* adjacent next free node */
-			if (mc_curr->address ==
-				(mc_free->address + mc_free->size)) {
-
-				mc_curr->address = mc_free->address;
-				mc_curr->size += mc_free->size;
-				list_del(&mc_free->node);
-				kfree(mc_free);
-
-				/* and adjacent prev free node */
-				if ((mc_prev != NULL) &&
-				   ((mc_prev->address + mc_prev->size) ==
-						mc_curr->address)) {
-
-					mc_prev->size += mc_curr->size;
-					list_del(&mc_curr->node);
-					kfree(mc_curr);
-				}
-			}
-			/* adjacent prev free node */
-			else if ((mc_prev != NULL) &&
-				((mc_prev->address + mc_prev->size) ==
-						mc_free->address)) {
-
-				mc_prev->size += mc_free->size;
-				list_del(&mc_free->node);
-				kfree(mc_free);
-			} else {
-				list_del(&mc_free->node);
-				list_add_tail(&mc_free->node,
-						&mc_curr->node);
-			}
-			spin_unlock_irqrestore(&mm_info->lock, flags);
-			return true;
+	if (mc_free->free) {
+		spin_unlock_irqrestore(&mm_info->lock, flags);
+		return false;
+	}
+
+	mm_info->free_size += mc_free->size;
+	mm_info->nr_allocs--;
+
+	/* adjacent next free node */
+	if (!list_is_last(&mc_free->node, &mm_info->chunks)) {
+		mc_adj = list_next_entry(mc_free, node);
+		if (mc_adj->free) {
+			mem_bin_del(mm_info, mc_adj);
+			mc_free->size += mc_adj->size;
+			list_del(&mc_adj->node);
+			kfree(mc_adj);
 		}
-		mc_prev = mc_curr;
 	}
+
+	/* adjacent prev free node */
+	if (!list_is_first(&mc_free->node, &mm_info->chunks)) {
+		mc_adj = list_prev_entry(mc_free, node);
+		if (mc_adj->free) {
+			mem_bin_del(mm_info, mc_adj);
+			mc_adj->size += mc_free->size;
+			list_del(&mc_free->node);
+			kfree(mc_free);
+			mc_free = mc_adj;
+		}
+	}
+
+	mem_bin_add(mm_info, mc_free);
+
 	spin_unlock_irqrestore(&mm_info->lock, flags);
-	return false;
+	return true;
 }
 
 inline unsigned long mem_get_address(void *handle)
@@ -167,14 +203,18 @@ void mem_print(void *mem_handle)
 
 	pr_info("------------------------------------\n");
 	pr_info("%s ALLOCATED\n", mm_info->name);
-	list_for_each_entry(mc_iterator, mm_info->alloc_list, node) {
+	list_for_each_entry(mc_iterator, &mm_info->chunks, node) {
+		if (mc_iterator->free)
+			continue;
 		pr_info("  addr = %lu, size = %lu, name = %s\n",
 			mc_iterator->address, mc_iterator->size,
 			mc_iterator->name);
 	}
 
 	pr_info("%s FREE\n", mm_info->name);
-	list_for_each_entry(mc_iterator, mm_info->free_list, node) {
+	list_for_each_entry(mc_iterator, &mm_info->chunks, node) {
+		if (!mc_iterator->free)
+			continue;
 		pr_info("  addr = %lu, size = %lu, name = %s\n",
 			mc_iterator->address, mc_iterator->size,
 			mc_iterator->name);
@@ -188,44 +228,53 @@ void mem_dump(void *mem_handle, struct seq_file *s)
 	struct mem_manager_info *mm_info =
 		(struct mem_manager_info *)mem_handle;
 	struct mem_chunk *mc_iterator = NULL;
+	unsigned long largest_free = 0;
+	unsigned long nr_free = 0;
+	unsigned long flags;
+
+	spin_lock_irqsave(&mm_info->lock, flags);
 
 	seq_puts(s, "---------------------------------------\n");
 	seq_printf(s, "%s ALLOCATED\n", mm_info->name);
-	list_for_each_entry(mc_iterator, mm_info->alloc_list, node) {
+	list_for_each_entry(mc_iterator, &mm_info->chunks, node) {
+		if (mc_iterator->free)
+			continue;
 		seq_printf(s, "  addr = %lu, size = %lu, name = %s\n",
 			mc_iterator->address, mc_iterator->size,
 			mc_iterator->name);
 	}
 
 	seq_printf(s, "%s FREE\n", mm_info->name);
-	list_for_each_entry(mc_iterator, mm_info->free_list, node) {
+	list_for_each_entry(mc_iterator, &mm_info->chunks, node) {
+		if (!mc_iterator->free)
+			continue;
 		seq_printf(s, "  addr = %lu, size = %lu, name = %s\n",
 			mc_iterator->address, mc_iterator->size,
 			mc_iterator->name);
+		largest_free = max(largest_free, mc_iterator->size);
+		nr_free++;
 	}
 
+	/* external fragmentation: free memory not in the largest chunk */
+	seq_printf(s, "%s STATS\n", mm_info->name);
+	seq_printf(s, "  total = %lu, free = %lu, largest free = %lu\n",
+		mm_info->size, mm_info->free_size, largest_free);
+	seq_printf(s, "  allocs = %lu, free chunks = %lu, fragmentation = %lu%%\n",
+		mm_info->nr_allocs, nr_free,
+		mm_info->free_size ?
+			100 - (largest_free * 100) / mm_info->free_size : 0);
+	seq_printf(s, "  requests = %lu, failed = %lu\n",
+		mm_info->nr_requests, mm_info->nr_failures);
 	seq_puts(s, "---------------------------------------\n");
-}
 
-static void clear_alloc_list(struct mem_manager_info *mm_info)
-{
-	struct list_head *curr, *next;
-	struct mem_chunk *mc = NULL;
-
-	list_for_each_safe(curr, next, mm_info->alloc_list) {
-		mc = list_entry(curr, struct mem_chunk, node);
-		pr_debug("  addr = %lu, size = %lu, name = %s\n",
-			mc->address, mc->size,
-			mc->name);
-		mem_release(mm_info, mc);
-	}
+	spin_unlock_irqrestore(&mm_info->lock, flags);
 }
 
 void *create_mem_manager(const char *name, unsigned long start_address,
 				unsigned long size)
 {
-	void *ret = NULL;
 	struct mem_chunk *mc;
+	unsigned int i;
 	struct mem_manager_info *mm_info =
 			kzalloc(sizeof(struct mem_manager_info), GFP_KERNEL);
 	if (unlikely(!mm_info)) {
@@ -235,67 +284,44 @@ void *create_mem_manager(const char *name, unsigned long start_address,
 
 	strscpy(mm_info->name, name, NAME_SIZE);
 
-	mm_info->alloc_list = kzalloc(sizeof(struct list_head), GFP_KERNEL);
-	if (unlikely(!mm_info->alloc_list)) {
-		pr_err("failed to allocate memory for alloc_list\n");
-		ret = ERR_PTR(-ENOMEM);
-		goto free_mm_info;
-	}
-
-	mm_info->free_list = kzalloc(sizeof(struct list_head), GFP_KERNEL);
-	if (unlikely(!mm_info->free_list)) {
-		pr_err("failed to allocate memory for free_list\n");
-		ret = ERR_PTR(-ENOMEM);
-		goto free_alloc_list;
-	}
-
-	INIT_LIST_HEAD(mm_info->alloc_list);
-	INIT_LIST_HEAD(mm_info->free_list);
+	INIT_LIST_HEAD(&mm_info->chunks);
+	for (i = 0; i < MEM_NR_BINS; i++)
+		INIT_LIST_HEAD(&mm_info->bins[i]);
 
 	mm_info->start_address = start_address;
 	mm_info->size = size;
+	mm_info->free_size = size;
 
 	/* Add whole memory to free list */
 	mc = kzalloc(sizeof(struct mem_chunk), GFP_KERNEL);
 	if (unlikely(!mc)) {
 		pr_err("failed to allocate memory for mem_chunk\n");
-		ret = ERR_PTR(-ENOMEM);
-		goto free_free_list;
+		kfree(mm_info);
+		return ERR_PTR(-ENOMEM);
 	}
 
 	mc->address = mm_info->start_address;
 	mc->size = mm_info->size;
-	strscpy(mc->name, "FREE", NAME_SIZE);
-	list_add(&mc->node, mm_info->free_list);
+	list_add(&mc->node, &mm_info->chunks);
+	mem_bin_add(mm_info, mc);
 	spin_lock_init(&mm_info->lock);
 
 	return (void *)mm_info;
-
-free_free_list:
-	kfree(mm_info->free_list);
-free_alloc_list:
-	kfree(mm_info->alloc_list);
-free_mm_info:
-	kfree(mm_info);
-
-	return ret;
 }
 
 void destroy_mem_manager(void *mem_handle)
 {
 	struct mem_manager_info *mm_info =
 		(struct mem_manager_info *)mem_handle;
-	struct mem_chunk *mc_last = NULL;
-
-	/* Clear all allocated memory */
-	clear_alloc_list(mm_info);
+	struct mem_chunk *mc, *tmp;
 
-	mc_last = list_entry((mm_info->free_list)->next,
-			struct mem_chunk, node);
-	list_del(&mc_last->node);
+	/* Clear all allocated and free chunks */
+	list_for_each_entry_safe(mc, tmp, &mm_info->chunks, node) {
+		pr_debug("  addr = %lu, size = %lu, name = %s\n",
+			mc->address, mc->size, mc->name);
+		list_del(&mc->node);
+		kfree(mc);
+	}
 
-	kfree(mc_last);
-	kfree(mm_info->alloc_list);
-	kfree(mm_info->free_list);
 	kfree(mm_info);
 }
@@ -6,23 +6,36 @@
 #ifndef __TEGRA_NVADSP_MEM_MANAGER_H
 #define __TEGRA_NVADSP_MEM_MANAGER_H
 
+#include <linux/bitmap.h>
+#include <linux/list.h>
 #include <linux/sizes.h>
+#include <linux/spinlock.h>
 
 #define NAME_SIZE SZ_16
 
+/* free chunks are binned by power-of-two size class */
+#define MEM_NR_BINS BITS_PER_LONG
+
 struct mem_chunk {
-	struct list_head node;
+	struct list_head node;		/* all chunks, by address */
+	struct list_head bin_node;	/* free chunks, by size class */
 	char name[NAME_SIZE];
 	unsigned long address;
 	unsigned long size;
+	bool free;
 };
 
 struct mem_manager_info {
-	struct list_head *alloc_list;
-	struct list_head *free_list;
+	struct list_head chunks;
+	struct list_head bins[MEM_NR_BINS];
+	DECLARE_BITMAP(bin_map, MEM_NR_BINS);
 	char name[NAME_SIZE];
 	unsigned long start_address;
 	unsigned long size;
+	unsigned long free_size;
+	unsigned long nr_allocs;
+	unsigned long nr_requests;
+	unsigned long nr_failures;
 	spinlock_t lock;
 };
 
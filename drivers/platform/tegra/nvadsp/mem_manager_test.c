@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+
+/*
+ * KUnit checks of the segregated-fit memory manager: placement within
+ * and across size classes, coalescing on release and double release.
+ */
+
+#include <kunit/test.h>
+#include <linux/err.h>
+#include <linux/sizes.h>
+
+#include "mem_manager.h"
+
+#define TEST_START	0x10000UL
+#define TEST_SIZE	SZ_64K
+
+static void *test_request(struct kunit *test, void *mm, size_t size,
+			  unsigned long address)
+{
+	void *mc = mem_request(mm, "test", size);
+
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, mc);
+	KUNIT_EXPECT_EQ(test, mem_get_address(mc), TEST_START + address);
+	return mc;
+}
+
+static void *test_create(struct kunit *test)
+{
+	void *mm = create_mem_manager("test", TEST_START, TEST_SIZE);
+
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, mm);
+	return mm;
+}
+
+/* the whole range is one chunk again only if every release coalesced */
+static void expect_all_free(struct kunit *test, void *mm)
+{
+	void *mc = test_request(test, mm, TEST_SIZE, 0);
+
+	KUNIT_EXPECT_TRUE(test, mem_release(mm, mc));
+}
+
+static void mem_manager_test_sequential(struct kunit *test)
+{
+	void *mm = test_create(test);
+	void *mc[8];
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(mc); i++)
+		mc[i] = test_request(test, mm, SZ_1K, i * SZ_1K);
+
+	/* release out of order, merging on either side */
+	for (i = 1; i < ARRAY_SIZE(mc); i += 2)
+		KUNIT_EXPECT_TRUE(test, mem_release(mm, mc[i]));
+	for (i = 0; i < ARRAY_SIZE(mc); i += 2)
+		KUNIT_EXPECT_TRUE(test, mem_release(mm, mc[i]));
+
+	expect_all_free(test, mm);
+	destroy_mem_manager(mm);
+}
+
+static void mem_manager_test_size_classes(struct kunit *test)
+{
+	void *mm = test_create(test);
+	void *a, *b, *c, *sep[3], *mc;
+
+	/* free holes of 0x280 and 0x2a0 (same class), 0x1000 and the tail */
+	a = test_request(test, mm, 0x280, 0);
+	sep[0] = test_request(test, mm, 0x100, 0x280);
+	b = test_request(test, mm, 0x2a0, 0x380);
+	sep[1] = test_request(test, mm, 0x100, 0x620);
+	c = test_request(test, mm, 0x1000, 0x720);
+	sep[2] = test_request(test, mm, 0x100, 0x1720);
+	KUNIT_EXPECT_TRUE(test, mem_release(mm, a));
+	KUNIT_EXPECT_TRUE(test, mem_release(mm, b));
+	KUNIT_EXPECT_TRUE(test, mem_release(mm, c));
+
+	/* best fit within the class of the request */
+	mc = test_request(test, mm, 0x290, 0x380);
+	KUNIT_EXPECT_TRUE(test, mem_release(mm, mc));
+
+	/* exact fit */
+	mc = test_request(test, mm, 0x280, 0);
+	KUNIT_EXPECT_TRUE(test, mem_release(mm, mc));
+
+	/* nothing in its class fits, smallest chunk of the next class */
+	mc = test_request(test, mm, 0x2b0, 0x720);
+	KUNIT_EXPECT_TRUE(test, mem_release(mm, mc));
+
+	/* empty classes in between are skipped */
+	mc = test_request(test, mm, SZ_2K, 0x720);
+	KUNIT_EXPECT_TRUE(test, mem_release(mm, mc));
+
+	/* only the tail is large enough */
+	mc = test_request(test, mm, SZ_8K, 0x1820);
+	KUNIT_EXPECT_TRUE(test, mem_release(mm, mc));
+
+	KUNIT_EXPECT_TRUE(test, mem_release(mm, sep[1]));
+	KUNIT_EXPECT_TRUE(test, mem_release(mm, sep[0]));
+	KUNIT_EXPECT_TRUE(test, mem_release(mm, sep[2]));
+	expect_all_free(test, mm);
+	destroy_mem_manager(mm);
+}
+
+static void mem_manager_test_exhaust(struct kunit *test)
+{
+	void *mm = test_create(test);
+	void *a, *b;
+
+	KUNIT_EXPECT_TRUE(test, IS_ERR(mem_request(mm, "test", TEST_SIZE + 1)));
+
+	a = test_request(test, mm, SZ_32K, 0);
+	b = test_request(test, mm, SZ_32K, SZ_32K);
+	KUNIT_EXPECT_TRUE(test, IS_ERR(mem_request(mm, "test", 1)));
+
+	KUNIT_EXPECT_TRUE(test, mem_release(mm, a));
+	KUNIT_EXPECT_TRUE(test, IS_ERR(mem_request(mm, "test", SZ_32K + 1)));
+	KUNIT_EXPECT_TRUE(test, mem_release(mm, b));
+
+	expect_all_free(test, mm);
+	destroy_mem_manager(mm);
+}
+
+static void mem_manager_test_double_release(struct kunit *test)
+{
+	void *mm = test_create(test);
+	void *a, *b, *c;
+
+	a = test_request(test, mm, SZ_1K, 0);
+	b = test_request(test, mm, SZ_1K, SZ_1K);
+	c = test_request(test, mm, SZ_1K, SZ_2K);
+
+	/* b has no free neighbour, so it stays a chunk of its own */
+	KUNIT_EXPECT_TRUE(test, mem_release(mm, b));
+	KUNIT_EXPECT_FALSE(test, mem_release(mm, b));
+
+	KUNIT_EXPECT_TRUE(test, mem_release(mm, a));
+	KUNIT_EXPECT_TRUE(test, mem_release(mm, c));
+	expect_all_free(test, mm);
+	destroy_mem_manager(mm);
+}
+
+static struct kunit_case mem_manager_test_cases[] = {
+	KUNIT_CASE(mem_manager_test_sequential),
+	KUNIT_CASE(mem_manager_test_size_classes),
+	KUNIT_CASE(mem_manager_test_exhaust),
+	KUNIT_CASE(mem_manager_test_double_release),
+	{}
+};
+
+static struct kunit_suite mem_manager_test_suite = {
+	.name = "nvadsp-mem-manager",
+	.test_cases = mem_manager_test_cases,
+};
+kunit_test_suite(mem_manager_test_suite);
@@ -28,8 +28,11 @@
 #include <linux/tegra-firmwares.h>
 #include <linux/reset.h>
 #include <linux/poll.h>
+#include <linux/hashtable.h>
+#include <linux/stringhash.h>
 
 #include <linux/uaccess.h>
+#include <linux/platform/tegra/tegra-fw-boot.h>
 
 #include "amisc.h"
 #include "ape_actmon.h"
@@ -86,10 +89,17 @@ struct nvadsp_debug_log {
 	struct completion	complete;
 };
 
+/* buckets of the ADSP OS global symbol hash, indexed by symbol name */
+#define ADSP_GLO_SYM_HASH_BITS	10
+
 struct nvadsp_os_data {
 	const struct firmware	*os_firmware;
+	/* reads and parses the OS image in the background from probe */
+	struct tegra_fw_boot_engine fw_engine;
+	bool			fw_prefetch;
 	struct platform_device	*pdev;
 	struct global_sym_info	*adsp_glo_sym_tbl;
+	DECLARE_HASHTABLE(adsp_glo_sym_hash, ADSP_GLO_SYM_HASH_BITS);
 	void __iomem		*hwmailbox_base;
 	struct nvadsp_debug_log	logger;
 	struct nvadsp_cnsl   console;
@@ -460,6 +470,23 @@ static inline void __maybe_unused dump_global_symbol_table(void)
 				"STT_FUNC" : "STT_OBJECT");
 }
 
+static inline u32 global_symbol_hash(const char *name)
+{
+	return full_name_hash(NULL, name, strnlen(name, SYM_NAME_SZ));
+}
+
+static struct global_sym_info *lookup_global_symbol(const char *sym_name,
+						    u32 hash)
+{
+	struct global_sym_info *sym_info;
+
+	hash_for_each_possible(priv.adsp_glo_sym_hash, sym_info, node, hash) {
+		if (!strncmp(sym_info->name, sym_name, SYM_NAME_SZ))
+			return sym_info;
+	}
+	return NULL;
+}
+
 #ifdef CONFIG_ANDROID
 static int
 __maybe_unused create_global_symbol_table(const struct firmware *fw)
@@ -489,18 +516,27 @@ __maybe_unused create_global_symbol_table(const struct firmware *fw)
 	if (!priv.adsp_glo_sym_tbl)
 		return -ENOMEM;
 
-	last_sym = sym + num_ent;
+	last_sym = sym + num_ent - 1;
+	hash_init(priv.adsp_glo_sym_hash);
 
 	for (i = 1; sym < last_sym; sym++) {
 		unsigned char info = sym->st_info;
 		unsigned char type = ELF32_ST_TYPE(info);
 		if ((ELF32_ST_BIND(sym->st_info) == STB_GLOBAL) &&
 		((type == STT_OBJECT) || (type == STT_FUNC))) {
-			char *name = priv.adsp_glo_sym_tbl[i].name;
-
-			strscpy(name, name_table + sym->st_name, SYM_NAME_SZ);
-			priv.adsp_glo_sym_tbl[i].addr = sym->st_value;
-			priv.adsp_glo_sym_tbl[i].info = info;
+			struct global_sym_info *entry =
+				&priv.adsp_glo_sym_tbl[i];
+			u32 hash;
+
+			strscpy(entry->name, name_table + sym->st_name,
+				SYM_NAME_SZ);
+			entry->addr = sym->st_value;
+			entry->info = info;
+			/* first definition of a name wins, as in the symtab */
+			hash = global_symbol_hash(entry->name);
+			if (!lookup_global_symbol(entry->name, hash))
+				hash_add(priv.adsp_glo_sym_hash, &entry->node,
+					 hash);
 			i++;
 		}
 	}
@@ -512,21 +548,13 @@ __maybe_unused create_global_symbol_table(const struct firmware *fw)
 struct global_sym_info * __maybe_unused find_global_symbol(const char *sym_name)
 {
 	struct device *dev = &priv.pdev->dev;
-	struct global_sym_info *table = priv.adsp_glo_sym_tbl;
-	int num_ent;
-	int i;
 
-	if (unlikely(!table)) {
+	if (unlikely(!priv.adsp_glo_sym_tbl)) {
 		dev_err(dev, "symbol table not present\n");
 		return NULL;
 	}
-	num_ent = table[0].addr;
 
-	for (i = 1; i < num_ent; i++) {
-		if (!strncmp(table[i].name, sym_name, SYM_NAME_SZ))
-			return &table[i];
-	}
-	return NULL;
+	return lookup_global_symbol(sym_name, global_symbol_hash(sym_name));
 }
 
 static void *get_mailbox_shared_region(const struct firmware *fw)
@@ -967,21 +995,30 @@ static int nvadsp_firmware_load(struct platform_device *pdev)
 	struct nvadsp_drv_data *drv_data = platform_get_drvdata(pdev);
 	struct device *dev = &pdev->dev;
 	const struct firmware *fw;
+	bool own_fw = false;
 	int ret = 0;
 
-	ret = request_firmware(&fw, drv_data->adsp_elf, dev);
-	if (ret < 0) {
-		dev_err(dev, "reqest firmware for %s failed with %d\n",
-				drv_data->adsp_elf, ret);
-		goto end;
-	}
+	/* normally prefetched from probe, read it here if that failed */
+	if (priv.fw_prefetch &&
+	    !tegra_fw_boot_wait(&priv.fw_engine, MAX_SCHEDULE_TIMEOUT)) {
+		fw = priv.fw_engine.fw;
+	} else {
+		ret = request_firmware(&fw, drv_data->adsp_elf, dev);
+		if (ret < 0) {
+			dev_err(dev, "reqest firmware for %s failed with %d\n",
+					drv_data->adsp_elf, ret);
+			goto end;
+		}
+		own_fw = true;
 #ifdef CONFIG_ANDROID
-	ret = create_global_symbol_table(fw);
-	if (ret) {
-		dev_err(dev, "unable to create global symbol table\n");
-		goto release_firmware;
-	}
+		ret = create_global_symbol_table(fw);
+		if (ret) {
+			dev_err(dev, "unable to create global symbol table\n");
+			goto release_firmware;
+		}
 #endif
+	}
+
 	ret = allocate_memory_for_adsp_os();
 	if (ret) {
 		dev_err(dev, "unable to allocate memory for adsp os\n");
@@ -1032,7 +1069,8 @@ static int nvadsp_firmware_load(struct platform_device *pdev)
 deallocate_os_memory:
 	deallocate_memory_for_adsp_os();
 release_firmware:
-	release_firmware(fw);
+	if (own_fw)
+		release_firmware(fw);
 end:
 	return ret;
 
@@ -2604,6 +2642,26 @@ static ssize_t tegrafw_read_adsp(struct device *dev,
 	return strlen(data);
 }
 
+#ifdef CONFIG_ANDROID
+static int nvadsp_os_fw_prepare(struct tegra_fw_boot_engine *engine,
+				const struct firmware *fw)
+{
+	int ret;
+
+	ret = create_global_symbol_table(fw);
+	if (ret)
+		dev_err(engine->dev, "unable to create global symbol table\n");
+
+	return ret;
+}
+#endif
+
+static const struct tegra_fw_boot_ops nvadsp_os_fw_ops = {
+#ifdef CONFIG_ANDROID
+	.prepare = nvadsp_os_fw_prepare,
+#endif
+};
+
 int __init nvadsp_os_probe(struct platform_device *pdev)
 {
 	struct nvadsp_drv_data *drv_data = platform_get_drvdata(pdev);
@@ -2641,6 +2699,23 @@ int __init nvadsp_os_probe(struct platform_device *pdev)
 	mutex_init(&priv.os_run_lock);
 
 	priv.pdev = pdev;
+
+	/*
+	 * Read the OS image while the rest of the system boots, so that
+	 * nvadsp_os_load() does not have to wait for the file system.
+	 */
+	if (!drv_data->adsp_os_secload) {
+		priv.fw_engine.name = "adsp";
+		priv.fw_engine.fw_name = drv_data->adsp_elf;
+		priv.fw_engine.dev = dev;
+		priv.fw_engine.ops = &nvadsp_os_fw_ops;
+		if (tegra_fw_boot_register(&priv.fw_engine))
+			dev_warn(dev, "unable to prefetch %s\n",
+				 drv_data->adsp_elf);
+		else
+			priv.fw_prefetch = true;
+	}
+
 #ifdef CONFIG_DEBUG_FS
 	priv.logger.dev = &pdev->dev;
 	if (adsp_create_debug_logger(drv_data->adsp_debugfs_root))
@@ -2666,3 +2741,11 @@ int __init nvadsp_os_probe(struct platform_device *pdev)
 end:
 	return ret;
 }
+
+void nvadsp_os_remove(struct platform_device *pdev)
+{
+	if (priv.fw_prefetch) {
+		tegra_fw_boot_unregister(&priv.fw_engine);
+		priv.fw_prefetch = false;
+	}
+}
@@ -7,6 +7,7 @@
 #define __TEGRA_NVADSP_OS_H
 
 #include <linux/firmware.h>
+#include <linux/list.h>
 #include "adsp_shared_struct.h"
 
 #include "dev.h"
@@ -97,11 +98,13 @@ enum adsp_os_cmd {
  * @name:	Name of the symbol
  * @addr:	Address of the symbol
  * @info:	Type and binding attributes
+ * @node:	Entry in the symbol name hash table
  */
 struct global_sym_info {
 	char name[SYM_NAME_SZ];
 	uint32_t addr;
 	unsigned char info;
+	struct hlist_node node;
 };
 
 struct adsp_module {
@@ -167,6 +170,7 @@ static inline int nvadsp_os_init(struct platform_device *pdev)
 }
 
 int nvadsp_os_probe(struct platform_device *);
+void nvadsp_os_remove(struct platform_device *);
 int nvadsp_app_module_probe(struct platform_device *);
 void *nvadsp_da_to_va_mappings(u64 da, int len);
 int nvadsp_add_load_mappings(phys_addr_t pa, void *mapping, int len);
@@ -446,6 +446,8 @@ static void tegra_camrtc_ivc_notify(struct device *dev, u16 group)
 
 	if (rtcpu->ivc)
 		tegra_ivc_bus_notify(rtcpu->ivc, group);
+
+	tegra_rtcpu_trace_kick(rtcpu->tracer);
 }
 
 static int tegra_camrtc_poweron(struct device *dev, bool full_speed)
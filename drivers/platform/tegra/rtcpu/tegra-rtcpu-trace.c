@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: GPL-2.0
 // Copyright (c) 2022-2023, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
 
+#include <nvidia/conftest.h>
+
 #include "soc/tegra/camrtc-trace.h"
 
 #include <linux/completion.h>
@@ -10,14 +12,19 @@
 #include <linux/ioport.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
+#include <linux/kref.h>
 #include <linux/module.h>
 #include <linux/nospec.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
 #include <linux/of_reserved_mem.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
 #include <linux/printk.h>
 #include <linux/seq_buf.h>
 #include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
 #include <linux/tegra-camera-rtcpu.h>
 #include <linux/tegra-rtcpu-trace.h>
 #include <linux/workqueue.h>
@@ -41,6 +48,7 @@ EXPORT_TRACEPOINT_SYMBOL_GPL(capture_ivc_recv);
 #define NV(p) "nvidia," #p
 
 #define WORK_INTERVAL_DEFAULT		100
+#define WORK_INTERVAL_MIN_JIFFIES	1
 #define EXCEPTION_STR_LENGTH		2048
 
 /*
@@ -51,6 +59,8 @@ struct tegra_rtcpu_trace {
 	struct device *dev;
 	struct device_node *of_node;
 	struct mutex lock;
+	/* held by the driver, each raw file and each raw mapping */
+	struct kref ref;
 
 	/* memory */
 	void *trace_memory;
@@ -77,10 +87,19 @@ struct tegra_rtcpu_trace {
 	/* worker */
 	struct delayed_work work;
 	unsigned long work_interval_jiffies;
+	unsigned long cur_interval_jiffies;
+	/* pending events that trigger an immediate drain */
+	u32 event_watermark;
+	/* decode events into tracepoints, off when read raw from user space */
+	bool decode_events;
+
+	/* raw export, woken when new events have been drained */
+	wait_queue_head_t raw_wq;
 
 	/* statistics */
 	u32 n_exceptions;
 	u64 n_events;
+	u64 n_kicks;
 
 	/* copy of the latest exception and event */
 	char last_exception_str[EXCEPTION_STR_LENGTH];
@@ -1179,25 +1198,26 @@ static void rtcpu_trace_event(struct tegra_rtcpu_trace *tracer,
 	}
 }
 
-static inline void rtcpu_trace_events(struct tegra_rtcpu_trace *tracer)
+static inline u32 rtcpu_trace_events(struct tegra_rtcpu_trace *tracer)
 {
 	const struct camrtc_trace_memory_header *header = tracer->trace_memory;
 	u32 old_next = tracer->event_last_idx;
 	u32 new_next = header->event_next_idx;
 	struct camrtc_event_struct *event, *last_event;
+	u32 count = 0;
 
 	if (new_next >= tracer->event_entries) {
 		WARN_ON_ONCE(new_next >= tracer->event_entries);
 		dev_warn_ratelimited(tracer->dev,
 			"trace entry %u outside range 0..%u\n",
 			new_next, tracer->event_entries - 1);
-		return;
+		return 0;
 	}
 
 	new_next = array_index_nospec(new_next, tracer->event_entries);
 
 	if (old_next == new_next)
-		return;
+		return 0;
 
 	rtcpu_trace_invalidate_entries(tracer,
 				tracer->dma_handle_events,
@@ -1210,21 +1230,24 @@ static inline void rtcpu_trace_events(struct tegra_rtcpu_trace *tracer)
 		old_next = array_index_nospec(old_next, tracer->event_entries);
 		event = &tracer->events[old_next];
 		last_event = event;
-		rtcpu_trace_event(tracer, event);
-		tracer->n_events++;
+		if (tracer->decode_events)
+			rtcpu_trace_event(tracer, event);
+		count++;
 
 		if (++old_next == tracer->event_entries)
 			old_next = 0;
 	}
 
+	tracer->n_events += count;
 	tracer->event_last_idx = new_next;
 	tracer->copy_last_event = *last_event;
+
+	return count;
 }
 
-void tegra_rtcpu_trace_flush(struct tegra_rtcpu_trace *tracer)
+static u32 rtcpu_trace_drain(struct tegra_rtcpu_trace *tracer)
 {
-	if (tracer == NULL)
-		return;
+	u32 count;
 
 	mutex_lock(&tracer->lock);
 
@@ -1234,22 +1257,77 @@ void tegra_rtcpu_trace_flush(struct tegra_rtcpu_trace *tracer)
 
 	/* process exceptions and events */
 	rtcpu_trace_exceptions(tracer);
-	rtcpu_trace_events(tracer);
+	count = rtcpu_trace_events(tracer);
 
 	mutex_unlock(&tracer->lock);
+
+	if (count > 0)
+		wake_up_interruptible(&tracer->raw_wq);
+
+	return count;
+}
+
+void tegra_rtcpu_trace_flush(struct tegra_rtcpu_trace *tracer)
+{
+	if (tracer == NULL)
+		return;
+
+	rtcpu_trace_drain(tracer);
 }
 EXPORT_SYMBOL(tegra_rtcpu_trace_flush);
 
+/*
+ * Called when the RTCPU rings the doorbell. Drain at once if the ring
+ * has filled past the watermark, otherwise leave it to the worker.
+ */
+void tegra_rtcpu_trace_kick(struct tegra_rtcpu_trace *tracer)
+{
+	const struct camrtc_trace_memory_header *header;
+	u32 next, last, pending;
+
+	if (tracer == NULL)
+		return;
+
+	header = tracer->trace_memory;
+	next = READ_ONCE(header->event_next_idx);
+	last = READ_ONCE(tracer->event_last_idx);
+	if (unlikely(next >= tracer->event_entries))
+		return;
+
+	pending = (next + tracer->event_entries - last) % tracer->event_entries;
+	if (pending < READ_ONCE(tracer->event_watermark))
+		return;
+
+	tracer->n_kicks++;
+	mod_delayed_work(system_wq, &tracer->work, 0);
+}
+EXPORT_SYMBOL(tegra_rtcpu_trace_kick);
+
 static void rtcpu_trace_worker(struct work_struct *work)
 {
 	struct tegra_rtcpu_trace *tracer;
+	unsigned long interval;
+	u32 count;
 
 	tracer = container_of(work, struct tegra_rtcpu_trace, work.work);
 
-	tegra_rtcpu_trace_flush(tracer);
-
-	/* reschedule */
-	schedule_delayed_work(&tracer->work, tracer->work_interval_jiffies);
+	count = rtcpu_trace_drain(tracer);
+
+	/*
+	 * Poll faster while events keep arriving and back off to the
+	 * configured interval once the ring goes quiet.
+	 */
+	interval = tracer->cur_interval_jiffies;
+	if (count >= READ_ONCE(tracer->event_watermark))
+		interval = WORK_INTERVAL_MIN_JIFFIES;
+	else if (count > 0)
+		interval = max(interval / 2, (unsigned long)WORK_INTERVAL_MIN_JIFFIES);
+	else
+		interval = min(interval * 2, tracer->work_interval_jiffies);
+	tracer->cur_interval_jiffies = interval;
+
+	/* reschedule, unless kicked meanwhile */
+	queue_delayed_work(system_wq, &tracer->work, interval);
 }
 
 /*
@@ -1274,6 +1352,9 @@ static int rtcpu_trace_debugfs_stats_read(
 
 	seq_printf(file, "Exceptions: %u\nEvents: %llu\n",
 			tracer->n_exceptions, tracer->n_events);
+	seq_printf(file, "Kicks: %llu\nInterval: %u ms\n",
+			tracer->n_kicks,
+			jiffies_to_msecs(tracer->cur_interval_jiffies));
 
 	return 0;
 }
@@ -1341,6 +1422,196 @@ static int rtcpu_trace_debugfs_last_event_read(
 DEFINE_SEQ_FOPS(rtcpu_trace_debugfs_last_event,
 	rtcpu_trace_debugfs_last_event_read);
 
+static int rtcpu_trace_debugfs_watermark_get(void *data, u64 *val)
+{
+	struct tegra_rtcpu_trace *tracer = data;
+
+	*val = READ_ONCE(tracer->event_watermark);
+
+	return 0;
+}
+
+static int rtcpu_trace_debugfs_watermark_set(void *data, u64 val)
+{
+	struct tegra_rtcpu_trace *tracer = data;
+
+	/* 0 would drain and kick continuously */
+	WRITE_ONCE(tracer->event_watermark,
+		clamp_t(u64, val, 1, tracer->event_entries));
+
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(rtcpu_trace_debugfs_watermark,
+			rtcpu_trace_debugfs_watermark_get,
+			rtcpu_trace_debugfs_watermark_set, "%llu\n");
+
+/*
+ * Trace memory and tracer are freed with the last reference, which may
+ * be a raw file or mapping that outlives tegra_rtcpu_trace_destroy().
+ */
+static void rtcpu_trace_release(struct kref *ref)
+{
+	struct tegra_rtcpu_trace *tracer =
+		container_of(ref, struct tegra_rtcpu_trace, ref);
+	struct device *dev = tracer->dev;
+
+	dma_free_coherent(dev, tracer->trace_memory_size,
+			tracer->trace_memory, tracer->dma_handle);
+	kfree(tracer);
+	put_device(dev);
+}
+
+static void rtcpu_trace_put(struct tegra_rtcpu_trace *tracer)
+{
+	kref_put(&tracer->ref, rtcpu_trace_release);
+}
+
+/*
+ * Raw export: user space maps the trace memory read-only and decodes
+ * the event ring itself. read() returns a struct rtcpu_trace_raw_pos
+ * with the ring position the driver has drained up to; poll() reports
+ * readable once that position moves.
+ */
+struct rtcpu_trace_raw_pos {
+	u32 exception_next_idx;
+	u32 event_next_idx;
+	u64 n_events;
+};
+
+struct rtcpu_trace_raw_file {
+	struct tegra_rtcpu_trace *tracer;
+	u64 n_events_seen;
+};
+
+static int rtcpu_trace_raw_open(struct inode *inode, struct file *file)
+{
+	struct tegra_rtcpu_trace *tracer;
+	struct rtcpu_trace_raw_file *raw;
+	int ret;
+
+	raw = kzalloc(sizeof(*raw), GFP_KERNEL);
+	if (raw == NULL)
+		return -ENOMEM;
+
+	/* the file is not proxied, make sure the tracer is still there */
+	ret = debugfs_file_get(file->f_path.dentry);
+	if (ret) {
+		kfree(raw);
+		return ret;
+	}
+	tracer = inode->i_private;
+	kref_get(&tracer->ref);
+	debugfs_file_put(file->f_path.dentry);
+
+	raw->tracer = tracer;
+	file->private_data = raw;
+
+	return nonseekable_open(inode, file);
+}
+
+static int rtcpu_trace_raw_release(struct inode *inode, struct file *file)
+{
+	struct rtcpu_trace_raw_file *raw = file->private_data;
+
+	rtcpu_trace_put(raw->tracer);
+	kfree(raw);
+
+	return 0;
+}
+
+static ssize_t rtcpu_trace_raw_read(struct file *file, char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	struct rtcpu_trace_raw_file *raw = file->private_data;
+	struct tegra_rtcpu_trace *tracer = raw->tracer;
+	struct rtcpu_trace_raw_pos pos;
+
+	if (count < sizeof(pos))
+		return -EINVAL;
+
+	mutex_lock(&tracer->lock);
+	pos.exception_next_idx = tracer->exception_last_idx;
+	pos.event_next_idx = tracer->event_last_idx;
+	pos.n_events = tracer->n_events;
+	mutex_unlock(&tracer->lock);
+
+	if (copy_to_user(buf, &pos, sizeof(pos)))
+		return -EFAULT;
+
+	raw->n_events_seen = pos.n_events;
+
+	return sizeof(pos);
+}
+
+static __poll_t rtcpu_trace_raw_poll(struct file *file, poll_table *wait)
+{
+	struct rtcpu_trace_raw_file *raw = file->private_data;
+	struct tegra_rtcpu_trace *tracer = raw->tracer;
+
+	poll_wait(file, &tracer->raw_wq, wait);
+
+	if (READ_ONCE(tracer->n_events) != raw->n_events_seen)
+		return EPOLLIN | EPOLLRDNORM;
+
+	return 0;
+}
+
+static void rtcpu_trace_raw_vm_open(struct vm_area_struct *vma)
+{
+	struct tegra_rtcpu_trace *tracer = vma->vm_private_data;
+
+	kref_get(&tracer->ref);
+}
+
+static void rtcpu_trace_raw_vm_close(struct vm_area_struct *vma)
+{
+	rtcpu_trace_put(vma->vm_private_data);
+}
+
+static const struct vm_operations_struct rtcpu_trace_raw_vm_ops = {
+	.open = rtcpu_trace_raw_vm_open,
+	.close = rtcpu_trace_raw_vm_close,
+};
+
+static int rtcpu_trace_raw_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct rtcpu_trace_raw_file *raw = file->private_data;
+	struct tegra_rtcpu_trace *tracer = raw->tracer;
+	int ret;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+#if defined(NV_VM_AREA_STRUCT_HAS_CONST_VM_FLAGS) /* Linux v6.3 */
+	vm_flags_clear(vma, VM_MAYWRITE);
+#else
+	vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+
+	ret = dma_mmap_coherent(tracer->dev, vma, tracer->trace_memory,
+			tracer->dma_handle, tracer->trace_memory_size);
+	if (ret)
+		return ret;
+
+	/* the mapping keeps the trace memory alive */
+	vma->vm_private_data = tracer;
+	vma->vm_ops = &rtcpu_trace_raw_vm_ops;
+	kref_get(&tracer->ref);
+
+	return 0;
+}
+
+static const struct file_operations rtcpu_trace_debugfs_raw = {
+	.owner = THIS_MODULE,
+	.open = rtcpu_trace_raw_open,
+	.release = rtcpu_trace_raw_release,
+	.read = rtcpu_trace_raw_read,
+	.poll = rtcpu_trace_raw_poll,
+	.mmap = rtcpu_trace_raw_mmap,
+	.llseek = no_llseek,
+};
+
 static void rtcpu_trace_debugfs_deinit(struct tegra_rtcpu_trace *tracer)
 {
 	debugfs_remove_recursive(tracer->debugfs_root);
@@ -1369,6 +1640,20 @@ static void rtcpu_trace_debugfs_init(struct tegra_rtcpu_trace *tracer)
 	if (IS_ERR_OR_NULL(entry))
 		goto failed_create;
 
+	/* unproxied, the debugfs proxy has no mmap; lifetime is the kref */
+	entry = debugfs_create_file_unsafe("raw", S_IRUSR,
+	    tracer->debugfs_root, tracer, &rtcpu_trace_debugfs_raw);
+	if (IS_ERR_OR_NULL(entry))
+		goto failed_create;
+
+	entry = debugfs_create_file("watermark", S_IRUGO | S_IWUSR,
+	    tracer->debugfs_root, tracer, &rtcpu_trace_debugfs_watermark);
+	if (IS_ERR_OR_NULL(entry))
+		goto failed_create;
+
+	debugfs_create_bool("decode", S_IRUGO | S_IWUSR,
+	    tracer->debugfs_root, &tracer->decode_events);
+
 	return;
 
 failed_create:
@@ -1392,6 +1677,9 @@ struct tegra_rtcpu_trace *tegra_rtcpu_trace_create(struct device *dev,
 
 	tracer->dev = dev;
 	mutex_init(&tracer->lock);
+	kref_init(&tracer->ref);
+	init_waitqueue_head(&tracer->raw_wq);
+	tracer->decode_events = true;
 
 	/* Get the trace memory */
 	ret = rtcpu_trace_setup_memory(tracer);
@@ -1400,10 +1688,18 @@ struct tegra_rtcpu_trace *tegra_rtcpu_trace_create(struct device *dev,
 		kfree(tracer);
 		return NULL;
 	}
+	/* released with the trace memory, see rtcpu_trace_release() */
+	get_device(dev);
 
 	/* Initialize the trace memory */
 	rtcpu_trace_init_memory(tracer);
 
+	tracer->event_watermark = tracer->event_entries / 4;
+	of_property_read_u32(tracer->of_node, NV(event-watermark),
+			&tracer->event_watermark);
+	tracer->event_watermark = clamp_t(u32, tracer->event_watermark, 1,
+			tracer->event_entries);
+
 	/* Debugfs */
 	rtcpu_trace_debugfs_init(tracer);
 
@@ -1434,8 +1730,7 @@ struct tegra_rtcpu_trace *tegra_rtcpu_trace_create(struct device *dev,
 	param = WORK_INTERVAL_DEFAULT;
 	if (of_property_read_u32(tracer->of_node, NV(interval-ms), &param)) {
 		dev_err(dev, "interval-ms property not present\n");
-		kfree(tracer);
-		return NULL;
+		goto fail;
 	}
 
 	tracer->enable_printk = of_property_read_bool(tracer->of_node,
@@ -1445,12 +1740,12 @@ struct tegra_rtcpu_trace *tegra_rtcpu_trace_create(struct device *dev,
 	if (of_property_read_string(tracer->of_node, NV(log-prefix),
 				&tracer->log_prefix)) {
 		dev_err(dev, "RTCPU property not present\n");
-		kfree(tracer);
-		return NULL;
+		goto fail;
 	}
 
 	INIT_DELAYED_WORK(&tracer->work, rtcpu_trace_worker);
 	tracer->work_interval_jiffies = msecs_to_jiffies(param);
+	tracer->cur_interval_jiffies = tracer->work_interval_jiffies;
 
 	/* Done with initialization */
 	schedule_delayed_work(&tracer->work, 0);
@@ -1459,6 +1754,15 @@ struct tegra_rtcpu_trace *tegra_rtcpu_trace_create(struct device *dev,
 		 (u32)tracer->dma_handle);
 
 	return tracer;
+
+fail:
+	rtcpu_trace_debugfs_deinit(tracer);
+	platform_device_put(tracer->isp_platform_device);
+	platform_device_put(tracer->vi_platform_device);
+	platform_device_put(tracer->vi1_platform_device);
+	of_node_put(tracer->of_node);
+	rtcpu_trace_put(tracer);
+	return NULL;
 }
 EXPORT_SYMBOL(tegra_rtcpu_trace_create);
 
@@ -1490,9 +1794,9 @@ void tegra_rtcpu_trace_destroy(struct tegra_rtcpu_trace *tracer)
 	cancel_delayed_work_sync(&tracer->work);
 	flush_delayed_work(&tracer->work);
 	rtcpu_trace_debugfs_deinit(tracer);
-	dma_free_coherent(tracer->dev, tracer->trace_memory_size,
-			tracer->trace_memory, tracer->dma_handle);
-	kfree(tracer);
+	/* raw readers see no further progress */
+	wake_up_interruptible_all(&tracer->raw_wq);
+	rtcpu_trace_put(tracer);
 }
 EXPORT_SYMBOL(tegra_rtcpu_trace_destroy);
 
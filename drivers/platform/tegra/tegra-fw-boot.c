@@ -0,0 +1,469 @@
+// SPDX-License-Identifier: GPL-2.0-only
+// SPDX-FileCopyrightText: Copyright (c) 2024 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+/*
+ * Firmware boot orchestration for Tegra coprocessors.
+ *
+ * Engines register with an optional firmware image and a list of engines
+ * they depend on. Images of all engines are read and prepared in parallel
+ * on an unbound workqueue as soon as the engine registers, independent of
+ * dependencies. An engine boots once its image is ready and all of its
+ * dependencies have booted; engines that do not depend on each other boot
+ * in parallel. A failed engine fails everything that depends on it.
+ */
+
+#define pr_fmt(fmt) "tegra-fw-boot: " fmt
+
+#include <nvidia/conftest.h>
+
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/err.h>
+#include <linux/firmware.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/platform/tegra/tegra-fw-boot.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+
+static DEFINE_MUTEX(fw_boot_lock);
+static LIST_HEAD(fw_boot_engines);
+static struct workqueue_struct *fw_boot_wq;
+/* timeline origin, time of the first registration */
+static ktime_t fw_boot_epoch;
+
+static const char * const fw_boot_state_name[] = {
+	[TEGRA_FW_BOOT_FETCHING] = "fetching",
+	[TEGRA_FW_BOOT_WAITING] = "waiting",
+	[TEGRA_FW_BOOT_BOOTING] = "booting",
+	[TEGRA_FW_BOOT_DONE] = "done",
+	[TEGRA_FW_BOOT_FAILED] = "failed",
+};
+
+static struct tegra_fw_boot_engine *fw_boot_find(const char *name)
+{
+	struct tegra_fw_boot_engine *engine;
+
+	list_for_each_entry(engine, &fw_boot_engines, node) {
+		if (!strcmp(engine->name, name))
+			return engine;
+	}
+
+	return NULL;
+}
+
+static void fw_boot_finish(struct tegra_fw_boot_engine *engine, int status)
+{
+	engine->status = status;
+	engine->state = status ? TEGRA_FW_BOOT_FAILED : TEGRA_FW_BOOT_DONE;
+	complete_all(&engine->done);
+}
+
+/*
+ * Returns 0 when all dependencies have booted, -EAGAIN while some are
+ * still pending or not registered yet, -ENODEV if one of them failed.
+ */
+static int fw_boot_deps_ready(struct tegra_fw_boot_engine *engine)
+{
+	const char * const *dep;
+
+	for (dep = engine->deps; dep && *dep; dep++) {
+		struct tegra_fw_boot_engine *d = fw_boot_find(*dep);
+
+		if (!d)
+			return -EAGAIN;
+
+		if (d->state == TEGRA_FW_BOOT_FAILED) {
+			pr_err("%s: dependency %s failed\n", engine->name, *dep);
+			return -ENODEV;
+		}
+
+		if (d->state != TEGRA_FW_BOOT_DONE)
+			return -EAGAIN;
+	}
+
+	return 0;
+}
+
+/* Start every waiting engine whose dependencies are met */
+static void fw_boot_schedule(void)
+{
+	struct tegra_fw_boot_engine *engine;
+	bool changed;
+	int ret;
+
+	lockdep_assert_held(&fw_boot_lock);
+
+	do {
+		changed = false;
+		list_for_each_entry(engine, &fw_boot_engines, node) {
+			if (engine->state != TEGRA_FW_BOOT_WAITING)
+				continue;
+
+			ret = fw_boot_deps_ready(engine);
+			if (ret == -EAGAIN)
+				continue;
+
+			if (ret) {
+				/* may unblock failure of its dependents */
+				fw_boot_finish(engine, ret);
+				changed = true;
+				continue;
+			}
+
+			engine->state = TEGRA_FW_BOOT_BOOTING;
+			engine->t_boot_start = ktime_get();
+			queue_work(fw_boot_wq, &engine->work);
+		}
+	} while (changed);
+}
+
+static void fw_boot_work(struct work_struct *work)
+{
+	struct tegra_fw_boot_engine *engine =
+		container_of(work, struct tegra_fw_boot_engine, work);
+	const struct firmware *fw;
+	enum tegra_fw_boot_state state;
+	int ret = 0;
+
+	mutex_lock(&fw_boot_lock);
+	state = engine->state;
+	fw = engine->fw;
+	mutex_unlock(&fw_boot_lock);
+
+	if (state == TEGRA_FW_BOOT_FETCHING) {
+		ret = request_firmware(&fw, engine->fw_name, engine->dev);
+		if (!ret && engine->ops && engine->ops->prepare) {
+			ret = engine->ops->prepare(engine, fw);
+			if (ret)
+				release_firmware(fw);
+		}
+
+		mutex_lock(&fw_boot_lock);
+		engine->t_fetched = ktime_get();
+		if (ret) {
+			pr_err("%s: failed to prepare %s: %d\n",
+			       engine->name, engine->fw_name, ret);
+			fw_boot_finish(engine, ret);
+		} else {
+			engine->fw = fw;
+			engine->state = TEGRA_FW_BOOT_WAITING;
+		}
+	} else if (state == TEGRA_FW_BOOT_BOOTING) {
+		if (engine->ops && engine->ops->boot)
+			ret = engine->ops->boot(engine, fw);
+
+		mutex_lock(&fw_boot_lock);
+		engine->t_boot_end = ktime_get();
+		if (ret)
+			pr_err("%s: boot failed: %d\n", engine->name, ret);
+		fw_boot_finish(engine, ret);
+	} else {
+		return;
+	}
+
+	fw_boot_schedule();
+	mutex_unlock(&fw_boot_lock);
+}
+
+/**
+ * tegra_fw_boot_register - Hand an engine over to the orchestrator.
+ *
+ * @engine : Engine with name, fw_name, deps, dev and ops filled in.
+ *
+ * Reading the image starts right away; the engine boots asynchronously
+ * once its dependencies have booted. Use tegra_fw_boot_wait() to wait
+ * for the outcome.
+ *
+ * Return : 0 if successful, -EEXIST if the name is already registered.
+ */
+int tegra_fw_boot_register(struct tegra_fw_boot_engine *engine)
+{
+	int ret = 0;
+
+	if (!engine || !engine->name)
+		return -EINVAL;
+
+	mutex_lock(&fw_boot_lock);
+
+	if (fw_boot_find(engine->name)) {
+		pr_err("%s: engine already registered\n", engine->name);
+		ret = -EEXIST;
+		goto unlock;
+	}
+
+	INIT_WORK(&engine->work, fw_boot_work);
+	init_completion(&engine->done);
+	engine->fw = NULL;
+	engine->status = 0;
+	engine->t_register = ktime_get();
+	engine->t_fetched = 0;
+	engine->t_boot_start = 0;
+	engine->t_boot_end = 0;
+	if (!fw_boot_epoch)
+		fw_boot_epoch = engine->t_register;
+
+	list_add_tail(&engine->node, &fw_boot_engines);
+
+	if (engine->fw_name) {
+		engine->state = TEGRA_FW_BOOT_FETCHING;
+		queue_work(fw_boot_wq, &engine->work);
+	} else {
+		engine->state = TEGRA_FW_BOOT_WAITING;
+		engine->t_fetched = engine->t_register;
+	}
+
+	/* the new engine may also be the dependency others wait for */
+	fw_boot_schedule();
+
+unlock:
+	mutex_unlock(&fw_boot_lock);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(tegra_fw_boot_register);
+
+/**
+ * tegra_fw_boot_unregister - Remove an engine and drop its cached image.
+ *
+ * @engine : Registered engine.
+ *
+ * Waits for a running prepare or boot callback of the engine. Engines
+ * depending on it keep waiting until it is registered again.
+ */
+void tegra_fw_boot_unregister(struct tegra_fw_boot_engine *engine)
+{
+	mutex_lock(&fw_boot_lock);
+	list_del_init(&engine->node);
+	mutex_unlock(&fw_boot_lock);
+
+	cancel_work_sync(&engine->work);
+
+	mutex_lock(&fw_boot_lock);
+	if (engine->state != TEGRA_FW_BOOT_DONE &&
+	    engine->state != TEGRA_FW_BOOT_FAILED)
+		fw_boot_finish(engine, -ENODEV);
+	mutex_unlock(&fw_boot_lock);
+
+	release_firmware(engine->fw);
+	engine->fw = NULL;
+}
+EXPORT_SYMBOL_GPL(tegra_fw_boot_unregister);
+
+/**
+ * tegra_fw_boot_wait - Wait for an engine to boot.
+ *
+ * @engine  : Registered engine.
+ * @timeout : Timeout in jiffies, MAX_SCHEDULE_TIMEOUT to wait forever.
+ *
+ * Return : 0 if the engine booted, the error of its prepare or boot
+ *          callback, -ENODEV if a dependency failed, -ETIMEDOUT or
+ *          -ERESTARTSYS if the wait was cut short.
+ */
+int tegra_fw_boot_wait(struct tegra_fw_boot_engine *engine,
+		       unsigned long timeout)
+{
+	long ret;
+
+	ret = wait_for_completion_killable_timeout(&engine->done, timeout);
+	if (ret < 0)
+		return ret;
+	if (ret == 0)
+		return -ETIMEDOUT;
+
+	return engine->status;
+}
+EXPORT_SYMBOL_GPL(tegra_fw_boot_wait);
+
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *fw_boot_debugfs;
+
+static s64 fw_boot_us(ktime_t t)
+{
+	return t ? ktime_us_delta(t, fw_boot_epoch) : -1;
+}
+
+static int fw_boot_timeline_show(struct seq_file *s, void *data)
+{
+	struct tegra_fw_boot_engine *engine;
+
+	seq_printf(s, "%-16s %-8s %6s %10s %10s %10s %10s\n",
+		   "engine", "state", "status", "reg(us)", "fetch(us)",
+		   "start(us)", "end(us)");
+
+	mutex_lock(&fw_boot_lock);
+	list_for_each_entry(engine, &fw_boot_engines, node) {
+		seq_printf(s, "%-16s %-8s %6d %10lld %10lld %10lld %10lld\n",
+			   engine->name, fw_boot_state_name[engine->state],
+			   engine->status, fw_boot_us(engine->t_register),
+			   fw_boot_us(engine->t_fetched),
+			   fw_boot_us(engine->t_boot_start),
+			   fw_boot_us(engine->t_boot_end));
+	}
+	mutex_unlock(&fw_boot_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(fw_boot_timeline);
+
+/*
+ * Stub engines simulate boot latency and failures without hardware:
+ *   echo "<name> <boot ms> <result> [dep ...]" > stub
+ *   echo clear > stub
+ */
+#define FW_BOOT_STUB_NAME_LEN	32
+#define FW_BOOT_STUB_MAX_DEPS	8
+
+struct fw_boot_stub {
+	struct tegra_fw_boot_engine engine;
+	struct list_head node;
+	char name[FW_BOOT_STUB_NAME_LEN];
+	unsigned int boot_ms;
+	int result;
+	char *args;
+	const char *deps[FW_BOOT_STUB_MAX_DEPS + 1];
+};
+
+static DEFINE_MUTEX(fw_boot_stub_lock);
+static LIST_HEAD(fw_boot_stubs);
+
+static int fw_boot_stub_boot(struct tegra_fw_boot_engine *engine,
+			     const struct firmware *fw)
+{
+	struct fw_boot_stub *stub =
+		container_of(engine, struct fw_boot_stub, engine);
+
+	msleep(stub->boot_ms);
+
+	return stub->result;
+}
+
+static const struct tegra_fw_boot_ops fw_boot_stub_ops = {
+	.boot = fw_boot_stub_boot,
+};
+
+static void fw_boot_stub_clear(void)
+{
+	struct fw_boot_stub *stub, *tmp;
+
+	mutex_lock(&fw_boot_stub_lock);
+	list_for_each_entry_safe(stub, tmp, &fw_boot_stubs, node) {
+		tegra_fw_boot_unregister(&stub->engine);
+		list_del(&stub->node);
+		kfree(stub->args);
+		kfree(stub);
+	}
+	mutex_unlock(&fw_boot_stub_lock);
+}
+
+static ssize_t fw_boot_stub_write(struct file *file, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	struct fw_boot_stub *stub;
+	char *args, *cur, *dep;
+	unsigned int i = 0;
+	int ret, n = 0;
+
+	args = memdup_user_nul(buf, count);
+	if (IS_ERR(args))
+		return PTR_ERR(args);
+
+	cur = strim(args);
+	if (!strcmp(cur, "clear")) {
+		kfree(args);
+		fw_boot_stub_clear();
+		return count;
+	}
+
+	stub = kzalloc(sizeof(*stub), GFP_KERNEL);
+	if (!stub) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	if (sscanf(cur, "%31s %u %d %n", stub->name, &stub->boot_ms,
+		   &stub->result, &n) != 3) {
+		ret = -EINVAL;
+		goto err;
+	}
+
+	cur += n;
+	while ((dep = strsep(&cur, " ")) != NULL) {
+		if (!*dep)
+			continue;
+		if (i == FW_BOOT_STUB_MAX_DEPS) {
+			ret = -E2BIG;
+			goto err;
+		}
+		stub->deps[i++] = dep;
+	}
+
+	stub->args = args;
+	stub->engine.name = stub->name;
+	stub->engine.deps = stub->deps;
+	stub->engine.ops = &fw_boot_stub_ops;
+
+	mutex_lock(&fw_boot_stub_lock);
+	ret = tegra_fw_boot_register(&stub->engine);
+	if (!ret)
+		list_add_tail(&stub->node, &fw_boot_stubs);
+	mutex_unlock(&fw_boot_stub_lock);
+	if (ret)
+		goto err;
+
+	return count;
+
+err:
+	kfree(stub);
+	kfree(args);
+	return ret;
+}
+
+static const struct file_operations fw_boot_stub_fops = {
+	.open = simple_open,
+	.write = fw_boot_stub_write,
+	.llseek = noop_llseek,
+};
+
+static void fw_boot_debugfs_init(void)
+{
+	fw_boot_debugfs = debugfs_create_dir("tegra_fw_boot", NULL);
+	debugfs_create_file("timeline", 0444, fw_boot_debugfs, NULL,
+			    &fw_boot_timeline_fops);
+	debugfs_create_file("stub", 0200, fw_boot_debugfs, NULL,
+			    &fw_boot_stub_fops);
+}
+
+static void fw_boot_debugfs_exit(void)
+{
+	debugfs_remove_recursive(fw_boot_debugfs);
+	fw_boot_stub_clear();
+}
+#else
+static inline void fw_boot_debugfs_init(void) { }
+static inline void fw_boot_debugfs_exit(void) { }
+#endif /* CONFIG_DEBUG_FS */
+
+static int __init tegra_fw_boot_init(void)
+{
+	fw_boot_wq = alloc_workqueue("tegra-fw-boot", WQ_UNBOUND, 0);
+	if (!fw_boot_wq)
+		return -ENOMEM;
+
+	fw_boot_debugfs_init();
+
+	return 0;
+}
+module_init(tegra_fw_boot_init);
+
+static void __exit tegra_fw_boot_exit(void)
+{
+	fw_boot_debugfs_exit();
+	destroy_workqueue(fw_boot_wq);
+}
+module_exit(tegra_fw_boot_exit);
+
+MODULE_DESCRIPTION("Tegra coprocessor firmware boot orchestrator");
+MODULE_AUTHOR("NVIDIA Corporation");
+MODULE_LICENSE("GPL");
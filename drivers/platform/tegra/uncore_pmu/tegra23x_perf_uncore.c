@@ -6,6 +6,7 @@
 #include <linux/of.h>
 #include <linux/platform_device.h>
 #include <linux/bitops.h>
+#include <linux/cpumask.h>
 #include <linux/errno.h>
 #include <linux/interrupt.h>
 #include <linux/kernel.h>
@@ -13,6 +14,7 @@
 #include <linux/sysfs.h>
 #include <linux/perf_event.h>
 #include <linux/platform_device.h>
+#include <linux/percpu.h>
 #include <linux/types.h>
 #include <linux/sched/clock.h>
 #include <asm/irq_regs.h>
@@ -126,9 +128,29 @@ static struct attribute_group scf_uncore_pmu_format_group = {
 	.attrs = scf_uncore_pmu_formats,
 };
 
+/* CPU0 does all uncore counting, let the perf tool open events there only */
+static ssize_t scf_uncore_pmu_cpumask_show(struct device *dev,
+					   struct device_attribute *attr, char *buf)
+{
+	return cpumap_print_to_pagebuf(true, buf, cpumask_of(0));
+}
+
+static struct device_attribute scf_uncore_pmu_cpumask_attr =
+	__ATTR(cpumask, 0444, scf_uncore_pmu_cpumask_show, NULL);
+
+static struct attribute *scf_uncore_pmu_cpumask_attrs[] = {
+	&scf_uncore_pmu_cpumask_attr.attr,
+	NULL,
+};
+
+static struct attribute_group scf_uncore_pmu_cpumask_group = {
+	.attrs = scf_uncore_pmu_cpumask_attrs,
+};
+
 static const struct attribute_group *scf_uncore_pmu_attr_grps[] = {
 	&scf_uncore_pmu_events_group,
 	&scf_uncore_pmu_format_group,
+	&scf_uncore_pmu_cpumask_group,
 	NULL,
 };
 
@@ -137,12 +159,16 @@ struct uncore_unit {
 	u32 nv_unit_id;
 	struct perf_event *events[UNIT_CTRS];
 	DECLARE_BITMAP(used_ctrs, UNIT_CTRS);
+	/* Counters to read when the current PERF_PMU_TXN_READ commits */
+	DECLARE_BITMAP(txn_read, UNIT_CTRS);
 };
 
 struct uncore_pmu {
 	struct platform_device *pdev;
 	struct pmu pmu;
 	struct uncore_unit scf;
+	/* Flags of the transaction open on each CPU */
+	unsigned int __percpu *txn_flags;
 };
 
 static inline struct uncore_pmu *to_uncore_pmu(struct pmu *pmu)
@@ -200,6 +226,39 @@ static u32 mce_perfmon_read(struct uncore_unit* unit, uint8_t reg,
 	return data;
 }
 
+/*
+ * Read @count registers of a unit in one call into the MCE driver. Used
+ * wherever several registers are needed at once, so that they are sampled
+ * back to back instead of one ARI round trip per caller.
+ */
+static int mce_perfmon_read_batch(struct uncore_unit *unit, const uint8_t *reg,
+		const uint8_t *counter, u32 *data, u32 count)
+{
+	union dmce_perfmon_ari_request_hi_t r;
+	u32 req[UNIT_CTRS];
+	u32 i;
+	int status;
+
+	if (WARN_ON(count > UNIT_CTRS))
+		return -EINVAL;
+
+	for (i = 0; i < count; i++) {
+		r.flat = 0;
+		r.bits.command = DMCE_PERFMON_COMMAND_READ;
+		r.bits.group = unit->nv_group_id;
+		r.bits.unit = unit->nv_unit_id;
+		r.bits.reg = reg[i];
+		r.bits.counter = counter[i];
+		req[i] = r.flat;
+	}
+
+	status = tegra_mce_read_uncore_perfmon_batch(req, data, count);
+	if (status)
+		pr_err("perfmon batch read of %u regs failed: %d", count, status);
+
+	return status;
+}
+
 static void mce_perfmon_write(struct uncore_unit* unit, uint8_t reg,
 		uint8_t counter, u32 value)
 {
@@ -300,12 +359,25 @@ static void scf_uncore_event_start(struct perf_event *event, int flags) {
 	mce_perfmon_write(uncore_unit, NV_PMCNTENSET, 0, BIT(idx));
 }
 
+static void scf_uncore_event_add_delta(struct perf_event *event, u64 prev,
+		u64 now, bool ovf)
+{
+	u64 delta = 0;
+
+	if (prev > now)
+		delta = MAX_COUNTER - prev + now;
+	else
+		/* Either an incremental read, or fielding an IRQ from a ctr overflow */
+		delta = now - prev + (ovf ? MAX_COUNTER : 0);
+
+	local64_add(delta, &event->count);
+}
+
 static void scf_uncore_event_update(
 		struct uncore_unit *uncore_unit, struct perf_event *event, bool ovf)
 {
 	struct hw_perf_event *hwc = &event->hw;
 	u32 idx = hwc->idx;
-	u64 delta = 0;
 	u64 prev = 0;
 	u64 now = 0;
 
@@ -314,13 +386,70 @@ static void scf_uncore_event_update(
 		now = mce_perfmon_read(uncore_unit, NV_PMEVCNTR, idx);
 	} while (local64_cmpxchg(&hwc->prev_count, prev, now) != prev);
 
-	if (prev > now)
-		delta = MAX_COUNTER - prev + now;
-	else
-		/* Either an incremental read, or fielding an IRQ from a ctr overflow */
-		delta = now - prev + (ovf ? MAX_COUNTER : 0);
+	scf_uncore_event_add_delta(event, prev, now, ovf);
+}
 
-	local64_add(delta, &event->count);
+/*
+ * Account a counter value read earlier in a batch. If prev_count moved
+ * since the batch was issued, for example because the overflow IRQ ran
+ * on another CPU, the value may be older than prev_count, so read the
+ * counter again instead.
+ */
+static void scf_uncore_event_update_count(struct uncore_unit *uncore_unit,
+		struct perf_event *event, u64 prev, u64 now, bool ovf)
+{
+	struct hw_perf_event *hwc = &event->hw;
+
+	if (local64_cmpxchg(&hwc->prev_count, prev, now) != prev) {
+		scf_uncore_event_update(uncore_unit, event, ovf);
+		return;
+	}
+
+	scf_uncore_event_add_delta(event, prev, now, ovf);
+}
+
+/*
+ * Read every counter in @ctrs with a single batched MCE call and account
+ * the values to their events.
+ */
+static int scf_uncore_update_ctrs(struct uncore_unit *uncore_unit,
+		const unsigned long *ctrs, bool ovf)
+{
+	struct perf_event *events[UNIT_CTRS];
+	uint8_t reg[UNIT_CTRS];
+	uint8_t counter[UNIT_CTRS];
+	u64 prev[UNIT_CTRS];
+	u32 data[UNIT_CTRS];
+	u32 count = 0;
+	u32 idx;
+	u32 i;
+	int err;
+
+	for_each_set_bit(idx, ctrs, UNIT_CTRS) {
+		struct perf_event *event = uncore_unit->events[idx];
+
+		events[count] = event;
+		reg[count] = NV_PMEVCNTR;
+		counter[count] = idx;
+		/* snapshot before the read, so a concurrent update is noticed */
+		prev[count] = event ? local64_read(&event->hw.prev_count) : 0;
+		count++;
+	}
+
+	if (!count)
+		return 0;
+
+	err = mce_perfmon_read_batch(uncore_unit, reg, counter, data, count);
+	if (err)
+		return err;
+
+	for (i = 0; i < count; i++) {
+		if (events[i])
+			scf_uncore_event_update_count(uncore_unit, events[i],
+					prev[i], data[i], ovf);
+	}
+
+	return 0;
 }
 
 static void scf_uncore_event_stop(struct perf_event *event, int flags)
@@ -443,40 +572,110 @@ static void scf_uncore_event_read(struct perf_event *event)
 	if (unlikely(uncore_unit == NULL))
 		return;
 
+	/* Group read, the counter is read together with its siblings */
+	if (*this_cpu_ptr(uncore_pmu->txn_flags) & PERF_PMU_TXN_READ) {
+		set_bit(event->hw.idx, uncore_unit->txn_read);
+		return;
+	}
+
 	scf_uncore_event_update(uncore_unit, event, false);
 }
 
+/*
+ * Transactions. PERF_PMU_TXN_ADD keeps the counters disabled while a group
+ * is scheduled in, like the core does for PMUs without transactions.
+ * PERF_PMU_TXN_READ defers the reads of a PERF_FORMAT_GROUP group to
+ * commit, where all of them are fetched in one batched MCE call.
+ */
+static void scf_uncore_start_txn(struct pmu *pmu, unsigned int txn_flags)
+{
+	struct uncore_pmu *uncore_pmu = to_uncore_pmu(pmu);
+	unsigned int *flags = this_cpu_ptr(uncore_pmu->txn_flags);
+
+	WARN_ON_ONCE(*flags);
+	*flags = txn_flags;
+
+	/* CPU0 does all uncore counting, it alone owns txn_read */
+	if ((txn_flags & PERF_PMU_TXN_READ) && smp_processor_id() == 0)
+		bitmap_zero(uncore_pmu->scf.txn_read, UNIT_CTRS);
+
+	if (txn_flags & PERF_PMU_TXN_ADD)
+		perf_pmu_disable(pmu);
+}
+
+static int scf_uncore_commit_txn(struct pmu *pmu)
+{
+	struct uncore_pmu *uncore_pmu = to_uncore_pmu(pmu);
+	unsigned int *flags = this_cpu_ptr(uncore_pmu->txn_flags);
+	unsigned int txn_flags = *flags;
+	int err = 0;
+
+	WARN_ON_ONCE(!txn_flags);
+	*flags = 0;
+
+	if ((txn_flags & PERF_PMU_TXN_READ) && smp_processor_id() == 0)
+		err = scf_uncore_update_ctrs(&uncore_pmu->scf,
+				uncore_pmu->scf.txn_read, false);
+
+	if (txn_flags & PERF_PMU_TXN_ADD)
+		perf_pmu_enable(pmu);
+
+	return err;
+}
+
+static void scf_uncore_cancel_txn(struct pmu *pmu)
+{
+	struct uncore_pmu *uncore_pmu = to_uncore_pmu(pmu);
+	unsigned int *flags = this_cpu_ptr(uncore_pmu->txn_flags);
+	unsigned int txn_flags = *flags;
+
+	WARN_ON_ONCE(!txn_flags);
+	*flags = 0;
+
+	if (txn_flags & PERF_PMU_TXN_ADD)
+		perf_pmu_enable(pmu);
+}
+
 /*
  * Handle counter overflows. We have one interrupt for all uncore
  * counters, so iterate through active units to find overflow bits
  */
 static irqreturn_t scf_handle_irq(int irq_num, void *data)
 {
+	static const uint8_t status_reg[] = { NV_PMINTENCLR, NV_PMOVSCLR };
+	static const uint8_t status_ctr[] = { 0, 0 };
 	struct uncore_pmu *uncore_pmu = data;
 	struct uncore_unit *uncore_unit;
+	DECLARE_BITMAP(ovf_ctrs, UNIT_CTRS);
+	u32 status[2];
 	u32 int_en;
 	u32 ovf;
 	u32 idx;
 
 	uncore_unit = &uncore_pmu->scf;
 
-	int_en = mce_perfmon_read(uncore_unit, NV_PMINTENCLR, 0);
-	ovf = mce_perfmon_read(uncore_unit, NV_PMOVSCLR, 0);
+	if (mce_perfmon_read_batch(uncore_unit, status_reg, status_ctr,
+				   status, ARRAY_SIZE(status)))
+		return IRQ_NONE;
+
+	int_en = status[0];
+	ovf = status[1];
 
 	/* Disable the interrupt to prevent another interrupt during the handling */
 	mce_perfmon_write(uncore_unit, NV_PMINTENCLR, 0, int_en);
 
-	/* Find the counters that report overflow */
-	for_each_set_bit(idx, uncore_unit->used_ctrs, UNIT_CTRS) {
-		if (BIT(idx) & int_en & ovf) {
-			struct perf_event *event;
-
-			event = uncore_unit->events[idx];
-			if (event) {
-				scf_uncore_event_update(uncore_unit, event, true);
-				scf_uncore_event_set_period(uncore_unit, event);
-			}
-		}
+	/* Find the counters that report overflow and read them together */
+	bitmap_zero(ovf_ctrs, UNIT_CTRS);
+	ovf_ctrs[0] = int_en & ovf;
+	bitmap_and(ovf_ctrs, ovf_ctrs, uncore_unit->used_ctrs, UNIT_CTRS);
+
+	scf_uncore_update_ctrs(uncore_unit, ovf_ctrs, true);
+
+	for_each_set_bit(idx, ovf_ctrs, UNIT_CTRS) {
+		struct perf_event *event = uncore_unit->events[idx];
+
+		if (event)
+			scf_uncore_event_set_period(uncore_unit, event);
 	}
 
 	/* Clear overflow and reenable the interrupt */
@@ -486,6 +685,35 @@ static irqreturn_t scf_handle_irq(int irq_num, void *data)
 	return IRQ_HANDLED;
 }
 
+/*
+ * A group is read in one transaction, so all of its hardware events must
+ * be on this PMU and fit in the counters of a unit.
+ */
+static bool scf_uncore_validate_group(struct perf_event *event)
+{
+	struct perf_event *leader = event->group_leader;
+	struct perf_event *sibling;
+	int counters = 0;
+
+	if (leader == event)
+		return true;
+
+	if (leader->pmu == event->pmu)
+		counters++;
+	else if (!is_software_event(leader))
+		return false;
+
+	for_each_sibling_event(sibling, leader) {
+		if (sibling->pmu == event->pmu)
+			counters++;
+		else if (!is_software_event(sibling))
+			return false;
+	}
+
+	/* The event itself is not on the sibling list yet */
+	return counters + 1 <= UNIT_CTRS;
+}
+
 /*
  * event_init: Verify this PMU can handle the desired event
  */
@@ -543,6 +771,11 @@ static int scf_uncore_event_init(struct perf_event *event)
 			break;
 	}
 
+	if (!scf_uncore_validate_group(event)) {
+		dev_dbg(&pdev->dev, "Group does not fit the unit counters\n");
+		return -EINVAL;
+	}
+
 	/* Event is valid, hw not allocated yet */
 	hwc->idx = -1;
 	hwc->config_base = event->attr.config;
@@ -563,6 +796,10 @@ static int scf_pmu_device_probe(struct platform_device *pdev)
 	uncore_pmu->scf.nv_group_id = PMSELR_GROUP_SCF;
 	uncore_pmu->scf.nv_unit_id = PMSELR_UNIT_SCF_SCF;
 
+	uncore_pmu->txn_flags = devm_alloc_percpu(&pdev->dev, unsigned int);
+	if (!uncore_pmu->txn_flags)
+		return -ENOMEM;
+
 	platform_set_drvdata(pdev, uncore_pmu);
 	uncore_pmu->pmu = (struct pmu) {
 		.name			= "scf_pmu",
@@ -575,6 +812,9 @@ static int scf_pmu_device_probe(struct platform_device *pdev)
 		.start			= scf_uncore_event_start,
 		.stop			= scf_uncore_event_stop,
 		.read			= scf_uncore_event_read,
+		.start_txn		= scf_uncore_start_txn,
+		.commit_txn		= scf_uncore_commit_txn,
+		.cancel_txn		= scf_uncore_cancel_txn,
 		.attr_groups	= scf_uncore_pmu_attr_grps,
 		.type			= PERF_TYPE_HARDWARE,
 	};
@@ -16,8 +16,14 @@
 #include <linux/interrupt.h>
 #include <linux/io.h>
 #include <linux/kernel.h>
+#include <linux/kref.h>
 #include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/miscdevice.h>
+#include <linux/mutex.h>
+#include <linux/poll.h>
 #include <linux/sched/signal.h>
+#include <linux/slab.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/pm_runtime.h>
@@ -26,7 +32,9 @@
 #include <linux/spi/spi.h>
 #include <linux/spi/spi-tegra124-slave.h>
 #include <linux/clk/tegra.h>
+#include <linux/uaccess.h>
 #include <linux/version.h>
+#include <uapi/linux/tegra-spi-slave-stream.h>
 
 #define SPI_COMMAND1				0x000
 #define SPI_BIT_LENGTH(x)			(((x) & 0x1f) << 0)
@@ -264,6 +272,8 @@ struct tegra_spi_platform_data {
 	int max_dma_buffer_size;
 	const char *clk_pin;
 	bool slave_ready_pol;
+	u32 stream_buf_size;
+	u32 stream_period_size;
 };
 
 struct tegra_spi_controller_data {
@@ -280,6 +290,31 @@ struct tegra_spi_controller_data {
 	int cs_gpio;
 };
 
+struct tegra_spi_data;
+
+/*
+ * Stream ring and character device. An open file or a user mapping may
+ * outlive the controller, so this is refcounted separately from the
+ * devm allocated tegra_spi_data: the driver, every open file and every
+ * mapping hold a reference and the ring is freed with the last one.
+ */
+struct tegra_spi_stream {
+	struct kref			ref;
+	/* protects tspi, which is NULL once the controller is removed */
+	struct mutex			lock;
+	struct tegra_spi_data		*tspi;
+	struct device			*dev;
+	void				*buf;
+	dma_addr_t			phys;
+	u32				size;
+	/* bumped on every event a reader may be waiting for */
+	atomic_t			wake_seq;
+	wait_queue_head_t		wq;
+	atomic_t			open;
+	struct miscdevice		misc;
+	char				name[32];
+};
+
 struct tegra_spi_data {
 	struct device				*dev;
 	struct spi_controller			*controller;
@@ -350,6 +385,17 @@ struct tegra_spi_data {
 	int				rx_trig_words;
 	int				force_unpacked_mode;
 	bool				lsbyte_first;
+
+	/* continuous receive, see tegra_spi_stream_start() */
+	struct mutex			stream_lock;
+	bool				streaming;
+	struct tegra_spi_stream		*stream;
+	u32				stream_period;
+	u64				stream_head;
+	u64				stream_tail;
+	u64				stream_overruns;
+	u64				stream_dropped;
+	u32				stream_fifo_ovf;
 #ifdef PROFILE_SPI_SLAVE
 	ktime_t				start_time;
 	ktime_t				end_time;
@@ -1250,25 +1296,11 @@ static void set_best_clk_source(struct spi_device *spi,
 	}
 }
 
-static int tegra_spi_start_transfer_one(struct spi_device *spi,
-		struct spi_transfer *t, bool is_first_of_msg,
-		bool is_single_xfer)
+static int tegra_spi_set_core_clk(struct spi_device *spi, u32 speed)
 {
 	struct tegra_spi_data *tspi = spi_controller_get_devdata(spi->controller);
-	struct tegra_spi_controller_data *cdata = spi->controller_data;
-	u32 speed;
 	u32 core_speed;
-	u8 bits_per_word;
-	unsigned int total_fifo_words;
 	int ret;
-	unsigned long command1;
-	int req_mode;
-
-	bits_per_word = t->bits_per_word;
-	speed = t->speed_hz ? t->speed_hz : spi->max_speed_hz;
-	/* Set slave controller clk 1.5 times the bus frequency */
-	if (!speed)
-		speed = spi->max_speed_hz;
 
 	if (tspi->chip_data->new_features) {
 		/* In case of new feature, all DMA interfaces are async.
@@ -1301,6 +1333,32 @@ static int tegra_spi_start_transfer_one(struct spi_device *spi,
 		tspi->cur_speed = core_speed;
 	}
 
+	return 0;
+}
+
+static int tegra_spi_start_transfer_one(struct spi_device *spi,
+		struct spi_transfer *t, bool is_first_of_msg,
+		bool is_single_xfer)
+{
+	struct tegra_spi_data *tspi = spi_controller_get_devdata(spi->controller);
+	struct tegra_spi_controller_data *cdata = spi->controller_data;
+	u32 speed;
+	u8 bits_per_word;
+	unsigned int total_fifo_words;
+	int ret;
+	unsigned long command1;
+	int req_mode;
+
+	bits_per_word = t->bits_per_word;
+	speed = t->speed_hz ? t->speed_hz : spi->max_speed_hz;
+	/* Set slave controller clk 1.5 times the bus frequency */
+	if (!speed)
+		speed = spi->max_speed_hz;
+
+	ret = tegra_spi_set_core_clk(spi, speed);
+	if (ret < 0)
+		return ret;
+
 	tspi->cur_spi = spi;
 	tspi->curr_xfer = t;
 	tspi->curr_rx_pos = 0;
@@ -1770,9 +1828,19 @@ static int tegra_spi_transfer_one_message(struct spi_controller *controller,
 	msg->status = 0;
 	msg->actual_length = 0;
 
+	/* held for the whole message so a stream cannot start under it */
+	mutex_lock(&tspi->stream_lock);
+	if (tspi->streaming) {
+		mutex_unlock(&tspi->stream_lock);
+		msg->status = -EBUSY;
+		spi_finalize_current_message(controller);
+		return -EBUSY;
+	}
+
 	ret = pm_runtime_get_sync(tspi->dev);
 	if (ret < 0) {
 		dev_err(tspi->dev, "runtime PM get failed: %d\n", ret);
+		mutex_unlock(&tspi->stream_lock);
 		msg->status = ret;
 		spi_finalize_current_message(controller);
 		return ret;
@@ -1843,11 +1911,649 @@ static int tegra_spi_transfer_one_message(struct spi_controller *controller,
 exit:
 	tegra_spi_writel(tspi, tspi->def_command1_reg, SPI_COMMAND1);
 	pm_runtime_put(tspi->dev);
+	mutex_unlock(&tspi->stream_lock);
 	msg->status = ret;
 	spi_finalize_current_message(controller);
 	return ret;
 }
 
+static void tegra_spi_stream_wake(struct tegra_spi_stream *stream)
+{
+	atomic_inc(&stream->wake_seq);
+	wake_up_interruptible(&stream->wq);
+}
+
+/*
+ * Streaming mode keeps the slave armed in continuous mode with a cyclic
+ * RX DMA over a ring of stream->size bytes, so nothing is lost between
+ * messages. head advances by a period as each one is filled, the reader
+ * advances tail. A reader that falls behind loses the oldest data, which
+ * is counted in stream_overruns and stream_dropped.
+ */
+static void tegra_spi_stream_period_done(void *args)
+{
+	struct tegra_spi_data *tspi = args;
+	struct tegra_spi_stream *stream;
+	unsigned long fifo_status;
+	unsigned long flags;
+	u64 dropped;
+
+	spin_lock_irqsave(&tspi->lock, flags);
+	if (!tspi->streaming) {
+		spin_unlock_irqrestore(&tspi->lock, flags);
+		return;
+	}
+
+	/* interrupts stay masked while streaming, poll for lost data */
+	fifo_status = tegra_spi_readl(tspi, SPI_FIFO_STATUS);
+	if (fifo_status & SPI_RX_FIFO_OVF) {
+		tegra_spi_writel(tspi, fifo_status & SPI_RX_FIFO_OVF,
+				SPI_FIFO_STATUS);
+		tspi->stream_fifo_ovf++;
+	}
+
+	tspi->stream_head += tspi->stream_period;
+
+	/* the DMA is now filling the period after head */
+	if (tspi->stream_head + tspi->stream_period >
+			tspi->stream_tail + tspi->stream->size) {
+		dropped = tspi->stream_head + tspi->stream_period -
+				tspi->stream->size - tspi->stream_tail;
+		tspi->stream_tail += dropped;
+		tspi->stream_dropped += dropped;
+		tspi->stream_overruns++;
+	}
+	stream = tspi->stream;
+	spin_unlock_irqrestore(&tspi->lock, flags);
+
+	tegra_spi_stream_wake(stream);
+}
+
+static int tegra_spi_stream_start(struct tegra_spi_data *tspi,
+		struct spi_device *spi, u32 speed_hz)
+{
+	struct dma_slave_config dma_sconfig = { 0 };
+	struct dma_async_tx_descriptor *desc;
+	u8 bits_per_word = spi->bits_per_word;
+	unsigned long command1, val, flags;
+	int maxburst;
+	int ret;
+
+	if (!tspi->stream)
+		return -EOPNOTSUPP;
+
+	if (bits_per_word != 8 && bits_per_word != 16 && bits_per_word != 32)
+		return -EINVAL;
+
+	/* a message in progress may wait for the master indefinitely */
+	if (!mutex_trylock(&tspi->stream_lock))
+		return -EBUSY;
+
+	if (tspi->streaming) {
+		ret = -EBUSY;
+		goto exit_unlock;
+	}
+
+	ret = pm_runtime_get_sync(tspi->dev);
+	if (ret < 0) {
+		dev_err(tspi->dev, "runtime PM get failed: %d\n", ret);
+		pm_runtime_put_noidle(tspi->dev);
+		goto exit_unlock;
+	}
+
+	ret = tegra_spi_set_core_clk(spi, speed_hz);
+	if (ret < 0)
+		goto exit_rpm_put;
+
+	tegra_spi_ext_clk_enable(false, tspi);
+	tspi->reset_ctrl_status = true;
+	reset_controller(tspi);
+
+	tspi->bytes_per_word = (bits_per_word - 1) / 8 + 1;
+	tspi->is_packed = !tspi->force_unpacked_mode && bits_per_word != 32;
+	tspi->words_per_32bit = tspi->is_packed ? 32 / bits_per_word : 1;
+	tspi->cur_direction = DATA_DIR_RX;
+	tspi->is_curr_dma_xfer = true;
+	tspi->cur_spi = spi;
+
+	command1 = tspi->def_command1_reg;
+	command1 |= SPI_BIT_LENGTH(bits_per_word - 1);
+	command1 &= ~SPI_CONTROL_MODE_MASK;
+	command1 |= SPI_MODE_SEL(spi->mode & 0x3);
+	if (spi->mode & SPI_LSB_FIRST)
+		command1 |= SPI_LSBIT_FE;
+	if (tspi->is_packed)
+		command1 |= SPI_PACKED;
+	command1 &= ~(SPI_CS_SEL_MASK | SPI_TX_EN);
+	command1 |= SPI_RX_EN;
+#if defined(NV_SPI_GET_CHIPSELECT_PRESENT)
+	command1 |= SPI_CS_SEL(spi_get_chipselect(spi, 0));
+#else
+	command1 |= SPI_CS_SEL(spi->chip_select);
+#endif
+	tegra_spi_writel(tspi, command1, SPI_COMMAND1);
+	tspi->command1_reg = command1;
+
+	/* SPI_CONT restarts the block when it completes */
+	tegra_spi_writel(tspi, SPI_DMA_BLK_SET(MAX_PACKETS - 1), SPI_DMA_BLK);
+
+	/* periods are a multiple of 32 bytes, any trigger level fits */
+	if (tspi->rx_trig_words == 4) {
+		val = SPI_RX_TRIG_4;
+		maxburst = 4;
+	} else {
+		val = SPI_RX_TRIG_8;
+		maxburst = 8;
+	}
+	val |= SPI_CONT;
+	tegra_spi_writel(tspi, val, SPI_DMA_CTL);
+	tspi->dma_control_reg = val;
+
+	if (tspi->chip_data->intr_mask_reg)
+		tegra_spi_writel(tspi, tegra_spi_readl(tspi, SPI_INTR_MASK) |
+				SPI_INTR_CS_MASK | SPI_INTR_FRAME_END_MASK |
+				SPI_INTR_RDY_MASK | SPI_INTR_RX_FIFO_UNF_MASK |
+				SPI_INTR_TX_FIFO_UNF_MASK |
+				SPI_INTR_RX_FIFO_OVF_MASK |
+				SPI_INTR_TX_FIFO_OVF_MASK, SPI_INTR_MASK);
+
+	dma_sconfig.src_addr = tspi->phys + SPI_RX_FIFO;
+	dma_sconfig.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	dma_sconfig.src_maxburst = maxburst;
+	ret = dmaengine_slave_config(tspi->rx_dma_chan, &dma_sconfig);
+	if (ret < 0) {
+		dev_err(tspi->dev, "DMA slave config failed: %d\n", ret);
+		goto exit_rpm_put;
+	}
+
+	desc = dmaengine_prep_dma_cyclic(tspi->rx_dma_chan, tspi->stream->phys,
+				tspi->stream->size, tspi->stream_period,
+				DMA_DEV_TO_MEM, DMA_PREP_INTERRUPT);
+	if (!desc) {
+		dev_err(tspi->dev, "Not able to get cyclic desc for Rx\n");
+		ret = -EIO;
+		goto exit_rpm_put;
+	}
+	desc->callback = tegra_spi_stream_period_done;
+	desc->callback_param = tspi;
+
+	spin_lock_irqsave(&tspi->lock, flags);
+	tspi->stream_head = 0;
+	tspi->stream_tail = 0;
+	tspi->stream_overruns = 0;
+	tspi->stream_dropped = 0;
+	tspi->stream_fifo_ovf = 0;
+	tspi->streaming = true;
+	spin_unlock_irqrestore(&tspi->lock, flags);
+
+	dmaengine_submit(desc);
+	dma_async_issue_pending(tspi->rx_dma_chan);
+
+	tegra_spi_writel(tspi, val | SPI_DMA_EN, SPI_DMA_CTL);
+	tegra_spi_fence(tspi);
+	tegra_spi_ext_clk_enable(true, tspi);
+
+	tegra_spi_slave_ready(tspi);
+	if (tspi->spi_slave_ready_callback)
+		tspi->spi_slave_ready_callback(tspi->client_data);
+
+	mutex_unlock(&tspi->stream_lock);
+	return 0;
+
+exit_rpm_put:
+	pm_runtime_put(tspi->dev);
+exit_unlock:
+	mutex_unlock(&tspi->stream_lock);
+	return ret;
+}
+
+static void tegra_spi_stream_stop(struct tegra_spi_data *tspi)
+{
+	unsigned long flags;
+
+	/* no message can hold the lock while streaming */
+	if (!READ_ONCE(tspi->streaming))
+		return;
+
+	mutex_lock(&tspi->stream_lock);
+	if (!tspi->streaming)
+		goto exit_unlock;
+
+	tegra_spi_slave_busy(tspi);
+
+	spin_lock_irqsave(&tspi->lock, flags);
+	tspi->streaming = false;
+	spin_unlock_irqrestore(&tspi->lock, flags);
+
+	tegra_spi_writel(tspi, tspi->dma_control_reg & ~SPI_DMA_EN,
+			SPI_DMA_CTL);
+	/* wait for a running period callback, deinit frees the stream next */
+	dmaengine_terminate_sync(tspi->rx_dma_chan);
+	tegra_spi_ext_clk_enable(false, tspi);
+
+	/* the next message starts from a reset controller */
+	tspi->is_curr_dma_xfer = false;
+	tspi->reset_ctrl_status = true;
+	tegra_spi_writel(tspi, tspi->def_command1_reg, SPI_COMMAND1);
+	pm_runtime_put(tspi->dev);
+
+	tegra_spi_stream_wake(tspi->stream);
+
+exit_unlock:
+	mutex_unlock(&tspi->stream_lock);
+}
+
+int tegra124_spi_slave_stream_start(struct spi_device *spi, u32 speed_hz)
+{
+	struct tegra_spi_data *tspi = spi_controller_get_devdata(spi->controller);
+
+	return tegra_spi_stream_start(tspi, spi, speed_hz);
+}
+EXPORT_SYMBOL_GPL(tegra124_spi_slave_stream_start);
+
+void tegra124_spi_slave_stream_stop(struct spi_device *spi)
+{
+	struct tegra_spi_data *tspi = spi_controller_get_devdata(spi->controller);
+
+	tegra_spi_stream_stop(tspi);
+}
+EXPORT_SYMBOL_GPL(tegra124_spi_slave_stream_stop);
+
+static u64 tegra_spi_stream_avail(struct tegra_spi_data *tspi, u64 *tail,
+		bool *streaming)
+{
+	unsigned long flags;
+	u64 avail;
+
+	spin_lock_irqsave(&tspi->lock, flags);
+	avail = tspi->stream_head - tspi->stream_tail;
+	*tail = tspi->stream_tail;
+	*streaming = tspi->streaming;
+	spin_unlock_irqrestore(&tspi->lock, flags);
+
+	return avail;
+}
+
+static void tegra_spi_stream_free(struct kref *ref)
+{
+	struct tegra_spi_stream *stream =
+		container_of(ref, struct tegra_spi_stream, ref);
+
+	dma_free_coherent(stream->dev, stream->size, stream->buf,
+			stream->phys);
+	put_device(stream->dev);
+	kfree(stream);
+}
+
+static void tegra_spi_stream_put(struct tegra_spi_stream *stream)
+{
+	kref_put(&stream->ref, tegra_spi_stream_free);
+}
+
+static int tegra_spi_stream_open(struct inode *inode, struct file *file)
+{
+	struct tegra_spi_stream *stream = container_of(file->private_data,
+			struct tegra_spi_stream, misc);
+
+	/* one reader, tail is shared */
+	if (atomic_cmpxchg(&stream->open, 0, 1))
+		return -EBUSY;
+
+	/* misc_open() runs under misc_mtx, deregister can't race this */
+	kref_get(&stream->ref);
+	file->private_data = stream;
+	return nonseekable_open(inode, file);
+}
+
+static int tegra_spi_stream_release(struct inode *inode, struct file *file)
+{
+	struct tegra_spi_stream *stream = file->private_data;
+
+	atomic_set(&stream->open, 0);
+	tegra_spi_stream_put(stream);
+	return 0;
+}
+
+static ssize_t tegra_spi_stream_read(struct file *file, char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	struct tegra_spi_stream *stream = file->private_data;
+	struct tegra_spi_data *tspi;
+	unsigned long flags;
+	bool streaming;
+	u64 avail, tail;
+	u32 off;
+	size_t len, first;
+	int seq;
+	int ret;
+
+retry:
+	mutex_lock(&stream->lock);
+	tspi = stream->tspi;
+	if (!tspi) {
+		/* controller removed, end of stream */
+		mutex_unlock(&stream->lock);
+		return 0;
+	}
+
+	seq = atomic_read(&stream->wake_seq);
+	avail = tegra_spi_stream_avail(tspi, &tail, &streaming);
+	mutex_unlock(&stream->lock);
+	if (!avail) {
+		if (!streaming)
+			return 0;
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+
+		ret = wait_event_interruptible(stream->wq,
+				atomic_read(&stream->wake_seq) != seq);
+		if (ret)
+			return ret;
+		goto retry;
+	}
+
+	len = min_t(u64, count, avail);
+	div_u64_rem(tail, stream->size, &off);
+	first = min_t(size_t, len, stream->size - off);
+
+	/*
+	 * Copy without stream->lock: a fault here takes mmap_lock, which
+	 * mmap() holds while taking stream->lock. The open file keeps the
+	 * ring allocated.
+	 */
+	if (copy_to_user(buf, stream->buf + off, first) ||
+	    copy_to_user(buf + first, stream->buf, len - first))
+		return -EFAULT;
+
+	mutex_lock(&stream->lock);
+	tspi = stream->tspi;
+	if (!tspi) {
+		mutex_unlock(&stream->lock);
+		return 0;
+	}
+
+	spin_lock_irqsave(&tspi->lock, flags);
+	if (tspi->stream_tail != tail) {
+		/* overrun or another read while copying, copy is stale */
+		spin_unlock_irqrestore(&tspi->lock, flags);
+		mutex_unlock(&stream->lock);
+		goto retry;
+	}
+	tspi->stream_tail += len;
+	spin_unlock_irqrestore(&tspi->lock, flags);
+	mutex_unlock(&stream->lock);
+
+	return len;
+}
+
+static __poll_t tegra_spi_stream_poll(struct file *file,
+		struct poll_table_struct *wait)
+{
+	struct tegra_spi_stream *stream = file->private_data;
+	__poll_t mask = EPOLLHUP;
+	bool streaming;
+	u64 tail;
+
+	poll_wait(file, &stream->wq, wait);
+
+	mutex_lock(&stream->lock);
+	if (stream->tspi) {
+		if (tegra_spi_stream_avail(stream->tspi, &tail, &streaming))
+			mask = EPOLLIN | EPOLLRDNORM;
+		else if (streaming)
+			mask = 0;
+	}
+	mutex_unlock(&stream->lock);
+
+	return mask;
+}
+
+static void tegra_spi_stream_vm_open(struct vm_area_struct *vma)
+{
+	struct tegra_spi_stream *stream = vma->vm_private_data;
+
+	kref_get(&stream->ref);
+}
+
+static void tegra_spi_stream_vm_close(struct vm_area_struct *vma)
+{
+	tegra_spi_stream_put(vma->vm_private_data);
+}
+
+static const struct vm_operations_struct tegra_spi_stream_vm_ops = {
+	.open = tegra_spi_stream_vm_open,
+	.close = tegra_spi_stream_vm_close,
+};
+
+static int tegra_spi_stream_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct tegra_spi_stream *stream = file->private_data;
+	int ret;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+#if defined(NV_VM_AREA_STRUCT_HAS_CONST_VM_FLAGS) /* Linux v6.3 */
+	vm_flags_clear(vma, VM_MAYWRITE);
+#else
+	vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+
+	mutex_lock(&stream->lock);
+	if (!stream->tspi) {
+		ret = -ENODEV;
+		goto exit_unlock;
+	}
+
+	ret = dma_mmap_coherent(stream->dev, vma, stream->buf,
+			stream->phys, stream->size);
+	if (ret)
+		goto exit_unlock;
+
+	/* the mapping keeps the ring alive */
+	vma->vm_private_data = stream;
+	vma->vm_ops = &tegra_spi_stream_vm_ops;
+	kref_get(&stream->ref);
+
+exit_unlock:
+	mutex_unlock(&stream->lock);
+	return ret;
+}
+
+struct tegra_spi_stream_lookup {
+	u32 chip_select;
+	struct spi_device *spi;
+};
+
+static int tegra_spi_stream_find_cs(struct device *dev, void *data)
+{
+	struct tegra_spi_stream_lookup *lookup = data;
+	struct spi_device *spi = to_spi_device(dev);
+	u32 cs;
+
+#if defined(NV_SPI_GET_CHIPSELECT_PRESENT)
+	cs = spi_get_chipselect(spi, 0);
+#else
+	cs = spi->chip_select;
+#endif
+	if (cs != lookup->chip_select)
+		return 0;
+
+	lookup->spi = spi_dev_get(spi);
+	return 1;
+}
+
+static long tegra_spi_stream_do_ioctl(struct tegra_spi_data *tspi,
+		unsigned int cmd, unsigned long arg)
+{
+	struct tegra_spi_stream_status status;
+	struct tegra_spi_stream_config config;
+	void __user *uarg = (void __user *)arg;
+	struct tegra_spi_stream_lookup lookup = { 0 };
+	unsigned long flags;
+	u64 nbytes;
+	int ret;
+
+	switch (cmd) {
+	case TEGRA_SPI_STREAM_IOCTL_START:
+		if (copy_from_user(&config, uarg, sizeof(config)))
+			return -EFAULT;
+
+		/* children of the controller are its slave devices */
+		lookup.chip_select = config.chip_select;
+		device_for_each_child(&tspi->controller->dev, &lookup,
+				tegra_spi_stream_find_cs);
+		if (!lookup.spi)
+			return -ENODEV;
+
+		ret = tegra_spi_stream_start(tspi, lookup.spi, config.speed_hz);
+		spi_dev_put(lookup.spi);
+		return ret;
+
+	case TEGRA_SPI_STREAM_IOCTL_STOP:
+		tegra_spi_stream_stop(tspi);
+		return 0;
+
+	case TEGRA_SPI_STREAM_IOCTL_STATUS:
+		memset(&status, 0, sizeof(status));
+		spin_lock_irqsave(&tspi->lock, flags);
+		status.head = tspi->stream_head;
+		status.tail = tspi->stream_tail;
+		status.overruns = tspi->stream_overruns;
+		status.dropped_bytes = tspi->stream_dropped;
+		status.fifo_overflows = tspi->stream_fifo_ovf;
+		status.streaming = tspi->streaming;
+		spin_unlock_irqrestore(&tspi->lock, flags);
+		status.ring_size = tspi->stream->size;
+		status.period_size = tspi->stream_period;
+
+		if (copy_to_user(uarg, &status, sizeof(status)))
+			return -EFAULT;
+		return 0;
+
+	case TEGRA_SPI_STREAM_IOCTL_CONSUME:
+		if (get_user(nbytes, (u64 __user *)uarg))
+			return -EFAULT;
+
+		spin_lock_irqsave(&tspi->lock, flags);
+		nbytes = min(nbytes, tspi->stream_head - tspi->stream_tail);
+		tspi->stream_tail += nbytes;
+		spin_unlock_irqrestore(&tspi->lock, flags);
+		return 0;
+
+	default:
+		return -ENOTTY;
+	}
+}
+
+static long tegra_spi_stream_ioctl(struct file *file, unsigned int cmd,
+		unsigned long arg)
+{
+	struct tegra_spi_stream *stream = file->private_data;
+	long ret;
+
+	mutex_lock(&stream->lock);
+	if (stream->tspi)
+		ret = tegra_spi_stream_do_ioctl(stream->tspi, cmd, arg);
+	else
+		ret = -ENODEV;
+	mutex_unlock(&stream->lock);
+
+	return ret;
+}
+
+static const struct file_operations tegra_spi_stream_fops = {
+	.owner = THIS_MODULE,
+	.open = tegra_spi_stream_open,
+	.release = tegra_spi_stream_release,
+	.read = tegra_spi_stream_read,
+	.poll = tegra_spi_stream_poll,
+	.mmap = tegra_spi_stream_mmap,
+	.unlocked_ioctl = tegra_spi_stream_ioctl,
+};
+
+static int tegra_spi_stream_init(struct tegra_spi_data *tspi,
+		struct tegra_spi_platform_data *pdata)
+{
+	u32 period = pdata->stream_period_size;
+	u32 size = pdata->stream_buf_size;
+	struct tegra_spi_stream *stream;
+	int ret;
+
+	if (!size)
+		return 0;
+
+	if (!period)
+		period = size / 8;
+
+	/* cyclic DMA needs whole periods, two at least */
+	if (!IS_ALIGNED(period, 32) || size % period || size / period < 2) {
+		dev_err(tspi->dev, "invalid stream ring %u, period %u\n",
+				size, period);
+		return -EINVAL;
+	}
+
+	stream = kzalloc(sizeof(*stream), GFP_KERNEL);
+	if (!stream)
+		return -ENOMEM;
+
+	stream->buf = dma_alloc_coherent(tspi->dev, size, &stream->phys,
+				GFP_KERNEL);
+	if (!stream->buf) {
+		kfree(stream);
+		return -ENOMEM;
+	}
+
+	kref_init(&stream->ref);
+	mutex_init(&stream->lock);
+	init_waitqueue_head(&stream->wq);
+	atomic_set(&stream->wake_seq, 0);
+	atomic_set(&stream->open, 0);
+	stream->tspi = tspi;
+	stream->dev = get_device(tspi->dev);
+	stream->size = size;
+	tspi->stream_period = period;
+
+	snprintf(stream->name, sizeof(stream->name),
+			"spi-slave-stream%d", tspi->controller->bus_num);
+	stream->misc.minor = MISC_DYNAMIC_MINOR;
+	stream->misc.name = stream->name;
+	stream->misc.fops = &tegra_spi_stream_fops;
+	stream->misc.parent = tspi->dev;
+
+	tspi->stream = stream;
+
+	ret = misc_register(&stream->misc);
+	if (ret < 0) {
+		dev_err(tspi->dev, "stream device register failed: %d\n", ret);
+		tspi->stream = NULL;
+		tegra_spi_stream_put(stream);
+		return ret;
+	}
+
+	return 0;
+}
+
+static void tegra_spi_stream_deinit(struct tegra_spi_data *tspi)
+{
+	struct tegra_spi_stream *stream = tspi->stream;
+
+	if (!stream)
+		return;
+
+	/* open files and mappings see the controller gone from here on */
+	mutex_lock(&stream->lock);
+	stream->tspi = NULL;
+	mutex_unlock(&stream->lock);
+
+	tegra_spi_stream_stop(tspi);
+	misc_deregister(&stream->misc);
+	tegra_spi_stream_wake(stream);
+
+	tspi->stream = NULL;
+	tegra_spi_stream_put(stream);
+}
+
 static irqreturn_t tegra_spi_isr(int irq, void *context_data)
 {
 	struct tegra_spi_data *tspi = context_data;
@@ -1905,6 +2611,11 @@ static struct tegra_spi_platform_data
 	if (of_find_property(np, "nvidia,clock-always-on", NULL))
 		pdata->is_clkon_always = true;
 
+	of_property_read_u32(np, "nvidia,stream-buffer-size",
+			&pdata->stream_buf_size);
+	of_property_read_u32(np, "nvidia,stream-period-size",
+			&pdata->stream_period_size);
+
 	pdata->gpio_slave_ready =
 		devm_gpiod_get_optional(&pdev->dev, "nvidia,slave-ready-gpio", 0);
 
@@ -2038,6 +2749,7 @@ static int tegra_spi_probe(struct platform_device *pdev)
 	gpiod_direction_output(tspi->gpio_slave_ready, deassert_val);
 
 	spin_lock_init(&tspi->lock);
+	mutex_init(&tspi->stream_lock);
 
 	r = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	if (!r) {
@@ -2146,6 +2858,12 @@ static int tegra_spi_probe(struct platform_device *pdev)
 		goto exit_pm_disable;
 	}
 
+	ret = tegra_spi_stream_init(tspi, pdata);
+	if (ret < 0) {
+		spi_unregister_controller(controller);
+		goto exit_pm_disable;
+	}
+
 #ifdef TEGRA_SPI_SLAVE_DEBUG
 	ret = device_create_file(&pdev->dev, &dev_attr_force_unpacked_mode);
 	if (ret != 0)
@@ -2154,6 +2872,7 @@ static int tegra_spi_probe(struct platform_device *pdev)
 	return ret;
 
 exit_unregister_controller:
+	tegra_spi_stream_deinit(tspi);
 	spi_unregister_controller(controller);
 
 #endif
@@ -2182,6 +2901,7 @@ static int tegra_spi_remove(struct platform_device *pdev)
 #ifdef TEGRA_SPI_SLAVE_DEBUG
 	device_remove_file(&pdev->dev, &dev_attr_force_unpacked_mode);
 #endif
+	tegra_spi_stream_deinit(tspi);
 	free_irq(tspi->irq, tspi);
 	spi_unregister_controller(controller);
 
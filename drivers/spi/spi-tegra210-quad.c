@@ -22,6 +22,7 @@
 #include <linux/of_device.h>
 #include <linux/reset.h>
 #include <linux/spi/spi.h>
+#include <linux/spi/spi-mem.h>
 #include <linux/acpi.h>
 #include <linux/property.h>
 #include <linux/version.h>
@@ -184,6 +185,8 @@
 
 #define QSPI_DMA_TIMEOUT			(msecs_to_jiffies(1000))
 #define DEFAULT_QSPI_DMA_BUF_LEN		(64 * 1024)
+/* DMA_BLK holds a 16 bit count of 8 bit packets */
+#define QSPI_MEM_CHUNK_LEN			(64 * 1024)
 #define CMD_TRANSFER				0
 #define ADDR_TRANSFER				1
 #define DUMMY_TRANSFER				2
@@ -254,6 +257,20 @@ struct tegra_qspi {
 	u32					*tx_dma_buf;
 	dma_addr_t				tx_dma_phys;
 	struct dma_async_tx_descriptor		*tx_dma_desc;
+
+	/* spi-mem read streamed from the IRQ thread */
+	bool					mem_xfer;
+	struct spi_device			*mem_spi;
+	struct sg_table				mem_sgt;
+	struct scatterlist			*mem_sg;
+	unsigned int				mem_sg_pos;
+	unsigned int				mem_len;
+	unsigned int				mem_pos;
+	unsigned int				mem_chunk;
+	u64					mem_addr;
+	u8					mem_addr_nbytes;
+	u32					mem_command1;
+
 	const struct tegra_qspi_soc_data	*soc_data;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 16, 0)
 	struct tegra_prod_cfg_list *prod_list;
@@ -1505,6 +1522,299 @@ static int tegra_qspi_transfer_one_message(struct spi_controller *controller,
 	return ret;
 }
 
+static bool tegra_qspi_mem_can_stream(struct tegra_qspi *tqspi,
+				      const struct spi_mem_op *op)
+{
+	if (!tqspi->use_dma || !tqspi->soc_data->cmb_xfer_capable)
+		return false;
+
+	if (op->data.dir != SPI_MEM_DATA_IN ||
+	    op->data.nbytes <= (QSPI_FIFO_DEPTH << 2))
+		return false;
+
+	/* same limits as tegra_qspi_validate_cmb_seq() */
+	if (op->cmd.nbytes != 1 || op->addr.nbytes < 3 || op->addr.nbytes > 4)
+		return false;
+
+	if (op->dummy.nbytes &&
+	    op->dummy.nbytes * 8 / op->dummy.buswidth > QSPI_DUMMY_CYCLES_MAX)
+		return false;
+
+	/* DMA moves whole FIFO words */
+	return IS_ALIGNED(op->data.nbytes, 4) &&
+	       IS_ALIGNED((unsigned long)op->data.buf.in, 4);
+}
+
+/*
+ * CMB_SEQ_ADDR shifts out its low byte first, so the address is stored
+ * with its most significant byte in the low byte of the register.
+ */
+static u32 tegra_qspi_mem_addr_value(u64 addr, u8 nbytes)
+{
+	u32 val = 0;
+	u8 i;
+
+	for (i = 0; i < nbytes; i++)
+		val |= ((addr >> (8 * (nbytes - i - 1))) & 0xff) << (8 * i);
+
+	return val;
+}
+
+static void tegra_qspi_mem_start_chunk(struct tegra_qspi *tqspi)
+{
+	bool has_ext_dma = tqspi->soc_data->dma_mode & QSPI_DMA_EXT;
+	unsigned int len;
+	dma_addr_t dma_addr;
+
+	len = min_t(unsigned int, tqspi->mem_len - tqspi->mem_pos,
+		    QSPI_MEM_CHUNK_LEN);
+
+	/*
+	 * The external DMA runs one descriptor over the whole destination,
+	 * the internal DMA takes a single address so a chunk must not cross
+	 * a mapped segment.
+	 */
+	if (!has_ext_dma) {
+		len = min(len, sg_dma_len(tqspi->mem_sg) - tqspi->mem_sg_pos);
+		dma_addr = sg_dma_address(tqspi->mem_sg) + tqspi->mem_sg_pos;
+		tegra_qspi_writel(tqspi, lower_32_bits(dma_addr),
+				  QSPI_DMA_MEM_ADDRESS_REG);
+		tegra_qspi_writel(tqspi, (upper_32_bits(dma_addr) & 0xff),
+				  QSPI_DMA_HI_ADDRESS_REG);
+	}
+
+	tqspi->mem_chunk = len;
+
+	tegra_qspi_writel(tqspi,
+			  tegra_qspi_mem_addr_value(tqspi->mem_addr + tqspi->mem_pos,
+						    tqspi->mem_addr_nbytes),
+			  QSPI_CMB_SEQ_ADDR);
+	tegra_qspi_writel(tqspi, QSPI_DMA_BLK_SET(len - 1), QSPI_DMA_BLK);
+
+	tegra_qspi_unmask_irq(tqspi);
+
+	tqspi->command1_reg = tqspi->mem_command1;
+	tegra_qspi_writel(tqspi, tqspi->command1_reg, QSPI_COMMAND1);
+	tegra_qspi_writel(tqspi, tqspi->dma_control_reg | QSPI_DMA_EN,
+			  QSPI_DMA_CTL);
+}
+
+static int tegra_qspi_mem_start_ext_dma(struct tegra_qspi *tqspi)
+{
+	struct dma_slave_config dma_sconfig = { 0 };
+	struct dma_async_tx_descriptor *desc;
+	unsigned int len = tqspi->mem_len;
+	u8 dma_burst;
+	u32 val;
+	int ret;
+
+	/*
+	 * Every chunk but the last is QSPI_MEM_CHUNK_LEN long, so the
+	 * attention level picked from the total length suits all of them.
+	 */
+	if (len & 0xf) {
+		val = QSPI_RX_TRIG_1;
+		dma_burst = 1;
+	} else if ((len >> 4) & 0x1) {
+		val = QSPI_RX_TRIG_4;
+		dma_burst = 4;
+	} else {
+		val = QSPI_RX_TRIG_8;
+		dma_burst = 8;
+	}
+
+	dma_sconfig.device_fc = true;
+	dma_sconfig.src_addr = tqspi->phys + QSPI_RX_FIFO;
+	dma_sconfig.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	dma_sconfig.src_maxburst = dma_burst;
+	ret = dmaengine_slave_config(tqspi->rx_dma_chan, &dma_sconfig);
+	if (ret < 0) {
+		dev_err(tqspi->dev, "failed DMA slave config: %d\n", ret);
+		return ret;
+	}
+
+	desc = dmaengine_prep_slave_sg(tqspi->rx_dma_chan, tqspi->mem_sgt.sgl,
+				       tqspi->mem_sgt.nents, DMA_DEV_TO_MEM,
+				       DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!desc) {
+		dev_err(tqspi->dev, "Unable to get RX descriptor\n");
+		return -EIO;
+	}
+
+	reinit_completion(&tqspi->rx_dma_complete);
+	desc->callback = tegra_qspi_dma_complete;
+	desc->callback_param = &tqspi->rx_dma_complete;
+	dmaengine_submit(desc);
+	dma_async_issue_pending(tqspi->rx_dma_chan);
+
+	tqspi->dma_control_reg = val;
+	tegra_qspi_writel(tqspi, val, QSPI_DMA_CTL);
+
+	return 0;
+}
+
+/*
+ * Stream a flash read straight into the caller's buffer. The buffer is
+ * DMA mapped once and split into chunks of at most QSPI_MEM_CHUNK_LEN,
+ * each issued as a combined sequence read at the next flash address.
+ * The IRQ thread starts the next chunk as soon as one completes, and
+ * the caller only waits for the whole read.
+ */
+static int tegra_qspi_mem_read(struct tegra_qspi *tqspi, struct spi_device *spi,
+			       const struct spi_mem_op *op)
+{
+	struct spi_controller *controller = spi->controller;
+	bool has_ext_dma = tqspi->soc_data->dma_mode & QSPI_DMA_EXT;
+	struct spi_transfer xfer = {
+		.rx_buf = op->data.buf.in,
+		.len = op->data.nbytes,
+		.rx_nbits = op->data.buswidth,
+		.bits_per_word = 8,
+		.speed_hz = spi->max_speed_hz,
+	};
+	unsigned long flags, timeout;
+	u32 command1, val;
+	int ret;
+
+	ret = spi_controller_dma_map_mem_op_data(controller, op, &tqspi->mem_sgt);
+	if (ret < 0)
+		return ret;
+
+	tqspi->tx_status = 0;
+	tqspi->rx_status = 0;
+	tqspi->dummy_cycles = op->dummy.nbytes ?
+			      op->dummy.nbytes * 8 / op->dummy.buswidth : 0;
+
+	val = tegra_qspi_readl(tqspi, QSPI_GLOBAL_CONFIG);
+	val |= QSPI_CMB_SEQ_EN;
+	tegra_qspi_writel(tqspi, val, QSPI_GLOBAL_CONFIG);
+
+	tegra_qspi_writel(tqspi, op->cmd.opcode, QSPI_CMB_SEQ_CMD);
+	tegra_qspi_writel(tqspi, tegra_qspi_cmd_config(false, op->cmd.buswidth,
+						       op->cmd.nbytes),
+			  QSPI_CMB_SEQ_CMD_CFG);
+	tegra_qspi_writel(tqspi, tegra_qspi_addr_config(false, op->addr.buswidth,
+							op->addr.nbytes),
+			  QSPI_CMB_SEQ_ADDR_CFG);
+
+	command1 = tegra_qspi_setup_transfer_one(spi, &xfer, true);
+	command1 &= ~(QSPI_TX_EN | QSPI_INTERFACE_WIDTH_MASK);
+	command1 |= QSPI_PACKED | QSPI_RX_EN;
+	if (op->data.buswidth == SPI_NBITS_QUAD)
+		command1 |= QSPI_INTERFACE_WIDTH_QUAD;
+	else if (op->data.buswidth == SPI_NBITS_DUAL)
+		command1 |= QSPI_INTERFACE_WIDTH_DUAL;
+	else
+		command1 |= QSPI_INTERFACE_WIDTH_SINGLE;
+	tegra_qspi_writel(tqspi, command1, QSPI_COMMAND1);
+
+	tqspi->is_packed = true;
+	tqspi->bytes_per_word = 1;
+	tqspi->words_per_32bit = 4;
+	tqspi->cur_direction = DATA_DIR_RX;
+	tqspi->is_curr_dma_xfer = true;
+	tqspi->curr_xfer = NULL;
+
+	tegra_qspi_writel(tqspi, QSPI_NUM_DUMMY_CYCLE(tqspi->dummy_cycles),
+			  QSPI_MISC_REG);
+
+	ret = tegra_qspi_flush_fifos(tqspi, false);
+	if (ret < 0)
+		goto unmap;
+
+	tqspi->dma_control_reg = 0;
+	if (has_ext_dma) {
+		ret = tegra_qspi_mem_start_ext_dma(tqspi);
+		if (ret < 0)
+			goto unmap;
+	} else {
+		tegra_qspi_writel(tqspi, 0, QSPI_DMA_CTL);
+	}
+
+	tqspi->mem_spi = spi;
+	tqspi->mem_sg = tqspi->mem_sgt.sgl;
+	tqspi->mem_sg_pos = 0;
+	tqspi->mem_len = op->data.nbytes;
+	tqspi->mem_pos = 0;
+	tqspi->mem_addr = op->addr.val;
+	tqspi->mem_addr_nbytes = op->addr.nbytes;
+	tqspi->mem_command1 = command1;
+
+	reinit_completion(&tqspi->xfer_completion);
+
+	spin_lock_irqsave(&tqspi->lock, flags);
+	tqspi->mem_xfer = true;
+	tegra_qspi_mem_start_chunk(tqspi);
+	spin_unlock_irqrestore(&tqspi->lock, flags);
+
+	/* allow QSPI_DMA_TIMEOUT per chunk, as the message path does */
+	timeout = QSPI_DMA_TIMEOUT * DIV_ROUND_UP(tqspi->mem_len,
+						  QSPI_MEM_CHUNK_LEN);
+	ret = wait_for_completion_timeout(&tqspi->xfer_completion, timeout);
+
+	spin_lock_irqsave(&tqspi->lock, flags);
+	tqspi->mem_xfer = false;
+	spin_unlock_irqrestore(&tqspi->lock, flags);
+
+	if (WARN_ON(ret == 0)) {
+		dev_err(tqspi->dev, "spi-mem read timeout\n");
+		val = tegra_qspi_readl(tqspi, QSPI_DMA_CTL);
+		tegra_qspi_writel(tqspi, val & ~QSPI_DMA_EN, QSPI_DMA_CTL);
+		ret = -EIO;
+	} else if (tqspi->rx_status) {
+		ret = -EIO;
+	} else if (has_ext_dma &&
+		   !wait_for_completion_timeout(&tqspi->rx_dma_complete,
+						QSPI_DMA_TIMEOUT)) {
+		dev_err(tqspi->dev, "failed RX DMA transfer\n");
+		ret = -EIO;
+	} else {
+		ret = 0;
+	}
+
+	if (ret < 0) {
+		if (has_ext_dma)
+			dmaengine_terminate_all(tqspi->rx_dma_chan);
+		tegra_qspi_handle_error(tqspi);
+		tqspi->rx_status = 0;
+	}
+
+	tegra_qspi_transfer_end(spi);
+
+unmap:
+	spi_controller_dma_unmap_mem_op_data(controller, op, &tqspi->mem_sgt);
+
+	return ret;
+}
+
+static int tegra_qspi_adjust_mem_op_size(struct spi_mem *mem,
+					 struct spi_mem_op *op)
+{
+	/* leave an unaligned tail of a long read to the message path */
+	if (op->data.dir == SPI_MEM_DATA_IN &&
+	    op->data.nbytes > (QSPI_FIFO_DEPTH << 2))
+		op->data.nbytes = ALIGN_DOWN(op->data.nbytes, 4);
+
+	return 0;
+}
+
+static int tegra_qspi_exec_mem_op(struct spi_mem *mem,
+				  const struct spi_mem_op *op)
+{
+	struct tegra_qspi *tqspi = spi_controller_get_devdata(mem->spi->controller);
+
+	/* spi-mem falls back to transfer_one_message */
+	if (!tegra_qspi_mem_can_stream(tqspi, op))
+		return -EOPNOTSUPP;
+
+	return tegra_qspi_mem_read(tqspi, mem->spi, op);
+}
+
+static const struct spi_controller_mem_ops tegra_qspi_mem_ops = {
+	.adjust_op_size = tegra_qspi_adjust_mem_op_size,
+	.exec_op = tegra_qspi_exec_mem_op,
+};
+
 static irqreturn_t handle_cpu_based_xfer(struct tegra_qspi *tqspi)
 {
 	struct spi_transfer *t = tqspi->curr_xfer;
@@ -1624,6 +1934,38 @@ exit:
 	return IRQ_HANDLED;
 }
 
+static irqreturn_t handle_mem_dma_xfer(struct tegra_qspi *tqspi)
+{
+	bool has_ext_dma = tqspi->soc_data->dma_mode & QSPI_DMA_EXT;
+	unsigned long flags;
+
+	spin_lock_irqsave(&tqspi->lock, flags);
+
+	if (!tqspi->mem_xfer)
+		goto exit;
+
+	tqspi->mem_pos += tqspi->mem_chunk;
+	if (tqspi->rx_status || tqspi->mem_pos == tqspi->mem_len) {
+		complete(&tqspi->xfer_completion);
+		goto exit;
+	}
+
+	if (!has_ext_dma) {
+		tqspi->mem_sg_pos += tqspi->mem_chunk;
+		if (tqspi->mem_sg_pos == sg_dma_len(tqspi->mem_sg)) {
+			tqspi->mem_sg = sg_next(tqspi->mem_sg);
+			tqspi->mem_sg_pos = 0;
+		}
+	}
+
+	/* every chunk is a new read command, cycle CS before the next one */
+	tegra_qspi_transfer_end(tqspi->mem_spi);
+	tegra_qspi_mem_start_chunk(tqspi);
+exit:
+	spin_unlock_irqrestore(&tqspi->lock, flags);
+	return IRQ_HANDLED;
+}
+
 static irqreturn_t tegra_qspi_isr_thread(int irq, void *context_data)
 {
 	struct tegra_qspi *tqspi = context_data;
@@ -1638,6 +1980,9 @@ static irqreturn_t tegra_qspi_isr_thread(int irq, void *context_data)
 
 	tegra_qspi_mask_clear_irq(tqspi);
 
+	if (tqspi->mem_xfer)
+		return handle_mem_dma_xfer(tqspi);
+
 	if (!tqspi->is_curr_dma_xfer)
 		return handle_cpu_based_xfer(tqspi);
 
@@ -1732,6 +2077,7 @@ static int tegra_qspi_probe(struct platform_device *pdev)
 	controller->bits_per_word_mask = SPI_BPW_MASK(32) | SPI_BPW_MASK(16) | SPI_BPW_MASK(8);
 	controller->setup = tegra_qspi_setup;
 	controller->transfer_one_message = tegra_qspi_transfer_one_message;
+	controller->mem_ops = &tegra_qspi_mem_ops;
 	controller->num_chipselect = 1;
 	controller->auto_runtime_pm = true;
 
@@ -1783,8 +2129,11 @@ static int tegra_qspi_probe(struct platform_device *pdev)
 	if (ret < 0)
 		return ret;
 
-	if (tqspi->use_dma)
+	if (tqspi->use_dma) {
 		tqspi->max_buf_size = tqspi->dma_buf_size;
+		/* spi-mem maps read buffers for the channel's device */
+		controller->dma_rx = tqspi->rx_dma_chan;
+	}
 
 	init_completion(&tqspi->tx_dma_complete);
 	init_completion(&tqspi->rx_dma_complete);
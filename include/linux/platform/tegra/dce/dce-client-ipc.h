@@ -75,4 +75,51 @@ int tegra_dce_unregister_ipc_client(u32 handle);
  */
 int tegra_dce_client_ipc_send_recv(u32 handle, struct dce_ipc_message *msg);
 
+/*
+ * tegra_dce_client_ipc_async_cb_t - callback function to notify the
+ * client that an asynchronously submitted rpc has completed.
+ *
+ * @handle: handle the rpc was submitted on.
+ * @seq: sequence tag returned at submission.
+ * @status: 0 if the response was received into msg->rx, else error.
+ * @msg: message that was submitted.
+ * @usr_ctx: user context passed at submission.
+ */
+typedef void (*tegra_dce_client_ipc_async_cb_t)(u32 handle, u32 seq,
+	      int status, struct dce_ipc_message *msg, void *usr_ctx);
+
+/*
+ * tegra_dce_client_ipc_send_async() - queue an rpc to dce without waiting
+ * @handle : client handle registered with dce driver
+ * @msg : message to be sent and received, must stay valid until @cb runs
+ * @cb : called from process context once the response is received
+ * @usr_ctx : passed back to @cb
+ * @seqp : if not NULL, returns the sequence tag of the rpc
+ *
+ * Rpcs on a handle complete in submission order.
+ *
+ * Return: 0 if queued else corresponding error value.
+ */
+int tegra_dce_client_ipc_send_async(u32 handle, struct dce_ipc_message *msg,
+		tegra_dce_client_ipc_async_cb_t cb, void *usr_ctx, u32 *seqp);
+
+/*
+ * tegra_dce_client_ipc_send_batch() - queue several rpcs to dce at once
+ * @handle : client handle registered with dce driver
+ * @msgs : messages to be sent, in order
+ * @count : number of messages
+ * @cb : called once per message, in order
+ * @usr_ctx : passed back to @cb
+ * @seqp : if not NULL, returns the sequence tag of msgs[0]; the following
+ *	   messages get consecutive tags
+ *
+ * Messages are written to as many free channel frames as are available
+ * before dce is notified, so a burst costs fewer doorbells.
+ *
+ * Return: 0 if queued else corresponding error value.
+ */
+int tegra_dce_client_ipc_send_batch(u32 handle, struct dce_ipc_message **msgs,
+		u32 count, tegra_dce_client_ipc_async_cb_t cb, void *usr_ctx,
+		u32 *seqp);
+
 #endif
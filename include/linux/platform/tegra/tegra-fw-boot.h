@@ -0,0 +1,80 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Copyright (c) 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ *
+ * Firmware boot orchestration for Tegra coprocessors
+ */
+
+#ifndef __TEGRA_FW_BOOT_H
+#define __TEGRA_FW_BOOT_H
+
+#include <linux/completion.h>
+#include <linux/firmware.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/workqueue.h>
+
+enum tegra_fw_boot_state {
+	TEGRA_FW_BOOT_FETCHING,	/* image is being read and prepared */
+	TEGRA_FW_BOOT_WAITING,	/* image ready, waiting for dependencies */
+	TEGRA_FW_BOOT_BOOTING,
+	TEGRA_FW_BOOT_DONE,
+	TEGRA_FW_BOOT_FAILED,
+};
+
+struct tegra_fw_boot_engine;
+
+/**
+ * struct tegra_fw_boot_ops - engine callbacks, both optional
+ *
+ * @prepare : Parse or validate the image. Called once after the image
+ *            is read, before the dependencies of the engine have booted.
+ * @boot    : Boot the engine. Called once all dependencies have booted.
+ *            @fw is NULL for engines without a firmware image.
+ */
+struct tegra_fw_boot_ops {
+	int (*prepare)(struct tegra_fw_boot_engine *engine,
+		       const struct firmware *fw);
+	int (*boot)(struct tegra_fw_boot_engine *engine,
+		    const struct firmware *fw);
+};
+
+/**
+ * struct tegra_fw_boot_engine - coprocessor booted by the orchestrator
+ *
+ * @name    : Unique engine name, used to express dependencies.
+ * @fw_name : Firmware image to read, NULL if the engine has none.
+ * @deps    : NULL terminated names of engines that must boot first.
+ * @dev     : Device used to read the image and for logging.
+ * @ops     : Engine callbacks.
+ * @data    : Owner data, not used by the orchestrator.
+ *
+ * The remaining fields are owned by the orchestrator. @fw stays valid,
+ * and is not read again, until the engine is unregistered.
+ */
+struct tegra_fw_boot_engine {
+	const char *name;
+	const char *fw_name;
+	const char * const *deps;
+	struct device *dev;
+	const struct tegra_fw_boot_ops *ops;
+	void *data;
+
+	struct list_head node;
+	struct work_struct work;
+	struct completion done;
+	enum tegra_fw_boot_state state;
+	const struct firmware *fw;
+	int status;
+	ktime_t t_register;
+	ktime_t t_fetched;
+	ktime_t t_boot_start;
+	ktime_t t_boot_end;
+};
+
+int tegra_fw_boot_register(struct tegra_fw_boot_engine *engine);
+void tegra_fw_boot_unregister(struct tegra_fw_boot_engine *engine);
+int tegra_fw_boot_wait(struct tegra_fw_boot_engine *engine,
+		       unsigned long timeout);
+
+#endif /* __TEGRA_FW_BOOT_H */
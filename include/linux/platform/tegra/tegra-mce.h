@@ -100,6 +100,7 @@ int tegra_mce_read_uncore_mca(mca_cmd_t cmd, u64 *data, u32 *error);
 int tegra_mce_write_uncore_mca(mca_cmd_t cmd, u64 data, u32 *error);
 int tegra_mce_read_uncore_perfmon(u32 req, u32 *data);
 int tegra_mce_write_uncore_perfmon(u32 req, u32 data);
+int tegra_mce_read_uncore_perfmon_batch(const u32 *req, u32 *data, u32 count);
 int tegra_mce_enable_latic(void);
 int tegra_mce_write_dda_ctrl(u32 index, u64 value);
 int tegra_mce_read_dda_ctrl(u32 index, u64 *value);
@@ -131,6 +132,7 @@ struct tegra_mce_ops {
 	int (*write_uncore_mca)(mca_cmd_t, u64, u32 *);
 	int (*read_uncore_perfmon)(u32, u32 *);
 	int (*write_uncore_perfmon)(u32, u32);
+	int (*read_uncore_perfmon_batch)(const u32 *, u32 *, u32);
 	int (*enable_latic)(void);
 	int (*write_dda_ctrl)(u32 index, u64 value);
 	int (*read_dda_ctrl)(u32 index, u64 *value);
@@ -14,4 +14,13 @@ int tegra124_spi_slave_register_callback(struct spi_device *spi,
 				      spi_callback func_ready,
 				      spi_callback func_isr,
 				      void *client_data);
+
+/*
+ * Keep the slave armed and receive continuously into the controller's
+ * stream ring, see uapi/linux/tegra-spi-slave-stream.h. @speed_hz is the
+ * bus clock of the master. Messages to the controller fail with -EBUSY
+ * while it is streaming.
+ */
+int tegra124_spi_slave_stream_start(struct spi_device *spi, u32 speed_hz);
+void tegra124_spi_slave_stream_stop(struct spi_device *spi);
 #endif
@@ -151,6 +151,21 @@ void *tegra_pcie_edma_initialize(struct tegra_pcie_edma_init_info *info);
 edma_xfer_status_t tegra_pcie_edma_submit_xfer(void *cookie,
 						struct tegra_pcie_edma_xfer_info *tx_info);
 
+/**
+ * @brief: API to perform transfer operation spread across all channels.
+ *  The descriptors are split into equal byte shares, one per initialized async channel of
+ *  tx_info->type, and submitted concurrently. tx_info->channel_num is ignored.
+ *  tx_info->complete is called once, after all the channels have completed, with the first
+ *  failure reported by any channel. If this API fails, no callback is called.
+ *  Callbacks are invoked in submission order, batched once per interrupt, and may
+ *  submit the next xfer with this API. They must not call tegra_pcie_edma_stop().
+ * @param[in] tx_info: EDMA Tx data structure. Refer struct tegra_pcie_edma_xfer_info for details.
+ * @param[in] coockie : cookie data returned in tegra_pcie_edma_initialize() call.
+ * @retVal: Refer edma_xfer_status_t.
+ */
+edma_xfer_status_t tegra_pcie_edma_submit_xfer_multi(void *cookie,
+						      struct tegra_pcie_edma_xfer_info *tx_info);
+
 /**
  * @brief: API to stop EDMA engine,.
  * @param[in] cookie : cookie data returned in tegra_pcie_edma_initialize() call.
@@ -28,6 +28,22 @@
 struct tegra_vi_channel;
 struct capture_buffer_table;
 
+/**
+ * @brief VI capture status callback, invoked from the capture IVC worker
+ *	  on receipt of a CAPTURE_STATUS_IND for @a buffer_index.
+ *
+ * The callback may sleep, but must not issue capture-control requests on
+ * the same channel.
+ *
+ * @param[in]	priv		Opaque data registered with the callback
+ * @param[in]	chan		VI channel context
+ * @param[in]	buffer_index	Capture descriptor index the status is for
+ */
+typedef void (*vi_capture_status_cb)(
+	void *priv,
+	struct tegra_vi_channel *chan,
+	uint32_t buffer_index);
+
 /**
  * @brief VI channel capture context.
  */
@@ -75,6 +91,11 @@ struct vi_capture {
 		 * Completion for capture requests (frame), if progress status
 		 * notifier is not in use
 		 */
+	vi_capture_status_cb status_cb;
+		/**< Capture status callback, used in place of capture_resp */
+	void *status_cb_priv; /**< Private data passed to status_cb */
+	struct mutex status_cb_lock;
+		/**< Lock serializing status_cb invocation and update */
 	struct mutex control_msg_lock;
 		/**< Lock for capture-control IVC control_resp_msg */
 	struct CAPTURE_CONTROL_MSG control_resp_msg;
@@ -451,4 +472,22 @@ int vi_capture_set_progress_status_notifier(
 	struct tegra_vi_channel *chan,
 	struct vi_capture_progress_status_req *req);
 
+/**
+ * @brief Install a callback to be invoked on each capture status
+ *	  notification, instead of completing the capture status wait.
+ *
+ * Passing a NULL @a cb restores the blocking @ref vi_capture_status()
+ * behaviour; on return any in-flight callback invocation has finished.
+ *
+ * @param[in]	chan	VI channel context
+ * @param[in]	cb	Capture status callback, or NULL
+ * @param[in]	priv	Private data passed to @a cb
+ *
+ * @returns	0 (success), neg. errno (failure)
+ */
+int vi_capture_set_status_callback(
+	struct tegra_vi_channel *chan,
+	vi_capture_status_cb cb,
+	void *priv);
+
 #endif /* __FUSA_CAPTURE_VI_H__ */
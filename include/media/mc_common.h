@@ -130,6 +130,12 @@ struct tegra_vi_graph_entity {
  *
  * @kthread_capture: kernel thread task structure of this video channel
  * @wait: wait queue structure for kernel thread
+ * @status_work: refills the capture queue after a completion
+ * @error_work: runs channel error recovery outside the status callback
+ * @timeout_work: flags a capture timeout while requests are outstanding
+ * @submit_lock: serializes capture request submission and recovery
+ * @capture_active: capture requests may be submitted to the channel
+ * @status_count: capture status notifications pending per VI port
  *
  * @format: active V4L2 pixel format
  * @fmtinfo: format information corresponding to the active @format
@@ -215,6 +221,10 @@ struct tegra_channel {
 	spinlock_t dequeue_lock;
 	struct work_struct status_work;
 	struct work_struct error_work;
+	struct delayed_work timeout_work;
+	struct mutex submit_lock;
+	bool capture_active;
+	unsigned int status_count[TEGRA_CSI_BLOCKS];
 
 	void __iomem *csibase[TEGRA_CSI_BLOCKS];
 	unsigned int stride_align;
@@ -425,6 +435,7 @@ struct tegra_vi_fops {
 	int (*vi_setup_queue)(struct tegra_channel *chan,
 			unsigned int *nbuffers);
 	int (*vi_error_recover)(struct tegra_channel *chan, bool queue_error);
+	void (*vi_buffer_queue)(struct tegra_channel *chan);
 	int (*vi_add_ctrls)(struct tegra_channel *chan);
 	void (*vi_init_video_formats)(struct tegra_channel *chan);
 	long (*vi_default_ioctl)(struct file *file, void *fh,
@@ -23,7 +23,7 @@ struct nvpps_version {
 #define NVPPS_VERSION_MAJOR	0
 #define NVPPS_VERSION_MINOR	2
 #define NVPPS_API_MAJOR		0
-#define NVPPS_API_MINOR         4
+#define NVPPS_API_MINOR         5
 
 struct nvpps_params {
 	__u32	evt_mode;
@@ -34,6 +34,7 @@ struct nvpps_params {
 /* evt_mode */
 #define NVPPS_MODE_GPIO		0x01
 #define NVPPS_MODE_TIMER	0x02
+#define NVPPS_MODE_SIM		0x04
 
 /* tsc_mode */
 #define NVPPS_TSC_NSEC		0
@@ -69,10 +70,83 @@ struct nvpps_timestamp_struct {
 };
 
 
+/*
+ * One entry of the per-device timestamp history. tsc is always in
+ * nanoseconds, irrespective of tsc_mode.
+ */
+struct nvpps_sample {
+	__u32	evt_nb;
+	__u32	evt_mode;
+	__u64	tsc;
+	__u64	ptp;
+	__u64	secondary_ptp;
+	__u64	irq_latency;
+};
+
+#define NVPPS_HISTORY_LEN	64
+
+/*
+ * Read the samples this file has not seen yet, oldest first.
+ * samples: user pointer to an array of nvpps_sample
+ * count  : in, size of the array; out, number of samples returned
+ * lost   : out, samples overwritten before this file could read them
+ */
+struct nvpps_samples {
+	__u64	samples;
+	__u32	count;
+	__u32	lost;
+};
+
+/*
+ * In-kernel PI servo tracking PTP time against the TSC.
+ * kp, ki  : proportional and integral gains, 16.16 fixed point
+ * step_ns : offsets larger than this re-anchor the model instead of
+ *           being fed to the servo, 0 selects the default
+ */
+struct nvpps_servo_params {
+	__u32	enable;
+	__u32	kp;
+	__u32	ki;
+	__u32	step_ns;
+};
+
+/* servo state */
+#define NVPPS_SERVO_OFF		0
+#define NVPPS_SERVO_UNLOCKED	1
+#define NVPPS_SERVO_LOCKED	2
+
+/*
+ * Correction model published by the servo in a read-only page, mmap()
+ * the nvpps device at offset 0 to get it. The model maps a TSC time in
+ * nanoseconds to PTP time:
+ *
+ *   ptp = ptp_ref + (((__s64)(tsc_ns - tsc_ref) * mult) >> shift)
+ *
+ * where tsc_ns is the TSC counter multiplied by tsc_res_ns. The writer
+ * makes seq odd while updating; readers retry until they observe the
+ * same even seq before and after reading the other fields.
+ */
+struct nvpps_servo_model {
+	__u32	seq;
+	__u32	state;
+	__u64	tsc_ref;
+	__u64	ptp_ref;
+	__u64	mult;
+	__u32	shift;
+	__u32	tsc_res_ns;
+	__s64	offset_ns;
+	__s64	freq_ppb;
+	__u64	updates;
+	__u64	steps;
+};
+
 #define NVPPS_GETVERSION	_IOR('p', 0x1, struct nvpps_version *)
 #define NVPPS_GETPARAMS		_IOR('p', 0x2, struct nvpps_params *)
 #define NVPPS_SETPARAMS		_IOW('p', 0x3, struct nvpps_params *)
 #define NVPPS_GETEVENT		_IOR('p', 0x4, struct nvpps_timeevent *)
 #define NVPPS_GETTIMESTAMP	_IOWR('p', 0x5, struct nvpps_timestamp_struct *)
+#define NVPPS_GETSAMPLES	_IOWR('p', 0x6, struct nvpps_samples)
+#define NVPPS_SETSERVO		_IOW('p', 0x7, struct nvpps_servo_params)
+#define NVPPS_GETSERVO		_IOR('p', 0x8, struct nvpps_servo_params)
 
 #endif /* __UAPI_NVPPS_IOCTL_H__ */
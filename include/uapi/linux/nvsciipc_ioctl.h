@@ -1,6 +1,6 @@
 /* SPDX-License-Identifier: GPL-2.0-only */
 /*
- * SPDX-FileCopyrightText: Copyright (c) 2019-2023 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2024 NVIDIA CORPORATION & AFFILIATES. All rights reserved.
  */
 
 #ifndef __NVSCIIPC_IOCTL_H__
@@ -56,6 +56,30 @@ struct nvsciipc_get_db_by_vuid {
 	uint32_t idx;
 };
 
+/* idx reported by batched lookup for an endpoint not found in db */
+#define NVSCIIPC_DB_IDX_INVALID	0xFFFFFFFFU
+
+#define NVSCIIPC_GET_DB_BATCH_BY_NAME	0U
+#define NVSCIIPC_GET_DB_BATCH_BY_VUID	1U
+
+/*
+ * Resolve many endpoints in one call.
+ * @type: NVSCIIPC_GET_DB_BATCH_BY_NAME or NVSCIIPC_GET_DB_BATCH_BY_VUID
+ * @num_entries: number of entries in @entries
+ * @entries: user memory atleast of size num_entries *
+ *  sizeof(struct nvsciipc_get_db_by_name) or
+ *  sizeof(struct nvsciipc_get_db_by_vuid) per @type.
+ *  idx of an entry not found is set to NVSCIIPC_DB_IDX_INVALID.
+ * @num_found: (out) number of entries resolved
+ */
+struct nvsciipc_get_db_batch {
+	uint32_t type;
+	uint32_t num_entries;
+	uint64_t entries;
+	uint32_t num_found;
+	uint32_t reserved;
+};
+
 /* for userspace level test, debugging purpose only */
 struct nvsciipc_validate_auth_token {
 	uint32_t auth_token;
@@ -104,6 +128,9 @@ struct nvsciipc_map_vuid {
 #define NVSCIIPC_IOCTL_GET_VMID \
 	_IOWR(NVSCIIPC_IOCTL_MAGIC, 8, uint32_t)
 
-#define NVSCIIPC_IOCTL_NUMBER_MAX 8
+#define NVSCIIPC_IOCTL_GET_DB_BATCH \
+	_IOWR(NVSCIIPC_IOCTL_MAGIC, 9, struct nvsciipc_get_db_batch)
+
+#define NVSCIIPC_IOCTL_NUMBER_MAX 9
 
 #endif /* __NVSCIIPC_IOCTL_H__ */
@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: (GPL-2.0 WITH Linux-syscall-note)
+ *
+ * Copyright (c) 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+ */
+
+#ifndef _UAPI_TEGRA_SPI_SLAVE_STREAM_H_
+#define _UAPI_TEGRA_SPI_SLAVE_STREAM_H_
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+ * Continuous receive of a Tegra SPI slave controller into a ring buffer.
+ *
+ * The ring is read with read(), or mapped read-only with mmap() and then
+ * consumed with TEGRA_SPI_STREAM_IOCTL_CONSUME. head and tail are running
+ * byte counts, the ring offset of a byte is its count modulo ring_size.
+ * In packed mode (8 and 16 bits per word) the ring holds the received
+ * bytes, otherwise every word occupies a 32 bit FIFO word.
+ */
+
+#define TEGRA_SPI_STREAM_IOC_MAGIC	'S'
+
+struct tegra_spi_stream_config {
+	/* slave device, as a chip select on this controller */
+	__u32 chip_select;
+	/* bus clock of the master */
+	__u32 speed_hz;
+};
+
+struct tegra_spi_stream_status {
+	/* bytes written by the controller */
+	__u64 head;
+	/* bytes consumed by the reader, or dropped on overrun */
+	__u64 tail;
+	/* times the reader fell a full ring behind */
+	__u64 overruns;
+	/* bytes overwritten before they were read */
+	__u64 dropped_bytes;
+	/* periods in which the controller RX FIFO overflowed */
+	__u32 fifo_overflows;
+	__u32 ring_size;
+	/* head advances in steps of period_size */
+	__u32 period_size;
+	__u32 streaming;
+};
+
+#define TEGRA_SPI_STREAM_IOCTL_START	_IOW(TEGRA_SPI_STREAM_IOC_MAGIC, 1, \
+						struct tegra_spi_stream_config)
+#define TEGRA_SPI_STREAM_IOCTL_STOP	_IO(TEGRA_SPI_STREAM_IOC_MAGIC, 2)
+#define TEGRA_SPI_STREAM_IOCTL_STATUS	_IOR(TEGRA_SPI_STREAM_IOC_MAGIC, 3, \
+						struct tegra_spi_stream_status)
+#define TEGRA_SPI_STREAM_IOCTL_CONSUME	_IOW(TEGRA_SPI_STREAM_IOC_MAGIC, 4, \
+						__u64)
+
+#endif /* #ifndef _UAPI_TEGRA_SPI_SLAVE_STREAM_H_ */
@@ -1,6 +1,6 @@
 /* SPDX-License-Identifier: GPL-2.0-only */
 /*
- * Copyright (c) 2021-2023, NVIDIA CORPORATION.  All rights reserved.
+ * Copyright (c) 2021-2024, NVIDIA CORPORATION.  All rights reserved.
  */
 
 #ifndef __UAPI_NVSCIC2C_PCIE_IOCTL_H__
@@ -187,6 +187,22 @@ struct nvscic2c_pcie_submit_copy_args {
 	__u64 remote_post_fence_values;
 };
 
+/**
+ * stream extensions - Submit a batch of copy requests in one call.
+ * @num_copy_requests: Number of @nvscic2c_pcie_submit_copy_args in
+ *  @copy_requests. Must not exceed @max_copy_requests.
+ * @copy_requests: user memory atleast of size:
+ *  num_copy_requests * sizeof(struct nvscic2c_pcie_submit_copy_args)
+ * @num_submitted: (out) Number of copy requests, from the start of
+ *  @copy_requests, that were submitted. The remaining were not submitted
+ *  and may be re-submitted by the caller.
+ */
+struct nvscic2c_pcie_submit_copy_batch_args {
+	__u64 num_copy_requests;
+	__u64 copy_requests;
+	__u64 num_submitted;
+};
+
 /**
  * stream extensions - Pass upper limit for the total possible outstanding
  * submit copy requests.
@@ -206,6 +222,7 @@ struct nvscic2c_pcie_max_copy_args {
 union nvscic2c_pcie_ioctl_arg_max_size {
 	struct nvscic2c_pcie_max_copy_args mc;
 	struct nvscic2c_pcie_submit_copy_args cr;
+	struct nvscic2c_pcie_submit_copy_batch_args cb;
 	struct nvscic2c_pcie_free_obj_args fo;
 	struct nvscic2c_pcie_import_obj_args io;
 	struct nvscic2c_pcie_export_obj_args eo;
@@ -268,6 +285,13 @@ union nvscic2c_pcie_ioctl_arg_max_size {
 	_IOW(NVSCIC2C_PCIE_IOCTL_MAGIC, 8,\
 	      struct nvscic2c_pcie_max_copy_args)
 
-#define NVSCIC2C_PCIE_IOCTL_NUMBER_MAX 8
+/**
+ * Submit a batch of Copy requests for transfer.
+ */
+#define NVSCIC2C_PCIE_IOCTL_SUBMIT_COPY_BATCH \
+	_IOWR(NVSCIC2C_PCIE_IOCTL_MAGIC, 9,\
+	      struct nvscic2c_pcie_submit_copy_batch_args)
+
+#define NVSCIC2C_PCIE_IOCTL_NUMBER_MAX 9
 
 #endif /*__UAPI_NVSCIC2C_PCIE_IOCTL_H__*/
@@ -13,6 +13,7 @@
 #include <linux/hardirq.h>
 #include <linux/interrupt.h>
 #include <linux/iopoll.h>
+#include <linux/slab.h>
 #include <soc/tegra/virt/hv-ivc.h>
 
 #include "tegra_virt_alt_ivc.h"
@@ -84,18 +85,357 @@ fail:
 }
 EXPORT_SYMBOL_GPL(nvaudio_ivc_send);
 
-int nvaudio_ivc_send_receive(struct nvaudio_ivc_ctxt *ictxt,
-			struct nvaudio_ivc_msg *rx_msg, int size)
+enum nvaudio_ivc_cache_op {
+	NVAUDIO_CACHE_NONE,
+	NVAUDIO_CACHE_FILL,		/* GET: reply holds the value */
+	NVAUDIO_CACHE_UPDATE,		/* SET: request holds the value */
+	NVAUDIO_CACHE_INVALIDATE,	/* SET: reply layout differs from GET */
+};
+
+struct nvaudio_ivc_cache_entry {
+	struct hlist_node		node;
+	enum nvaudio_ivc_cmd_t		cmd;
+	uint32_t			key;
+	struct nvaudio_ivc_msg		msg;
+};
+
+/*
+ * Map a control request onto the GET command whose reply it determines,
+ * along with the key identifying the control instance. Only plain control
+ * values are cached; status and ratio readbacks always go to the server.
+ */
+static enum nvaudio_ivc_cache_op nvaudio_ivc_cache_key(
+		const struct nvaudio_ivc_msg *msg,
+		enum nvaudio_ivc_cmd_t *get_cmd, uint32_t *key)
+{
+	enum nvaudio_ivc_cache_op op = NVAUDIO_CACHE_UPDATE;
+
+	switch (msg->cmd) {
+	case NVAUDIO_AMIXER_GET_RX_GAIN:
+		op = NVAUDIO_CACHE_FILL;
+		fallthrough;
+	case NVAUDIO_AMIXER_SET_RX_GAIN:
+		*get_cmd = NVAUDIO_AMIXER_GET_RX_GAIN;
+		*key = msg->params.amixer_info.rx_idx;
+		break;
+	case NVAUDIO_AMIXER_GET_RX_DURATION:
+		op = NVAUDIO_CACHE_FILL;
+		fallthrough;
+	case NVAUDIO_AMIXER_SET_RX_DURATION:
+		*get_cmd = NVAUDIO_AMIXER_GET_RX_DURATION;
+		*key = msg->params.amixer_info.rx_idx;
+		break;
+	case NVAUDIO_AMIXER_GET_TX_ADDER_CONFIG:
+		op = NVAUDIO_CACHE_FILL;
+		fallthrough;
+	case NVAUDIO_AMIXER_SET_TX_ADDER_CONFIG:
+		*get_cmd = NVAUDIO_AMIXER_GET_TX_ADDER_CONFIG;
+		*key = (msg->params.amixer_info.adder_idx << 16) |
+			(msg->params.amixer_info.adder_rx_idx & 0xFFFF);
+		break;
+	case NVAUDIO_AMIXER_GET_ENABLE:
+		op = NVAUDIO_CACHE_FILL;
+		fallthrough;
+	case NVAUDIO_AMIXER_SET_ENABLE:
+		*get_cmd = NVAUDIO_AMIXER_GET_ENABLE;
+		*key = msg->params.amixer_info.id;
+		break;
+	case NVAUDIO_SFC_GET_IN_FREQ:
+		op = NVAUDIO_CACHE_FILL;
+		fallthrough;
+	case NVAUDIO_SFC_SET_IN_FREQ:
+		*get_cmd = NVAUDIO_SFC_GET_IN_FREQ;
+		*key = msg->params.sfc_info.id;
+		break;
+	case NVAUDIO_SFC_GET_OUT_FREQ:
+		op = NVAUDIO_CACHE_FILL;
+		fallthrough;
+	case NVAUDIO_SFC_SET_OUT_FREQ:
+		*get_cmd = NVAUDIO_SFC_GET_OUT_FREQ;
+		*key = msg->params.sfc_info.id;
+		break;
+	case NVAUDIO_MVC_GET_CURVETYPE:
+		op = NVAUDIO_CACHE_FILL;
+		fallthrough;
+	case NVAUDIO_MVC_SET_CURVETYPE:
+		*get_cmd = NVAUDIO_MVC_GET_CURVETYPE;
+		*key = msg->params.mvc_info.id;
+		break;
+	case NVAUDIO_MVC_GET_TAR_VOL:
+		op = NVAUDIO_CACHE_FILL;
+		fallthrough;
+	case NVAUDIO_MVC_SET_TAR_VOL:
+		*get_cmd = NVAUDIO_MVC_GET_TAR_VOL;
+		*key = msg->params.mvc_info.id;
+		break;
+	case NVAUDIO_MVC_GET_MUTE:
+		op = NVAUDIO_CACHE_FILL;
+		fallthrough;
+	case NVAUDIO_MVC_SET_MUTE:
+		*get_cmd = NVAUDIO_MVC_GET_MUTE;
+		*key = msg->params.mvc_info.id;
+		break;
+	case NVAUDIO_I2S_GET_LOOPBACK_ENABLE:
+		op = NVAUDIO_CACHE_FILL;
+		fallthrough;
+	case NVAUDIO_I2S_SET_LOOPBACK_ENABLE:
+		*get_cmd = NVAUDIO_I2S_GET_LOOPBACK_ENABLE;
+		*key = msg->params.i2s_info.i2s_id;
+		break;
+	case NVAUDIO_I2S_GET_RATE:
+		op = NVAUDIO_CACHE_FILL;
+		fallthrough;
+	case NVAUDIO_I2S_SET_RATE:
+		*get_cmd = NVAUDIO_I2S_GET_RATE;
+		*key = msg->params.i2s_info.i2s_id;
+		break;
+	case NVAUDIO_XBAR_GET_ROUTE:
+		*get_cmd = NVAUDIO_XBAR_GET_ROUTE;
+		*key = msg->params.xbar_info.rx_reg;
+		op = NVAUDIO_CACHE_FILL;
+		break;
+	case NVAUDIO_XBAR_SET_ROUTE:
+		*get_cmd = NVAUDIO_XBAR_GET_ROUTE;
+		*key = msg->params.xbar_info.rx_reg;
+		op = NVAUDIO_CACHE_INVALIDATE;
+		break;
+	default:
+		op = NVAUDIO_CACHE_NONE;
+		break;
+	}
+
+	return op;
+}
+
+static struct nvaudio_ivc_cache_entry *nvaudio_ivc_cache_find(
+		struct nvaudio_ivc_ctxt *ictxt,
+		enum nvaudio_ivc_cmd_t cmd, uint32_t key)
+{
+	struct nvaudio_ivc_cache_entry *entry;
+
+	hash_for_each_possible(ictxt->cache, entry, node, (cmd << 16) ^ key) {
+		if (entry->cmd == cmd && entry->key == key)
+			return entry;
+	}
+
+	return NULL;
+}
+
+static void nvaudio_ivc_cache_drop_cmd(struct nvaudio_ivc_ctxt *ictxt,
+		enum nvaudio_ivc_cmd_t cmd)
 {
+	struct nvaudio_ivc_cache_entry *entry;
+	struct hlist_node *tmp;
+	int bkt;
+
+	hash_for_each_safe(ictxt->cache, bkt, tmp, entry, node) {
+		if (entry->cmd == cmd) {
+			hash_del(&entry->node);
+			kfree(entry);
+		}
+	}
+}
 
+void nvaudio_ivc_cache_flush(struct nvaudio_ivc_ctxt *ictxt)
+{
+	struct nvaudio_ivc_cache_entry *entry;
+	struct hlist_node *tmp;
+	unsigned long flags;
+	int bkt;
+
+	if (!ictxt)
+		return;
+
+	spin_lock_irqsave(&ictxt->cache_lock, flags);
+	hash_for_each_safe(ictxt->cache, bkt, tmp, entry, node) {
+		hash_del(&entry->node);
+		kfree(entry);
+	}
+	ictxt->cache_gen++;
+	spin_unlock_irqrestore(&ictxt->cache_lock, flags);
+}
+EXPORT_SYMBOL_GPL(nvaudio_ivc_cache_flush);
+
+/* Serve a GET from the shadow cache, returns true on a hit */
+static bool nvaudio_ivc_cache_lookup(struct nvaudio_ivc_ctxt *ictxt,
+		struct nvaudio_ivc_msg *msg)
+{
+	struct nvaudio_ivc_cache_entry *entry;
+	enum nvaudio_ivc_cmd_t get_cmd;
+	unsigned long flags;
+	uint32_t key;
+	bool hit = false;
+
+	if (nvaudio_ivc_cache_key(msg, &get_cmd, &key) != NVAUDIO_CACHE_FILL)
+		return false;
+
+	spin_lock_irqsave(&ictxt->cache_lock, flags);
+	entry = nvaudio_ivc_cache_find(ictxt, get_cmd, key);
+	if (entry) {
+		memcpy(&msg->params, &entry->msg.params, sizeof(msg->params));
+		msg->err = NVAUDIO_ERR_OK;
+		hit = true;
+	}
+	spin_unlock_irqrestore(&ictxt->cache_lock, flags);
+
+	return hit;
+}
+
+/* Drop cached values a request is about to change */
+static void nvaudio_ivc_cache_invalidate(struct nvaudio_ivc_ctxt *ictxt,
+		const struct nvaudio_ivc_msg *msg)
+{
+	struct nvaudio_ivc_cache_entry *entry;
+	enum nvaudio_ivc_cmd_t get_cmd;
+	enum nvaudio_ivc_cache_op op;
+	unsigned long flags;
+	uint32_t key;
+
+	if (msg->cmd == NVAUDIO_ADSP_RESET) {
+		nvaudio_ivc_cache_flush(ictxt);
+		return;
+	}
+
+	op = nvaudio_ivc_cache_key(msg, &get_cmd, &key);
+	if (msg->cmd != NVAUDIO_AMIXER_SET_FADE &&
+	    (op == NVAUDIO_CACHE_NONE || op == NVAUDIO_CACHE_FILL))
+		return;
+
+	spin_lock_irqsave(&ictxt->cache_lock, flags);
+	if (msg->cmd == NVAUDIO_AMIXER_SET_FADE) {
+		/* fade ramps every rx gain of the mixer */
+		nvaudio_ivc_cache_drop_cmd(ictxt, NVAUDIO_AMIXER_GET_RX_GAIN);
+	} else {
+		entry = nvaudio_ivc_cache_find(ictxt, get_cmd, key);
+		if (entry) {
+			hash_del(&entry->node);
+			kfree(entry);
+		}
+	}
+	ictxt->cache_gen++;
+	spin_unlock_irqrestore(&ictxt->cache_lock, flags);
+}
+
+/*
+ * Record the value of a completed request. @gen is the cache generation
+ * sampled before submission, a GET reply is discarded if a SET raced it.
+ */
+static void nvaudio_ivc_cache_update(struct nvaudio_ivc_ctxt *ictxt,
+		const struct nvaudio_ivc_msg *req,
+		const struct nvaudio_ivc_msg *reply, uint32_t gen)
+{
+	struct nvaudio_ivc_cache_entry *entry, *new;
+	const struct nvaudio_ivc_msg *src;
+	enum nvaudio_ivc_cmd_t get_cmd;
+	enum nvaudio_ivc_cache_op op;
+	unsigned long flags;
+	uint32_t key;
+
+	op = nvaudio_ivc_cache_key(req, &get_cmd, &key);
+	if (op == NVAUDIO_CACHE_FILL)
+		src = reply;
+	else if (op == NVAUDIO_CACHE_UPDATE)
+		src = req;
+	else
+		return;
+
+	if (reply->err != NVAUDIO_ERR_OK)
+		return;
+
+	new = kzalloc(sizeof(*new), GFP_ATOMIC);
+	if (!new)
+		return;
+
+	new->cmd = get_cmd;
+	new->key = key;
+	memcpy(&new->msg, src, sizeof(new->msg));
+	new->msg.cmd = get_cmd;
+
+	spin_lock_irqsave(&ictxt->cache_lock, flags);
+	if (op == NVAUDIO_CACHE_FILL && gen != ictxt->cache_gen) {
+		spin_unlock_irqrestore(&ictxt->cache_lock, flags);
+		kfree(new);
+		return;
+	}
+	entry = nvaudio_ivc_cache_find(ictxt, get_cmd, key);
+	if (entry) {
+		hash_del(&entry->node);
+		kfree(entry);
+	}
+	hash_add(ictxt->cache, &new->node, (get_cmd << 16) ^ key);
+	spin_unlock_irqrestore(&ictxt->cache_lock, flags);
+}
+
+/*
+ * Read every reply available on the channel and hand it to the request
+ * it answers. Called from the IVC interrupt, and by atomic waiters
+ * polling for their own reply.
+ */
+static void nvaudio_ivc_rx_drain(struct nvaudio_ivc_ctxt *ictxt)
+{
+	struct nvaudio_ivc_xfer *xfer, *match;
+	struct nvaudio_ivc_msg rx;
+	unsigned long flags;
+	int len;
+
+	spin_lock_irqsave(&ictxt->ivck_rx_lock, flags);
+	while (tegra_hv_ivc_can_read(ictxt->ivck)) {
+		memset(&rx, 0, sizeof(rx));
+		len = tegra_hv_ivc_read(ictxt->ivck, &rx, sizeof(rx));
+
+		spin_lock(&ictxt->lock);
+		match = NULL;
+		list_for_each_entry(xfer, &ictxt->pending, node) {
+			if (xfer->seq == ictxt->rx_seq) {
+				match = xfer;
+				break;
+			}
+		}
+		ictxt->rx_seq++;
+
+		if (match) {
+			list_del_init(&match->node);
+			if (len != sizeof(rx)) {
+				dev_err(ictxt->dev,
+					"IVC read failure (msg size error)\n");
+				match->status = -EIO;
+			} else {
+				memcpy(match->msg, &rx, sizeof(rx));
+				match->status = len;
+			}
+			complete(&match->done);
+		} else {
+			/* late reply to a request that already timed out */
+			dev_err(ictxt->dev, "dropping stale reply, cmd %d\n",
+				rx.cmd);
+		}
+		spin_unlock(&ictxt->lock);
+	}
+	spin_unlock_irqrestore(&ictxt->ivck_rx_lock, flags);
+}
+
+static irqreturn_t nvaudio_ivc_irq(int irq, void *data)
+{
+	struct nvaudio_ivc_ctxt *ictxt = data;
+
+	if (tegra_hv_ivc_channel_notified(ictxt->ivck) != 0)
+		return IRQ_HANDLED;
+
+	nvaudio_ivc_rx_drain(ictxt);
+
+	return IRQ_HANDLED;
+}
+
+int nvaudio_ivc_submit(struct nvaudio_ivc_ctxt *ictxt,
+		struct nvaudio_ivc_xfer *xfer,
+		struct nvaudio_ivc_msg *msg, int size)
+{
 	int len = 0;
-	unsigned long flags = 0, flags1 = 0;
+	unsigned long flags = 0;
 	int err = 0;
 	int dcnt = 50;
-	int status = -1;
-	struct nvaudio_ivc_msg *msg = rx_msg;
 
-	if (!ictxt || !ictxt->ivck || !msg || !size)
+	if (!ictxt || !ictxt->ivck || !xfer || !msg || !size)
 		return -EINVAL;
 
 	while (tegra_hv_ivc_channel_notified(ictxt->ivck) != 0) {
@@ -106,56 +446,152 @@ int nvaudio_ivc_send_receive(struct nvaudio_ivc_ctxt *ictxt,
 			return -EIO;
 	}
 
-	spin_lock_irqsave(&ictxt->ivck_rx_lock, flags);
-	spin_lock_irqsave(&ictxt->ivck_tx_lock, flags1);
+	INIT_LIST_HEAD(&xfer->node);
+	init_completion(&xfer->done);
+	xfer->ictxt = ictxt;
+	xfer->msg = msg;
+	xfer->status = -EIO;
+
+	nvaudio_ivc_cache_invalidate(ictxt, msg);
+
+	spin_lock_irqsave(&ictxt->ivck_tx_lock, flags);
 
 	if (!tegra_hv_ivc_can_write(ictxt->ivck)) {
 		err = -EBUSY;
-		spin_unlock_irqrestore(&ictxt->ivck_tx_lock, flags1);
 		goto fail;
 	}
 
+	/* queue before writing, the reply may race the write */
+	spin_lock(&ictxt->lock);
+	xfer->seq = ictxt->tx_seq;
+	list_add_tail(&xfer->node, &ictxt->pending);
+	spin_unlock(&ictxt->lock);
+
 	len = tegra_hv_ivc_write(ictxt->ivck, msg, size);
+	spin_lock(&ictxt->lock);
 	if (len != size) {
 		pr_err("%s: write Error\n", __func__);
+		list_del_init(&xfer->node);
 		err = -EIO;
-		spin_unlock_irqrestore(&ictxt->ivck_tx_lock, flags1);
-		goto fail;
+	} else {
+		ictxt->tx_seq++;
 	}
-	spin_unlock_irqrestore(&ictxt->ivck_tx_lock, flags1);
+	spin_unlock(&ictxt->lock);
 
-	err = readx_poll_timeout_atomic(tegra_hv_ivc_can_read, ictxt->ivck,
-			status, status, 10, NVAUDIO_IVC_WAIT_TIMEOUT);
+fail:
+	spin_unlock_irqrestore(&ictxt->ivck_tx_lock, flags);
+	return err;
+}
+EXPORT_SYMBOL_GPL(nvaudio_ivc_submit);
 
-	if (err == -ETIMEDOUT) {
-		pr_err("%s: Waited too long for msg reply\n", __func__);
-		goto fail;
-	}
+static int nvaudio_ivc_xfer_timeout(struct nvaudio_ivc_xfer *xfer)
+{
+	struct nvaudio_ivc_ctxt *ictxt = xfer->ictxt;
+	unsigned long flags;
+	bool pending;
 
-	/* Message available */
-	memset(rx_msg, 0, sizeof(struct nvaudio_ivc_msg));
-	len = tegra_hv_ivc_read(ictxt->ivck,
-				rx_msg,
-				sizeof(struct nvaudio_ivc_msg));
-	if (len != sizeof(struct nvaudio_ivc_msg)) {
-		dev_err(ictxt->dev, "IVC read failure (msg size error)\n");
-		err = -1;
-		goto fail;
-	}
-	err = len;
+	spin_lock_irqsave(&ictxt->lock, flags);
+	pending = !list_empty(&xfer->node);
+	list_del_init(&xfer->node);
+	spin_unlock_irqrestore(&ictxt->lock, flags);
 
-fail:
-	spin_unlock_irqrestore(&ictxt->ivck_rx_lock, flags);
+	/* reply arrived while timing out */
+	if (!pending)
+		return xfer->status;
+
+	pr_err("%s: Waited too long for msg reply\n", __func__);
+	return -ETIMEDOUT;
+}
+
+static bool nvaudio_ivc_xfer_poll(struct nvaudio_ivc_xfer *xfer)
+{
+	nvaudio_ivc_rx_drain(xfer->ictxt);
+
+	return completion_done(&xfer->done);
+}
+
+static int nvaudio_ivc_wait_atomic(struct nvaudio_ivc_xfer *xfer)
+{
+	bool done;
+	int err;
+
+	err = readx_poll_timeout_atomic(nvaudio_ivc_xfer_poll, xfer,
+			done, done, 10, NVAUDIO_IVC_WAIT_TIMEOUT);
+	if (err == -ETIMEDOUT)
+		return nvaudio_ivc_xfer_timeout(xfer);
+
+	return xfer->status;
+}
+
+/*
+ * Wait for the reply to a request queued with nvaudio_ivc_submit().
+ * Sleeps unless the channel interrupt is unavailable. Returns the reply
+ * length or a negative error.
+ */
+int nvaudio_ivc_wait(struct nvaudio_ivc_xfer *xfer)
+{
+	if (!xfer->ictxt->irq_enabled)
+		return nvaudio_ivc_wait_atomic(xfer);
+
+	if (!wait_for_completion_timeout(&xfer->done,
+			usecs_to_jiffies(NVAUDIO_IVC_WAIT_TIMEOUT)))
+		return nvaudio_ivc_xfer_timeout(xfer);
+
+	return xfer->status;
+}
+EXPORT_SYMBOL_GPL(nvaudio_ivc_wait);
+
+static int nvaudio_ivc_transact(struct nvaudio_ivc_ctxt *ictxt,
+		struct nvaudio_ivc_msg *msg, int size, bool atomic)
+{
+	struct nvaudio_ivc_xfer xfer;
+	struct nvaudio_ivc_msg req;
+	uint32_t gen;
+	int err;
+
+	if (!ictxt || !ictxt->ivck || !msg || !size)
+		return -EINVAL;
+
+	if (nvaudio_ivc_cache_lookup(ictxt, msg))
+		return sizeof(struct nvaudio_ivc_msg);
+
+	memcpy(&req, msg, sizeof(req));
+	gen = READ_ONCE(ictxt->cache_gen);
+
+	err = nvaudio_ivc_submit(ictxt, &xfer, msg, size);
+	if (err < 0)
+		return err;
+
+	if (atomic)
+		err = nvaudio_ivc_wait_atomic(&xfer);
+	else
+		err = nvaudio_ivc_wait(&xfer);
+
+	if (err >= 0)
+		nvaudio_ivc_cache_update(ictxt, &req, msg, gen);
 
 	return err;
+}
 
+int nvaudio_ivc_send_receive(struct nvaudio_ivc_ctxt *ictxt,
+			struct nvaudio_ivc_msg *rx_msg, int size)
+{
+	return nvaudio_ivc_transact(ictxt, rx_msg, size, false);
 }
 EXPORT_SYMBOL_GPL(nvaudio_ivc_send_receive);
 
+/* As nvaudio_ivc_send_receive(), for callers that may not sleep */
+int nvaudio_ivc_send_receive_atomic(struct nvaudio_ivc_ctxt *ictxt,
+			struct nvaudio_ivc_msg *rx_msg, int size)
+{
+	return nvaudio_ivc_transact(ictxt, rx_msg, size, true);
+}
+EXPORT_SYMBOL_GPL(nvaudio_ivc_send_receive_atomic);
+
 /* Every communication with the server is identified
  * with this ivc context.
- * There can be one outstanding request to the server per
- * ivc context.
+ * Replies are matched in submission order, so several requests
+ * may be outstanding to the server per ivc context.
  */
 struct nvaudio_ivc_ctxt *nvaudio_ivc_alloc_ctxt(struct device *dev)
 {
@@ -174,6 +610,11 @@ struct nvaudio_ivc_ctxt *nvaudio_ivc_alloc_ctxt(struct device *dev)
 	saved_ivc_ctxt = ictxt;
 	ictxt->dev = dev;
 	ictxt->timeout = 250; /* Not used in polling */
+	spin_lock_init(&ictxt->lock);
+	spin_lock_init(&ictxt->cache_lock);
+	INIT_LIST_HEAD(&ictxt->pending);
+	hash_init(ictxt->cache);
+
 	if (nvaudio_ivc_init(ictxt) != 0) {
 		dev_err(dev, "nvaudio_ivc_init failed\n");
 		goto fail;
@@ -184,6 +625,13 @@ struct nvaudio_ivc_ctxt *nvaudio_ivc_alloc_ctxt(struct device *dev)
 
 	tegra_hv_ivc_channel_reset(ictxt->ivck);
 
+	/* Replies are drained from the channel interrupt when available */
+	if (devm_request_irq(dev, ictxt->ivck->irq, nvaudio_ivc_irq, 0,
+			dev_name(dev), ictxt) == 0)
+		ictxt->irq_enabled = true;
+	else
+		dev_warn(dev, "ivc irq unavailable, polling for replies\n");
+
 	return ictxt;
 fail:
 	nvaudio_ivc_free_ctxt(dev);
@@ -205,6 +653,10 @@ EXPORT_SYMBOL_GPL(nvaudio_get_ivc_alloc_ctxt);
 void nvaudio_ivc_free_ctxt(struct device *dev)
 {
 	if (saved_ivc_ctxt) {
+		if (saved_ivc_ctxt->irq_enabled)
+			devm_free_irq(saved_ivc_ctxt->dev,
+				saved_ivc_ctxt->ivck->irq, saved_ivc_ctxt);
+		nvaudio_ivc_cache_flush(saved_ivc_ctxt);
 		nvaudio_ivc_deinit(saved_ivc_ctxt);
 		devm_kfree(dev, saved_ivc_ctxt);
 		saved_ivc_ctxt = NULL;
@@ -6,10 +6,31 @@
 #ifndef __TEGRA_VIRT_ALT_IVC_H__
 #define __TEGRA_VIRT_ALT_IVC_H__
 
+#include <linux/completion.h>
+#include <linux/hashtable.h>
+#include <linux/list.h>
+
 #include "tegra_virt_alt_ivc_common.h"
 
 #define NVAUDIO_IVC_WAIT_TIMEOUT	1000000
+#define NVAUDIO_IVC_CACHE_BITS		6
 struct nvaudio_ivc_dev;
+struct nvaudio_ivc_ctxt;
+
+/*
+ * One outstanding request to the server. The server answers requests in
+ * the order they were written, so the reply is matched by the sequence
+ * number of the request and copied back into msg. Nothing of this goes
+ * on the wire.
+ */
+struct nvaudio_ivc_xfer {
+	struct list_head		node;
+	struct nvaudio_ivc_ctxt		*ictxt;
+	struct nvaudio_ivc_msg		*msg;
+	struct completion		done;
+	uint32_t			seq;
+	int				status;
+};
 
 struct nvaudio_ivc_ctxt {
 	struct tegra_hv_ivc_cookie	*ivck;
@@ -22,6 +43,13 @@ struct nvaudio_ivc_ctxt {
 	spinlock_t			ivck_rx_lock;
 	spinlock_t			ivck_tx_lock;
 	spinlock_t			lock;
+	struct list_head		pending;
+	uint32_t			tx_seq;
+	uint32_t			rx_seq;
+	bool				irq_enabled;
+	spinlock_t			cache_lock;
+	uint32_t			cache_gen;
+	DECLARE_HASHTABLE(cache, NVAUDIO_IVC_CACHE_BITS);
 };
 
 void nvaudio_ivc_rx(struct tegra_hv_ivc_cookie *ivck);
@@ -42,6 +70,19 @@ int nvaudio_ivc_send_receive(struct nvaudio_ivc_ctxt *ictxt,
 				struct nvaudio_ivc_msg *msg,
 				int size);
 
+int nvaudio_ivc_send_receive_atomic(struct nvaudio_ivc_ctxt *ictxt,
+				struct nvaudio_ivc_msg *msg,
+				int size);
+
+int nvaudio_ivc_submit(struct nvaudio_ivc_ctxt *ictxt,
+				struct nvaudio_ivc_xfer *xfer,
+				struct nvaudio_ivc_msg *msg,
+				int size);
+
+int nvaudio_ivc_wait(struct nvaudio_ivc_xfer *xfer);
+
+void nvaudio_ivc_cache_flush(struct nvaudio_ivc_ctxt *ictxt);
+
 int tegra124_virt_xbar_set_ivc(struct nvaudio_ivc_ctxt *ictxt,
 					int rx_idx,
 					int tx_idx);
@@ -113,6 +113,14 @@ void tegra210_ahub_write_ram(struct regmap *regmap, unsigned int reg_ctrl,
 	val |= TEGRA210_AHUBRAMCTL_CTRL_RW_WRITE;
 
 	regmap_write(regmap, reg_ctrl, val);
+
+	/*
+	 * Stream the words in one go where the regmap allows a
+	 * non-incrementing write to the data register.
+	 */
+	if (!regmap_noinc_write(regmap, reg_data, data, size * sizeof(*data)))
+		return;
+
 	for (i = 0; i < size; i++)
 		regmap_write(regmap, reg_data, data[i]);
 
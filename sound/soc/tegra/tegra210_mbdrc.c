@@ -328,9 +328,12 @@ static int tegra210_mbdrc_biquad_coeffs_put(struct snd_kcontrol *kcontrol,
 	u32 reg_ctrl = params->soc.base;
 	u32 reg_data = reg_ctrl + cmpnt->val_bytes;
 	u32 *data = (u32 *)ucontrol->value.bytes.data;
+	u32 band = (reg_ctrl - TEGRA210_MBDRC_AHUBRAMCTL_CONFIG_RAM_CTRL) /
+		   TEGRA210_MBDRC_FILTER_PARAM_STRIDE;
 
 	tegra210_ahub_write_ram(ope->mbdrc_regmap, reg_ctrl, reg_data,
 				    params->shift, data, params->soc.num_regs);
+	clear_bit(band, &ope->mbdrc_ram_default);
 
 	return 0;
 }
@@ -679,6 +682,7 @@ static const struct regmap_config tegra210_mbdrc_regmap_config = {
 	.readable_reg = tegra210_mbdrc_rd_reg,
 	.volatile_reg = tegra210_mbdrc_volatile_reg,
 	.precious_reg = tegra210_mbdrc_precious_reg,
+	.writeable_noinc_reg = tegra210_mbdrc_precious_reg,
 	.reg_defaults = tegra210_mbdrc_reg_defaults,
 	.num_reg_defaults = ARRAY_SIZE(tegra210_mbdrc_reg_defaults),
 	.cache_type = REGCACHE_FLAT,
@@ -700,11 +704,16 @@ int tegra210_mbdrc_hw_params(struct snd_soc_component *cmpnt)
 		&conf->band_params[i];
 		u32 reg_off = i * TEGRA210_MBDRC_FILTER_PARAM_STRIDE;
 
+		/* skip bands whose RAM still holds these coefficients */
+		if (test_bit(i, &ope->mbdrc_ram_default))
+			continue;
+
 		tegra210_ahub_write_ram(ope->mbdrc_regmap,
 			reg_off + TEGRA210_MBDRC_AHUBRAMCTL_CONFIG_RAM_CTRL,
 			reg_off + TEGRA210_MBDRC_AHUBRAMCTL_CONFIG_RAM_DATA, 0,
 			(u32 *)&params->biquad_params[0],
 			TEGRA210_MBDRC_MAX_BIQUAD_STAGES * 5);
+		set_bit(i, &ope->mbdrc_ram_default);
 	}
 	return 0;
 }
@@ -858,6 +867,7 @@ int tegra210_mbdrc_codec_init(struct snd_soc_component *cmpnt)
 			reg_off + TEGRA210_MBDRC_AHUBRAMCTL_CONFIG_RAM_DATA, 0,
 			(u32 *)&params->biquad_params[0],
 			TEGRA210_MBDRC_MAX_BIQUAD_STAGES * 5);
+		set_bit(i, &ope->mbdrc_ram_default);
 	}
 	pm_runtime_put_sync(cmpnt->dev);
 
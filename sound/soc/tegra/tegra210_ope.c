@@ -39,6 +39,8 @@ static int tegra210_ope_runtime_suspend(struct device *dev)
 	struct tegra210_ope *ope = dev_get_drvdata(dev);
 
 	tegra210_peq_save(ope);
+	/* MBDRC RAM is not retained, hw_params must reload it */
+	ope->mbdrc_ram_default = 0;
 
 	regcache_cache_only(ope->mbdrc_regmap, true);
 	regcache_cache_only(ope->peq_regmap, true);
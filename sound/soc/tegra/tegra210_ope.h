@@ -64,8 +64,14 @@ struct tegra210_ope {
 	struct regmap *regmap;
 	struct regmap *peq_regmap;
 	struct regmap *mbdrc_regmap;
-	u32 peq_biquad_gains[TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH];
-	u32 peq_biquad_shifts[TEGRA210_PEQ_SHIFT_PARAM_SIZE_PER_CH];
+	/* copy of PEQ coefficient RAM, valid while peq_ram_valid is set */
+	u32 peq_biquad_gains[TEGRA210_PEQ_MAX_CHANNELS *
+			     TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH];
+	u32 peq_biquad_shifts[TEGRA210_PEQ_MAX_CHANNELS *
+			      TEGRA210_PEQ_SHIFT_PARAM_SIZE_PER_CH];
+	bool peq_ram_valid;
+	/* MBDRC bands whose biquad RAM holds the default coefficients */
+	unsigned long mbdrc_ram_default;
 };
 
 extern int tegra210_peq_regmap_init(struct platform_device *pdev);
@@ -116,6 +116,42 @@ static int tegra210_peq_ahub_ram_get(struct snd_kcontrol *kcontrol,
 	return 0;
 }
 
+/*
+ * Writes to PEQ coefficient RAM keep a copy in the OPE, so that writes
+ * which would not change RAM content are skipped and the whole RAM can
+ * be written back in bulk after power up.
+ */
+static void tegra210_peq_write_ram(struct tegra210_ope *ope, u32 reg_ctrl,
+				   u32 offset, u32 *data, size_t size)
+{
+	u32 reg_data = reg_ctrl + sizeof(u32);
+	u32 *shadow;
+	size_t depth;
+
+	if (reg_ctrl == TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_CTRL) {
+		shadow = ope->peq_biquad_gains;
+		depth = ARRAY_SIZE(ope->peq_biquad_gains);
+	} else {
+		shadow = ope->peq_biquad_shifts;
+		depth = ARRAY_SIZE(ope->peq_biquad_shifts);
+	}
+
+	if (WARN_ON_ONCE(offset + size > depth)) {
+		tegra210_ahub_write_ram(ope->peq_regmap, reg_ctrl, reg_data,
+					offset, data, size);
+		ope->peq_ram_valid = false;
+		return;
+	}
+
+	if (ope->peq_ram_valid &&
+	    !memcmp(&shadow[offset], data, size * sizeof(u32)))
+		return;
+
+	tegra210_ahub_write_ram(ope->peq_regmap, reg_ctrl, reg_data,
+				offset, data, size);
+	memcpy(&shadow[offset], data, size * sizeof(u32));
+}
+
 static int tegra210_peq_ahub_ram_put(struct snd_kcontrol *kcontrol,
 	struct snd_ctl_elem_value *ucontrol)
 {
@@ -123,15 +159,14 @@ static int tegra210_peq_ahub_ram_put(struct snd_kcontrol *kcontrol,
 	struct snd_soc_component *cmpnt = snd_soc_kcontrol_component(kcontrol);
 	struct tegra210_ope *ope = snd_soc_component_get_drvdata(cmpnt);
 	u32 i, reg_ctrl = params->soc.base;
-	u32 reg_data = reg_ctrl + cmpnt->val_bytes;
 	s32 *data = (s32 *)biquad_coeff_buffer;
 
 	for (i = 0; i < params->soc.num_regs; i++)
 		data[i] = (s32)ucontrol->value.integer.value[i];
 
 	pm_runtime_get_sync(cmpnt->dev);
-	tegra210_ahub_write_ram(ope->peq_regmap, reg_ctrl, reg_data,
-				    params->shift, data, params->soc.num_regs);
+	tegra210_peq_write_ram(ope, reg_ctrl, params->shift, (u32 *)data,
+			       params->soc.num_regs);
 	pm_runtime_put_sync(cmpnt->dev);
 
 	return 0;
@@ -263,6 +298,7 @@ static const struct regmap_config tegra210_peq_regmap_config = {
 	.readable_reg = tegra210_peq_rd_reg,
 	.volatile_reg = tegra210_peq_volatile_reg,
 	.precious_reg = tegra210_peq_precious_reg,
+	.writeable_noinc_reg = tegra210_peq_precious_reg,
 	.reg_defaults = tegra210_peq_reg_defaults,
 	.num_reg_defaults = ARRAY_SIZE(tegra210_peq_reg_defaults),
 	.cache_type = REGCACHE_FLAT,
@@ -270,47 +306,28 @@ static const struct regmap_config tegra210_peq_regmap_config = {
 
 void tegra210_peq_restore(struct tegra210_ope *ope)
 {
-	unsigned int i;
-
-	for (i = 0; i < TEGRA210_PEQ_MAX_CHANNELS; i++) {
-		tegra210_ahub_write_ram(ope->peq_regmap,
-			TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_CTRL,
-			TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_DATA,
-			(i * TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH),
-			(u32 *)&ope->peq_biquad_gains,
-			TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH);
-
-		tegra210_ahub_write_ram(ope->peq_regmap,
-			TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_SHIFT_CTRL,
-			TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_SHIFT_DATA,
-			(i * TEGRA210_PEQ_SHIFT_PARAM_SIZE_PER_CH),
-			(u32 *)&ope->peq_biquad_shifts,
-			TEGRA210_PEQ_SHIFT_PARAM_SIZE_PER_CH);
-
-	}
+	/* channel RAM regions are contiguous, write each RAM in one go */
+	tegra210_ahub_write_ram(ope->peq_regmap,
+		TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_CTRL,
+		TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_DATA, 0,
+		ope->peq_biquad_gains, ARRAY_SIZE(ope->peq_biquad_gains));
+
+	tegra210_ahub_write_ram(ope->peq_regmap,
+		TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_SHIFT_CTRL,
+		TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_SHIFT_DATA, 0,
+		ope->peq_biquad_shifts, ARRAY_SIZE(ope->peq_biquad_shifts));
+
+	ope->peq_ram_valid = true;
 }
 EXPORT_SYMBOL_GPL(tegra210_peq_restore);
 
 void tegra210_peq_save(struct tegra210_ope *ope)
 {
-	unsigned int i;
-
-	for (i = 0; i < TEGRA210_PEQ_MAX_CHANNELS; i++) {
-		tegra210_ahub_read_ram(ope->peq_regmap,
-			TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_CTRL,
-			TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_DATA,
-			(i * TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH),
-			(u32 *)&ope->peq_biquad_gains,
-			TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH);
-
-		tegra210_ahub_read_ram(ope->peq_regmap,
-			TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_SHIFT_CTRL,
-			TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_SHIFT_DATA,
-			(i * TEGRA210_PEQ_SHIFT_PARAM_SIZE_PER_CH),
-			(u32 *)&ope->peq_biquad_shifts,
-			TEGRA210_PEQ_SHIFT_PARAM_SIZE_PER_CH);
-
-	}
+	/*
+	 * The driver copy already holds the RAM content, only note that
+	 * RAM is lost while powered down.
+	 */
+	ope->peq_ram_valid = false;
 }
 EXPORT_SYMBOL_GPL(tegra210_peq_save);
 
@@ -331,21 +348,20 @@ int tegra210_peq_codec_init(struct snd_soc_component *cmpnt)
 	/* Initialize PEQ AHUB RAM with default params */
 	for (i = 0; i < TEGRA210_PEQ_MAX_CHANNELS; i++) {
 		/* Set default gain params */
-		tegra210_ahub_write_ram(ope->peq_regmap,
+		tegra210_peq_write_ram(ope,
 			TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_CTRL,
-			TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_DATA,
 			(i * TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH),
 			(u32 *)&biquad_init_gains,
 			TEGRA210_PEQ_GAIN_PARAM_SIZE_PER_CH);
 
 		/* Set default shift params */
-		tegra210_ahub_write_ram(ope->peq_regmap,
+		tegra210_peq_write_ram(ope,
 			TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_SHIFT_CTRL,
-			TEGRA210_PEQ_AHUBRAMCTL_CONFIG_RAM_SHIFT_DATA,
 			(i * TEGRA210_PEQ_SHIFT_PARAM_SIZE_PER_CH),
 			(u32 *)&biquad_init_shifts,
 			TEGRA210_PEQ_SHIFT_PARAM_SIZE_PER_CH);
 	}
+	ope->peq_ram_valid = true;
 	pm_runtime_put_sync(cmpnt->dev);
 
 	snd_soc_add_component_controls(cmpnt, tegra210_peq_controls,
@@ -2910,6 +2910,7 @@ static int tegra210_sfc_runtime_suspend(struct device *dev)
 
 	regcache_cache_only(sfc->regmap, true);
 	regcache_mark_dirty(sfc->regmap);
+	sfc->coef_loaded = NULL;
 
 	return 0;
 }
@@ -2932,18 +2933,20 @@ static int tegra210_sfc_write_coeff_ram(struct tegra210_sfc *sfc)
 	if (!coeff_ram)
 		return -EINVAL;
 
-	if (coeff_ram) {
+	/* soft reset keeps RAM content, reload only for a new rate pair */
+	if (sfc->coef_loaded != coeff_ram) {
 		tegra210_ahub_write_ram(sfc->regmap,
 			TEGRA210_SFC_CFG_RAM_CTRL,
 			TEGRA210_SFC_CFG_RAM_DATA,
 			0, coeff_ram, TEGRA210_SFC_COEF_RAM_DEPTH);
-
-		regmap_update_bits(sfc->regmap,
-			TEGRA210_SFC_COEF_RAM,
-			TEGRA210_SFC_COEF_RAM_EN,
-			TEGRA210_SFC_COEF_RAM_EN);
+		sfc->coef_loaded = coeff_ram;
 	}
 
+	regmap_update_bits(sfc->regmap,
+		TEGRA210_SFC_COEF_RAM,
+		TEGRA210_SFC_COEF_RAM_EN,
+		TEGRA210_SFC_COEF_RAM_EN);
+
 	return 0;
 }
 
@@ -3441,6 +3444,7 @@ static const struct regmap_config tegra210_sfc_regmap_config = {
 	.readable_reg = tegra210_sfc_rd_reg,
 	.volatile_reg = tegra210_sfc_volatile_reg,
 	.precious_reg = tegra210_sfc_precious_reg,
+	.writeable_noinc_reg = tegra210_sfc_precious_reg,
 	.reg_defaults = tegra210_sfc_reg_defaults,
 	.num_reg_defaults = ARRAY_SIZE(tegra210_sfc_reg_defaults),
 	.cache_type = REGCACHE_FLAT,
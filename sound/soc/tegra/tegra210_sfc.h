@@ -75,6 +75,8 @@ struct tegra210_sfc {
 	int client_ch_override; /* common for both TX and RX */
 	int stereo_to_mono[SFC_PATHS];
 	int mono_to_stereo[SFC_PATHS];
+	/* coefficients in SFC RAM, NULL once RAM content may be lost */
+	const u32 *coef_loaded;
 };
 
 #endif